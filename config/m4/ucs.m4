@@ -82,7 +82,7 @@ AS_IF([test "x$enable_backtrace_detail" == xyes],
 #
 AC_ARG_ENABLE([stats],
 	AS_HELP_STRING([--enable-stats], 
-	               [Enable statistics, useful for profiling, default: NO]),
+	               [Compile in statistics, which are collected only when UCX_STATS_DEST is set, default: NO]),
 	[],
 	[enable_stats=no])
 	
@@ -149,6 +149,33 @@ if [ -n "$JENKINS_RUN_TESTS" ]; then
 
     rm -f ./active_message
 
+    # incast and all-to-all over the socket RTE, a star of 3 processes
+    UCX_PERFTEST_PORT=$(( 10500 + ${BASHPID} ))
+    opt_perftest_group="-G 3 -p ${UCX_PERFTEST_PORT} -x mm -d posix -n 10000 -w 100"
+    for tname in am_incast am_alltoall tag_incast tag_alltoall; do
+        echo Running ucx_perftest ${tname} with 3 processes
+        $ucx_inst/bin/ucx_perftest ${opt_perftest_group} -t ${tname} > ptest_server.log &
+        ptest_server_pid=$!
+
+        sleep 3
+
+        $ucx_inst/bin/ucx_perftest ${opt_perftest_group} -t ${tname} $(hostname) &
+        ptest_client1_pid=$!
+        $ucx_inst/bin/ucx_perftest ${opt_perftest_group} -t ${tname} $(hostname) &
+        ptest_client2_pid=$!
+
+        wait ${ptest_server_pid}
+        wait ${ptest_client1_pid}
+        wait ${ptest_client2_pid}
+        cat ptest_server.log
+
+        # The server must receive everything the clients announced in FIN
+        if [[ ${tname} =~ .*incast ]]; then
+            grep -q "recv msgs: *20000 " ptest_server.log
+        fi
+    done
+    rm -f ptest_server.log
+
     for tname in malloc_hooks external_events flag_no_install; do
         echo "Running memory hook (${tname}) on MPI"
         mpirun -np 1 -mca pml ob1 -mca btl sm,self -mca coll ^hcoll,ml $AFFINITY ./test/mpi/test_memhooks -t $tname
@@ -180,6 +207,8 @@ if [ -n "$JENKINS_RUN_TESTS" ]; then
     ${ucx_inst}/bin/ucx_read_profile -r ucx_jenkins.prof | grep "printf" -C 20
     ${ucx_inst}/bin/ucx_read_profile -r ucx_jenkins.prof | grep -q "calc_pi"
     ${ucx_inst}/bin/ucx_read_profile -r ucx_jenkins.prof | grep -q "print_pi"
+    ${ucx_inst}/bin/ucx_read_profile -r -s ucx_jenkins.prof | grep -q "^    leibnitz "
+    ${ucx_inst}/bin/ucx_read_profile -r -s ucx_jenkins.prof | grep -q "^    printf "
 
     export GTEST_RANDOM_SEED=0
     export GTEST_SHUFFLE=1
@@ -0,0 +1,205 @@
+#!/usr/bin/python
+
+"""
+This python script compares ucx_perftest results, printed with the "-J" option,
+against a stored baseline. Results of the same test configuration are grouped,
+so running the benchmark several times into the same file provides the samples
+for a statistical test. A metric is flagged as a regression when it is worse by
+more than the threshold, and - if both sides have at least 2 samples - Welch's
+t-test shows the difference is significant.
+
+Example:
+  ucx_perftest <server> -t tag_bw -S 1:4m -J > current.json   (several times)
+  ucx_perftest_compare.py baseline.json current.json
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import math
+import sys
+
+# Metric path in the result, and whether higher values are better
+METRICS = [
+    ("latency_usec.overall",  False),
+    ("latency_usec.p99",      False),
+    ("bandwidth_mbs.overall", True),
+    ("msgrate.overall",       True),
+]
+
+# Result fields which are not part of the test configuration
+NON_KEY_FIELDS = set(["host", "ucx_version", "env", "iterations", "latency_usec",
+                      "bandwidth_mbs", "msgrate", "recv"])
+
+
+def read_results(file_paths):
+    results = {}
+    for file_path in file_paths:
+        with open(file_path) as f:
+            for line_num, line in enumerate(f, 1):
+                line = line.strip()
+                if not line.startswith("{"):
+                    continue # Not a result, e.g. a log message
+                try:
+                    result = json.loads(line)
+                except ValueError as e:
+                    print("%s:%d: %s" % (file_path, line_num, e), file=sys.stderr)
+                    continue
+                key = tuple(sorted((k, str(v)) for k, v in result.items()
+                                   if k not in NON_KEY_FIELDS))
+                results.setdefault(key, []).append(result)
+    return results
+
+
+def get_metric(result, path):
+    value = result
+    for field in path.split("."):
+        value = value[field]
+    return float(value)
+
+
+def mean_var(samples):
+    n = len(samples)
+    mean = sum(samples) / n
+    if n < 2:
+        return mean, 0.0
+    return mean, sum((x - mean) ** 2 for x in samples) / (n - 1)
+
+
+def betacf(a, b, x):
+    """Continued fraction for the incomplete beta function"""
+    tiny = 1e-30
+    qab, qap, qam = a + b, a + 1.0, a - 1.0
+    c = 1.0
+    d = 1.0 - qab * x / qap
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    h = d
+    for m in range(1, 200):
+        m2 = 2 * m
+        aa = m * (b - m) * x / ((qam + m2) * (a + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        h *= d * c
+        aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2))
+        d = 1.0 + aa * d
+        d = 1.0 / (d if abs(d) > tiny else tiny)
+        c = 1.0 + aa / c
+        c = c if abs(c) > tiny else tiny
+        delta = d * c
+        h *= delta
+        if abs(delta - 1.0) < 1e-12:
+            break
+    return h
+
+
+def betai(a, b, x):
+    """Regularized incomplete beta function"""
+    if x <= 0.0:
+        return 0.0
+    if x >= 1.0:
+        return 1.0
+    bt = math.exp(math.lgamma(a + b) - math.lgamma(a) - math.lgamma(b) +
+                  a * math.log(x) + b * math.log(1.0 - x))
+    if x < (a + 1.0) / (a + b + 2.0):
+        return bt * betacf(a, b, x) / a
+    return 1.0 - bt * betacf(b, a, 1.0 - x) / b
+
+
+def welch_p_worse(base, cur, higher_is_better):
+    """One-sided p-value of the current samples being worse than the baseline"""
+    mb, vb = mean_var(base)
+    mc, vc = mean_var(cur)
+    se2 = vb / len(base) + vc / len(cur)
+    worse = (mc < mb) if higher_is_better else (mc > mb)
+    if se2 == 0.0:
+        return 0.0 if worse else 1.0
+    t = abs(mc - mb) / math.sqrt(se2)
+    df = se2 ** 2 / ((vb / len(base)) ** 2 / (len(base) - 1) +
+                     (vc / len(cur)) ** 2 / (len(cur) - 1))
+    p_two_sided = betai(df / 2.0, 0.5, df / (df + t * t))
+    return p_two_sided / 2.0 if worse else 1.0 - p_two_sided / 2.0
+
+
+def describe(result):
+    desc = result["test"]
+    name = result.get("name", "")
+    size = str(result["message_size"])
+    if name.endswith(size):
+        name = name[:-len(size)].rstrip("/") # Sweep size is printed below
+    if name:
+        desc += " " + name
+    if result.get("transport"):
+        desc += " %s/%s" % (result["transport"], result.get("device", ""))
+    desc += " %sB" % result["message_size"]
+    if result.get("thread") != "all":
+        desc += " thread %s" % result["thread"]
+    return desc
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Compare ucx_perftest JSON results against a baseline.")
+    parser.add_argument("baseline", help="baseline results, comma-separated files")
+    parser.add_argument("current", help="current results, comma-separated files")
+    parser.add_argument("-t", "--threshold", type=float, default=5.0,
+                        help="minimal change to report, percent (5)")
+    parser.add_argument("-a", "--alpha", type=float, default=0.05,
+                        help="significance level of the t-test (0.05)")
+    parser.add_argument("-v", "--verbose", action="store_true",
+                        help="print all compared metrics, not only changes")
+    args = parser.parse_args()
+
+    baseline = read_results(args.baseline.split(","))
+    current  = read_results(args.current.split(","))
+
+    num_regressions = 0
+    print("%-50s %-22s %12s %12s %8s %7s  %s" %
+          ("test", "metric", "baseline", "current", "change", "p", "verdict"))
+    for key in sorted(set(baseline) & set(current)):
+        base_results, cur_results = baseline[key], current[key]
+        for path, higher_is_better in METRICS:
+            try:
+                base = [get_metric(r, path) for r in base_results]
+                cur  = [get_metric(r, path) for r in cur_results]
+            except KeyError:
+                continue
+            mb, mc = sum(base) / len(base), sum(cur) / len(cur)
+            if mb == 0.0:
+                continue
+
+            change = (mc - mb) / mb * 100.0
+            worse_pct = -change if higher_is_better else change
+            if (len(base) > 1) and (len(cur) > 1):
+                p = welch_p_worse(base, cur, higher_is_better)
+                p_str = "%.4f" % p
+                significant = p < args.alpha
+            else:
+                p_str = "n/a" # Not enough samples, use the threshold alone
+                significant = True
+
+            if (worse_pct > args.threshold) and significant:
+                verdict = "REGRESSION"
+                num_regressions += 1
+            elif worse_pct < -args.threshold:
+                verdict = "improved"
+            elif args.verbose:
+                verdict = "ok"
+            else:
+                continue
+
+            print("%-50s %-22s %12.4f %12.4f %+7.1f%% %7s  %s" %
+                  (describe(cur_results[0])[:50], path, mb, mc, change, p_str,
+                   verdict))
+
+    missing = len(set(baseline) - set(current))
+    if missing > 0:
+        print("%d baseline configurations have no current results" % missing)
+    print("%d regressions found" % num_regressions)
+    return 1 if num_regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -9,7 +9,9 @@
 #include "libperf_int.h"
 
 #include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
 #include <malloc.h>
+#include <string.h>
 #include <unistd.h>
 
 
@@ -170,6 +172,13 @@ static void ucx_perf_test_reset(ucx_perf_context_t *perf,
     for (i = 0; i < TIMING_QUEUE_SIZE; ++i) {
         perf->timing_queue[i] = 0;
     }
+    perf->latency_sample_mask =
+        (perf->params.test_type == UCX_PERF_TEST_TYPE_PINGPONG) ? 0 :
+        (UCX_PERF_LATENCY_SAMPLE_INTERVAL - 1);
+    memset(perf->latency_hist, 0, sizeof(perf->latency_hist));
+    perf->ep_index          = 0;
+    perf->ep_seed           = perf->thread_index + 1;
+    memset(&perf->recv, 0, sizeof(perf->recv));
 }
 
 void ucx_perf_test_cleanup(ucx_perf_context_t *perf)
@@ -178,18 +187,87 @@ void ucx_perf_test_cleanup(ucx_perf_context_t *perf)
     free(perf->recv_buffer);
 }
 
+/*
+ * Return the lowest value of the bucket which holds the given percentile of
+ * the latency histogram samples.
+ */
+static double ucx_perf_latency_percentile(const ucx_perf_counter_t *hist,
+                                          ucx_perf_counter_t count,
+                                          double percentile)
+{
+    ucx_perf_counter_t threshold, sum;
+    unsigned i;
+
+    threshold = (ucx_perf_counter_t)(count * percentile / 100.0 + 0.5);
+    threshold = ucs_max(threshold, 1);
+
+    sum = 0;
+    for (i = 0; i < UCX_PERF_LATENCY_HIST_BUCKETS; ++i) {
+        sum += hist[i];
+        if (sum >= threshold) {
+            return ucs_stats_histogram_bucket_value(i);
+        }
+    }
+
+    return ucs_stats_histogram_bucket_value(UCX_PERF_LATENCY_HIST_BUCKETS - 1);
+}
+
+static void ucx_perf_calc_latency_dist(const ucx_perf_counter_t *hist,
+                                       ucx_perf_result_t *result,
+                                       double unit)
+{
+    double value, mean, deviation;
+    ucx_perf_counter_t count;
+    unsigned i;
+
+    count = 0;
+    mean  = 0.0;
+    for (i = 0; i < UCX_PERF_LATENCY_HIST_BUCKETS; ++i) {
+        count += hist[i];
+        mean  += hist[i] * (double)ucs_stats_histogram_bucket_value(i);
+    }
+
+    result->latency_dist.samples     = count;
+    result->latency_dist.bucket_unit = unit;
+    result->latency_dist.histogram   = hist;
+    if (count == 0) {
+        result->latency_dist.p50    = 0.0;
+        result->latency_dist.p99    = 0.0;
+        result->latency_dist.p999   = 0.0;
+        result->latency_dist.jitter = 0.0;
+        return;
+    }
+
+    /* Jitter is the mean absolute deviation from the average latency */
+    mean     /= count;
+    deviation = 0.0;
+    for (i = 0; i < UCX_PERF_LATENCY_HIST_BUCKETS; ++i) {
+        value      = ucs_stats_histogram_bucket_value(i) - mean;
+        deviation += hist[i] * ((value < 0) ? -value : value);
+    }
+
+    result->latency_dist.p50    = unit * ucx_perf_latency_percentile(hist, count, 50.0);
+    result->latency_dist.p99    = unit * ucx_perf_latency_percentile(hist, count, 99.0);
+    result->latency_dist.p999   = unit * ucx_perf_latency_percentile(hist, count, 99.9);
+    result->latency_dist.jitter = unit * deviation / count;
+}
+
 void ucx_perf_calc_result(ucx_perf_context_t *perf, ucx_perf_result_t *result)
 {
     double latency_factor;
     double sec_value;
 
     sec_value = ucs_time_from_sec(1.0);
-    if (perf->params.test_type == UCX_PERF_TEST_TYPE_PINGPONG) {
+    if ((perf->params.test_type == UCX_PERF_TEST_TYPE_PINGPONG) &&
+        (perf->params.command != UCX_PERF_CMD_CONNECT))
+    {
+        /* Half of the round trip; a connection is measured as a whole */
         latency_factor = 2.0;
     } else {
         latency_factor = 1.0;
     }
 
+    result->thread_index = perf->thread_index;
     result->iters = perf->current.iters;
     result->bytes = perf->current.bytes;
     result->elapsed_time = perf->current.time - perf->start_time;
@@ -213,6 +291,9 @@ void ucx_perf_calc_result(ucx_perf_context_t *perf, ucx_perf_result_t *result)
         / sec_value
         / latency_factor;
 
+    ucx_perf_calc_latency_dist(perf->latency_hist, result,
+                               1.0 / sec_value / latency_factor);
+
 
     /* Bandwidth */
 
@@ -239,10 +320,25 @@ void ucx_perf_calc_result(ucx_perf_context_t *perf, ucx_perf_result_t *result)
         perf->current.msgs * sec_value
         / (double)(perf->current.time - perf->start_time);
 
+
+    /* Receiver side */
+
+    result->recv.msgs      = perf->recv.msgs;
+    result->recv.unexp_max = perf->recv.unexp_max;
+
+    result->recv.msgrate = (perf->recv.msgs == 0) ? 0.0 :
+        perf->recv.msgs * sec_value
+        / (double)(perf->recv.time - perf->start_time);
+
+    result->recv.unexp_average = (perf->recv.unexp_samples == 0) ? 0.0 :
+        (double)perf->recv.unexp_total / perf->recv.unexp_samples;
+
 }
 
 static ucs_status_t ucx_perf_test_check_params(ucx_perf_params_t *params)
 {
+    unsigned group_size;
+
     if (params->message_size < 1) {
         if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
             ucs_error("Message size too small, need to be at least 1");
@@ -257,6 +353,44 @@ static ucs_status_t ucx_perf_test_check_params(ucx_perf_params_t *params)
         return UCS_ERR_INVALID_PARAM;
     }
 
+    if (params->ep_count < 1) {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("ep_count, need to be at least 1");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    if (params->ep_order >= UCX_PERF_EP_ORDER_LAST) {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("Invalid endpoint order");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    group_size = params->rte->group_size(params->rte_group);
+    if ((params->test_type == UCX_PERF_TEST_TYPE_INCAST) ||
+        (params->test_type == UCX_PERF_TEST_TYPE_ALLTOALL))
+    {
+        if (group_size < 2) {
+            if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("This test requires at least 2 processes");
+            }
+            return UCS_ERR_INVALID_PARAM;
+        }
+
+        if (params->thread_count > 1) {
+            if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("This test supports only a single thread");
+            }
+            return UCS_ERR_UNSUPPORTED;
+        }
+    } else if (group_size != 2) {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("This test requires exactly 2 processes");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
     return UCS_OK;
 }
 
@@ -417,39 +551,70 @@ static ucs_status_t uct_perf_test_check_capabilities(ucx_perf_params_t *params,
     return UCS_OK;
 }
 
+static void uct_perf_test_destroy_eps(ucx_perf_context_t *perf,
+                                      unsigned group_size)
+{
+    unsigned i, j;
+
+    for (i = 0; i < group_size; ++i) {
+        if (perf->uct.peers[i].rkey.type != NULL) {
+            uct_rkey_release(&perf->uct.peers[i].rkey);
+        }
+        if (perf->uct.peers[i].eps == NULL) {
+            continue;
+        }
+        for (j = 0; j < perf->params.ep_count; ++j) {
+            if (perf->uct.peers[i].eps[j] != NULL) {
+                uct_ep_destroy(perf->uct.peers[i].eps[j]);
+            }
+        }
+        free(perf->uct.peers[i].eps);
+    }
+    free(perf->uct.peers);
+}
+
 static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
 {
-    const size_t buffer_size = 2048;
+    const unsigned ep_count = perf->params.ep_count;
     ucx_perf_ep_info_t info, *remote_info;
-    unsigned group_size, i, group_index;
+    unsigned group_size, i, j, group_index;
     uct_device_addr_t *dev_addr;
     uct_iface_addr_t *iface_addr;
     uct_ep_addr_t *ep_addr;
     uct_iface_attr_t iface_attr;
     uct_md_attr_t md_attr;
+    unsigned num_ep_addrs;
+    size_t buffer_size;
     void *rkey_buffer;
     ucs_status_t status;
     struct iovec vec[5];
     void *buffer;
     void *req;
 
-    buffer = malloc(buffer_size);
-    if (buffer == NULL) {
-        ucs_error("Failed to allocate RTE buffer");
-        status = UCS_ERR_NO_MEMORY;
-        goto err;
-    }
-
     status = uct_iface_query(perf->uct.iface, &iface_attr);
     if (status != UCS_OK) {
         ucs_error("Failed to uct_iface_query: %s", ucs_status_string(status));
-        goto err_free;
+        goto err;
     }
 
     status = uct_md_query(perf->uct.md, &md_attr);
     if (status != UCS_OK) {
         ucs_error("Failed to uct_md_query: %s", ucs_status_string(status));
-        goto err_free;
+        goto err;
+    }
+
+    group_size  = rte_call(perf, group_size);
+    group_index = rte_call(perf, group_index);
+
+    /* For connect-to-ep transports, every endpoint to every peer needs its own
+     * address, so addresses are packed by (peer index, endpoint index) */
+    num_ep_addrs = group_size * ep_count;
+    buffer_size  = 2048 + (num_ep_addrs * iface_attr.ep_addr_len);
+    buffer       = malloc(buffer_size);
+    if (buffer == NULL) {
+        ucs_error("Failed to allocate RTE buffer");
+        status = UCS_ERR_NO_MEMORY;
+        goto err;
     }
 
     info.rkey_size          = md_attr.rkey_packed_size;
@@ -462,7 +627,8 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
     dev_addr                = (void*)rkey_buffer + info.rkey_size;
     iface_addr              = (void*)dev_addr    + info.uct.dev_addr_len;
     ep_addr                 = (void*)iface_addr  + info.uct.iface_addr_len;
-    ucs_assert_always((void*)ep_addr + info.uct.ep_addr_len <= buffer + buffer_size);
+    ucs_assert_always((void*)ep_addr + (num_ep_addrs * info.uct.ep_addr_len) +
+                      sizeof(info) <= buffer + buffer_size);
 
     status = uct_iface_get_device_address(perf->uct.iface, dev_addr);
     if (status != UCS_OK) {
@@ -485,26 +651,37 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
         goto err_free;
     }
 
-    group_size  = rte_call(perf, group_size);
-    group_index = rte_call(perf, group_index);
-
     perf->uct.peers = calloc(group_size, sizeof(*perf->uct.peers));
     if (perf->uct.peers == NULL) {
+        status = UCS_ERR_NO_MEMORY;
         goto err_free;
     }
 
-    if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP) {
-        for (i = 0; i < group_size; ++i) {
-            if (i == group_index) {
-                continue;
-            }
+    for (i = 0; i < group_size; ++i) {
+        if (i == group_index) {
+            continue;
+        }
+
+        perf->uct.peers[i].eps = calloc(ep_count, sizeof(*perf->uct.peers[i].eps));
+        if (perf->uct.peers[i].eps == NULL) {
+            ucs_error("Failed to allocate endpoints array");
+            status = UCS_ERR_NO_MEMORY;
+            goto err_destroy_eps;
+        }
 
-            status = uct_ep_create(perf->uct.iface, &perf->uct.peers[i].ep);
+        if (!(iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP)) {
+            continue;
+        }
+
+        for (j = 0; j < ep_count; ++j) {
+            status = uct_ep_create(perf->uct.iface, &perf->uct.peers[i].eps[j]);
             if (status != UCS_OK) {
                 ucs_error("Failed to uct_ep_create: %s", ucs_status_string(status));
                 goto err_destroy_eps;
             }
-            status = uct_ep_get_address(perf->uct.peers[i].ep, ep_addr);
+            status = uct_ep_get_address(perf->uct.peers[i].eps[j],
+                                        (void*)ep_addr + ((i * ep_count) + j) *
+                                        info.uct.ep_addr_len);
             if (status != UCS_OK) {
                 ucs_error("Failed to uct_ep_get_address: %s", ucs_status_string(status));
                 goto err_destroy_eps;
@@ -516,7 +693,8 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
     vec[0].iov_len          = sizeof(info);
     vec[1].iov_base         = buffer;
     vec[1].iov_len          = info.rkey_size + info.uct.dev_addr_len +
-                              info.uct.iface_addr_len + info.uct.ep_addr_len;
+                              info.uct.iface_addr_len +
+                              (num_ep_addrs * info.uct.ep_addr_len);
 
     rte_call(perf, post_vec, vec, 2, &req);
     rte_call(perf, exchange_vec, req);
@@ -541,17 +719,23 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
             goto err_destroy_eps;
         }
 
-        if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP) {
-            status = uct_ep_connect_to_ep(perf->uct.peers[i].ep, dev_addr, ep_addr);
-        } else if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE) {
-            status = uct_ep_create_connected(perf->uct.iface, dev_addr, iface_addr,
-                                             &perf->uct.peers[i].ep);
-        } else {
-            status = UCS_ERR_UNSUPPORTED;
-        }
-        if (status != UCS_OK) {
-            ucs_error("Failed to connect endpoint: %s", ucs_status_string(status));
-            goto err_destroy_eps;
+        for (j = 0; j < ep_count; ++j) {
+            if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP) {
+                status = uct_ep_connect_to_ep(perf->uct.peers[i].eps[j], dev_addr,
+                                              (void*)ep_addr +
+                                              ((group_index * ep_count) + j) *
+                                              remote_info->uct.ep_addr_len);
+            } else if (iface_attr.cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE) {
+                status = uct_ep_create_connected(perf->uct.iface, dev_addr,
+                                                 iface_addr,
+                                                 &perf->uct.peers[i].eps[j]);
+            } else {
+                status = UCS_ERR_UNSUPPORTED;
+            }
+            if (status != UCS_OK) {
+                ucs_error("Failed to connect endpoint: %s", ucs_status_string(status));
+                goto err_destroy_eps;
+            }
         }
     }
     uct_perf_iface_flush_b(perf);
@@ -561,15 +745,7 @@ static ucs_status_t uct_perf_test_setup_endpoints(ucx_perf_context_t *perf)
     return UCS_OK;
 
 err_destroy_eps:
-    for (i = 0; i < group_size; ++i) {
-        if (perf->uct.peers[i].rkey.type != NULL) {
-            uct_rkey_release(&perf->uct.peers[i].rkey);
-        }
-        if (perf->uct.peers[i].ep != NULL) {
-            uct_ep_destroy(perf->uct.peers[i].ep);
-        }
-    }
-    free(perf->uct.peers);
+    uct_perf_test_destroy_eps(perf, group_size);
 err_free:
     free(buffer);
 err:
@@ -578,24 +754,13 @@ err:
 
 static void uct_perf_test_cleanup_endpoints(ucx_perf_context_t *perf)
 {
-    unsigned group_size, group_index, i;
-
     rte_call(perf, barrier);
 
     uct_iface_set_am_handler(perf->uct.iface, UCT_PERF_TEST_AM_ID, NULL, NULL, UCT_AM_CB_FLAG_SYNC);
+    uct_iface_set_am_handler(perf->uct.iface, UCT_PERF_TEST_FIN_AM_ID, NULL, NULL,
+                             UCT_AM_CB_FLAG_SYNC);
 
-    group_size  = rte_call(perf, group_size);
-    group_index = rte_call(perf, group_index);
-
-    for (i = 0; i < group_size; ++i) {
-        if (i != group_index) {
-            uct_rkey_release(&perf->uct.peers[i].rkey);
-            if (perf->uct.peers[i].ep) {
-                uct_ep_destroy(perf->uct.peers[i].ep);
-            }
-        }
-    }
-    free(perf->uct.peers);
+    uct_perf_test_destroy_eps(perf, rte_call(perf, group_size));
 }
 
 static ucs_status_t ucp_perf_test_check_params(ucx_perf_params_t *params,
@@ -625,6 +790,16 @@ static ucs_status_t ucp_perf_test_check_params(ucx_perf_params_t *params,
 
         break;
     case UCX_PERF_CMD_TAG:
+        *features = UCP_FEATURE_TAG;
+        break;
+    case UCX_PERF_CMD_CONNECT:
+        if (params->rte->group_size(params->rte_group) != 2) {
+            if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("Connect test requires a client and a server");
+            }
+            return UCS_ERR_INVALID_PARAM;
+        }
+
         *features = UCP_FEATURE_TAG;
         break;
     default:
@@ -639,6 +814,61 @@ static ucs_status_t ucp_perf_test_check_params(ucx_perf_params_t *params,
         return status;
     }
 
+    if (params->ep_count > 1) {
+        /* ucp_ep_create() returns the existing endpoint for a remote worker */
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("UCP supports only one endpoint per peer worker");
+        }
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    if ((params->ucp.datatype != UCP_PERF_DATATYPE_CONTIG) &&
+        (params->command != UCX_PERF_CMD_TAG))
+    {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("Only tag matching supports non-contiguous datatypes");
+        }
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    if ((params->ucp.datatype == UCP_PERF_DATATYPE_IOV) &&
+        ((params->ucp.iov_count < 1) ||
+         (params->ucp.iov_count > params->message_size)))
+    {
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("IOV count must be between 1 and the message size");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    switch (params->ucp.call_mode) {
+    case UCP_PERF_CALL_MODE_BLOCKING:
+        break;
+    case UCP_PERF_CALL_MODE_NB:
+        if (params->command != UCX_PERF_CMD_TAG) {
+            if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("Non-blocking mode is supported only by tag matching");
+            }
+            return UCS_ERR_UNSUPPORTED;
+        }
+        break;
+    case UCP_PERF_CALL_MODE_NBI:
+        if ((params->command != UCX_PERF_CMD_PUT) &&
+            (params->command != UCX_PERF_CMD_GET))
+        {
+            if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("Implicit non-blocking mode is supported only by put/get");
+            }
+            return UCS_ERR_UNSUPPORTED;
+        }
+        break;
+    default:
+        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+            ucs_error("Invalid call mode");
+        }
+        return UCS_ERR_INVALID_PARAM;
+    }
+
     return UCS_OK;
 }
 
@@ -911,58 +1141,156 @@ out:
     return status;
 }
 
-static ucs_status_t uct_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *params)
+static unsigned ucx_perf_num_workers(ucx_perf_params_t *params)
+{
+    return (params->flags & UCX_PERF_TEST_FLAG_MT_WORKERS) ?
+           params->thread_count : 1;
+}
+
+static ucs_thread_mode_t ucx_perf_worker_thread_mode(ucx_perf_params_t *params)
+{
+    /* A worker which is used by a single thread does not need locking */
+    return (params->flags & UCX_PERF_TEST_FLAG_MT_WORKERS) ?
+           UCS_THREAD_MODE_SINGLE : params->thread_mode;
+}
+
+static void uct_perf_select_worker(ucx_perf_context_t *perf, unsigned index)
+{
+    perf->uct.worker = perf->uct.workers[index].worker;
+    perf->uct.iface  = perf->uct.workers[index].iface;
+    perf->uct.peers  = perf->uct.workers[index].peers;
+}
+
+static void uct_perf_destroy_workers(ucx_perf_context_t *perf)
+{
+    unsigned i;
+
+    for (i = 0; i < perf->uct.num_workers; ++i) {
+        if (perf->uct.workers[i].iface != NULL) {
+            uct_iface_close(perf->uct.workers[i].iface);
+        }
+        if (perf->uct.workers[i].worker != NULL) {
+            uct_worker_destroy(perf->uct.workers[i].worker);
+        }
+    }
+    free(perf->uct.workers);
+}
+
+static ucs_status_t uct_perf_create_workers(ucx_perf_context_t *perf,
+                                            ucx_perf_params_t *params)
 {
     uct_iface_config_t *iface_config;
     ucs_status_t status;
+    unsigned i;
     uct_iface_params_t iface_params = {
         .tl_name     = params->uct.tl_name,
         .dev_name    = params->uct.dev_name,
         .rx_headroom = 0
     };
 
-    status = ucs_async_context_init(&perf->uct.async, params->async_mode);
-    if (status != UCS_OK) {
-        goto out;
+    perf->uct.num_workers = ucx_perf_num_workers(params);
+    perf->uct.workers     = calloc(perf->uct.num_workers,
+                                   sizeof(*perf->uct.workers));
+    if (perf->uct.workers == NULL) {
+        return UCS_ERR_NO_MEMORY;
     }
 
-    status = uct_worker_create(&perf->uct.async, params->thread_mode,
-                               &perf->uct.worker);
+    status = uct_iface_config_read(params->uct.tl_name, NULL, NULL, &iface_config);
     if (status != UCS_OK) {
-        goto out_cleanup_async;
+        goto err_destroy_workers;
     }
 
-    status = uct_perf_create_md(perf);
+    for (i = 0; i < perf->uct.num_workers; ++i) {
+        status = uct_worker_create(&perf->uct.async,
+                                   ucx_perf_worker_thread_mode(params),
+                                   &perf->uct.workers[i].worker);
+        if (status != UCS_OK) {
+            goto err_release_config;
+        }
+
+        status = uct_iface_open(perf->uct.md, perf->uct.workers[i].worker,
+                                &iface_params, iface_config,
+                                &perf->uct.workers[i].iface);
+        if (status != UCS_OK) {
+            ucs_error("Failed to open iface: %s", ucs_status_string(status));
+            goto err_release_config;
+        }
+    }
+
+    uct_config_release(iface_config);
+    uct_perf_select_worker(perf, 0);
+    return UCS_OK;
+
+err_release_config:
+    uct_config_release(iface_config);
+err_destroy_workers:
+    uct_perf_destroy_workers(perf);
+    return status;
+}
+
+static void uct_perf_cleanup_workers_endpoints(ucx_perf_context_t *perf,
+                                               unsigned num_workers)
+{
+    unsigned i;
+
+    for (i = 0; i < num_workers; ++i) {
+        uct_perf_select_worker(perf, i);
+        uct_perf_test_cleanup_endpoints(perf);
+    }
+    uct_perf_select_worker(perf, 0);
+}
+
+static ucs_status_t uct_perf_setup_workers_endpoints(ucx_perf_context_t *perf)
+{
+    ucs_status_t status;
+    unsigned i;
+
+    for (i = 0; i < perf->uct.num_workers; ++i) {
+        uct_perf_select_worker(perf, i);
+        status = uct_perf_test_setup_endpoints(perf);
+        if (status != UCS_OK) {
+            ucs_error("Failed to setup endpoints: %s", ucs_status_string(status));
+            uct_perf_cleanup_workers_endpoints(perf, i);
+            return status;
+        }
+        perf->uct.workers[i].peers = perf->uct.peers;
+    }
+
+    uct_perf_select_worker(perf, 0);
+    return UCS_OK;
+}
+
+static ucs_status_t uct_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *params)
+{
+    ucs_status_t status;
+
+    status = ucs_async_context_init(&perf->uct.async, params->async_mode);
     if (status != UCS_OK) {
-        goto out_destroy_worker;
+        goto out;
     }
 
-    status = uct_iface_config_read(params->uct.tl_name, NULL, NULL, &iface_config);
+    status = uct_perf_create_md(perf);
     if (status != UCS_OK) {
-        goto out_destroy_md;
+        goto out_cleanup_async;
     }
 
-    status = uct_iface_open(perf->uct.md, perf->uct.worker, &iface_params,
-                            iface_config, &perf->uct.iface);
-    uct_config_release(iface_config);
+    status = uct_perf_create_workers(perf, params);
     if (status != UCS_OK) {
-        ucs_error("Failed to open iface: %s", ucs_status_string(status));
         goto out_destroy_md;
     }
 
     status = uct_perf_test_check_capabilities(params, perf->uct.iface);
     if (status != UCS_OK) {
-        goto out_iface_close;
+        goto out_destroy_workers;
     }
 
     status = uct_perf_test_alloc_mem(perf, params);
     if (status != UCS_OK) {
-        goto out_iface_close;
+        goto out_destroy_workers;
     }
 
-    status = uct_perf_test_setup_endpoints(perf);
+    status = uct_perf_setup_workers_endpoints(perf);
     if (status != UCS_OK) {
-        ucs_error("Failed to setup endpoints: %s", ucs_status_string(status));
         goto out_free_mem;
     }
 
@@ -970,12 +1298,10 @@ static ucs_status_t uct_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *
 
 out_free_mem:
     uct_perf_test_free_mem(perf);
-out_iface_close:
-    uct_iface_close(perf->uct.iface);
+out_destroy_workers:
+    uct_perf_destroy_workers(perf);
 out_destroy_md:
     uct_md_close(perf->uct.md);
-out_destroy_worker:
-    uct_worker_destroy(perf->uct.worker);
 out_cleanup_async:
     ucs_async_context_cleanup(&perf->uct.async);
 out:
@@ -984,14 +1310,93 @@ out:
 
 static void uct_perf_cleanup(ucx_perf_context_t *perf)
 {
-    uct_perf_test_cleanup_endpoints(perf);
+    uct_perf_cleanup_workers_endpoints(perf, perf->uct.num_workers);
     uct_perf_test_free_mem(perf);
-    uct_iface_close(perf->uct.iface);
+    uct_perf_destroy_workers(perf);
     uct_md_close(perf->uct.md);
-    uct_worker_destroy(perf->uct.worker);
     ucs_async_context_cleanup(&perf->uct.async);
 }
 
+static void ucp_perf_select_worker(ucx_perf_context_t *perf, unsigned index)
+{
+    perf->ucp.worker = perf->ucp.workers[index].worker;
+    perf->ucp.peers  = perf->ucp.workers[index].peers;
+}
+
+static void ucp_perf_destroy_workers(ucx_perf_context_t *perf)
+{
+    unsigned i;
+
+    for (i = 0; i < perf->ucp.num_workers; ++i) {
+        if (perf->ucp.workers[i].worker != NULL) {
+            ucp_worker_destroy(perf->ucp.workers[i].worker);
+        }
+    }
+    free(perf->ucp.workers);
+}
+
+static ucs_status_t ucp_perf_create_workers(ucx_perf_context_t *perf,
+                                            ucx_perf_params_t *params)
+{
+    ucs_status_t status;
+    unsigned i;
+
+    perf->ucp.num_workers = ucx_perf_num_workers(params);
+    perf->ucp.workers     = calloc(perf->ucp.num_workers,
+                                   sizeof(*perf->ucp.workers));
+    if (perf->ucp.workers == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < perf->ucp.num_workers; ++i) {
+        status = ucp_worker_create(perf->ucp.context,
+                                   ucx_perf_worker_thread_mode(params),
+                                   &perf->ucp.workers[i].worker);
+        if (status != UCS_OK) {
+            ucp_perf_destroy_workers(perf);
+            return status;
+        }
+    }
+
+    ucp_perf_select_worker(perf, 0);
+    return UCS_OK;
+}
+
+static void ucp_perf_cleanup_workers_endpoints(ucx_perf_context_t *perf,
+                                               unsigned num_workers)
+{
+    unsigned i;
+
+    for (i = 0; i < num_workers; ++i) {
+        ucp_perf_select_worker(perf, i);
+        ucp_perf_test_cleanup_endpoints(perf);
+    }
+    ucp_perf_select_worker(perf, 0);
+}
+
+static ucs_status_t ucp_perf_setup_workers_endpoints(ucx_perf_context_t *perf,
+                                                     uint64_t features)
+{
+    ucs_status_t status;
+    unsigned i;
+
+    for (i = 0; i < perf->ucp.num_workers; ++i) {
+        ucp_perf_select_worker(perf, i);
+        status = ucp_perf_test_setup_endpoints(perf, features);
+        if (status != UCS_OK) {
+            if (perf->params.flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+                ucs_error("Failed to setup endpoints: %s", ucs_status_string(status));
+            }
+            ucp_perf_cleanup_workers_endpoints(perf, i);
+            return status;
+        }
+        perf->ucp.workers[i].peers = perf->ucp.peers;
+    }
+
+    ucp_perf_select_worker(perf, 0);
+    return UCS_OK;
+}
+
 static ucs_status_t ucp_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *params)
 {
     ucp_params_t ucp_params;
@@ -1020,8 +1425,7 @@ static ucs_status_t ucp_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *
         goto err;
     }
 
-    status = ucp_worker_create(perf->ucp.context, params->thread_mode,
-                               &perf->ucp.worker);
+    status = ucp_perf_create_workers(perf, params);
     if (status != UCS_OK) {
         goto err_cleanup;
     }
@@ -1029,14 +1433,11 @@ static ucs_status_t ucp_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *
     status = ucp_perf_test_alloc_mem(perf, params);
     if (status != UCS_OK) {
         ucs_warn("ucp test failed to alocate memory");
-        goto err_destroy_worker;
+        goto err_destroy_workers;
     }
 
-    status = ucp_perf_test_setup_endpoints(perf, features);
+    status = ucp_perf_setup_workers_endpoints(perf, features);
     if (status != UCS_OK) {
-        if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
-            ucs_error("Failed to setup endpoints: %s", ucs_status_string(status));
-        }
         goto err_free_mem;
     }
 
@@ -1044,8 +1445,8 @@ static ucs_status_t ucp_perf_setup(ucx_perf_context_t *perf, ucx_perf_params_t *
 
 err_free_mem:
     ucp_perf_test_free_mem(perf);
-err_destroy_worker:
-    ucp_worker_destroy(perf->ucp.worker);
+err_destroy_workers:
+    ucp_perf_destroy_workers(perf);
 err_cleanup:
     ucp_cleanup(perf->ucp.context);
 err:
@@ -1054,10 +1455,10 @@ err:
 
 static void ucp_perf_cleanup(ucx_perf_context_t *perf)
 {
-    ucp_perf_test_cleanup_endpoints(perf);
+    ucp_perf_cleanup_workers_endpoints(perf, perf->ucp.num_workers);
     rte_call(perf, barrier);
     ucp_perf_test_free_mem(perf);
-    ucp_worker_destroy(perf->ucp.worker);
+    ucp_perf_destroy_workers(perf);
     ucp_cleanup(perf->ucp.context);
 }
 
@@ -1065,16 +1466,35 @@ static struct {
     ucs_status_t (*setup)(ucx_perf_context_t *perf, ucx_perf_params_t *params);
     void         (*cleanup)(ucx_perf_context_t *perf);
     ucs_status_t (*run)(ucx_perf_context_t *perf);
+    void         (*select_worker)(ucx_perf_context_t *perf, unsigned index);
 } ucx_perf_funcs[] = {
-    [UCX_PERF_API_UCT] = {uct_perf_setup, uct_perf_cleanup, uct_perf_test_dispatch},
-    [UCX_PERF_API_UCP] = {ucp_perf_setup, ucp_perf_cleanup, ucp_perf_test_dispatch}
+    [UCX_PERF_API_UCT] = {uct_perf_setup, uct_perf_cleanup, uct_perf_test_dispatch,
+                          uct_perf_select_worker},
+    [UCX_PERF_API_UCP] = {ucp_perf_setup, ucp_perf_cleanup, ucp_perf_test_dispatch,
+                          ucp_perf_select_worker}
 };
 
-static int ucx_perf_thread_spawn(ucx_perf_params_t* params,
-                                 ucx_perf_result_t* result);
+static ucs_status_t ucx_perf_thread_spawn(ucx_perf_params_t* params,
+                                          ucx_perf_result_t* result);
+
+static ucs_status_t ucx_perf_check_allocs(ucx_perf_params_t *params,
+                                          size_t num_allocs,
+                                          size_t num_hot_path_allocs)
+{
+    if (num_allocs == 0) {
+        return UCS_OK;
+    }
+
+    if (params->flags & UCX_PERF_TEST_FLAG_VERBOSE) {
+        ucs_error("%zu memory allocations (%zu on the hot path) were made during "
+                  "the measured iterations", num_allocs, num_hot_path_allocs);
+    }
+    return UCS_ERR_EXCEEDS_LIMIT;
+}
 
 ucs_status_t ucx_perf_run(ucx_perf_params_t *params, ucx_perf_result_t *result)
 {
+    size_t num_allocs, num_hot_path_allocs;
     ucx_perf_context_t perf;
     ucs_status_t status;
 
@@ -1090,10 +1510,31 @@ ucs_status_t ucx_perf_run(ucx_perf_params_t *params, ucx_perf_result_t *result)
         goto out;
     }
 
+    if ((params->flags & UCX_PERF_TEST_FLAG_NO_ALLOC) &&
+        !ucs_memtrack_is_enabled()) {
+        ucs_error("Allocation check requires memory tracking (UCX_MEMTRACK_DEST)");
+        status = UCS_ERR_UNSUPPORTED;
+        goto out;
+    }
+
+    if ((params->flags & UCX_PERF_TEST_FLAG_NO_ALLOC) &&
+        (UCS_THREAD_MODE_SINGLE != params->thread_mode)) {
+        ucs_error("Allocation check is supported only in single-thread mode");
+        status = UCS_ERR_UNSUPPORTED;
+        goto out;
+    }
+
     if (UCS_THREAD_MODE_SINGLE != params->thread_mode) {
         return ucx_perf_thread_spawn(params, result);
     }
-        
+
+    if (params->flags & UCX_PERF_TEST_FLAG_MT_WORKERS) {
+        ucs_error("Worker per thread requires multi-threaded mode");
+        status = UCS_ERR_INVALID_PARAM;
+        goto out;
+    }
+
+    perf.thread_index = -1;
     ucx_perf_test_reset(&perf, params);
 
     status = ucx_perf_funcs[params->api].setup(&perf, params);
@@ -1113,11 +1554,19 @@ ucs_status_t ucx_perf_run(ucx_perf_params_t *params, ucx_perf_result_t *result)
     }
 
     /* Run test */
+    num_allocs          = ucs_memtrack_num_allocs();
+    num_hot_path_allocs = ucs_memtrack_num_hot_path_allocs();
     status = ucx_perf_funcs[params->api].run(&perf);
+    num_allocs          = ucs_memtrack_num_allocs() - num_allocs;
+    num_hot_path_allocs = ucs_memtrack_num_hot_path_allocs() - num_hot_path_allocs;
     rte_call(&perf, barrier);
     if (status == UCS_OK) {
         ucx_perf_calc_result(&perf, result);
         rte_call(&perf, report, result, perf.params.report_arg, 1);
+        if (params->flags & UCX_PERF_TEST_FLAG_NO_ALLOC) {
+            status = ucx_perf_check_allocs(params, num_allocs,
+                                           num_hot_path_allocs);
+        }
     }
 
 out_cleanup:
@@ -1150,6 +1599,8 @@ static void* ucx_perf_thread_run_test(void* arg) {
     int tid = tctx->tid;
     int i;
 
+    ucx_perf_test_reset(perf, params);
+
     if (params->warmup_iter > 0) {
         ucx_perf_set_warmup(perf, params);
         statuses[tid] = ucx_perf_funcs[params->api].run(perf);
@@ -1159,10 +1610,14 @@ static void* ucx_perf_thread_run_test(void* arg) {
                 goto out;
             }
         }
-#pragma omp master
         ucx_perf_test_reset(perf, params);
     }
 
+    /* Only the first thread reports intermediate results */
+    if (tid != 0) {
+        perf->report_interval = UINT64_MAX;
+    }
+
     /* Run test */
 #pragma omp barrier
     statuses[tid] = ucx_perf_funcs[params->api].run(perf);
@@ -1172,22 +1627,63 @@ static void* ucx_perf_thread_run_test(void* arg) {
             goto out;
         }
     }
-#pragma omp master
-    {
-        /* Assuming all threads are fairly treated, reporting only tid==0
-            TODO: aggregate reports */
-        ucx_perf_calc_result(perf, result);
-        rte_call(perf, report, result, perf->params.report_arg, 1);
-    }
+
+    ucx_perf_calc_result(perf, result);
 
 out:
     return &statuses[tid];
 }
 
-static int ucx_perf_thread_spawn(ucx_perf_params_t* params,
-                                 ucx_perf_result_t* result) {
+/*
+ * Combine the results of all threads: counters, bandwidth and message rate
+ * are summed, latency is averaged, and the latency distribution is calculated
+ * from the merged histograms.
+ */
+static void ucx_perf_thread_aggregate(ucx_perf_thread_context_t *tctx, int nti,
+                                      ucx_perf_counter_t *hist,
+                                      ucx_perf_result_t *result)
+{
+    const ucx_perf_result_t *tresult;
+    unsigned i;
+    int ti;
+
+    memset(result, 0, sizeof(*result));
+    result->thread_index = -1;
+
+    for (ti = 0; ti < nti; ti++) {
+        tresult = &tctx[ti].result;
+
+        result->iters                    += tresult->iters;
+        result->bytes                    += tresult->bytes;
+        result->elapsed_time              = ucs_max(result->elapsed_time,
+                                                    tresult->elapsed_time);
+        result->latency.typical          += tresult->latency.typical / nti;
+        result->latency.moment_average   += tresult->latency.moment_average / nti;
+        result->latency.total_average    += tresult->latency.total_average / nti;
+        result->bandwidth.moment_average += tresult->bandwidth.moment_average;
+        result->bandwidth.total_average  += tresult->bandwidth.total_average;
+        result->msgrate.moment_average   += tresult->msgrate.moment_average;
+        result->msgrate.total_average    += tresult->msgrate.total_average;
+        result->recv.msgs                += tresult->recv.msgs;
+        result->recv.msgrate             += tresult->recv.msgrate;
+        result->recv.unexp_average       += tresult->recv.unexp_average / nti;
+        result->recv.unexp_max            = ucs_max(result->recv.unexp_max,
+                                                    tresult->recv.unexp_max);
+
+        for (i = 0; i < UCX_PERF_LATENCY_HIST_BUCKETS; ++i) {
+            hist[i] += tctx[ti].perf.latency_hist[i];
+        }
+    }
+
+    ucx_perf_calc_latency_dist(hist, result,
+                               tctx[0].result.latency_dist.bucket_unit);
+}
+
+static ucs_status_t ucx_perf_thread_spawn(ucx_perf_params_t* params,
+                                          ucx_perf_result_t* result) {
     ucx_perf_context_t perf;
     ucs_status_t status = UCS_OK;
+    ucx_perf_counter_t *hist;
     int ti, nti;
 
     omp_set_num_threads(params->thread_count);
@@ -1197,7 +1693,13 @@ static int ucx_perf_thread_spawn(ucx_perf_params_t* params,
         calloc(nti, sizeof(ucx_perf_thread_context_t));
     ucs_status_t* statuses =
         calloc(nti, sizeof(ucs_status_t));
+    hist = calloc(UCX_PERF_LATENCY_HIST_BUCKETS, sizeof(*hist));
+    if ((tctx == NULL) || (statuses == NULL) || (hist == NULL)) {
+        status = UCS_ERR_NO_MEMORY;
+        goto out_cleanup;
+    }
 
+    perf.thread_index = -1;
     ucx_perf_test_reset(&perf, params);
     status = ucx_perf_funcs[params->api].setup(&perf, params);
     if (UCS_OK != status) {
@@ -1212,6 +1714,10 @@ static int ucx_perf_thread_spawn(ucx_perf_params_t* params,
     tctx[ti].statuses = statuses;
     tctx[ti].params = *params;
     tctx[ti].perf = perf;
+    tctx[ti].perf.thread_index = ti;
+    if (params->flags & UCX_PERF_TEST_FLAG_MT_WORKERS) {
+        ucx_perf_funcs[params->api].select_worker(&tctx[ti].perf, ti);
+    }
     /* Doctor the src and dst buffers to make them thread specific */
     tctx[ti].perf.send_buffer += ti * params->message_size;
     tctx[ti].perf.recv_buffer += ti * params->message_size;
@@ -1225,19 +1731,28 @@ static int ucx_perf_thread_spawn(ucx_perf_params_t* params,
         }
     }
 
+    if (status == UCS_OK) {
+        ucx_perf_thread_aggregate(tctx, nti, hist, result);
+        for (ti = 0; ti < nti; ti++) {
+            rte_call(&perf, report, &tctx[ti].result, perf.params.report_arg, 1);
+        }
+        rte_call(&perf, report, result, perf.params.report_arg, 1);
+    }
+
     ucx_perf_funcs[params->api].cleanup(&perf);
 
 out_cleanup:
+    free(hist);
     free(statuses);
     free(tctx);
 
     return status;
 }
 #else
-static int ucx_perf_thread_spawn(ucx_perf_params_t* params,
-                                 ucx_perf_result_t* result) {
+static ucs_status_t ucx_perf_thread_spawn(ucx_perf_params_t* params,
+                                          ucx_perf_result_t* result) {
     ucs_error("Invalid test parameter (thread mode requested without OpenMP capabilities)");
-    return UCS_ERR_INVALID_PARAM;
+    return UCS_ERR_UNSUPPORTED;
 }
 #endif /* _OPENMP */
 
@@ -16,6 +16,7 @@ BEGIN_C_DECLS
 #include <sys/uio.h>
 #include <uct/api/uct.h>
 #include <ucp/api/ucp.h>
+#include <ucs/stats/libstats.h>
 #include <ucs/sys/math.h>
 #include <ucs/type/status.h>
 
@@ -36,6 +37,7 @@ typedef enum {
     UCX_PERF_CMD_SWAP,
     UCX_PERF_CMD_CSWAP,
     UCX_PERF_CMD_TAG,
+    UCX_PERF_CMD_CONNECT,
     UCX_PERF_CMD_LAST
 } ucx_perf_cmd_t;
 
@@ -44,6 +46,8 @@ typedef enum {
     UCX_PERF_TEST_TYPE_PINGPONG,         /* Ping-pong mode */
     UCX_PERF_TEST_TYPE_STREAM_UNI,       /* Unidirectional stream */
     UCX_PERF_TEST_TYPE_STREAM_BI,        /* Bidirectional stream */
+    UCX_PERF_TEST_TYPE_INCAST,           /* All ranks stream to rank 0 */
+    UCX_PERF_TEST_TYPE_ALLTOALL,         /* Every rank streams to all other ranks */
     UCX_PERF_TEST_TYPE_LAST
 } ucx_perf_test_type_t;
 
@@ -56,6 +60,31 @@ typedef enum {
 } uct_perf_data_layout_t;
 
 
+typedef enum {
+    UCP_PERF_DATATYPE_CONTIG,        /* Contiguous buffer */
+    UCP_PERF_DATATYPE_IOV,           /* Scatter-gather list */
+    UCP_PERF_DATATYPE_GENERIC,       /* Packed and unpacked by callbacks */
+    UCP_PERF_DATATYPE_LAST
+} ucp_perf_datatype_t;
+
+
+typedef enum {
+    UCP_PERF_CALL_MODE_BLOCKING,     /* Wait for every operation to complete */
+    UCP_PERF_CALL_MODE_NB,           /* Non-blocking, keep up to max_outstanding
+                                        requests in flight (tag matching) */
+    UCP_PERF_CALL_MODE_NBI,          /* Implicit non-blocking, flush after every
+                                        max_outstanding operations (RMA) */
+    UCP_PERF_CALL_MODE_LAST
+} ucp_perf_call_mode_t;
+
+
+typedef enum {
+    UCX_PERF_EP_ORDER_ROUND_ROBIN,   /* Cycle through the endpoints */
+    UCX_PERF_EP_ORDER_RANDOM,        /* Pick a random endpoint for every operation */
+    UCX_PERF_EP_ORDER_LAST
+} ucx_perf_ep_order_t;
+
+
 typedef enum {
     UCX_PERF_WAIT_MODE_PROGRESS,     /* Repeatedly call progress */
     UCX_PERF_WAIT_MODE_SLEEP,        /* Go to sleep */
@@ -69,6 +98,10 @@ enum ucx_perf_test_flags {
     UCX_PERF_TEST_FLAG_ONE_SIDED    = UCS_BIT(2), /* For test which involve only one side,
                                                      the responder would not call progress(). */
     UCX_PERF_TEST_FLAG_MAP_NONBLOCK = UCS_BIT(3), /* Map memory in non-blocking mode */
+    UCX_PERF_TEST_FLAG_NO_ALLOC     = UCS_BIT(4), /* Fail if measured iterations allocate
+                                                     memory. Requires memtrack. */
+    UCX_PERF_TEST_FLAG_MT_WORKERS   = UCS_BIT(5), /* In multi-threaded tests, every thread
+                                                     uses its own worker and endpoints */
     UCX_PERF_TEST_FLAG_VERBOSE      = UCS_BIT(7)  /* Print error messages */
 };
 
@@ -82,6 +115,17 @@ enum {
 typedef uint64_t ucx_perf_counter_t;
 
 
+/*
+ * Per-iteration latency is collected into a log-linear histogram of
+ * ucs_time_t values, with the same layout as UCS statistics histograms (see
+ * ucs_stats_histogram_bucket()). In ping-pong tests every iteration is
+ * recorded; in stream tests one of every UCX_PERF_LATENCY_SAMPLE_INTERVAL
+ * iterations is recorded.
+ */
+#define UCX_PERF_LATENCY_HIST_BUCKETS     UCS_STATS_HISTOGRAM_BUCKETS
+#define UCX_PERF_LATENCY_SAMPLE_INTERVAL  16
+
+
 /*
  * Performance test result.
  *
@@ -89,6 +133,8 @@ typedef uint64_t ucx_perf_counter_t;
  * Size values are in bytes.
  */
 typedef struct ucx_perf_result {
+    int                     thread_index;   /* Thread which produced the result, or
+                                               -1 for the aggregate of all threads */
     ucx_perf_counter_t      iters;
     double                  elapsed_time;
     ucx_perf_counter_t      bytes;
@@ -98,6 +144,25 @@ typedef struct ucx_perf_result {
         double              total_average;  /* Average of the whole test */
     }
     latency, bandwidth, msgrate;
+    struct {
+        ucx_perf_counter_t  msgs;           /* Number of received messages */
+        double              msgrate;        /* Received messages per second */
+        double              unexp_average;  /* Average unexpected queue depth */
+        ucx_perf_counter_t  unexp_max;      /* Maximal unexpected queue depth */
+    } recv;                                 /* Receiver side of incast and
+                                               all-to-all tests */
+    struct {
+        double              p50;            /* Median */
+        double              p99;
+        double              p999;           /* 99.9th percentile */
+        double              jitter;         /* Mean absolute deviation */
+        ucx_perf_counter_t  samples;        /* Number of latency samples */
+        double              bucket_unit;    /* Seconds per histogram value unit */
+        const ucx_perf_counter_t *histogram; /* Raw distribution, with
+                                                UCX_PERF_LATENCY_HIST_BUCKETS
+                                                entries; valid only during the
+                                                report callback */
+    } latency_dist;
 } ucx_perf_result_t;
 
 
@@ -145,6 +210,8 @@ typedef struct ucx_perf_params {
     size_t                 am_hdr_size;     /* Active message header size (included in message size) */
     size_t                 alignment;       /* Message buffer alignment */
     unsigned               max_outstanding; /* Maximal number of outstanding sends */
+    unsigned               ep_count;        /* Number of endpoints to every peer */
+    ucx_perf_ep_order_t    ep_order;        /* Order of using the endpoints */
     ucx_perf_counter_t     warmup_iter;     /* Number of warm-up iterations */
     ucx_perf_counter_t     max_iter;        /* Iterations limit, 0 - unlimited */
     double                 max_time;        /* Time limit (seconds), 0 - unlimited */
@@ -162,7 +229,9 @@ typedef struct ucx_perf_params {
     } uct;
 
     struct {
-        unsigned               nonblocking_mode; /* TBD */
+        ucp_perf_datatype_t    datatype;    /* Datatype of sends and receives */
+        unsigned               iov_count;   /* Number of IOV entries, for iov datatype */
+        ucp_perf_call_mode_t   call_mode;   /* Blocking or non-blocking calls */
     } ucp;
 
 } ucx_perf_params_t;
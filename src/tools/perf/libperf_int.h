@@ -15,19 +15,24 @@ BEGIN_C_DECLS
 
 #include <ucs/time/time.h>
 #include <ucs/async/async.h>
+#include <stdlib.h>
 
 
-#define TIMING_QUEUE_SIZE    2048
-#define UCT_PERF_TEST_AM_ID  5
+#define TIMING_QUEUE_SIZE        2048
+#define UCT_PERF_TEST_AM_ID      5
+#define UCT_PERF_TEST_FIN_AM_ID  6   /* Sender is done (incast and all-to-all) */
 
 
 typedef struct ucx_perf_context  ucx_perf_context_t;
 typedef struct uct_peer          uct_peer_t;
 typedef struct ucp_peer          ucp_peer_t;
+typedef struct uct_perf_worker   uct_perf_worker_t;
+typedef struct ucp_perf_worker   ucp_perf_worker_t;
 
 
 struct ucx_perf_context {
     ucx_perf_params_t            params;
+    int                          thread_index;  /* -1 if not multi-threaded */
 
     /* Buffers */
     void                         *send_buffer;
@@ -50,6 +55,23 @@ struct ucx_perf_context {
     ucs_time_t                   timing_queue[TIMING_QUEUE_SIZE];
     unsigned                     timing_queue_head;
 
+    /* Latency distribution, see UCX_PERF_LATENCY_HIST_BUCKETS */
+    ucx_perf_counter_t           latency_sample_mask;
+    ucx_perf_counter_t           latency_hist[UCX_PERF_LATENCY_HIST_BUCKETS];
+
+    /* Receiver side of incast and all-to-all tests */
+    struct {
+        ucx_perf_counter_t       msgs;
+        ucs_time_t               time;        /* Time of the last reception */
+        ucx_perf_counter_t       unexp_total; /* Sum of sampled queue depths */
+        ucx_perf_counter_t       unexp_samples;
+        ucx_perf_counter_t       unexp_max;
+    } recv;
+
+    /* Endpoint selection, see ucx_perf_next_ep_index() */
+    unsigned                     ep_index;
+    unsigned                     ep_seed;
+
     union {
         struct {
             ucs_async_context_t  async;
@@ -59,6 +81,9 @@ struct ucx_perf_context {
             uct_peer_t           *peers;
             uct_allocated_memory_t send_mem;
             uct_allocated_memory_t recv_mem;
+            uct_perf_worker_t    *workers;     /* All workers, the first one is
+                                                  also stored above */
+            unsigned             num_workers;
         } uct;
 
         struct {
@@ -67,13 +92,16 @@ struct ucx_perf_context {
             ucp_peer_t           *peers;
             ucp_mem_h            send_memh;
             ucp_mem_h            recv_memh;
+            ucp_perf_worker_t    *workers;     /* All workers, the first one is
+                                                  also stored above */
+            unsigned             num_workers;
         } ucp;
     };
 };
 
 
 struct uct_peer {
-    uct_ep_h                     ep;
+    uct_ep_h                     *eps;          /* params.ep_count endpoints */
     unsigned long                remote_addr;
     uct_rkey_bundle_t            rkey;
 };
@@ -86,6 +114,23 @@ struct ucp_peer {
 };
 
 
+/*
+ * With UCX_PERF_TEST_FLAG_MT_WORKERS, every test thread gets its own worker,
+ * interface and endpoints.
+ */
+struct uct_perf_worker {
+    uct_worker_h                 worker;
+    uct_iface_h                  iface;
+    uct_peer_t                   *peers;
+};
+
+
+struct ucp_perf_worker {
+    ucp_worker_h                 worker;
+    ucp_peer_t                   *peers;
+};
+
+
 #define UCX_PERF_TEST_FOREACH(perf) \
     while (!ucx_perf_context_done(perf))
 
@@ -115,18 +160,78 @@ static UCS_F_ALWAYS_INLINE int ucx_perf_context_done(ucx_perf_context_t *perf)
 }
 
 
+/**
+ * @return Index of the endpoint to use for the next operation.
+ */
+static UCS_F_ALWAYS_INLINE unsigned ucx_perf_next_ep_index(ucx_perf_context_t *perf)
+{
+    unsigned index;
+
+    if (ucs_likely(perf->params.ep_count == 1)) {
+        return 0;
+    }
+
+    if (perf->params.ep_order == UCX_PERF_EP_ORDER_RANDOM) {
+        return rand_r(&perf->ep_seed) % perf->params.ep_count;
+    }
+
+    index = perf->ep_index;
+    if (++perf->ep_index == perf->params.ep_count) {
+        perf->ep_index = 0;
+    }
+    return index;
+}
+
+
+static UCS_F_ALWAYS_INLINE void
+ucx_perf_update_recv(ucx_perf_context_t *perf, ucx_perf_counter_t msgs)
+{
+    perf->recv.msgs += msgs;
+    perf->recv.time  = ucs_get_time();
+}
+
+
+static UCS_F_ALWAYS_INLINE void
+ucx_perf_update_unexp(ucx_perf_context_t *perf, ucx_perf_counter_t depth)
+{
+    perf->recv.unexp_total   += depth;
+    perf->recv.unexp_samples += 1;
+    perf->recv.unexp_max      = ucs_max(perf->recv.unexp_max, depth);
+}
+
+
+/*
+ * Exclude time which was spent outside of the measured operation, e.g on
+ * creating per-iteration resources, from the results and from the time limit.
+ */
+static inline void ucx_perf_omit(ucx_perf_context_t *perf, ucs_time_t time)
+{
+    perf->start_time += time;
+    perf->prev_time  += time;
+    perf->prev.time  += time;
+    if (perf->end_time != UINT64_MAX) {
+        perf->end_time += time;
+    }
+}
+
+
 static inline void ucx_perf_update(ucx_perf_context_t *perf, ucx_perf_counter_t iters,
                                    size_t bytes)
 {
     ucx_perf_result_t result;
+    ucs_time_t delta;
 
     perf->current.time   = ucs_get_time();
     perf->current.iters += iters;
     perf->current.bytes += bytes;
     perf->current.msgs  += 1;
 
-    perf->timing_queue[perf->timing_queue_head++] = perf->current.time - perf->prev_time;
+    delta = perf->current.time - perf->prev_time;
+    perf->timing_queue[perf->timing_queue_head++] = delta;
     perf->timing_queue_head %= TIMING_QUEUE_SIZE;
+    if (!(perf->current.msgs & perf->latency_sample_mask)) {
+        ++perf->latency_hist[ucs_stats_histogram_bucket(delta)];
+    }
     perf->prev_time = perf->current.time;
 
     if (perf->current.time - perf->prev.time >= perf->report_interval) {
@@ -15,6 +15,7 @@
 #include "libperf.h"
 
 #include <ucs/sys/sys.h>
+#include <ucs/config/parser.h>
 #include <ucs/debug/log.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -33,6 +34,12 @@
 #endif
 
 #define MAX_BATCH_FILES  32
+#define SWEEP_ITER_SIZE  8192 /* Sweep reduces the iterations above this size */
+#define SWEEP_MIN_ITERS  10
+#define DEFAULT_MAX_ITER     1000000l
+#define DEFAULT_WARMUP_ITER  10000
+#define CONNECT_MAX_ITER     1000l /* A connection takes about 8 ms */
+#define CONNECT_WARMUP_ITER  10
 
 
 enum {
@@ -41,12 +48,19 @@ enum {
     TEST_FLAG_SET_AFFINITY  = UCS_BIT(8),
     TEST_FLAG_NUMERIC_FMT   = UCS_BIT(9),
     TEST_FLAG_PRINT_FINAL   = UCS_BIT(10),
-    TEST_FLAG_PRINT_CSV     = UCS_BIT(11)
+    TEST_FLAG_PRINT_CSV     = UCS_BIT(11),
+    TEST_FLAG_PRINT_HIST    = UCS_BIT(12),
+    TEST_FLAG_PRINT_JSON    = UCS_BIT(13)
 };
 
 typedef struct sock_rte_group {
     int                          is_server;
-    int                          connfd;
+    int                          connfd;     /* Client: connection to the server */
+    int                          *peer_fds;  /* Server: connection per client index */
+    unsigned                     size;       /* Number of processes, incl. server */
+    unsigned                     index;      /* Index of this process */
+    void                         **vecs;     /* Last data posted by every process */
+    size_t                       *vec_sizes;
 } sock_rte_group_t;
 
 
@@ -71,12 +85,22 @@ struct perftest_context {
 
     unsigned                     num_batch_files;
     char                         *batch_files[MAX_BATCH_FILES];
-    char                         *test_names[MAX_BATCH_FILES];
+    char                         *test_names[MAX_BATCH_FILES + 1];
+    unsigned                     num_test_names; /* Batch files, and the sweep */
+
+    /* Message size sweep, sent to the server along with the parameters */
+    struct {
+        size_t                   min_size;
+        size_t                   max_size;       /* 0 - no sweep */
+        double                   factor;
+    } sweep;
+
+    const ucx_perf_params_t      *cur_params;    /* Parameters of the running test */
 
     sock_rte_group_t             sock_rte_group;
 };
 
-#define TEST_PARAMS_ARGS   "t:n:s:W:O:w:D:H:oqM:T:d:x:A:B"
+#define TEST_PARAMS_ARGS   "t:n:s:W:O:w:D:H:oqM:T:d:x:A:BZe:E:ui:m:"
 
 
 test_type_t tests[] = {
@@ -110,12 +134,24 @@ test_type_t tests[] = {
     {"add_mr", UCX_PERF_API_UCT, UCX_PERF_CMD_ADD, UCX_PERF_TEST_TYPE_STREAM_UNI,
      "atomic add message rate"},
 
+    {"am_incast", UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_INCAST,
+     "active message incast (all ranks to rank 0)"},
+
+    {"am_alltoall", UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_ALLTOALL,
+     "active message all-to-all"},
+
     {"tag_lat", UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_PINGPONG,
      "tag match latency"},
 
     {"tag_bw", UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_STREAM_UNI,
      "tag match bandwidth"},
 
+    {"tag_incast", UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_INCAST,
+     "tag match incast (all ranks to rank 0)"},
+
+    {"tag_alltoall", UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_ALLTOALL,
+     "tag match all-to-all"},
+
     {"ucp_put_lat", UCX_PERF_API_UCP, UCX_PERF_CMD_PUT, UCX_PERF_TEST_TYPE_PINGPONG,
      "UCP put latency"},
 
@@ -137,9 +173,19 @@ test_type_t tests[] = {
     {"ucp_cswap", UCX_PERF_API_UCP, UCX_PERF_CMD_CSWAP, UCX_PERF_TEST_TYPE_STREAM_UNI,
      "UCP atomic compare-and-swap latency / bandwidth / message rate"},
 
+    {"ucp_connect", UCX_PERF_API_UCP, UCX_PERF_CMD_CONNECT, UCX_PERF_TEST_TYPE_PINGPONG,
+     "UCP endpoint connect rate, over a listener"},
+
     {NULL}
 };
 
+static const char *ucp_call_mode_names[] = {
+    [UCP_PERF_CALL_MODE_BLOCKING] = "blocking",
+    [UCP_PERF_CALL_MODE_NB]       = "nb",
+    [UCP_PERF_CALL_MODE_NBI]      = "nbi",
+    [UCP_PERF_CALL_MODE_LAST]     = "(undefined)"
+};
+
 static int safe_send(int sock, void *data, size_t size)
 {
     size_t total = 0;
@@ -172,13 +218,58 @@ static int safe_recv(int sock, void *data, size_t size)
     return 0;
 }
 
+static void print_latency_dist(const ucx_perf_result_t *result, unsigned flags)
+{
+    const ucx_perf_counter_t *hist = result->latency_dist.histogram;
+    ucx_perf_counter_t sum;
+    unsigned i;
+
+    if (!(flags & TEST_FLAG_PRINT_CSV)) {
+        printf("| percentiles (usec)   p50: %9.3f  p99: %9.3f  p99.9: %9.3f  jitter: %9.3f |\n",
+               result->latency_dist.p50    * 1000000.0,
+               result->latency_dist.p99    * 1000000.0,
+               result->latency_dist.p999   * 1000000.0,
+               result->latency_dist.jitter * 1000000.0);
+    }
+
+    if (!(flags & TEST_FLAG_PRINT_HIST) || (result->latency_dist.samples == 0)) {
+        return;
+    }
+
+    printf("# latency distribution of %lu samples: usec (bucket lower bound),"
+           " samples, cumulative %%\n", result->latency_dist.samples);
+    sum = 0;
+    for (i = 0; i < UCX_PERF_LATENCY_HIST_BUCKETS; ++i) {
+        if (hist[i] == 0) {
+            continue;
+        }
+        sum += hist[i];
+        printf((flags & TEST_FLAG_PRINT_CSV) ? "%.3f,%lu,%.3f\n" :
+                                               "%14.3f %11lu %9.3f\n",
+               ucs_stats_histogram_bucket_value(i) *
+               result->latency_dist.bucket_unit * 1000000.0,
+               hist[i], sum * 100.0 / result->latency_dist.samples);
+    }
+}
+
+static void print_recv_stats(const ucx_perf_result_t *result, unsigned flags)
+{
+    if ((flags & TEST_FLAG_PRINT_CSV) || (result->recv.msgs == 0)) {
+        return;
+    }
+
+    printf("| recv msgs: %'12lu  rate: %'12.0f msg/s  unexpected avg: %8.2f max: %7lu |\n",
+           result->recv.msgs, result->recv.msgrate, result->recv.unexp_average,
+           result->recv.unexp_max);
+}
+
 static void print_progress(char **test_names, unsigned num_names,
                            const ucx_perf_result_t *result, unsigned flags,
                            int final)
 {
-    static const char *fmt_csv     =  "%.0f,%.3f,%.3f,%.3f,%.2f,%.2f,%.0f,%.0f\n";
-    static const char *fmt_numeric =  "%'14.0f %9.3f %9.3f %9.3f %10.2f %10.2f %'11.0f %'11.0f\n";
-    static const char *fmt_plain   =  "%14.0f %9.3f %9.3f %9.3f %10.2f %10.2f %11.0f %11.0f\n";
+    static const char *fmt_csv     =  "%.0f,%.3f,%.3f,%.3f,%.2f,%.2f,%.0f,%.0f,%.3f,%.3f,%.3f,%.3f,%.0f,%.2f,%lu";
+    static const char *fmt_numeric =  "%'14.0f %9.3f %9.3f %9.3f %10.2f %10.2f %'11.0f %'11.0f";
+    static const char *fmt_plain   =  "%14.0f %9.3f %9.3f %9.3f %10.2f %10.2f %11.0f %11.0f";
     unsigned i;
 
     if (!(flags & TEST_FLAG_PRINT_RESULTS) ||
@@ -203,17 +294,191 @@ static void print_progress(char **test_names, unsigned num_names,
            result->bandwidth.moment_average / (1024.0 * 1024.0),
            result->bandwidth.total_average / (1024.0 * 1024.0),
            result->msgrate.moment_average,
-           result->msgrate.total_average);
+           result->msgrate.total_average,
+           result->latency_dist.p50    * 1000000.0,
+           result->latency_dist.p99    * 1000000.0,
+           result->latency_dist.p999   * 1000000.0,
+           result->latency_dist.jitter * 1000000.0,
+           result->recv.msgrate,
+           result->recv.unexp_average,
+           result->recv.unexp_max);
+
+    if (flags & TEST_FLAG_PRINT_CSV) {
+        if (result->thread_index < 0) {
+            printf(",all\n");
+        } else {
+            printf(",%d\n", result->thread_index);
+        }
+    } else if (result->thread_index >= 0) {
+        printf("  thread %d\n", result->thread_index);
+    } else {
+        printf("\n");
+    }
+
+    /* Print the distribution only for the overall result */
+    if (final && (result->thread_index < 0)) {
+        print_latency_dist(result, flags);
+        print_recv_stats(result, flags);
+    }
     fflush(stdout);
 }
 
+static void print_json_string(const char *str)
+{
+    putchar('"');
+    for (; *str != '\0'; ++str) {
+        if ((*str == '"') || (*str == '\\')) {
+            printf("\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            printf("\\u%04x", *str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+static test_type_t *find_test(const ucx_perf_params_t *params)
+{
+    test_type_t *test;
+
+    for (test = tests; test->name != NULL; ++test) {
+        if ((test->api == params->api) && (test->command == params->command) &&
+            (test->test_type == params->test_type)) {
+            return test;
+        }
+    }
+    return NULL;
+}
+
+/* One JSON object per line, with the metadata needed to compare runs */
+static void print_json(struct perftest_context *ctx,
+                       const ucx_perf_result_t *result)
+{
+    static const char *uct_layout_names[] = {
+        [UCT_PERF_DATA_LAYOUT_SHORT] = "short",
+        [UCT_PERF_DATA_LAYOUT_BCOPY] = "bcopy",
+        [UCT_PERF_DATA_LAYOUT_ZCOPY] = "zcopy",
+        [UCT_PERF_DATA_LAYOUT_LAST]  = "(undefined)"
+    };
+    static const char *ucp_datatype_names[] = {
+        [UCP_PERF_DATATYPE_CONTIG]   = "contig",
+        [UCP_PERF_DATATYPE_IOV]      = "iov",
+        [UCP_PERF_DATATYPE_GENERIC]  = "generic",
+        [UCP_PERF_DATATYPE_LAST]     = "(undefined)"
+    };
+    const ucx_perf_params_t *params = ctx->cur_params;
+    test_type_t *test               = find_test(params);
+    char hostname[256];
+    const char *eq;
+    char **env;
+    unsigned i;
+
+    if (gethostname(hostname, sizeof(hostname)) != 0) {
+        strcpy(hostname, "");
+    }
+    hostname[sizeof(hostname) - 1] = '\0';
+
+    printf("{\"test\": ");
+    print_json_string((test == NULL) ? "" : test->name);
+    printf(", \"name\": \"");
+    for (i = 0; i < ctx->num_test_names; ++i) {
+        printf("%s%s", (i == 0) ? "" : "/", ctx->test_names[i]);
+    }
+    printf("\", \"host\": ");
+    print_json_string(hostname);
+    printf(", \"ucx_version\": ");
+    print_json_string(ucp_get_version_string());
+
+    if (params->api == UCX_PERF_API_UCT) {
+        printf(", \"api\": \"uct\", \"transport\": ");
+        print_json_string(params->uct.tl_name);
+        printf(", \"device\": ");
+        print_json_string(params->uct.dev_name);
+        printf(", \"data_layout\": \"%s\"",
+               uct_layout_names[ucs_min(params->uct.data_layout,
+                                        UCT_PERF_DATA_LAYOUT_LAST)]);
+    } else {
+        printf(", \"api\": \"ucp\", \"data_layout\": \"%s\", \"iov_count\": %u"
+               ", \"call_mode\": \"%s\"",
+               ucp_datatype_names[ucs_min(params->ucp.datatype,
+                                          UCP_PERF_DATATYPE_LAST)],
+               params->ucp.iov_count,
+               ucp_call_mode_names[ucs_min(params->ucp.call_mode,
+                                           UCP_PERF_CALL_MODE_LAST)]);
+    }
+
+    printf(", \"message_size\": %zu, \"max_outstanding\": %u, \"threads\": %u"
+           ", \"ep_count\": %u",
+           params->message_size, params->max_outstanding, params->thread_count,
+           params->ep_count);
+    if (result->thread_index < 0) {
+        printf(", \"thread\": \"all\"");
+    } else {
+        printf(", \"thread\": %d", result->thread_index);
+    }
+
+    printf(", \"iterations\": %lu", result->iters);
+    printf(", \"latency_usec\": {\"typical\": %.4f, \"average\": %.4f"
+           ", \"overall\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"p999\": %.4f"
+           ", \"jitter\": %.4f}",
+           result->latency.typical       * 1000000.0,
+           result->latency.moment_average * 1000000.0,
+           result->latency.total_average * 1000000.0,
+           result->latency_dist.p50      * 1000000.0,
+           result->latency_dist.p99      * 1000000.0,
+           result->latency_dist.p999     * 1000000.0,
+           result->latency_dist.jitter   * 1000000.0);
+    printf(", \"bandwidth_mbs\": {\"average\": %.4f, \"overall\": %.4f}",
+           result->bandwidth.moment_average / (1024.0 * 1024.0),
+           result->bandwidth.total_average / (1024.0 * 1024.0));
+    printf(", \"msgrate\": {\"average\": %.2f, \"overall\": %.2f}",
+           result->msgrate.moment_average, result->msgrate.total_average);
+    if (result->recv.msgs > 0) {
+        printf(", \"recv\": {\"msgs\": %lu, \"msgrate\": %.2f"
+               ", \"unexp_average\": %.4f, \"unexp_max\": %lu}",
+               result->recv.msgs, result->recv.msgrate,
+               result->recv.unexp_average, result->recv.unexp_max);
+    }
+
+    /* UCX configuration from the environment */
+    printf(", \"env\": {");
+    i = 0;
+    for (env = environ; *env != NULL; ++env) {
+        eq = strchr(*env, '=');
+        if ((strncmp(*env, "UCX_", 4) != 0) || (eq == NULL)) {
+            continue;
+        }
+        printf("%s\"%.*s\": ", (i++ == 0) ? "" : ", ", (int)(eq - *env), *env);
+        print_json_string(eq + 1);
+    }
+    printf("}}\n");
+    fflush(stdout);
+}
+
+static void report_result(struct perftest_context *ctx,
+                          const ucx_perf_result_t *result, int is_final)
+{
+    if (!(ctx->flags & TEST_FLAG_PRINT_JSON)) {
+        print_progress(ctx->test_names, ctx->num_test_names, result, ctx->flags,
+                       is_final);
+    } else if (is_final && (ctx->flags & TEST_FLAG_PRINT_RESULTS)) {
+        print_json(ctx, result);
+    }
+}
+
 static void print_header(struct perftest_context *ctx)
 {
     const char *test_api_str;
     const char *test_data_str;
+    char ucp_data_str[60];
     test_type_t *test;
     unsigned i;
 
+    if (ctx->flags & TEST_FLAG_PRINT_JSON) {
+        return;
+    }
+
     if (ctx->flags & TEST_FLAG_PRINT_TEST) {
         for (test = tests; test->name; ++test) {
             if ((test->command == ctx->params.command) && (test->test_type == ctx->params.test_type)) {
@@ -239,7 +504,25 @@ static void print_header(struct perftest_context *ctx)
                 }
             } else if (test->api == UCX_PERF_API_UCP) {
                 test_api_str = "protocol layer";
-                test_data_str = "(automatic)"; /* TODO contig/stride/stream */
+                switch (ctx->params.ucp.datatype) {
+                case UCP_PERF_DATATYPE_CONTIG:
+                    snprintf(ucp_data_str, sizeof(ucp_data_str), "contig");
+                    break;
+                case UCP_PERF_DATATYPE_IOV:
+                    snprintf(ucp_data_str, sizeof(ucp_data_str), "iov, %u entries",
+                             ctx->params.ucp.iov_count);
+                    break;
+                case UCP_PERF_DATATYPE_GENERIC:
+                    snprintf(ucp_data_str, sizeof(ucp_data_str), "generic");
+                    break;
+                default:
+                    snprintf(ucp_data_str, sizeof(ucp_data_str), "(undefined)");
+                    break;
+                }
+                snprintf(ucp_data_str + strlen(ucp_data_str),
+                         sizeof(ucp_data_str) - strlen(ucp_data_str), " (%s)",
+                         ucp_call_mode_names[ctx->params.ucp.call_mode]);
+                test_data_str = ucp_data_str;
             } else {
                 return;
             }
@@ -257,7 +540,11 @@ static void print_header(struct perftest_context *ctx)
             for (i = 0; i < ctx->num_batch_files; ++i) {
                 printf("%s,", basename(ctx->batch_files[i]));
             }
-            printf("iterations,typical_lat,avg_lat,overall_lat,avg_bw,overall_bw,avg_mr,overall_mr\n");
+            if (ctx->sweep.max_size > 0) {
+                printf("msg_size,");
+            }
+            printf("iterations,typical_lat,avg_lat,overall_lat,avg_bw,overall_bw,avg_mr,overall_mr,"
+                   "p50_lat,p99_lat,p999_lat,jitter,recv_mr,unexp_avg,unexp_max,thread\n");
         }
     } else {
         if (ctx->flags & TEST_FLAG_PRINT_RESULTS) {
@@ -277,11 +564,12 @@ static void print_test_name(struct perftest_context *ctx)
     char buf[200];
     unsigned i, pos;
 
-    if (!(ctx->flags & TEST_FLAG_PRINT_CSV) && (ctx->num_batch_files > 0)) {
+    if (!(ctx->flags & (TEST_FLAG_PRINT_CSV | TEST_FLAG_PRINT_JSON)) &&
+        (ctx->num_test_names > 0)) {
         strcpy(buf, "+--------------+---------+---------+---------+----------+----------+-----------+-----------+");
 
         pos = 1;
-        for (i = 0; i < ctx->num_batch_files; ++i) {
+        for (i = 0; i < ctx->num_test_names; ++i) {
            if (i != 0) {
                buf[pos++] = '/';
            }
@@ -319,19 +607,40 @@ static void usage(struct perftest_context *ctx, const char *program)
     printf("                        short : Use short messages API (cannot used for get).\n");
     printf("                        bcopy : Use copy-out API (cannot used for atomics).\n");
     printf("                        zcopy : Use zero-copy API (cannot used for atomics).\n");
+    printf("                       contig : UCP contiguous datatype (default for UCP).\n");
+    printf("                          iov : UCP scatter-gather datatype, tag matching only.\n");
+    printf("                      generic : UCP generic datatype, tag matching only.\n");
+    printf("     -i <count>     Number of IOV entries, for \"-D iov\". (%u)\n", ctx->params.ucp.iov_count);
+    printf("     -m <mode>      UCP call mode. (blocking)\n");
+    printf("                     blocking  : Wait for every operation to complete.\n");
+    printf("                     nb        : Non-blocking tag matching, with up to \"-O\"\n");
+    printf("                                 requests in flight.\n");
+    printf("                     nbi       : Implicit non-blocking put/get, flushed every\n");
+    printf("                                 \"-O\" operations.\n");
     printf("\n");
     printf("     -d <device>    Device to use for testing.\n");
     printf("     -x <tl>        Transport to use for testing.\n");
     printf("     -c <cpu>       Set affinity to this CPU. (off)\n");
-    printf("     -n <iters>     Number of iterations to run. (%ld)\n", ctx->params.max_iter);
+    printf("     -n <iters>     Number of iterations to run. (%ld, %ld for ucp_connect)\n",
+           ctx->params.max_iter, CONNECT_MAX_ITER);
     printf("     -s <size>      Message size. (%zu)\n", ctx->params.message_size);
     printf("     -H <size>      AM Header size. (%zu)\n", ctx->params.am_hdr_size);
-    printf("     -w <iters>     Number of warm-up iterations. (%zu)\n", ctx->params.warmup_iter);
+    printf("     -w <iters>     Number of warm-up iterations. (%zu, %d for ucp_connect)\n",
+           ctx->params.warmup_iter, CONNECT_WARMUP_ITER);
     printf("     -W <count>     Flow control window size, for active messages. (%u)\n", ctx->params.uct.fc_window);
     printf("     -O <count>     Maximal number of uncompleted outstanding sends. (%u)\n", ctx->params.max_outstanding);
     printf("     -N             Use numeric formatting - thousands separator.\n");
     printf("     -f             Print only final numbers.\n");
     printf("     -v             Print CSV-formatted output.\n");
+    printf("     -L             Print the latency distribution after the final result.\n");
+    printf("     -J             Print final results as JSON, one object per line, with the\n");
+    printf("                       host, version and configuration of the test.\n");
+    printf("     -S <min>:<max>[:<factor>]\n");
+    printf("                    Sweep message sizes from <min> to <max>, multiplying by\n");
+    printf("                       <factor> (%.0f). Above %d bytes, the iterations are reduced\n",
+           ctx->sweep.factor, SWEEP_ITER_SIZE);
+    printf("                       to keep the amount of data, but not below %d.\n",
+           SWEEP_MIN_ITERS);
     printf("     -p <port>      TCP port to use for data exchange. (%d)\n", ctx->port);
     printf("     -b <batchfile> Batch mode. Read and execute tests from a file.\n");
     printf("                       Every line of the file is a test to run. The first word is the\n");
@@ -341,10 +650,18 @@ static void usage(struct perftest_context *ctx, const char *program)
     printf("                        serialized : One thread can access at a time.\n");
     printf("                        multi      : Multiple threads can access.\n");
     printf("     -T <threads>   Number of threads in the test (1); also implies \"-M multi\".\n");
+    printf("     -u             Every thread uses its own worker and endpoints, instead of\n");
+    printf("                       sharing one worker. Requires \"-T\".\n");
+    printf("     -e <count>     Number of endpoints to the peer, UCT only. (%u)\n", ctx->params.ep_count);
+    printf("     -E <order>     Order of using the endpoints. (rr)\n");
+    printf("                        rr         : Round-robin.\n");
+    printf("                        random     : Random endpoint for every operation.\n");
     printf("     -A <mode>      Async progress mode. (thread)\n");
     printf("                        thread     : Use separate progress thread.\n");
     printf("                        signal     : Use signal based timer.\n"); 
     printf("     -B             Register memory with NONBLOCK flag.\n");
+    printf("     -Z             Fail if the measured iterations allocate memory. Requires\n");
+    printf("                       memory tracking (UCX_MEMTRACK_DEST).\n");
 #if HAVE_MPI
     printf("     -P <0|1>       Disable/enable MPI mode (%d)\n", ctx->mpi);
 #endif
@@ -352,6 +669,10 @@ static void usage(struct perftest_context *ctx, const char *program)
     printf("\n");
     printf("  Server options:\n");
     printf("     -l             Accept clients in an infinite loop\n");
+    printf("     -G <count>     Number of processes in the test, including the server. (%u)\n",
+           ctx->sock_rte_group.size);
+    printf("                       More than 2 is supported by the incast and all-to-all tests,\n");
+    printf("                       and every client connects to this server.\n");
     printf("\n");
 }
 
@@ -371,16 +692,21 @@ static void init_test_params(ucx_perf_params_t *params)
     params->async_mode      = UCS_ASYNC_MODE_THREAD;
     params->wait_mode       = UCX_PERF_WAIT_MODE_LAST;
     params->max_outstanding = 1;
-    params->warmup_iter     = 10000;
+    params->ep_count        = 1;
+    params->ep_order        = UCX_PERF_EP_ORDER_ROUND_ROBIN;
+    params->warmup_iter     = DEFAULT_WARMUP_ITER;
     params->message_size    = 8;
     params->am_hdr_size     = 8;
     params->alignment       = ucs_get_page_size();
-    params->max_iter        = 1000000l;
+    params->max_iter        = DEFAULT_MAX_ITER;
     params->max_time        = 0.0;
     params->report_interval = 1.0;
     params->flags           = UCX_PERF_TEST_FLAG_VERBOSE;
     params->uct.fc_window   = UCT_PERF_TEST_MAX_FC_WINDOW;
     params->uct.data_layout = UCT_PERF_DATA_LAYOUT_SHORT;
+    params->ucp.datatype    = UCP_PERF_DATATYPE_CONTIG;
+    params->ucp.iov_count   = 1;
+    params->ucp.call_mode   = UCP_PERF_CALL_MODE_BLOCKING;
     strcpy(params->uct.dev_name, "");
     strcpy(params->uct.tl_name, "");
 }
@@ -404,6 +730,16 @@ static ucs_status_t parse_test_params(ucx_perf_params_t *params, char opt, const
                 params->api       = test->api;
                 params->command   = test->command;
                 params->test_type = test->test_type;
+                if (test->command == UCX_PERF_CMD_CONNECT) {
+                    /* A connection takes milliseconds, so the default number
+                     * of iterations would run for hours */
+                    if (params->max_iter == DEFAULT_MAX_ITER) {
+                        params->max_iter = CONNECT_MAX_ITER;
+                    }
+                    if (params->warmup_iter == DEFAULT_WARMUP_ITER) {
+                        params->warmup_iter = CONNECT_WARMUP_ITER;
+                    }
+                }
                 break;
             }
         }
@@ -419,6 +755,12 @@ static ucs_status_t parse_test_params(ucx_perf_params_t *params, char opt, const
             params->uct.data_layout   = UCT_PERF_DATA_LAYOUT_BCOPY;
         } else if (0 == strcmp(optarg, "zcopy")) {
             params->uct.data_layout   = UCT_PERF_DATA_LAYOUT_ZCOPY;
+        } else if (0 == strcmp(optarg, "contig")) {
+            params->ucp.datatype      = UCP_PERF_DATATYPE_CONTIG;
+        } else if (0 == strcmp(optarg, "iov")) {
+            params->ucp.datatype      = UCP_PERF_DATATYPE_IOV;
+        } else if (0 == strcmp(optarg, "generic")) {
+            params->ucp.datatype      = UCP_PERF_DATATYPE_GENERIC;
         } else {
             ucs_error("Invalid option argument for -D");
             return -1;
@@ -451,6 +793,9 @@ static ucs_status_t parse_test_params(ucx_perf_params_t *params, char opt, const
     case 'q':
         params->flags &= ~UCX_PERF_TEST_FLAG_VERBOSE;
         return UCS_OK;
+    case 'Z':
+        params->flags |= UCX_PERF_TEST_FLAG_NO_ALLOC;
+        return UCS_OK;
     case 'M':
         if (0 == strcmp(optarg, "single")) {
             params->thread_mode = UCS_THREAD_MODE_SINGLE;
@@ -469,6 +814,40 @@ static ucs_status_t parse_test_params(ucx_perf_params_t *params, char opt, const
         params->thread_count = atoi(optarg);
         params->thread_mode = UCS_THREAD_MODE_MULTI;
         return UCS_OK;
+    case 'u':
+        params->flags |= UCX_PERF_TEST_FLAG_MT_WORKERS;
+        return UCS_OK;
+    case 'e':
+        params->ep_count = atoi(optarg);
+        return UCS_OK;
+    case 'i':
+        params->ucp.iov_count = atoi(optarg);
+        return UCS_OK;
+    case 'm':
+        if (0 == strcmp(optarg, "blocking")) {
+            params->ucp.call_mode = UCP_PERF_CALL_MODE_BLOCKING;
+            return UCS_OK;
+        } else if (0 == strcmp(optarg, "nb")) {
+            params->ucp.call_mode = UCP_PERF_CALL_MODE_NB;
+            return UCS_OK;
+        } else if (0 == strcmp(optarg, "nbi")) {
+            params->ucp.call_mode = UCP_PERF_CALL_MODE_NBI;
+            return UCS_OK;
+        } else {
+            ucs_error("Invalid option argument for -m");
+            return UCS_ERR_INVALID_PARAM;
+        }
+    case 'E':
+        if (0 == strcmp(optarg, "rr")) {
+            params->ep_order = UCX_PERF_EP_ORDER_ROUND_ROBIN;
+            return UCS_OK;
+        } else if (0 == strcmp(optarg, "random")) {
+            params->ep_order = UCX_PERF_EP_ORDER_RANDOM;
+            return UCS_OK;
+        } else {
+            ucs_error("Invalid option argument for -E");
+            return UCS_ERR_INVALID_PARAM;
+        }
     case 'A':
         if (0 == strcmp(optarg, "thread")) {
             params->async_mode = UCS_ASYNC_MODE_THREAD;
@@ -524,6 +903,35 @@ static ucs_status_t read_batch_file(FILE *batch_file, ucx_perf_params_t *params,
     return UCS_OK;
 }
 
+/* Parse "<min>:<max>[:<factor>]", sizes may have a k/m/g suffix */
+static ucs_status_t parse_sweep(struct perftest_context *ctx, const char *arg)
+{
+    char *str, *min_str, *max_str, *factor_str, *saveptr;
+    ucs_status_t status;
+
+    str        = strdup(arg);
+    min_str    = strtok_r(str, ":", &saveptr);
+    max_str    = strtok_r(NULL, ":", &saveptr);
+    factor_str = strtok_r(NULL, ":", &saveptr);
+
+    if ((min_str == NULL) || (max_str == NULL) ||
+        !ucs_config_sscanf_memunits(min_str, &ctx->sweep.min_size, NULL) ||
+        !ucs_config_sscanf_memunits(max_str, &ctx->sweep.max_size, NULL) ||
+        ((factor_str != NULL) && (sscanf(factor_str, "%lf", &ctx->sweep.factor) != 1)) ||
+        (ctx->sweep.min_size == 0) || (ctx->sweep.min_size > ctx->sweep.max_size) ||
+        (ctx->sweep.factor <= 1.0))
+    {
+        ucs_error("Invalid option argument for -S: '%s'", arg);
+        ctx->sweep.max_size = 0;
+        status = UCS_ERR_INVALID_PARAM;
+    } else {
+        status = UCS_OK;
+    }
+
+    free(str);
+    return status;
+}
+
 static ucs_status_t parse_opts(struct perftest_context *ctx, int argc, char **argv)
 {
     ucs_status_t status;
@@ -536,12 +944,16 @@ static ucs_status_t parse_opts(struct perftest_context *ctx, int argc, char **ar
     ctx->num_batch_files        = 0;
     ctx->port                   = 13337;
     ctx->flags                  = 0;
+    ctx->sock_rte_group.size    = 2;
+    ctx->sweep.min_size         = 0;
+    ctx->sweep.max_size         = 0;
+    ctx->sweep.factor           = 2.0;
 #if HAVE_MPI
     ctx->mpi                    = !isatty(0);
 #endif
 
     optind = 1;
-    while ((c = getopt (argc, argv, "p:b:Nfvc:P:h" TEST_PARAMS_ARGS)) != -1) {
+    while ((c = getopt (argc, argv, "p:b:NfvLJS:c:P:G:h" TEST_PARAMS_ARGS)) != -1) {
         switch (c) {
         case 'p':
             ctx->port = atoi(optarg);
@@ -560,10 +972,25 @@ static ucs_status_t parse_opts(struct perftest_context *ctx, int argc, char **ar
         case 'v':
             ctx->flags |= TEST_FLAG_PRINT_CSV;
             break;
+        case 'L':
+            ctx->flags |= TEST_FLAG_PRINT_HIST;
+            break;
+        case 'J':
+            ctx->flags |= TEST_FLAG_PRINT_JSON;
+            break;
+        case 'S':
+            status = parse_sweep(ctx, optarg);
+            if (status != UCS_OK) {
+                return status;
+            }
+            break;
         case 'c':
             ctx->flags |= TEST_FLAG_SET_AFFINITY;
             ctx->cpu = atoi(optarg);
             break;
+        case 'G':
+            ctx->sock_rte_group.size = atoi(optarg);
+            break;
         case 'P':
 #if HAVE_MPI
             ctx->mpi = atoi(optarg);
@@ -591,15 +1018,20 @@ static ucs_status_t parse_opts(struct perftest_context *ctx, int argc, char **ar
 
 static unsigned sock_rte_group_size(void *rte_group)
 {
-    return 2;
+    sock_rte_group_t *group = rte_group;
+    return group->size;
 }
 
 static unsigned sock_rte_group_index(void *rte_group)
 {
     sock_rte_group_t *group = rte_group;
-    return group->is_server ? 0 : 1;
+    return group->index;
 }
 
+/*
+ * With more than 2 processes, the server (index 0) is the hub of a star: every
+ * client talks only to the server, which relays barrier and address exchange.
+ */
 static void sock_rte_barrier(void *rte_group)
 {
 #pragma omp master
@@ -607,23 +1039,55 @@ static void sock_rte_barrier(void *rte_group)
     sock_rte_group_t *group = rte_group;
     const unsigned magic = 0xdeadbeef;
     unsigned sync;
+    unsigned i;
 
-    sync = magic;
-    safe_send(group->connfd, &sync, sizeof(unsigned));
+    if (group->is_server) {
+        for (i = 1; i < group->size; ++i) {
+            sync = 0;
+            safe_recv(group->peer_fds[i], &sync, sizeof(unsigned));
+            ucs_assert(sync == magic);
+        }
+        sync = magic;
+        for (i = 1; i < group->size; ++i) {
+            safe_send(group->peer_fds[i], &sync, sizeof(unsigned));
+        }
+    } else {
+        sync = magic;
+        safe_send(group->connfd, &sync, sizeof(unsigned));
 
-    sync = 0;
-    safe_recv(group->connfd, &sync, sizeof(unsigned));
+        sync = 0;
+        safe_recv(group->connfd, &sync, sizeof(unsigned));
 
-    ucs_assert(sync == magic);
+        ucs_assert(sync == magic);
+    }
   }
 #pragma omp barrier
 }
 
+static void sock_rte_send_vec(int fd, sock_rte_group_t *group, unsigned src)
+{
+    safe_send(fd, &group->vec_sizes[src], sizeof(size_t));
+    safe_send(fd, group->vecs[src], group->vec_sizes[src]);
+}
+
+static void sock_rte_recv_vec(int fd, sock_rte_group_t *group, unsigned src)
+{
+    size_t size;
+
+    safe_recv(fd, &size, sizeof(size));
+    free(group->vecs[src]);
+    group->vecs[src]      = malloc(size);
+    group->vec_sizes[src] = size;
+    ucs_assert_always((group->vecs[src] != NULL) || (size == 0));
+    safe_recv(fd, group->vecs[src], size);
+}
+
 static void sock_rte_post_vec(void *rte_group, const struct iovec *iovec,
                               int iovcnt, void **req)
 {
     sock_rte_group_t *group = rte_group;
-    size_t size;
+    size_t size, offset;
+    void *vec;
     int i;
 
     size = 0;
@@ -631,9 +1095,43 @@ static void sock_rte_post_vec(void *rte_group, const struct iovec *iovec,
         size += iovec[i].iov_len;
     }
 
-    safe_send(group->connfd, &size, sizeof(size));
+    vec = malloc(size);
+    ucs_assert_always((vec != NULL) || (size == 0));
+
+    offset = 0;
     for (i = 0; i < iovcnt; ++i) {
-        safe_send(group->connfd, iovec[i].iov_base, iovec[i].iov_len);
+        memcpy((char*)vec + offset, iovec[i].iov_base, iovec[i].iov_len);
+        offset += iovec[i].iov_len;
+    }
+
+    free(group->vecs[group->index]);
+    group->vecs[group->index]      = vec;
+    group->vec_sizes[group->index] = size;
+}
+
+static void sock_rte_exchange_vec(void *rte_group, void *req)
+{
+    sock_rte_group_t *group = rte_group;
+    unsigned i, src;
+
+    if (group->is_server) {
+        for (i = 1; i < group->size; ++i) {
+            sock_rte_recv_vec(group->peer_fds[i], group, i);
+        }
+        for (i = 1; i < group->size; ++i) {
+            for (src = 0; src < group->size; ++src) {
+                if (src != i) {
+                    sock_rte_send_vec(group->peer_fds[i], group, src);
+                }
+            }
+        }
+    } else {
+        sock_rte_send_vec(group->connfd, group, group->index);
+        for (src = 0; src < group->size; ++src) {
+            if (src != group->index) {
+                sock_rte_recv_vec(group->connfd, group, src);
+            }
+        }
     }
 }
 
@@ -641,26 +1139,21 @@ static void sock_rte_recv(void *rte_group, unsigned src, void *buffer,
                           size_t max, void *req)
 {
     sock_rte_group_t *group = rte_group;
-    int group_index;
-    size_t size;
 
-    group_index = sock_rte_group_index(rte_group);
-    if (src == group_index) {
+    if (src == group->index) {
         return;
     }
 
-    ucs_assert_always(src == (1 - group_index));
-    safe_recv(group->connfd, &size, sizeof(size));
-    ucs_assert_always(size <= max);
-    safe_recv(group->connfd, buffer, size);
+    ucs_assert_always(src < group->size);
+    ucs_assert_always(group->vec_sizes[src] <= max);
+    memcpy(buffer, group->vecs[src], group->vec_sizes[src]);
 }
 
 static void sock_rte_report(void *rte_group, const ucx_perf_result_t *result,
                             void *arg, int is_final)
 {
     struct perftest_context *ctx = arg;
-    print_progress(ctx->test_names, ctx->num_batch_files, result, ctx->flags,
-                   is_final);
+    report_result(ctx, result, is_final);
 }
 
 static ucx_perf_rte_t sock_rte = {
@@ -669,17 +1162,19 @@ static ucx_perf_rte_t sock_rte = {
     .barrier       = sock_rte_barrier,
     .post_vec      = sock_rte_post_vec,
     .recv          = sock_rte_recv,
-    .exchange_vec  = (void*)ucs_empty_function,
+    .exchange_vec  = sock_rte_exchange_vec,
     .report        = sock_rte_report,
 };
 
 static ucs_status_t setup_sock_rte(struct perftest_context *ctx)
 {
+    sock_rte_group_t *group = &ctx->sock_rte_group;
     struct sockaddr_in inaddr;
     struct hostent *he;
     ucs_status_t status;
     int optval = 1;
     int sockfd, connfd;
+    unsigned i, info[2];
     int ret;
 
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
@@ -690,6 +1185,12 @@ static ucs_status_t setup_sock_rte(struct perftest_context *ctx)
     }
 
     if (ctx->server_addr == NULL) {
+        if (group->size < 2) {
+            ucs_error("group size must be at least 2");
+            status = UCS_ERR_INVALID_PARAM;
+            goto err_close_sockfd;
+        }
+
         optval = 1;
         ret = setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
         if (ret < 0) {
@@ -716,21 +1217,43 @@ static ucs_status_t setup_sock_rte(struct perftest_context *ctx)
             goto err_close_sockfd;
         }
 
-        printf("Waiting for connection...\n");
-
-        /* Accept next connection */
-        connfd = accept(sockfd, NULL, NULL);
-        if (connfd < 0) {
-            ucs_error("accept() failed: %m");
-            status = UCS_ERR_IO_ERROR;
+        group->peer_fds = calloc(group->size, sizeof(*group->peer_fds));
+        if (group->peer_fds == NULL) {
+            status = UCS_ERR_NO_MEMORY;
             goto err_close_sockfd;
         }
 
+        if (group->size > 2) {
+            printf("Waiting for %u connections...\n", group->size - 1);
+        } else {
+            printf("Waiting for connection...\n");
+        }
+
+        /* Accept the clients, and assign them indices by connection order */
+        for (i = 1; i < group->size; ++i) {
+            connfd = accept(sockfd, NULL, NULL);
+            if (connfd < 0) {
+                ucs_error("accept() failed: %m");
+                status = UCS_ERR_IO_ERROR;
+                goto err_close_peers;
+            }
+
+            group->peer_fds[i] = connfd;
+            safe_recv(connfd, &ctx->params, sizeof(ctx->params));
+            safe_recv(connfd, &ctx->sweep, sizeof(ctx->sweep));
+        }
+
         close(sockfd);
-        safe_recv(connfd, &ctx->params, sizeof(ctx->params));
 
-        ctx->sock_rte_group.connfd    = connfd;
-        ctx->sock_rte_group.is_server = 1;
+        for (i = 1; i < group->size; ++i) {
+            info[0] = group->size;
+            info[1] = i;
+            safe_send(group->peer_fds[i], info, sizeof(info));
+        }
+
+        group->connfd    = -1;
+        group->index     = 0;
+        group->is_server = 1;
     } else {
         he = gethostbyname(ctx->server_addr);
         if (he == NULL || he->h_addr_list == NULL) {
@@ -754,22 +1277,57 @@ static ucs_status_t setup_sock_rte(struct perftest_context *ctx)
         }
 
         safe_send(sockfd, &ctx->params, sizeof(ctx->params));
+        safe_send(sockfd, &ctx->sweep, sizeof(ctx->sweep));
+        safe_recv(sockfd, info, sizeof(info));
+
+        group->connfd    = sockfd;
+        group->peer_fds  = NULL;
+        group->size      = info[0];
+        group->index     = info[1];
+        group->is_server = 0;
+    }
 
-        ctx->sock_rte_group.connfd    = sockfd;
-        ctx->sock_rte_group.is_server = 0;
+    group->vecs      = calloc(group->size, sizeof(*group->vecs));
+    group->vec_sizes = calloc(group->size, sizeof(*group->vec_sizes));
+    if ((group->vecs == NULL) || (group->vec_sizes == NULL)) {
+        free(group->vecs);
+        free(group->vec_sizes);
+        status = UCS_ERR_NO_MEMORY;
+        goto err_close_conns;
     }
 
-    if (ctx->sock_rte_group.is_server) {
+    if (group->size > 2) {
+        /* Only the server, which is also the receiver of incast, reports */
+        if (group->is_server) {
+            ctx->flags |= TEST_FLAG_PRINT_TEST | TEST_FLAG_PRINT_RESULTS;
+        }
+    } else if (group->is_server) {
         ctx->flags |= TEST_FLAG_PRINT_TEST;
     } else {
         ctx->flags |= TEST_FLAG_PRINT_RESULTS;
     }
 
-    ctx->params.rte_group         = &ctx->sock_rte_group;
+    ctx->params.rte_group         = group;
     ctx->params.rte               = &sock_rte;
     ctx->params.report_arg        = ctx;
     return UCS_OK;
 
+err_close_conns:
+    if (group->is_server) {
+        for (i = 1; i < group->size; ++i) {
+            close(group->peer_fds[i]);
+        }
+        free(group->peer_fds);
+    } else {
+        close(group->connfd);
+    }
+    return status;
+
+err_close_peers:
+    while (--i > 0) {
+        close(group->peer_fds[i]);
+    }
+    free(group->peer_fds);
 err_close_sockfd:
     close(sockfd);
 err:
@@ -778,7 +1336,23 @@ err:
 
 static ucs_status_t cleanup_sock_rte(struct perftest_context *ctx)
 {
-    close(ctx->sock_rte_group.connfd);
+    sock_rte_group_t *group = &ctx->sock_rte_group;
+    unsigned i;
+
+    for (i = 0; i < group->size; ++i) {
+        free(group->vecs[i]);
+    }
+    free(group->vecs);
+    free(group->vec_sizes);
+
+    if (group->is_server) {
+        for (i = 1; i < group->size; ++i) {
+            close(group->peer_fds[i]);
+        }
+        free(group->peer_fds);
+    } else {
+        close(group->connfd);
+    }
     return UCS_OK;
 }
 
@@ -856,8 +1430,7 @@ static void mpi_rte_report(void *rte_group, const ucx_perf_result_t *result,
                            void *arg, int is_final)
 {
     struct perftest_context *ctx = arg;
-    print_progress(ctx->test_names, ctx->num_batch_files, result, ctx->flags,
-                   is_final);
+    report_result(ctx, result, is_final);
 }
 
 static ucx_perf_rte_t mpi_rte = {
@@ -974,8 +1547,7 @@ static void ext_rte_report(void *rte_group, const ucx_perf_result_t *result,
                            void *arg, int is_final)
 {
     struct perftest_context *ctx = arg;
-    print_progress(ctx->test_names, ctx->num_batch_files, result, ctx->flags,
-                   is_final);
+    report_result(ctx, result, is_final);
 }
 
 static ucx_perf_rte_t ext_rte = {
@@ -1085,6 +1657,47 @@ static ucs_status_t check_system(struct perftest_context *ctx)
     return UCS_OK;
 }
 
+/* Run the test for every message size of the sweep, as an extra batch level */
+static ucs_status_t run_sweep(struct perftest_context *ctx,
+                              ucx_perf_params_t *parent_params, unsigned depth)
+{
+    ucx_perf_params_t params;
+    ucx_perf_result_t result;
+    ucs_status_t status;
+    char size_str[32];
+    size_t size;
+
+    params          = *parent_params;
+    ctx->cur_params = &params;
+    status          = UCS_OK;
+
+    size = ctx->sweep.min_size;
+    while (size <= ctx->sweep.max_size) {
+        params.message_size = size;
+        params.max_iter     = parent_params->max_iter;
+        if ((size > SWEEP_ITER_SIZE) && (params.max_iter > 0)) {
+            params.max_iter = ucs_max(params.max_iter * SWEEP_ITER_SIZE / size,
+                                      SWEEP_MIN_ITERS);
+        }
+
+        snprintf(size_str, sizeof(size_str), "%zu", size);
+        ctx->test_names[depth] = size_str;
+        print_test_name(ctx);
+
+        status = ucx_perf_run(&params, &result);
+        if (status != UCS_OK) {
+            ucs_error("Sweep stopped at message size %zu: %s", size,
+                      ucs_status_string(status));
+            break;
+        }
+
+        size = ucs_max(size + 1, (size_t)(size * ctx->sweep.factor));
+    }
+
+    ctx->cur_params = parent_params;
+    return status;
+}
+
 static ucs_status_t run_test_recurs(struct perftest_context *ctx,
                                     ucx_perf_params_t *parent_params,
                                     unsigned depth)
@@ -1097,8 +1710,12 @@ static ucs_status_t run_test_recurs(struct perftest_context *ctx,
     ucs_trace_func("depth=%u", depth);
 
     if (depth >= ctx->num_batch_files) {
-        print_test_name(ctx);
-        return ucx_perf_run(parent_params, &result);
+        if (ctx->sweep.max_size == 0) {
+            ctx->cur_params = parent_params;
+            print_test_name(ctx);
+            return ucx_perf_run(parent_params, &result);
+        }
+        return run_sweep(ctx, parent_params, depth);
     }
 
     batch_file = fopen(ctx->batch_files[depth], "r");
@@ -1125,6 +1742,9 @@ static ucs_status_t run_test(struct perftest_context *ctx)
 
     setlocale(LC_ALL, "en_US");
 
+    ctx->num_test_names = ctx->num_batch_files +
+                          ((ctx->sweep.max_size > 0) ? 1 : 0);
+
     print_header(ctx);
 
     status = run_test_recurs(ctx, &ctx->params, 0);
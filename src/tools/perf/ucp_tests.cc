@@ -14,21 +14,154 @@ extern "C" {
 }
 #include <ucs/sys/preprocessor.h>
 
+#include <unistd.h>
+
+
+/* Maximal length of the listener address, which is sent to the client */
+#define UCX_PERF_CONNECT_SOCKADDR_MAX  256
+
 
 template <ucx_perf_cmd_t CMD, ucx_perf_test_type_t TYPE, bool ONESIDED>
 class ucp_perf_test_runner {
 public:
-    static const ucp_tag_t TAG = 0x1337a880u;
+    static const ucp_tag_t TAG      = 0x1337a880u;
+    static const ucp_tag_t FIN_TAG  = TAG + 1;   /* Sender is done */
+    static const ucp_tag_t TAG_MASK = (ucp_tag_t)-1 ^ 1; /* Match TAG and FIN_TAG */
 
     typedef uint8_t psn_t;
 
+    typedef struct {
+        void               *buffer;
+        size_t             length;
+    } generic_state_t;
+
+    typedef struct {
+        ucp_ep_h           ep;       /* Last endpoint created by the listener */
+        ucx_perf_counter_t count;    /* Number of endpoints created */
+    } connect_state_t;
+
     ucp_perf_test_runner(ucx_perf_context_t &perf) :
         m_perf(perf),
         m_outstanding(0),
-        m_max_outstanding(m_perf.params.max_outstanding)
-
+        m_max_outstanding(m_perf.params.max_outstanding),
+        m_fin_count(0),
+        m_fin_expected(0),
+        m_call_mode(m_perf.params.ucp.call_mode),
+        m_req_head(0)
     {
         ucs_assert_always(m_max_outstanding > 0);
+
+        m_requests = (void**)malloc(sizeof(*m_requests) * m_max_outstanding);
+        ucs_assert_always(m_requests != NULL);
+        init_datatype();
+    }
+
+    ~ucp_perf_test_runner() {
+        ucs_assert(m_outstanding == 0);
+        if (m_perf.params.ucp.datatype == UCP_PERF_DATATYPE_GENERIC) {
+            ucp_dt_destroy(m_datatype);
+        }
+        free(m_iov);
+        free(m_requests);
+    }
+
+    void init_datatype()
+    {
+        static const ucp_generic_dt_ops_t generic_ops = {
+            generic_start_pack,
+            generic_start_unpack,
+            generic_packed_size,
+            generic_pack,
+            generic_unpack,
+            generic_finish
+        };
+        size_t length = m_perf.params.message_size;
+        unsigned iov_count, i;
+        size_t offset;
+        ucs_status_t status;
+
+        m_iov = NULL;
+
+        switch (m_perf.params.ucp.datatype) {
+        case UCP_PERF_DATATYPE_IOV:
+            /* Split the send and receive buffers into equal parts, the last
+             * entry takes the remainder */
+            iov_count  = m_perf.params.ucp.iov_count;
+            m_iov      = (ucp_dt_iov_t*)malloc(sizeof(*m_iov) * 2 * iov_count);
+            ucs_assert_always(m_iov != NULL);
+            m_send_iov = m_iov;
+            m_recv_iov = m_iov + iov_count;
+            offset     = 0;
+            for (i = 0; i < iov_count; ++i) {
+                m_send_iov[i].buffer = (char*)m_perf.send_buffer + offset;
+                m_recv_iov[i].buffer = (char*)m_perf.recv_buffer + offset;
+                m_send_iov[i].length = (i == iov_count - 1) ?
+                                       (length - offset) : (length / iov_count);
+                m_recv_iov[i].length = m_send_iov[i].length;
+                offset              += m_send_iov[i].length;
+            }
+            m_datatype = ucp_dt_make_iov();
+            m_count    = iov_count;
+            break;
+        case UCP_PERF_DATATYPE_GENERIC:
+            status = ucp_dt_create_generic(&generic_ops, this, &m_datatype);
+            ucs_assert_always(status == UCS_OK);
+            m_count = length;
+            break;
+        case UCP_PERF_DATATYPE_CONTIG:
+        default:
+            m_datatype = ucp_dt_make_contig(1);
+            m_count    = length;
+            break;
+        }
+    }
+
+    /* Generic datatype packs from, and unpacks to, a contiguous buffer */
+    static void *generic_start_pack(void *context, const void *buffer,
+                                    size_t count)
+    {
+        ucp_perf_test_runner *self = (ucp_perf_test_runner*)context;
+
+        self->m_pack_state.buffer = (void*)buffer;
+        self->m_pack_state.length = count;
+        return &self->m_pack_state;
+    }
+
+    static void *generic_start_unpack(void *context, void *buffer, size_t count)
+    {
+        ucp_perf_test_runner *self = (ucp_perf_test_runner*)context;
+
+        self->m_unpack_state.buffer = buffer;
+        self->m_unpack_state.length = count;
+        return &self->m_unpack_state;
+    }
+
+    static size_t generic_packed_size(void *state)
+    {
+        return ((generic_state_t*)state)->length;
+    }
+
+    static size_t generic_pack(void *state, size_t offset, void *dest,
+                               size_t max_length)
+    {
+        generic_state_t *gstate = (generic_state_t*)state;
+        size_t length = ucs_min(max_length, gstate->length - offset);
+
+        memcpy(dest, (char*)gstate->buffer + offset, length);
+        return length;
+    }
+
+    static ucs_status_t generic_unpack(void *state, size_t offset,
+                                       const void *src, size_t count)
+    {
+        generic_state_t *gstate = (generic_state_t*)state;
+
+        memcpy((char*)gstate->buffer + offset, src, count);
+        return UCS_OK;
+    }
+
+    static void generic_finish(void *state)
+    {
     }
 
     void UCS_F_ALWAYS_INLINE progress_responder() {
@@ -58,6 +191,67 @@ public:
         return UCS_OK;
     }
 
+    /*
+     * In non-blocking mode, keep up to max_outstanding requests in flight and
+     * wait only for the oldest one when the window is full.
+     */
+    ucs_status_t UCS_F_ALWAYS_INLINE wait_window(void *request, bool is_requestor)
+    {
+        unsigned index;
+
+        if (ucs_likely(!UCS_PTR_IS_PTR(request)) ||
+            (m_call_mode != UCP_PERF_CALL_MODE_NB))
+        {
+            return wait(request, is_requestor);
+        }
+
+        if (m_outstanding >= m_max_outstanding) {
+            wait(m_requests[m_req_head], is_requestor);
+            m_req_head = (m_req_head + 1) % m_max_outstanding;
+            --m_outstanding;
+        }
+
+        index             = (m_req_head + m_outstanding) % m_max_outstanding;
+        m_requests[index] = request;
+        ++m_outstanding;
+        return UCS_OK;
+    }
+
+    /* Complete all outstanding requests, or flush implicit operations */
+    void wait_all(bool is_requestor)
+    {
+        if (m_call_mode == UCP_PERF_CALL_MODE_NBI) {
+            if (m_outstanding > 0) {
+                ucp_worker_flush(m_perf.ucp.worker);
+                m_outstanding = 0;
+            }
+            return;
+        }
+
+        while (m_outstanding > 0) {
+            wait(m_requests[m_req_head], is_requestor);
+            m_req_head = (m_req_head + 1) % m_max_outstanding;
+            --m_outstanding;
+        }
+    }
+
+    /* Flush implicit non-blocking operations after every window */
+    ucs_status_t UCS_F_ALWAYS_INLINE flush_window(ucs_status_t status)
+    {
+        if (ucs_unlikely((status != UCS_OK) && (status != UCS_INPROGRESS))) {
+            return status;
+        }
+
+        /* In ping-pong the remote side waits for every operation */
+        if ((TYPE == UCX_PERF_TEST_TYPE_PINGPONG) ||
+            (++m_outstanding >= m_max_outstanding))
+        {
+            ucp_worker_flush(m_perf.ucp.worker);
+            m_outstanding = 0;
+        }
+        return UCS_OK;
+    }
+
     ucs_status_t UCS_F_ALWAYS_INLINE
     send(ucp_ep_h ep, void *buffer, unsigned length, uint8_t sn,
          uint64_t remote_addr, ucp_rkey_h rkey)
@@ -66,13 +260,23 @@ public:
 
         switch (CMD) {
         case UCX_PERF_CMD_TAG:
-            request = ucp_tag_send_nb(ep, buffer, length, ucp_dt_make_contig(1),
-                                      TAG, (ucp_send_callback_t)ucs_empty_function);
-            return wait(request, true);
+            request = ucp_tag_send_nb(ep, (m_datatype == ucp_dt_make_iov()) ?
+                                      (void*)m_send_iov : buffer,
+                                      m_count, m_datatype, TAG,
+                                      (ucp_send_callback_t)ucs_empty_function);
+            return wait_window(request, true);
         case UCX_PERF_CMD_PUT:
             *((uint8_t*)buffer + length - 1) = sn;
+            if (m_call_mode == UCP_PERF_CALL_MODE_NBI) {
+                return flush_window(ucp_put_nbi(ep, buffer, length, remote_addr,
+                                                rkey));
+            }
             return ucp_put(ep, buffer, length, remote_addr, rkey);
         case UCX_PERF_CMD_GET:
+            if (m_call_mode == UCP_PERF_CALL_MODE_NBI) {
+                return flush_window(ucp_get_nbi(ep, buffer, length, remote_addr,
+                                                rkey));
+            }
             return ucp_get(ep, buffer, length, remote_addr, rkey);
         case UCX_PERF_CMD_ADD:
             if (length == sizeof(uint32_t)) {
@@ -119,10 +323,15 @@ public:
 
         switch (CMD) {
         case UCX_PERF_CMD_TAG:
-            request = ucp_tag_recv_nb(worker, buffer, length, ucp_dt_make_contig(1),
-                                      TAG, 0,
+            request = ucp_tag_recv_nb(worker, (m_datatype == ucp_dt_make_iov()) ?
+                                      (void*)m_recv_iov : buffer,
+                                      m_count, m_datatype, TAG, 0,
                                       (ucp_tag_recv_callback_t)ucs_empty_function);
-            return wait(request, false);
+            if (TYPE == UCX_PERF_TEST_TYPE_PINGPONG) {
+                /* The reply depends on this message */
+                return wait(request, false);
+            }
+            return wait_window(request, false);
         case UCX_PERF_CMD_PUT:
             switch (TYPE) {
             case UCX_PERF_TEST_TYPE_PINGPONG:
@@ -199,6 +408,7 @@ public:
             }
         }
 
+        wait_all(true);
         ucp_worker_flush(m_perf.ucp.worker);
         rte_call(&m_perf, barrier);
         return UCS_OK;
@@ -246,18 +456,370 @@ public:
             }
         }
 
+        wait_all(my_index == 1);
+        ucp_worker_flush(m_perf.ucp.worker);
+        rte_call(&m_perf, barrier);
+        return UCS_OK;
+    }
+
+    /*
+     * Receive all messages which are waiting in the unexpected queue. There is
+     * no API to query the queue, so its depth is sampled as the number of
+     * messages found waiting by every pass which finds any.
+     */
+    void drain_unexpected(bool is_result)
+    {
+        ucx_perf_counter_t depth = 0;
+        ucp_tag_message_h message;
+        ucp_tag_recv_info_t info;
+        uint64_t fin_count;
+        void *request;
+
+        for (;;) {
+            message = ucp_tag_probe_nb(m_perf.ucp.worker, TAG, TAG_MASK, 1, &info);
+            if (message == NULL) {
+                break;
+            }
+
+            ++depth;
+            if (info.sender_tag == FIN_TAG) {
+                request = ucp_tag_msg_recv_nb(m_perf.ucp.worker, &fin_count,
+                                              sizeof(fin_count),
+                                              ucp_dt_make_contig(1), message,
+                                              (ucp_tag_recv_callback_t)ucs_empty_function);
+                wait(request, false);
+                m_fin_expected += fin_count;
+                ++m_fin_count;
+                continue;
+            }
+
+            request = ucp_tag_msg_recv_nb(m_perf.ucp.worker, m_perf.recv_buffer,
+                                          info.length, ucp_dt_make_contig(1),
+                                          message,
+                                          (ucp_tag_recv_callback_t)ucs_empty_function);
+            wait(request, false);
+            if (is_result) {
+                ucx_perf_update(&m_perf, 1, info.length);
+            }
+            ucx_perf_update_recv(&m_perf, 1);
+        }
+
+        if (depth > 0) {
+            ucx_perf_update_unexp(&m_perf, depth);
+        }
+    }
+
+    /* Send while receiving, so a peer waiting on us for rendezvous can proceed */
+    void send_drain(ucp_ep_h ep, void *buffer, size_t length, ucp_tag_t tag,
+                    bool is_result)
+    {
+        void *request;
+
+        request = ucp_tag_send_nb(ep, buffer, length, ucp_dt_make_contig(1), tag,
+                                  (ucp_send_callback_t)ucs_empty_function);
+        if (!UCS_PTR_IS_PTR(request)) {
+            ucs_assert_always(UCS_PTR_STATUS(request) == UCS_OK);
+            return;
+        }
+
+        while (!ucp_request_is_completed(request)) {
+            progress_requestor();
+            drain_unexpected(is_result);
+        }
+        ucp_request_release(request);
+    }
+
+    /* Wait for FIN from all other ranks, and for all the messages they sent */
+    void wait_fin(unsigned num_senders, bool is_result)
+    {
+        while ((m_fin_count < num_senders) || (m_perf.recv.msgs < m_fin_expected)) {
+            progress_responder();
+            drain_unexpected(is_result);
+        }
+    }
+
+    ucs_status_t run_incast()
+    {
+        unsigned group_size, my_index;
+        uint64_t sent;
+        ucp_ep_h ep;
+
+        ucs_assert(m_perf.params.message_size >= sizeof(psn_t));
+
+        rte_call(&m_perf, barrier);
+
+        group_size = rte_call(&m_perf, group_size);
+        my_index   = rte_call(&m_perf, group_index);
+
+        ucx_perf_test_start_clock(&m_perf);
+
+        if (my_index == 0) {
+            /* The receive rate is the result of rank 0 */
+            wait_fin(group_size - 1, true);
+        } else {
+            ep = m_perf.ucp.peers[0].ep;
+            UCX_PERF_TEST_FOREACH(&m_perf) {
+                send(ep, m_perf.send_buffer, m_perf.params.message_size, 0, 0,
+                     NULL);
+                ucx_perf_update(&m_perf, 1, m_perf.params.message_size);
+            }
+
+            wait_all(true);
+            sent = m_perf.current.iters;
+            send_drain(ep, &sent, sizeof(sent), FIN_TAG, false);
+        }
+
         ucp_worker_flush(m_perf.ucp.worker);
         rte_call(&m_perf, barrier);
         return UCS_OK;
     }
 
+    ucs_status_t run_alltoall()
+    {
+        unsigned group_size, my_index, peer_index, i;
+        ucx_perf_counter_t *sent;
+        uint64_t fin_count;
+
+        ucs_assert(m_perf.params.message_size >= sizeof(psn_t));
+
+        group_size = rte_call(&m_perf, group_size);
+        my_index   = rte_call(&m_perf, group_index);
+
+        sent = (ucx_perf_counter_t*)calloc(group_size, sizeof(*sent));
+        if (sent == NULL) {
+            return UCS_ERR_NO_MEMORY;
+        }
+
+        rte_call(&m_perf, barrier);
+
+        ucx_perf_test_start_clock(&m_perf);
+
+        /* Every iteration sends to the next rank, skipping ourselves */
+        peer_index = my_index;
+        UCX_PERF_TEST_FOREACH(&m_perf) {
+            peer_index = (peer_index + 1) % group_size;
+            if (peer_index == my_index) {
+                peer_index = (peer_index + 1) % group_size;
+            }
+
+            send_drain(m_perf.ucp.peers[peer_index].ep, m_perf.send_buffer,
+                       m_perf.params.message_size, TAG, false);
+            ++sent[peer_index];
+            ucx_perf_update(&m_perf, 1, m_perf.params.message_size);
+            drain_unexpected(false);
+        }
+
+        for (i = 0; i < group_size; ++i) {
+            if (i != my_index) {
+                fin_count = sent[i];
+                send_drain(m_perf.ucp.peers[i].ep, &fin_count, sizeof(fin_count),
+                           FIN_TAG, false);
+            }
+        }
+        wait_fin(group_size - 1, false);
+
+        free(sent);
+        ucp_worker_flush(m_perf.ucp.worker);
+        rte_call(&m_perf, barrier);
+        return UCS_OK;
+    }
+
+    static void connect_accept_cb(ucp_ep_h ep, void *arg)
+    {
+        connect_state_t *state = (connect_state_t*)arg;
+
+        state->ep = ep;
+        ++state->count;
+    }
+
+    ucs_status_t connect_wait(ucp_worker_h worker, void *request)
+    {
+        if (!UCS_PTR_IS_PTR(request)) {
+            return UCS_PTR_STATUS(request);
+        }
+
+        while (!ucp_request_is_completed(request)) {
+            ucp_worker_progress(worker);
+        }
+        ucp_request_release(request);
+        return UCS_OK;
+    }
+
+    ucs_status_t connect_send(ucp_worker_h worker, ucp_ep_h ep)
+    {
+        return connect_wait(worker,
+                            ucp_tag_send_nb(ep, m_perf.send_buffer,
+                                            m_perf.params.message_size,
+                                            ucp_dt_make_contig(1), TAG,
+                                            (ucp_send_callback_t)ucs_empty_function));
+    }
+
+    ucs_status_t connect_recv(ucp_worker_h worker)
+    {
+        return connect_wait(worker,
+                            ucp_tag_recv_nb(worker, m_perf.recv_buffer,
+                                            m_perf.params.message_size,
+                                            ucp_dt_make_contig(1), TAG,
+                                            (ucp_tag_t)-1,
+                                            (ucp_tag_recv_callback_t)ucs_empty_function));
+    }
+
+    /*
+     * Server side of the connect test: accept a connection for every
+     * iteration, reply to its first message, and destroy the endpoint.
+     */
+    ucs_status_t run_connect_server()
+    {
+        char sockaddr[UCX_PERF_CONNECT_SOCKADDR_MAX];
+        char hostname[UCX_PERF_CONNECT_SOCKADDR_MAX];
+        ucp_worker_h worker = m_perf.ucp.worker;
+        ucp_listener_h listener;
+        connect_state_t state;
+        ucs_status_t status;
+        struct iovec vec;
+        const char *port;
+        void *req = NULL;
+
+        state.ep    = NULL;
+        state.count = 0;
+
+        status = ucp_listener_create(worker, "*:0", connect_accept_cb, &state,
+                                     &listener);
+        if (status != UCS_OK) {
+            sockaddr[0] = '\0';
+        } else {
+            /* Clients connect by the host name and the port of the listener */
+            ucp_listener_get_sockaddr(listener, sockaddr, sizeof(sockaddr));
+            port = strrchr(sockaddr, ':');
+            gethostname(hostname, sizeof(hostname));
+            hostname[sizeof(hostname) - 1] = '\0';
+            snprintf(sockaddr, sizeof(sockaddr), "%s%s", hostname,
+                     (port == NULL) ? "" : port);
+        }
+
+        vec.iov_base = sockaddr;
+        vec.iov_len  = sizeof(sockaddr);
+        rte_call(&m_perf, post_vec, &vec, 1, &req);
+        rte_call(&m_perf, exchange_vec, req);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        rte_call(&m_perf, barrier);
+
+        ucx_perf_test_start_clock(&m_perf);
+
+        UCX_PERF_TEST_FOREACH(&m_perf) {
+            /* The message could arrive before the endpoint is created */
+            status = connect_recv(worker);
+            if (status == UCS_OK) {
+                while (state.count <= m_perf.current.iters) {
+                    ucp_worker_progress(worker);
+                }
+                status = connect_send(worker, state.ep);
+                ucp_ep_destroy(state.ep);
+                state.ep = NULL;
+            }
+            if (status != UCS_OK) {
+                break;
+            }
+            ucx_perf_update(&m_perf, 1, m_perf.params.message_size);
+        }
+
+        ucp_listener_destroy(listener);
+        ucp_worker_flush(worker);
+        rte_call(&m_perf, barrier);
+        return status;
+    }
+
+    /*
+     * Client side of the connect test: every iteration creates a new worker,
+     * connects it to the listener and exchanges a message with the server.
+     * Only the connection and the exchange are measured.
+     */
+    ucs_status_t run_connect_client()
+    {
+        char sockaddr[UCX_PERF_CONNECT_SOCKADDR_MAX];
+        ucs_time_t idle_start;
+        ucp_worker_h worker;
+        ucs_status_t status;
+        struct iovec vec;
+        void *req = NULL;
+        ucp_ep_h ep;
+
+        vec.iov_base = sockaddr;
+        vec.iov_len  = 0;
+        rte_call(&m_perf, post_vec, &vec, 1, &req);
+        rte_call(&m_perf, exchange_vec, req);
+        rte_call(&m_perf, recv, 0, sockaddr, sizeof(sockaddr), req);
+        if (sockaddr[0] == '\0') {
+            return UCS_ERR_NO_DEVICE;
+        }
+
+        rte_call(&m_perf, barrier);
+
+        ucx_perf_test_start_clock(&m_perf);
+
+        status     = UCS_OK;
+        idle_start = ucs_get_time();
+        UCX_PERF_TEST_FOREACH(&m_perf) {
+            status = ucp_worker_create(m_perf.ucp.context, UCS_THREAD_MODE_SINGLE,
+                                       &worker);
+            if (status != UCS_OK) {
+                break;
+            }
+            ucx_perf_omit(&m_perf, ucs_get_time() - idle_start);
+
+            status = ucp_ep_create_sockaddr(worker, sockaddr, &ep);
+            if (status == UCS_OK) {
+                status = connect_send(worker, ep);
+                if (status == UCS_OK) {
+                    status = connect_recv(worker);
+                }
+                if (status == UCS_OK) {
+                    ucx_perf_update(&m_perf, 1, m_perf.params.message_size);
+                }
+
+                idle_start = ucs_get_time();
+                ucp_ep_destroy(ep);
+            } else {
+                idle_start = ucs_get_time();
+            }
+            ucp_worker_destroy(worker);
+            if (status != UCS_OK) {
+                break;
+            }
+        }
+
+        rte_call(&m_perf, barrier);
+        return status;
+    }
+
+    ucs_status_t run_connect()
+    {
+        /* The first process listens, like the server of the test itself */
+        if (rte_call(&m_perf, group_index) == 0) {
+            return run_connect_server();
+        } else {
+            return run_connect_client();
+        }
+    }
+
     ucs_status_t run()
     {
+        if (CMD == UCX_PERF_CMD_CONNECT) {
+            return run_connect();
+        }
+
         switch (TYPE) {
         case UCX_PERF_TEST_TYPE_PINGPONG:
             return run_pingpong();
         case UCX_PERF_TEST_TYPE_STREAM_UNI:
             return run_stream_uni();
+        case UCX_PERF_TEST_TYPE_INCAST:
+            return run_incast();
+        case UCX_PERF_TEST_TYPE_ALLTOALL:
+            return run_alltoall();
         case UCX_PERF_TEST_TYPE_STREAM_BI:
         default:
             return UCS_ERR_INVALID_PARAM;
@@ -268,6 +830,18 @@ private:
     ucx_perf_context_t &m_perf;
     unsigned           m_outstanding;
     const unsigned     m_max_outstanding;
+    unsigned           m_fin_count;      /* Number of FIN messages received */
+    ucx_perf_counter_t m_fin_expected;   /* Total messages announced by FINs */
+    ucp_perf_call_mode_t m_call_mode;
+    void               **m_requests;     /* Window of non-blocking requests */
+    unsigned           m_req_head;       /* Oldest request in the window */
+    ucp_datatype_t     m_datatype;
+    size_t             m_count;          /* Count argument, in datatype units */
+    ucp_dt_iov_t       *m_iov;
+    ucp_dt_iov_t       *m_send_iov;
+    ucp_dt_iov_t       *m_recv_iov;
+    generic_state_t    m_pack_state;
+    generic_state_t    m_unpack_state;
 };
 
 
@@ -289,13 +863,16 @@ ucs_status_t ucp_perf_test_dispatch(ucx_perf_context_t *perf)
     UCS_PP_FOREACH(TEST_CASE_ALL_OSD, perf,
         (UCX_PERF_CMD_TAG,   UCX_PERF_TEST_TYPE_PINGPONG),
         (UCX_PERF_CMD_TAG,   UCX_PERF_TEST_TYPE_STREAM_UNI),
+        (UCX_PERF_CMD_TAG,   UCX_PERF_TEST_TYPE_INCAST),
+        (UCX_PERF_CMD_TAG,   UCX_PERF_TEST_TYPE_ALLTOALL),
         (UCX_PERF_CMD_PUT,   UCX_PERF_TEST_TYPE_PINGPONG),
         (UCX_PERF_CMD_PUT,   UCX_PERF_TEST_TYPE_STREAM_UNI),
         (UCX_PERF_CMD_GET,   UCX_PERF_TEST_TYPE_STREAM_UNI),
         (UCX_PERF_CMD_ADD,   UCX_PERF_TEST_TYPE_STREAM_UNI),
         (UCX_PERF_CMD_FADD,  UCX_PERF_TEST_TYPE_STREAM_UNI),
         (UCX_PERF_CMD_SWAP,  UCX_PERF_TEST_TYPE_STREAM_UNI),
-        (UCX_PERF_CMD_CSWAP, UCX_PERF_TEST_TYPE_STREAM_UNI)
+        (UCX_PERF_CMD_CSWAP, UCX_PERF_TEST_TYPE_STREAM_UNI),
+        (UCX_PERF_CMD_CONNECT, UCX_PERF_TEST_TYPE_PINGPONG)
         );
 
     ucs_error("Invalid test case");
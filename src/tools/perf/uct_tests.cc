@@ -24,7 +24,10 @@ public:
     uct_perf_test_runner(ucx_perf_context_t &perf) :
         m_perf(perf),
         m_max_outstanding(m_perf.params.max_outstanding),
-        m_send_b_count(0)
+        m_send_b_count(0),
+        m_recv_count(0),
+        m_fin_count(0),
+        m_fin_expected(0)
 
     {
         ucs_assert_always(m_max_outstanding > 0);
@@ -36,7 +39,14 @@ public:
         uct_iface_attr_t attr;
         status = uct_iface_query(m_perf.uct.iface, &attr);
         ucs_assert_always(status == UCS_OK);
-        if (attr.cap.flags & (UCT_IFACE_FLAG_AM_SHORT|UCT_IFACE_FLAG_AM_BCOPY|UCT_IFACE_FLAG_AM_ZCOPY)) {
+        if (is_many_to_many()) {
+            status = uct_iface_set_am_handler(m_perf.uct.iface, UCT_PERF_TEST_AM_ID,
+                                              am_count_handler, this, UCT_AM_CB_FLAG_SYNC);
+            ucs_assert_always(status == UCS_OK);
+            status = uct_iface_set_am_handler(m_perf.uct.iface, UCT_PERF_TEST_FIN_AM_ID,
+                                              am_fin_handler, this, UCT_AM_CB_FLAG_SYNC);
+            ucs_assert_always(status == UCS_OK);
+        } else if (attr.cap.flags & (UCT_IFACE_FLAG_AM_SHORT|UCT_IFACE_FLAG_AM_BCOPY|UCT_IFACE_FLAG_AM_ZCOPY)) {
             status = uct_iface_set_am_handler(m_perf.uct.iface, UCT_PERF_TEST_AM_ID,
                                               am_hander, m_perf.recv_buffer, UCT_AM_CB_FLAG_SYNC);
             ucs_assert_always(status == UCS_OK);
@@ -45,6 +55,15 @@ public:
 
     ~uct_perf_test_runner() {
         uct_iface_set_am_handler(m_perf.uct.iface, UCT_PERF_TEST_AM_ID, NULL, NULL, UCT_AM_CB_FLAG_SYNC);
+        if (is_many_to_many()) {
+            uct_iface_set_am_handler(m_perf.uct.iface, UCT_PERF_TEST_FIN_AM_ID,
+                                     NULL, NULL, UCT_AM_CB_FLAG_SYNC);
+        }
+    }
+
+    static bool is_many_to_many() {
+        return (TYPE == UCX_PERF_TEST_TYPE_INCAST) ||
+               (TYPE == UCX_PERF_TEST_TYPE_ALLTOALL);
     }
 
     void UCS_F_ALWAYS_INLINE progress_responder() {
@@ -59,8 +78,28 @@ public:
 
     static ucs_status_t am_hander(void *arg, void *data, size_t length, void *desc)
     {
-        ucs_assert(UCS_CIRCULAR_COMPARE8(*(psn_t*)arg, <=, *(psn_t*)data));
-        *(psn_t*)arg = *(psn_t*)data;
+        /* With several endpoints, messages may arrive out of order */
+        if (UCS_CIRCULAR_COMPARE8(*(psn_t*)arg, <, *(psn_t*)data)) {
+            *(psn_t*)arg = *(psn_t*)data;
+        }
+        return UCS_OK;
+    }
+
+    static ucs_status_t am_count_handler(void *arg, void *data, size_t length,
+                                         void *desc)
+    {
+        ++((uct_perf_test_runner*)arg)->m_recv_count;
+        return UCS_OK;
+    }
+
+    /* The header of the FIN message is the number of messages its sender sent */
+    static ucs_status_t am_fin_handler(void *arg, void *data, size_t length,
+                                       void *desc)
+    {
+        uct_perf_test_runner *self = (uct_perf_test_runner*)arg;
+
+        self->m_fin_expected += *(uint64_t*)data;
+        ++self->m_fin_count;
         return UCS_OK;
     }
 
@@ -185,6 +224,10 @@ public:
         }
     }
 
+    uct_ep_h UCS_F_ALWAYS_INLINE next_ep(uct_ep_h *eps) {
+        return eps[ucx_perf_next_ep_index(&m_perf)];
+    }
+
     void UCS_F_ALWAYS_INLINE
     send_b(uct_ep_h ep, psn_t sn, psn_t prev_sn, void *buffer, unsigned length,
            uint64_t remote_addr, uct_rkey_t rkey, uct_completion_t *comp)
@@ -216,7 +259,7 @@ public:
     {
         psn_t send_sn, *recv_sn;
         unsigned my_index;
-        uct_ep_h ep;
+        uct_ep_h *eps;
         uint64_t remote_addr;
         uct_rkey_t rkey;
         void *buffer;
@@ -250,13 +293,13 @@ public:
         length      = m_perf.params.message_size;
         remote_addr = m_perf.uct.peers[1 - my_index].remote_addr + m_perf.offset;
         rkey        = m_perf.uct.peers[1 - my_index].rkey.rkey;
-        ep          = m_perf.uct.peers[1 - my_index].ep;
+        eps         = m_perf.uct.peers[1 - my_index].eps;
 
         send_sn = 0;
         if (my_index == 0) {
             UCX_PERF_TEST_FOREACH(&m_perf) {
-                send_b(ep, send_sn, send_sn - 1, buffer, length, remote_addr,
-                       rkey, NULL);
+                send_b(next_ep(eps), send_sn, send_sn - 1, buffer, length,
+                       remote_addr, rkey, NULL);
                 ucx_perf_update(&m_perf, 1, length);
                 while (*recv_sn != send_sn) {
                     progress_responder();
@@ -268,8 +311,8 @@ public:
                 while (*recv_sn != send_sn) {
                     progress_responder();
                 }
-                send_b(ep, send_sn, send_sn - 1, buffer, length, remote_addr,
-                       rkey, NULL);
+                send_b(next_ep(eps), send_sn, send_sn - 1, buffer, length,
+                       remote_addr, rkey, NULL);
                 ucx_perf_update(&m_perf, 1, length);
                 ++send_sn;
             }
@@ -290,7 +333,7 @@ public:
         unsigned fc_window;
         unsigned my_index;
         unsigned length;
-        uct_ep_h ep;
+        uct_ep_h *eps;
 
         ucs_assert(m_perf.params.message_size >= sizeof(psn_t));
         ucs_assert(m_perf.params.uct.fc_window <= ((psn_t)-1) / 2);
@@ -306,7 +349,7 @@ public:
 
         ucx_perf_test_start_clock(&m_perf);
 
-        ep          = m_perf.uct.peers[1 - my_index].ep;
+        eps         = m_perf.uct.peers[1 - my_index].eps;
         buffer      = m_perf.send_buffer;
         length      = m_perf.params.message_size;
         remote_addr = m_perf.uct.peers[1 - my_index].remote_addr + m_perf.offset;
@@ -340,12 +383,12 @@ public:
                 }
 
                 if (flow_control) {
-                    send_b(ep, send_sn, send_sn - 1, buffer, length, remote_addr,
-                           rkey, &m_completion);
+                    send_b(next_ep(eps), send_sn, send_sn - 1, buffer, length,
+                           remote_addr, rkey, &m_completion);
                     ++send_sn;
                 } else {
-                    send_b(ep, send_sn, send_sn, buffer, length, remote_addr,
-                           rkey, &m_completion);
+                    send_b(next_ep(eps), send_sn, send_sn, buffer, length,
+                           remote_addr, rkey, &m_completion);
                 }
 
                 ucx_perf_update(&m_perf, 1, length);
@@ -357,9 +400,14 @@ public:
                     while (outstanding() >= m_max_outstanding) {
                         progress_requestor();
                     }
+                    if (m_perf.params.ep_count > 1) {
+                        /* Make sure the sentinel is not overtaken by previous
+                         * operations on other endpoints */
+                        uct_perf_iface_flush_b(&m_perf);
+                    }
                     *(psn_t*)buffer = 2;
-                    send_b(ep, 2, send_sn, buffer, length, remote_addr, rkey,
-                           &m_completion);
+                    send_b(next_ep(eps), 2, send_sn, buffer, length, remote_addr,
+                           rkey, &m_completion);
                 } else {
                     *(psn_t*)m_perf.recv_buffer = 2;
                 }
@@ -382,8 +430,8 @@ public:
                     progress_responder();
                     if (UCS_CIRCULAR_COMPARE8(sn, >, (psn_t)(send_sn + (fc_window / 2)))) {
                         /* Send ACK every half-window */
-                        send_b(ep, sn, send_sn, buffer, length, remote_addr,
-                               rkey, &m_completion);
+                        send_b(next_ep(eps), sn, send_sn, buffer, length,
+                               remote_addr, rkey, &m_completion);
                         send_sn = sn;
                     }
 
@@ -394,8 +442,8 @@ public:
 
                 /* Send ACK for last packet */
                 if (UCS_CIRCULAR_COMPARE8(*recv_sn, >, send_sn)) {
-                    send_b(ep, *recv_sn, send_sn, buffer, length, remote_addr,
-                           rkey, &m_completion);
+                    send_b(next_ep(eps), *recv_sn, send_sn, buffer, length,
+                           remote_addr, rkey, &m_completion);
                 }
             } else {
                 /* Wait for "sentinel" value */
@@ -404,8 +452,8 @@ public:
                     progress_responder();
                     if (!direction_to_responder) {
                         if (ucs_get_time() > poll_time + ucs_time_from_msec(1.0)) {
-                            send_b(ep, 0, 0, buffer, length, remote_addr, rkey,
-                                   &m_completion);
+                            send_b(next_ep(eps), 0, 0, buffer, length, remote_addr,
+                                   rkey, &m_completion);
                             poll_time = ucs_get_time();
                         }
                     }
@@ -422,6 +470,157 @@ public:
         return UCS_OK;
     }
 
+    /* Account messages received since the last call, return how many */
+    ucx_perf_counter_t UCS_F_ALWAYS_INLINE update_recv(bool is_result)
+    {
+        ucx_perf_counter_t count = m_recv_count - m_perf.recv.msgs;
+        ucx_perf_counter_t i;
+
+        if (count == 0) {
+            return 0;
+        }
+
+        if (is_result) {
+            for (i = 0; i < count; ++i) {
+                ucx_perf_update(&m_perf, 1, m_perf.params.message_size);
+            }
+        }
+        ucx_perf_update_recv(&m_perf, count);
+        return count;
+    }
+
+    void send_fin(uct_ep_h ep, uint64_t count)
+    {
+        ucs_status_t status;
+
+        do {
+            status = uct_ep_am_short(ep, UCT_PERF_TEST_FIN_AM_ID, count, NULL, 0);
+            progress_requestor();
+        } while (status == UCS_ERR_NO_RESOURCE);
+        ucs_assert_always(status == UCS_OK);
+    }
+
+    /* Wait for FIN from all other ranks, and for all the messages they sent */
+    void wait_fin(unsigned num_senders, bool is_result)
+    {
+        while ((m_fin_count < num_senders) || (m_perf.recv.msgs < m_fin_expected)) {
+            progress_responder();
+            update_recv(is_result);
+        }
+    }
+
+    ucs_status_t run_incast()
+    {
+        unsigned group_size, my_index;
+        uint64_t remote_addr;
+        uct_rkey_t rkey;
+        uct_ep_h *eps;
+        void *buffer;
+        size_t length;
+
+        ucs_assert(m_perf.params.message_size >= sizeof(psn_t));
+
+        group_size = rte_call(&m_perf, group_size);
+        my_index   = rte_call(&m_perf, group_index);
+
+        rte_call(&m_perf, barrier);
+
+        ucx_perf_test_start_clock(&m_perf);
+
+        if (my_index == 0) {
+            /* The receive rate is the result of rank 0 */
+            wait_fin(group_size - 1, true);
+        } else {
+            buffer      = m_perf.send_buffer;
+            length      = m_perf.params.message_size;
+            remote_addr = m_perf.uct.peers[0].remote_addr + m_perf.offset;
+            rkey        = m_perf.uct.peers[0].rkey.rkey;
+            eps         = m_perf.uct.peers[0].eps;
+
+            UCX_PERF_TEST_FOREACH(&m_perf) {
+                while (outstanding() >= m_max_outstanding) {
+                    progress_requestor();
+                }
+                send_b(next_ep(eps), 0, 0, buffer, length, remote_addr, rkey,
+                       &m_completion);
+                ucx_perf_update(&m_perf, 1, length);
+            }
+
+            /* FIN must not overtake data sent on other endpoints */
+            uct_perf_iface_flush_b(&m_perf);
+            send_fin(eps[0], m_perf.current.iters);
+        }
+
+        uct_perf_iface_flush_b(&m_perf);
+        ucs_assert(outstanding() == 0);
+        if (my_index != 0) {
+            ucx_perf_update(&m_perf, 0, 0);
+        }
+
+        return UCS_OK;
+    }
+
+    ucs_status_t run_alltoall()
+    {
+        unsigned group_size, my_index, peer_index, i;
+        ucx_perf_counter_t *sent;
+        uct_peer_t *peer;
+        void *buffer;
+        size_t length;
+
+        ucs_assert(m_perf.params.message_size >= sizeof(psn_t));
+
+        group_size = rte_call(&m_perf, group_size);
+        my_index   = rte_call(&m_perf, group_index);
+        buffer     = m_perf.send_buffer;
+        length     = m_perf.params.message_size;
+
+        sent = (ucx_perf_counter_t*)calloc(group_size, sizeof(*sent));
+        if (sent == NULL) {
+            return UCS_ERR_NO_MEMORY;
+        }
+
+        rte_call(&m_perf, barrier);
+
+        ucx_perf_test_start_clock(&m_perf);
+
+        /* Every iteration sends to the next rank, skipping ourselves */
+        peer_index = my_index;
+        UCX_PERF_TEST_FOREACH(&m_perf) {
+            peer_index = (peer_index + 1) % group_size;
+            if (peer_index == my_index) {
+                peer_index = (peer_index + 1) % group_size;
+            }
+
+            while (outstanding() >= m_max_outstanding) {
+                progress_requestor();
+            }
+
+            peer = &m_perf.uct.peers[peer_index];
+            send_b(next_ep(peer->eps), 0, 0, buffer, length,
+                   peer->remote_addr + m_perf.offset, peer->rkey.rkey,
+                   &m_completion);
+            ++sent[peer_index];
+            ucx_perf_update(&m_perf, 1, length);
+            update_recv(false);
+        }
+
+        uct_perf_iface_flush_b(&m_perf);
+        for (i = 0; i < group_size; ++i) {
+            if (i != my_index) {
+                send_fin(m_perf.uct.peers[i].eps[0], sent[i]);
+            }
+        }
+        wait_fin(group_size - 1, false);
+
+        uct_perf_iface_flush_b(&m_perf);
+        ucs_assert(outstanding() == 0);
+        ucx_perf_update(&m_perf, 0, 0);
+
+        free(sent);
+        return UCS_OK;
+    }
+
     ucs_status_t run()
     {
         bool zcopy = (DATA == UCT_PERF_DATA_LAYOUT_ZCOPY);
@@ -458,6 +657,10 @@ public:
             default:
                 return UCS_ERR_INVALID_PARAM;
             }
+        case UCX_PERF_TEST_TYPE_INCAST:
+            return run_incast();
+        case UCX_PERF_TEST_TYPE_ALLTOALL:
+            return run_alltoall();
         case UCX_PERF_TEST_TYPE_STREAM_BI:
         default:
             return UCS_ERR_INVALID_PARAM;
@@ -473,6 +676,9 @@ private:
     const unsigned     m_max_outstanding;
     uct_completion_t   m_completion;
     int                m_send_b_count;
+    ucx_perf_counter_t m_recv_count;     /* Received by incast and all-to-all */
+    unsigned           m_fin_count;      /* Number of FIN messages received */
+    ucx_perf_counter_t m_fin_expected;   /* Total messages announced by FINs */
     const static int   N_SEND_B_PER_PROGRESS = 16;
 };
 
@@ -506,7 +712,9 @@ ucs_status_t uct_perf_test_dispatch(ucx_perf_context_t *perf)
         (UCX_PERF_CMD_ADD, UCX_PERF_TEST_TYPE_STREAM_UNI),
         (UCX_PERF_CMD_FADD, UCX_PERF_TEST_TYPE_STREAM_UNI),
         (UCX_PERF_CMD_SWAP, UCX_PERF_TEST_TYPE_STREAM_UNI),
-        (UCX_PERF_CMD_CSWAP, UCX_PERF_TEST_TYPE_STREAM_UNI)
+        (UCX_PERF_CMD_CSWAP, UCX_PERF_TEST_TYPE_STREAM_UNI),
+        (UCX_PERF_CMD_AM,  UCX_PERF_TEST_TYPE_INCAST),
+        (UCX_PERF_CMD_AM,  UCX_PERF_TEST_TYPE_ALLTOALL)
         );
 
     ucs_error("Invalid test case");
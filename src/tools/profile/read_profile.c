@@ -5,13 +5,16 @@
  */
 
 #include <ucs/debug/profile.h>
+#include <ucs/debug/instrument.h>
 
 #include <sys/signal.h>
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <getopt.h>
 #include <unistd.h>
 #include <string.h>
@@ -44,19 +47,58 @@ typedef enum {
 typedef struct options {
     const char                   *filename;
     int                          raw;
+    int                          chrome_trace; /* Print Chrome trace JSON */
+    int                          instrument;   /* Input is instrumentation file */
+    int                          summary;      /* Print time per stage */
     time_units_t                 time_units;
 } options_t;
 
 
+typedef struct {
+    const ucs_profile_thread_header_t   *header;
+    const ucs_profile_thread_location_t *locations;
+    const ucs_profile_record_t          *records;
+} profile_thread_data_t;
+
+
 typedef struct {
     void                         *mem;
     size_t                       length;
     const ucs_profile_header_t   *header;
     const ucs_profile_location_t *locations;
-    const ucs_profile_record_t   *records;
+    profile_thread_data_t        *threads;
 } profile_data_t;
 
 
+typedef struct {
+    void                          *mem;
+    size_t                        length;
+    const ucs_instrument_header_t *header;
+    const void                    *locations;  /* Location entries */
+    const ucs_instrument_record_t *records;
+} instrument_data_t;
+
+
+/*
+ * A stage is a scope, identified by its call path: the same scope called from
+ * two different scopes is two stages. Time which is not spent in any nested
+ * stage is the stage's own ("self") time.
+ */
+typedef struct stage {
+    uint32_t                     location;      /* Scope end location */
+    uint64_t                     count;
+    uint64_t                     total_time;
+    uint64_t                     children_time;
+    struct stage                 *parent;
+    struct stage                 *children;
+    struct stage                 *next;         /* Next sibling */
+} stage_t;
+
+
+/* Size of a location entry in instrumentation file */
+#define INSTRUMENT_LOCATION_SIZE   offsetof(ucs_instrument_location_t, list)
+
+
 /* Used to redirect output to a "less" command */
 static int output_pipefds[2] = {-1, -1};
 
@@ -70,7 +112,15 @@ static const char* time_units_str[] = {
 };
 
 
-static int read_profile_data(const char *file_name, profile_data_t *data)
+static const double time_units_val[] = {
+    [TIME_UNITS_NSEC] = 1e9,
+    [TIME_UNITS_USEC] = 1e6,
+    [TIME_UNITS_MSEC] = 1e3,
+    [TIME_UNITS_SEC]  = 1e0
+};
+
+
+static int map_file(const char *file_name, void **mem_p, size_t *length_p)
 {
     struct stat stat;
     int ret, fd;
@@ -78,8 +128,7 @@ static int read_profile_data(const char *file_name, profile_data_t *data)
     fd = open(file_name, O_RDONLY);
     if (fd < 0) {
         fprintf(stderr, "Failed to open %s: %m\n", file_name);
-        ret = fd;
-        goto out;
+        return fd;
     }
 
     ret = fstat(fd, &stat);
@@ -88,41 +137,109 @@ static int read_profile_data(const char *file_name, profile_data_t *data)
         goto out_close;
     }
 
-    data->length = stat.st_size;
-    data->mem    = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data->mem == MAP_FAILED) {
+    *length_p = stat.st_size;
+    *mem_p    = mmap(NULL, stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (*mem_p == MAP_FAILED) {
         fprintf(stderr, "mmap(%s, length=%zd) failed: %m\n", file_name,
-                data->length);
+                *length_p);
         ret = -1;
         goto out_close;
     }
 
-    data->header    = data->mem;
-    data->locations = (const void*)(data->header + 1);
-    data->records   = (const void*)(data->locations + data->header->num_locations);
-
     ret = 0;
 
 out_close:
     close(fd);
-out:
     return ret;
 }
 
+static int read_profile_data(const char *file_name, profile_data_t *data)
+{
+    profile_thread_data_t *thread;
+    const void *ptr;
+    unsigned i;
+    int ret;
+
+    ret = map_file(file_name, &data->mem, &data->length);
+    if (ret < 0) {
+        return ret;
+    }
+
+    data->header    = data->mem;
+    if ((data->length < sizeof(*data->header)) ||
+        (data->header->version != UCS_PROFILE_FILE_VERSION)) {
+        fprintf(stderr, "%s: unsupported profile file format, expected "
+                "version %u\n", file_name, UCS_PROFILE_FILE_VERSION);
+        munmap(data->mem, data->length);
+        return -1;
+    }
+
+    data->locations = (const void*)(data->header + 1);
+    data->threads   = calloc(data->header->num_threads, sizeof(*data->threads));
+    if (data->threads == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        munmap(data->mem, data->length);
+        return -1;
+    }
+
+    /* Each thread section is a header, location counters, and records */
+    ptr = data->locations + data->header->num_locations;
+    for (i = 0; i < data->header->num_threads; ++i) {
+        thread            = &data->threads[i];
+        thread->header    = ptr;
+        thread->locations = (const void*)(thread->header + 1);
+        thread->records   = (const void*)(thread->locations +
+                                          data->header->num_locations);
+        ptr               = thread->records + thread->header->num_records;
+    }
+
+    return 0;
+}
+
 static void release_profile_data(profile_data_t *data)
 {
+    free(data->threads);
     munmap(data->mem, data->length);
 }
 
-static double time_to_usec(profile_data_t *data, options_t *opts, uint64_t time)
+static int read_instrument_data(const char *file_name, instrument_data_t *data)
 {
-    static const double time_units_val[] = {
-        [TIME_UNITS_NSEC] = 1e9,
-        [TIME_UNITS_USEC] = 1e6,
-        [TIME_UNITS_MSEC] = 1e3,
-        [TIME_UNITS_SEC]  = 1e0
-    };
+    int ret;
+
+    ret = map_file(file_name, &data->mem, &data->length);
+    if (ret < 0) {
+        return ret;
+    }
 
+    data->header    = data->mem;
+    data->locations = data->header + 1;
+    data->records   = data->locations +
+                      data->header->num_locations * INSTRUMENT_LOCATION_SIZE;
+    return 0;
+}
+
+static void release_instrument_data(instrument_data_t *data)
+{
+    munmap(data->mem, data->length);
+}
+
+static const char *instrument_location_name(instrument_data_t *data,
+                                            uint32_t location)
+{
+    const ucs_instrument_location_t *loc;
+    size_t i;
+
+    for (i = 0; i < data->header->num_locations; ++i) {
+        loc = data->locations + i * INSTRUMENT_LOCATION_SIZE;
+        if (loc->location == location) {
+            return loc->name;
+        }
+    }
+    return "<unknown>";
+}
+
+static double time_to_usec(profile_data_t *data, options_t *opts, uint64_t time)
+{
     return time * time_units_val[opts->time_units] / data->header->one_second;
 }
 
@@ -135,25 +252,24 @@ static int compare_locations(const void *l1, const void *l2)
            0;
 }
 
-static void show_profile_data_accum(profile_data_t *data, options_t *opts)
+static void show_accum_locations(profile_data_t *data, options_t *opts,
+                                 ucs_profile_location_t *locations,
+                                 int skip_unused)
 {
     uint32_t num_locations = data->header->num_locations;
-    ucs_profile_location_t *sorted_locations;
     ucs_profile_location_t *loc;
 
-    sorted_locations = malloc(sizeof(*sorted_locations) * num_locations);
-    if (sorted_locations == NULL) {
-        return;
-    }
-
     /* Sort locations */
-    memcpy(sorted_locations, data->locations, sizeof(*sorted_locations) * num_locations);
-    qsort(sorted_locations, num_locations, sizeof(*sorted_locations), compare_locations);
+    qsort(locations, num_locations, sizeof(*locations), compare_locations);
 
     /* Print locations */
     printf("%25s %13s %13s %10s             FILE     FUNCTION\n",
            "NAME", "AVG", "TOTAL", "COUNT");
-    for (loc = sorted_locations; loc < sorted_locations + num_locations; ++loc) {
+    for (loc = locations; loc < locations + num_locations; ++loc) {
+        if (skip_unused && (loc->count == 0)) {
+            continue;
+        }
+
         switch (loc->type) {
         case UCS_PROFILE_TYPE_SAMPLE:
             printf("%25s %13s %13s %10ld %15s:%-4d %s()\n",
@@ -175,13 +291,46 @@ static void show_profile_data_accum(profile_data_t *data, options_t *opts)
             break;
         }
     }
+}
+
+static void show_profile_data_accum(profile_data_t *data, options_t *opts)
+{
+    uint32_t num_locations = data->header->num_locations;
+    const profile_thread_data_t *thread;
+    ucs_profile_location_t *locations;
+    unsigned i;
+
+    locations = malloc(sizeof(*locations) * num_locations);
+    if (locations == NULL) {
+        return;
+    }
 
-    free(sorted_locations);
+    /* Totals of all threads */
+    memcpy(locations, data->locations, sizeof(*locations) * num_locations);
+    show_accum_locations(data, opts, locations, 0);
+
+    /* Per-thread costs, if there is more than one thread */
+    if (data->header->num_threads > 1) {
+        for (thread = data->threads;
+             thread < data->threads + data->header->num_threads; ++thread) {
+            printf("\nthread %d:\n", thread->header->tid);
+            memcpy(locations, data->locations, sizeof(*locations) * num_locations);
+            for (i = 0; i < num_locations; ++i) {
+                locations[i].total_time = thread->locations[i].total_time;
+                locations[i].count      = thread->locations[i].count;
+            }
+            show_accum_locations(data, opts, locations, 1);
+        }
+    }
+
+    free(locations);
 }
 
-static void show_profile_data_log(profile_data_t *data, options_t *opts)
+static void show_profile_data_log(profile_data_t *data, options_t *opts,
+                                  const profile_thread_data_t *thread)
 {
-    size_t num_recods               = data->header->num_records;
+    size_t num_recods                   = thread->header->num_records;
+    const ucs_profile_record_t *records = thread->records;
     const ucs_profile_record_t **stack[UCS_PROFILE_STACK_MAX * 2];
     const ucs_profile_record_t **scope_ends;
     const ucs_profile_location_t *loc;
@@ -215,21 +364,23 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
 
     memset(stack, 0, sizeof(stack));
 
+    printf("thread %d:\n", thread->header->tid);
+
     /* Find the first record with minimal nesting level, which is the base of call stack */
     nesting         = 0;
     min_nesting     = 0;
     min_nesting_idx = -1;
-    for (rec = data->records; rec < data->records + num_recods; ++rec) {
+    for (rec = records; rec < records + num_recods; ++rec) {
         loc = &data->locations[rec->location];
         switch (loc->type) {
         case UCS_PROFILE_TYPE_SCOPE_BEGIN:
             ++nesting;
-            stack[nesting + UCS_PROFILE_STACK_MAX] = &scope_ends[rec - data->records];
+            stack[nesting + UCS_PROFILE_STACK_MAX] = &scope_ends[rec - records];
             break;
         case UCS_PROFILE_TYPE_SCOPE_END:
             if (nesting < min_nesting) {
                 min_nesting     = nesting;
-                min_nesting_idx = rec - data->records;
+                min_nesting_idx = rec - records;
             }
             sep = stack[nesting + UCS_PROFILE_STACK_MAX];
             if (sep != NULL) {
@@ -243,14 +394,14 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
     }
 
     if (num_recods > 0) {
-        prev_time = data->records[0].timestamp;
+        prev_time = records[0].timestamp;
     } else {
         prev_time = 0;
     }
 
     /* Display records */
     nesting = 0;
-    for (rec = data->records + min_nesting_idx + 1; rec < data->records + num_recods; ++rec) {
+    for (rec = records + min_nesting_idx + 1; rec < records + num_recods; ++rec) {
         loc = &data->locations[rec->location];
         switch (loc->type) {
         case UCS_PROFILE_TYPE_SAMPLE:
@@ -260,7 +411,7 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
             PRINT_RECORD();
             break;
         case UCS_PROFILE_TYPE_SCOPE_BEGIN:
-            se = scope_ends[rec - data->records];
+            se = scope_ends[rec - records];
             if (se != NULL) {
                 snprintf(buf, sizeof(buf), RECORD_FMT"  %s%s%s %s%.3f%s {",
                          RECORD_ARG(rec->timestamp - prev_time),
@@ -286,6 +437,403 @@ static void show_profile_data_log(profile_data_t *data, options_t *opts)
     free(scope_ends);
 }
 
+static stage_t *stage_get_child(stage_t *parent, uint32_t location)
+{
+    stage_t *stage;
+
+    for (stage = parent->children; stage != NULL; stage = stage->next) {
+        if (stage->location == location) {
+            return stage;
+        }
+    }
+
+    stage = calloc(1, sizeof(*stage));
+    if (stage == NULL) {
+        return NULL;
+    }
+
+    stage->location  = location;
+    stage->parent    = parent;
+    stage->next      = parent->children;
+    parent->children = stage;
+    return stage;
+}
+
+static void stage_free_children(stage_t *parent)
+{
+    stage_t *stage, *next;
+
+    for (stage = parent->children; stage != NULL; stage = next) {
+        next = stage->next;
+        stage_free_children(stage);
+        free(stage);
+    }
+    parent->children = NULL;
+}
+
+/*
+ * Add the scopes of a thread log to the stage tree. A scope is matched with
+ * its end record first, since the end location holds the scope name. Scopes
+ * which were cut by the circular log, on either side, are skipped.
+ */
+static int collect_thread_stages(profile_data_t *data,
+                                 const profile_thread_data_t *thread,
+                                 stage_t *root)
+{
+    size_t num_records                  = thread->header->num_records;
+    const ucs_profile_record_t *records = thread->records;
+    const ucs_profile_record_t *stack[UCS_PROFILE_STACK_MAX];
+    const ucs_profile_record_t **scope_ends;
+    const ucs_profile_location_t *loc;
+    const ucs_profile_record_t *rec, *se;
+    stage_t *stage;
+    int nesting;
+
+    if (num_records == 0) {
+        return 0;
+    }
+
+    scope_ends = calloc(1, sizeof(*scope_ends) * num_records);
+    if (scope_ends == NULL) {
+        fprintf(stderr, "Failed to allocate memory\n");
+        return -1;
+    }
+
+    nesting = 0;
+    for (rec = records; rec < records + num_records; ++rec) {
+        loc = &data->locations[rec->location];
+        if (loc->type == UCS_PROFILE_TYPE_SCOPE_BEGIN) {
+            if (nesting < UCS_PROFILE_STACK_MAX) {
+                stack[nesting] = rec;
+            }
+            ++nesting;
+        } else if ((loc->type == UCS_PROFILE_TYPE_SCOPE_END) && (nesting > 0)) {
+            --nesting;
+            if (nesting < UCS_PROFILE_STACK_MAX) {
+                scope_ends[stack[nesting] - records] = rec;
+            }
+        }
+    }
+
+    stage = root;
+    for (rec = records; rec < records + num_records; ++rec) {
+        loc = &data->locations[rec->location];
+        if (loc->type == UCS_PROFILE_TYPE_SCOPE_BEGIN) {
+            se = scope_ends[rec - records];
+            if (se == NULL) {
+                /* The scope, and everything after it, did not end before the
+                 * log did */
+                break;
+            }
+
+            stage = stage_get_child(stage, se->location);
+            if (stage == NULL) {
+                fprintf(stderr, "Failed to allocate memory\n");
+                free(scope_ends);
+                return -1;
+            }
+
+            stage->count                 += 1;
+            stage->total_time            += se->timestamp - rec->timestamp;
+            stage->parent->children_time += se->timestamp - rec->timestamp;
+        } else if ((loc->type == UCS_PROFILE_TYPE_SCOPE_END) && (stage != root)) {
+            stage = stage->parent;
+        }
+    }
+
+    free(scope_ends);
+    return 0;
+}
+
+static int compare_stages(const void *s1, const void *s2)
+{
+    const stage_t *stage1 = *(const stage_t**)s1;
+    const stage_t *stage2 = *(const stage_t**)s2;
+    return (stage1->total_time > stage2->total_time) ? -1 :
+           (stage1->total_time < stage2->total_time) ? +1 :
+           0;
+}
+
+static void show_stages(profile_data_t *data, options_t *opts,
+                        const stage_t *parent, uint64_t root_time, int nesting)
+{
+    const ucs_profile_location_t *loc;
+    stage_t **children, *stage;
+    size_t i, num_children;
+
+    num_children = 0;
+    for (stage = parent->children; stage != NULL; stage = stage->next) {
+        ++num_children;
+    }
+
+    children = malloc(sizeof(*children) * num_children);
+    if (children == NULL) {
+        return;
+    }
+
+    i = 0;
+    for (stage = parent->children; stage != NULL; stage = stage->next) {
+        children[i++] = stage;
+    }
+
+    /* Most expensive stage first */
+    qsort(children, num_children, sizeof(*children), compare_stages);
+
+    for (i = 0; i < num_children; ++i) {
+        stage = children[i];
+        loc   = &data->locations[stage->location];
+        printf("%*s%-*s %10ld %13.3f %13.0f %13.0f %6.1f%%\n",
+               INDENT * nesting, "", 40 - (INDENT * nesting), loc->name,
+               (long)stage->count,
+               time_to_usec(data, opts, stage->total_time) / stage->count,
+               time_to_usec(data, opts, stage->total_time),
+               time_to_usec(data, opts, stage->total_time - stage->children_time),
+               (root_time == 0) ? 0.0 : stage->total_time * 100.0 / root_time);
+        show_stages(data, opts, stage, root_time, nesting + 1);
+    }
+
+    free(children);
+}
+
+/*
+ * Break the logged time down by stages. Nested stages are indented under the
+ * stage which called them. SELF is the time which was not spent in nested
+ * stages, and the percentage is relative to the time of all top-level stages.
+ * For example, the client side of "ucx_perftest -t tag_lat" over mm:
+ *
+ * STAGE                                  COUNT      AVG    TOTAL     SELF       %
+ * ucp_tag_send_nb                         2200    2.252     4954     1590   41.0%
+ *     ucp_tag_send_eager_short            2200    1.529     3364     1787   27.9%
+ *         uct_mm_ep_am_short              2200    0.717     1577     1577   13.1%
+ * uct_mm_iface_process_recv               2200    2.167     4768     1972   39.5%
+ *     ucp_eager_only_handler              2200    1.271     2796     2102   23.1%
+ *         ucp_tag_process_recv            2200    0.315      694      694    5.7%
+ * ucp_tag_recv_nb                         2200    0.956     2104     1857   17.4%
+ *     ucp_tag_search_unexp                2200    0.112      247      247    2.0%
+ */
+static int show_profile_data_summary(profile_data_t *data, options_t *opts)
+{
+    const profile_thread_data_t *thread;
+    stage_t root = {0};
+    uint64_t root_time;
+    stage_t *stage;
+    int ret;
+
+    ret = 0;
+    for (thread = data->threads;
+         thread < data->threads + data->header->num_threads; ++thread) {
+        ret = collect_thread_stages(data, thread, &root);
+        if (ret < 0) {
+            goto out;
+        }
+    }
+
+    root_time = 0;
+    for (stage = root.children; stage != NULL; stage = stage->next) {
+        root_time += stage->total_time;
+    }
+
+    printf("%-40s %10s %13s %13s %13s %7s\n",
+           "STAGE", "COUNT", "AVG", "TOTAL", "SELF", "%");
+    show_stages(data, opts, &root, root_time, 0);
+    printf("\n");
+
+out:
+    stage_free_children(&root);
+    return ret;
+}
+
+static void print_json_string(const char *str)
+{
+    putchar('"');
+    for (; *str != '\0'; ++str) {
+        if ((*str == '"') || (*str == '\\')) {
+            printf("\\%c", *str);
+        } else if ((unsigned char)*str < 0x20) {
+            printf("\\u%04x", (unsigned char)*str);
+        } else {
+            putchar(*str);
+        }
+    }
+    putchar('"');
+}
+
+/*
+ * Print a Chrome trace event. Phase "X" is a complete (duration) event, "i" is
+ * an instant event, and "M" is metadata. Timestamps are in microseconds.
+ */
+static void print_trace_event(int *first, const char *phase, const char *name,
+                              int pid, int tid, double ts, double dur,
+                              const char *args_fmt, ...)
+{
+    va_list ap;
+
+    printf("%s{\"name\":", *first ? "" : ",\n");
+    print_json_string(name);
+    printf(",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f",
+           phase, pid, tid, ts);
+    if (!strcmp(phase, "X")) {
+        printf(",\"dur\":%.3f", dur);
+    } else if (!strcmp(phase, "i")) {
+        printf(",\"s\":\"t\"");
+    }
+    if (args_fmt != NULL) {
+        printf(",\"args\":{");
+        va_start(ap, args_fmt);
+        vprintf(args_fmt, ap);
+        va_end(ap);
+        printf("}");
+    }
+    printf("}");
+    *first = 0;
+}
+
+static void print_trace_name_event(int *first, const char *type, int pid,
+                                   int tid, const char *name)
+{
+    printf("%s{\"name\":\"%s\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+           "\"args\":{\"name\":", *first ? "" : ",\n", type, pid, tid);
+    print_json_string(name);
+    printf("}}");
+    *first = 0;
+}
+
+static double trace_time_usec(uint64_t time, uint64_t base, uint64_t one_second)
+{
+    return (time - base) * 1e6 / one_second;
+}
+
+static void write_profile_thread_trace(profile_data_t *data,
+                                       const profile_thread_data_t *thread,
+                                       uint64_t base_time, int *first)
+{
+    const ucs_profile_record_t *stack[UCS_PROFILE_STACK_MAX];
+    uint64_t one_second = data->header->one_second;
+    int pid             = data->header->pid;
+    int tid             = thread->header->tid;
+    const ucs_profile_location_t *loc;
+    const ucs_profile_record_t *rec;
+    char thread_name[64];
+    int nesting;
+
+    snprintf(thread_name, sizeof(thread_name), "thread %d", tid);
+    print_trace_name_event(first, "thread_name", pid, tid, thread_name);
+
+    /* Scopes become complete events, named after their end location. Scopes
+     * whose begin was overwritten in the circular log are dropped. */
+    nesting = 0;
+    for (rec = thread->records;
+         rec < thread->records + thread->header->num_records; ++rec) {
+        loc = &data->locations[rec->location];
+        switch (loc->type) {
+        case UCS_PROFILE_TYPE_SAMPLE:
+            print_trace_event(first, "i", loc->name, pid, tid,
+                              trace_time_usec(rec->timestamp, base_time,
+                                              one_second),
+                              0, "\"location\":\"%s:%d\",\"function\":\"%s\"",
+                              loc->file, loc->line, loc->function);
+            break;
+        case UCS_PROFILE_TYPE_SCOPE_BEGIN:
+            if (nesting < UCS_PROFILE_STACK_MAX) {
+                stack[nesting] = rec;
+            }
+            ++nesting;
+            break;
+        case UCS_PROFILE_TYPE_SCOPE_END:
+            if (nesting == 0) {
+                break;
+            }
+            --nesting;
+            if (nesting < UCS_PROFILE_STACK_MAX) {
+                print_trace_event(first, "X", loc->name, pid, tid,
+                                  trace_time_usec(stack[nesting]->timestamp,
+                                                  base_time, one_second),
+                                  (rec->timestamp - stack[nesting]->timestamp) *
+                                  1e6 / one_second,
+                                  "\"location\":\"%s:%d\",\"function\":\"%s\"",
+                                  loc->file, loc->line, loc->function);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static int write_profile_trace(profile_data_t *data)
+{
+    const profile_thread_data_t *thread;
+    uint64_t base_time;
+    int first;
+
+    /* All threads share the same time base */
+    base_time = UINT64_MAX;
+    for (thread = data->threads;
+         thread < data->threads + data->header->num_threads; ++thread) {
+        if (thread->header->num_records > 0) {
+            base_time = ucs_min(base_time, thread->records[0].timestamp);
+        }
+    }
+
+    first = 1;
+    printf("{\"traceEvents\":[\n");
+    print_trace_name_event(&first, "process_name", data->header->pid, 0,
+                           data->header->cmdline);
+    for (thread = data->threads;
+         thread < data->threads + data->header->num_threads; ++thread) {
+        write_profile_thread_trace(data, thread, base_time, &first);
+    }
+    printf("\n],\"displayTimeUnit\":\"ns\"}\n");
+    return 0;
+}
+
+static int write_instrument_trace(instrument_data_t *data)
+{
+    const ucs_instrument_record_t *rec;
+    int pid = data->header->app.pid;
+    int first;
+
+    first = 1;
+    printf("{\"traceEvents\":[\n");
+    print_trace_name_event(&first, "process_name", pid, 0,
+                           data->header->app.cmdline);
+    for (rec = data->records; rec < data->records + data->header->num_records;
+         ++rec) {
+        print_trace_event(&first, "i",
+                          instrument_location_name(data, rec->location), pid, 0,
+                          trace_time_usec(rec->timestamp, data->header->start_time,
+                                          data->header->one_second),
+                          0, "\"lparam\":\"0x%"PRIx64"\",\"wparam\":%u",
+                          rec->lparam, rec->wparam);
+    }
+    printf("\n],\"displayTimeUnit\":\"ns\"}\n");
+    return 0;
+}
+
+static int show_instrument_data(instrument_data_t *data, options_t *opts)
+{
+    const ucs_instrument_header_t *hdr = data->header;
+    const ucs_instrument_record_t *rec;
+
+    printf("\n");
+    printf("   command : %s\n", hdr->app.cmdline);
+    printf("   host    : %s\n", hdr->app.hostname);
+    printf("   pid     : %d\n", hdr->app.pid);
+    printf("   units   : %s\n", time_units_str[opts->time_units]);
+    printf("\n");
+
+    printf("%13s %18s %10s  NAME\n", "TIME", "LPARAM", "WPARAM");
+    for (rec = data->records; rec < data->records + hdr->num_records; ++rec) {
+        printf("%13.3f 0x%016"PRIx64" %10u  %s\n",
+               trace_time_usec(rec->timestamp, hdr->start_time, hdr->one_second) *
+               time_units_val[opts->time_units] / 1e6,
+               rec->lparam, rec->wparam,
+               instrument_location_name(data, rec->location));
+    }
+    printf("\n");
+    return 0;
+}
+
 static void close_pipes()
 {
     close(output_pipefds[0]);
@@ -310,9 +858,10 @@ static int redirect_output(const ucs_profile_header_t *hdr)
 
     num_lines = 6 + /* header */
                 ((hdr->mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) ?
-                                (hdr->num_locations + 2) : 0) +
+                                ((hdr->num_locations + 3) *
+                                 (hdr->num_threads   + 1)) : 0) +
                 ((hdr->mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) ?
-                                (hdr->num_records    + 1) : 0) +
+                                (hdr->num_records + 2 * hdr->num_threads) : 0) +
                 1; /* footer */
 
     if (num_lines <= wsz.ws_row) {
@@ -371,8 +920,14 @@ static void show_header(profile_data_t *data, options_t *opts)
 
 static int show_profile_data(profile_data_t *data, options_t *opts)
 {
+    const profile_thread_data_t *thread;
     int ret;
 
+    if (opts->summary && !(data->header->mode & UCS_BIT(UCS_PROFILE_MODE_LOG))) {
+        fprintf(stderr, "Stage summary requires a profile in 'log' mode\n");
+        return -1;
+    }
+
     if (!opts->raw) {
         ret = redirect_output(data->header);
         if (ret < 0) {
@@ -382,14 +937,21 @@ static int show_profile_data(profile_data_t *data, options_t *opts)
 
     show_header(data, opts);
 
+    if (opts->summary) {
+        return show_profile_data_summary(data, opts);
+    }
+
     if (data->header->mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) {
         show_profile_data_accum(data, opts);
         printf("\n");
     }
 
     if (data->header->mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
-        show_profile_data_log(data, opts);
-        printf("\n");
+        for (thread = data->threads;
+             thread < data->threads + data->header->num_threads; ++thread) {
+            show_profile_data_log(data, opts, thread);
+            printf("\n");
+        }
     }
 
     return 0;
@@ -399,14 +961,26 @@ int parse_args(int argc, char **argv, options_t *opts)
 {
     int c;
 
-    opts->raw         = !isatty(fileno(stdout));
-    opts->time_units  = TIME_UNITS_USEC;
+    opts->raw          = !isatty(fileno(stdout));
+    opts->chrome_trace = 0;
+    opts->instrument   = 0;
+    opts->summary      = 0;
+    opts->time_units   = TIME_UNITS_USEC;
 
-    while ( (c = getopt(argc, argv, "hrt:")) != -1 ) {
+    while ( (c = getopt(argc, argv, "hrjist:")) != -1 ) {
         switch (c) {
         case 'r':
             opts->raw = 1;
             break;
+        case 'j':
+            opts->chrome_trace = 1;
+            break;
+        case 'i':
+            opts->instrument = 1;
+            break;
+        case 's':
+            opts->summary = 1;
+            break;
         case 't':
             if (!strcasecmp(optarg, "sec")) {
                 opts->time_units = TIME_UNITS_SEC;
@@ -436,6 +1010,7 @@ int parse_args(int argc, char **argv, options_t *opts)
 
 int main(int argc, char **argv)
 {
+    instrument_data_t instrument_data = {0};
     profile_data_t data = {0};
     options_t opts;
     int ret;
@@ -445,15 +1020,32 @@ int main(int argc, char **argv)
         printf("Options:\n");
         printf("      -r             raw output\n");
         printf("      -t UNITS       select time units (sec/msec/usec/nsec)\n");
+        printf("      -j             print Chrome trace-event JSON, which can be\n");
+        printf("                     loaded by chrome://tracing or Perfetto\n");
+        printf("      -i             the file is an instrumentation file\n");
+        printf("      -s             summarize the time of every stage (scope)\n");
+        printf("                     by its call path, requires 'log' mode\n");
         printf("\n");
         return -1;
     }
 
+    if (opts.instrument) {
+        if (read_instrument_data(opts.filename, &instrument_data) < 0) {
+            return -1;
+        }
+
+        ret = opts.chrome_trace ? write_instrument_trace(&instrument_data) :
+                                  show_instrument_data(&instrument_data, &opts);
+        release_instrument_data(&instrument_data);
+        return ret;
+    }
+
     if (read_profile_data(opts.filename, &data) < 0) {
         return -1;
     }
 
-    ret = show_profile_data(&data, &opts);
+    ret = opts.chrome_trace ? write_profile_trace(&data) :
+                              show_profile_data(&data, &opts);
     release_profile_data(&data);
     return ret;
 }
@@ -28,8 +28,10 @@
         UCP_RMA_CHECK_ATOMIC(_remote_addr, _size); \
         for (;;) { \
             UCP_EP_RESOLVE_RKEY_AMO(_ep, _rkey, lane, uct_rkey); \
+            UCP_THREAD_CS_ENTER_CONDITIONAL((_ep)->worker); \
             status = _uct_func((_ep)->uct_eps[lane], _param, _remote_addr, \
                                uct_rkey); \
+            UCP_THREAD_CS_EXIT_CONDITIONAL((_ep)->worker); \
             if (ucs_likely(status != UCS_ERR_NO_RESOURCE)) { \
                 return status; \
             } \
@@ -50,8 +52,10 @@
         \
         for (;;) { \
             UCP_EP_RESOLVE_RKEY_AMO(_ep, _rkey, lane, uct_rkey); \
+            UCP_THREAD_CS_ENTER_CONDITIONAL((_ep)->worker); \
             status = _uct_func((_ep)->uct_eps[lane], UCS_PP_TUPLE_BREAK _params, \
                                _remote_addr, uct_rkey, _result, &comp); \
+            UCP_THREAD_CS_EXIT_CONDITIONAL((_ep)->worker); \
             if (ucs_likely(status == UCS_OK)) { \
                 goto out; \
             } else if (status == UCS_INPROGRESS) { \
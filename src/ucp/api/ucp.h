@@ -178,11 +178,17 @@ enum ucp_dt_type {
  * ucp_mem_map() function.
  */
 enum {
-    UCP_MEM_MAP_NONBLOCK = UCS_BIT(0) /**< Complete the mapping faster, possibly by
-                                           not populating the pages in the mapping
-                                           up-front, and mapping them later when
-                                           they are accessed by communication
-                                           routines. */
+    UCP_MEM_MAP_NONBLOCK = UCS_BIT(0), /**< Complete the mapping faster, possibly by
+                                            not populating the pages in the mapping
+                                            up-front, and mapping them later when
+                                            they are accessed by communication
+                                            routines. */
+    UCP_MEM_MAP_ASYNC    = UCS_BIT(1)  /**< Register an existing memory segment
+                                            in the background, and return
+                                            UCS_INPROGRESS immediately. The
+                                            progress can be checked with @ref
+                                            ucp_mem_map_test "ucp_mem_map_test()".
+                                            Ignored when the memory is allocated. */
 };
 
 
@@ -672,6 +678,12 @@ void ucp_context_print_info(ucp_context_h context, FILE *stream);
  *
  * @note The worker object is allocated within context of the calling thread
  *
+ * @note If @a thread_mode is @ref UCS_THREAD_MODE_MULTI, the worker can be
+ * used concurrently by multiple threads: the worker's shared state (matching
+ * queues, request pool, endpoint hash and transport interfaces) is protected
+ * by an internal per-worker lock, which is held only while that state is
+ * accessed. Other modes do not add any locking overhead.
+ *
  * @param [in] context     Handle to @ref ucp_context_h
  *                         "UCP application context".
  * @param [in] thread_mode Thread safety @ref ucs_thread_mode_t "mode" for
@@ -759,6 +771,65 @@ ucs_status_t ucp_worker_get_address(ucp_worker_h worker,
 void ucp_worker_release_address(ucp_worker_h worker, ucp_address_t *address);
 
 
+/**
+ * @ingroup UCP_WORKER
+ * @brief Listen for connections on a socket address.
+ *
+ * This routine creates a @ref ucp_listener_h "listener", which accepts
+ * connections from @ref ucp_ep_create_sockaddr "ucp_ep_create_sockaddr()" on
+ * the given socket address. The worker addresses are exchanged from the async
+ * context of the worker, and an endpoint to every client is created from the
+ * @ref ucp_worker_progress "progress" of the worker, which then invokes
+ * @a accept_cb with it.
+ *
+ * @param [in]  worker      Worker to create the endpoints on.
+ * @param [in]  sockaddr    Address to listen on, either "<host>:<port>" or
+ *                          "unix:<path>". The host may be empty or "*" to
+ *                          listen on all interfaces, and the port may be 0 to
+ *                          select a free one.
+ * @param [in]  accept_cb   Callback for every created endpoint.
+ * @param [in]  arg         User argument for the callback.
+ * @param [out] listener_p  A handle to the created listener.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucp_listener_create(ucp_worker_h worker, const char *sockaddr,
+                                 ucp_listener_accept_callback_t accept_cb,
+                                 void *arg, ucp_listener_h *listener_p);
+
+
+/**
+ * @ingroup UCP_WORKER
+ * @brief Destroy a listener.
+ *
+ * This routine stops accepting connections, and releases the
+ * @ref ucp_listener_h "listener". Endpoints which were created by the listener
+ * are not affected.
+ *
+ * @param [in]  listener    Listener to destroy.
+ */
+void ucp_listener_destroy(ucp_listener_h listener);
+
+
+/**
+ * @ingroup UCP_WORKER
+ * @brief Get the socket address of a listener.
+ *
+ * This routine returns the address which the @ref ucp_listener_h "listener"
+ * is bound to, in the format accepted by @ref ucp_ep_create_sockaddr
+ * "ucp_ep_create_sockaddr()". It provides the selected port when the listener
+ * was created with port 0.
+ *
+ * @param [in]  listener    Listener to query.
+ * @param [out] buf         Filled with the socket address string.
+ * @param [in]  max         Size of the buffer.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucp_listener_get_sockaddr(ucp_listener_h listener, char *buf,
+                                       size_t max);
+
+
 /**
  * @ingroup UCP_WORKER
  * @brief Progress all communications on a specific worker.
@@ -933,6 +1004,28 @@ ucs_status_t ucp_ep_create(ucp_worker_h worker, const ucp_address_t *address,
                            ucp_ep_h *ep_p);
 
 
+/**
+ * @ingroup UCP_ENDPOINT
+ * @brief Create an endpoint to a worker which listens on a socket address.
+ *
+ * This routine connects to a @ref ucp_listener_h "listener" on a socket
+ * address, exchanges the worker addresses with it, and creates an
+ * @ref ucp_ep_h "endpoint" to the listening worker, as @ref ucp_ep_create
+ * "ucp_ep_create()" does. The routine blocks until the listener replies,
+ * which does not depend on the progress of the listening worker.
+ *
+ * @param [in]  worker      Handle to the worker; the endpoint
+ *                          is associated with the worker.
+ * @param [in]  sockaddr    Address of the listener, either "<host>:<port>" or
+ *                          "unix:<path>".
+ * @param [out] ep_p        A handle to the created endpoint.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucp_ep_create_sockaddr(ucp_worker_h worker, const char *sockaddr,
+                                    ucp_ep_h *ep_p);
+
+
 /**
  * @ingroup UCP_ENDPOINT
  *
@@ -1036,12 +1129,39 @@ ucs_status_t ucp_ep_flush(ucp_ep_h ep);
  * @param [out]    memh_p     UCP @ref ucp_mem_h "handle" for the allocated
  *                            segment.
  *
+ * @return UCS_INPROGRESS     - The segment is registered in the background,
+ *                              see @ref UCP_MEM_MAP_ASYNC.
  * @return Error code as defined by @ref ucs_status_t
  */
 ucs_status_t ucp_mem_map(ucp_context_h context, void **address_p, size_t length,
                          unsigned flags, ucp_mem_h *memh_p);
 
 
+/**
+ * @ingroup UCP_MEM
+ * @brief Check the status of a background memory mapping.
+ *
+ * This routine checks whether a memory segment, which was mapped with the
+ * @ref UCP_MEM_MAP_ASYNC flag, is registered with all the network resources.
+ * While the registration is in progress, the @ref ucp_mem_h "memory handle"
+ * can already be used with the resources which were registered so far: a
+ * @ref ucp_rkey_pack "packed remote key" contains only these resources, so a
+ * peer can access the memory over the transports which are ready. The handle
+ * may be @ref ucp_mem_unmap "unmapped" at any time, which stops the
+ * registration.
+ *
+ * @param [in]  context     Application @ref ucp_context_h "context" which was
+ *                          used to map the memory.
+ * @param [in]  memh        @ref ucp_mem_h "Handle" to memory region.
+ *
+ * @return UCS_OK           - The segment is registered with all resources.
+ * @return UCS_INPROGRESS   - The registration is in progress.
+ * @return Error code as defined by @ref ucs_status_t, if the registration
+ *         failed. The handle must still be unmapped.
+ */
+ucs_status_t ucp_mem_map_test(ucp_context_h context, ucp_mem_h memh);
+
+
 /**
  * @ingroup UCP_MEM
  * @brief Unmap memory segment
@@ -139,6 +139,18 @@ typedef struct ucp_mem                   *ucp_mem_h;
  typedef struct ucp_worker                *ucp_worker_h;
 
 
+/**
+ * @ingroup UCP_WORKER
+ * @brief UCP Listener
+ *
+ * UCP listener is an opaque object which accepts connections on a socket
+ * address. It exchanges worker addresses with every connecting client, and
+ * creates an @ref ucp_ep_h "endpoint" to it on the listening
+ * @ref ucp_worker_h "worker".
+ */
+typedef struct ucp_listener              *ucp_listener_h;
+
+
 /**
  * @ingroup UCP_COMM
  * @brief UCP Tag Identifier
@@ -235,4 +247,21 @@ typedef void (*ucp_tag_recv_callback_t)(void *request, ucs_status_t status,
                                         ucp_tag_recv_info_t *info);
 
 
+/**
+ * @ingroup UCP_WORKER
+ * @brief Callback for endpoints created by a listener.
+ *
+ * This callback routine is invoked from the progress of the listening
+ * @ref ucp_worker_h "worker", whenever an endpoint was created to a client
+ * which connected to the @ref ucp_listener_h "listener". The endpoint belongs
+ * to the application, and the wireup with the client may still be in
+ * progress.
+ *
+ * @param [in]  ep        Endpoint to the client.
+ * @param [in]  arg       User argument, which was passed to
+ *                        @ref ucp_listener_create "ucp_listener_create()".
+ */
+typedef void (*ucp_listener_accept_callback_t)(ucp_ep_h ep, void *arg);
+
+
 #endif
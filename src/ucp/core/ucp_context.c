@@ -7,6 +7,7 @@
 
 #include "ucp_context.h"
 #include "ucp_request.h"
+#include "ucp_mm.h"
 
 #include <ucs/config/parser.h>
 #include <ucs/algorithm/crc.h>
@@ -111,6 +112,49 @@ static ucs_config_field_t ucp_config_table[] = {
    "Maximal length of worker name. Affects the size of worker address in debug builds.",
    ucs_offsetof(ucp_config_t, ctx.max_worker_name), UCS_CONFIG_TYPE_UINT},
 
+  {"EP_LAZY_CONNECT", "n",
+   "If enabled, ucp_ep_create() only saves the remote address, and the transport\n"
+   "lanes of the endpoint are selected and connected by the first operation which\n"
+   "sends data on it. Reduces the startup time and memory footprint of jobs which\n"
+   "create endpoints to many peers but communicate with only a few of them.",
+   ucs_offsetof(ucp_config_t, ctx.ep_lazy_connect), UCS_CONFIG_TYPE_BOOL},
+
+  {"ADDRESS_SHORT", "n",
+   "If enabled, worker addresses returned by ucp_worker_get_address() contain\n"
+   "only the information needed to check reachability and to connect, without\n"
+   "performance estimations of the transports. This makes the addresses smaller\n"
+   "to exchange out-of-band, and transport selection assumes the remote\n"
+   "interfaces perform like the local ones.",
+   ucs_offsetof(ucp_config_t, ctx.address_short), UCS_CONFIG_TYPE_BOOL},
+
+  {"RKEY_CACHE_SIZE", "0",
+   "Maximal number of unpacked remote keys to cache on every worker. If a packed\n"
+   "remote key is unpacked again for an endpoint with the same configuration,\n"
+   "ucp_ep_rkey_unpack() returns the cached handle instead of creating a new one.\n"
+   "The least recently used keys are released when the cache is full.\n"
+   "0 disables the cache.",
+   ucs_offsetof(ucp_config_t, ctx.rkey_cache_size), UCS_CONFIG_TYPE_UINT},
+
+  {"MEM_ARENA_THRESH", "0",
+   "Memory allocations by ucp_mem_map() up to this size are carved out of larger\n"
+   "arenas, which are allocated and registered with all memory domains only once.\n"
+   "The regions are rounded up to a power of 2. Note that a remote key of such a\n"
+   "region gives access to the whole arena. 0 disables the arenas.",
+   ucs_offsetof(ucp_config_t, ctx.mem_arena_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
+  {"MEM_ARENA_SIZE", "4m",
+   "Size of every memory arena used for small ucp_mem_map() allocations.",
+   ucs_offsetof(ucp_config_t, ctx.mem_arena_size), UCS_CONFIG_TYPE_MEMUNITS},
+
+  {"MEM_REG_CHUNK", "64m",
+   "Memory mapped with UCP_MEM_MAP_ASYNC is registered in the background in chunks\n"
+   "of this size, so unmapping it stops the registration after the current chunk,\n"
+   "and rendezvous receives can use the chunks which are already registered.\n"
+   "A region larger than one chunk is then registered again as a whole, for remote\n"
+   "keys and rendezvous sends, so it's registered twice on every memory domain\n"
+   "until it's unmapped. Setting this to 0 disables the chunks.",
+   ucs_offsetof(ucp_config_t, ctx.mem_reg_chunk), UCS_CONFIG_TYPE_MEMUNITS},
+
   {NULL}
 };
 
@@ -689,12 +733,26 @@ ucs_status_t ucp_init_version(unsigned api_major_version, unsigned api_minor_ver
     ucs_queue_head_init(&context->tag.expected);
     ucs_queue_head_init(&context->tag.unexpected);
 
+    status = ucp_mem_arena_init(context);
+    if (status != UCS_OK) {
+        goto err_free_resources;
+    }
+
+    status = ucp_mem_reg_init(context);
+    if (status != UCS_OK) {
+        goto err_arena_cleanup;
+    }
+
     ucs_debug("created ucp context %p [%d mds %d tls] features 0x%lx", context,
               context->num_mds, context->num_tls, context->config.features);
 
     *context_p = context;
     return UCS_OK;
 
+err_arena_cleanup:
+    ucp_mem_arena_cleanup(context);
+err_free_resources:
+    ucp_free_resources(context);
 err_free_config:
     ucp_free_config(context);
 err_free_ctx:
@@ -705,6 +763,8 @@ err:
 
 void ucp_cleanup(ucp_context_h context)
 {
+    ucp_mem_arena_cleanup(context);
+    ucp_mem_reg_cleanup(context);
     ucp_free_resources(context);
     ucp_free_config(context);
     ucs_free(context);
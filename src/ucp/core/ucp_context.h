@@ -11,9 +11,13 @@
 
 #include <ucp/api/ucp.h>
 #include <uct/api/uct.h>
+#include <ucs/datastruct/list.h>
 #include <ucs/datastruct/queue_types.h>
+#include <ucs/type/spinlock.h>
 #include <ucs/type/component.h>
 
+#include <pthread.h>
+
 
 #define UCP_WORKER_NAME_MAX          32   /* Worker name for debugging */
 #define UCP_MIN_BCOPY                64   /* Minimal size for bcopy */
@@ -103,6 +107,18 @@ typedef struct ucp_context_config {
     unsigned                               max_worker_name;
     /** Atomic mode */
     ucp_atomic_mode_t                      atomic_mode;
+    /** Whether to connect endpoint lanes on first use */
+    int                                    ep_lazy_connect;
+    /** Whether to pack worker addresses without performance attributes */
+    int                                    address_short;
+    /** Maximal number of cached remote keys per worker */
+    unsigned                               rkey_cache_size;
+    /** Maximal size of allocations to carve out of registered memory arenas */
+    size_t                                 mem_arena_thresh;
+    /** Size of a registered memory arena */
+    size_t                                 mem_arena_size;
+    /** Size of a unit of background memory registration */
+    size_t                                 mem_reg_chunk;
 } ucp_context_config_t;
 
 
@@ -128,6 +144,11 @@ typedef void (*ucp_am_tracer_t)(ucp_worker_h worker, uct_am_trace_type_t type,
                                 char *buffer, size_t max);
 
 
+/* Size classes of regions carved out of memory arenas: 64 bytes and up */
+#define UCP_MEM_ARENA_MIN_SHIFT      6
+#define UCP_MEM_ARENA_MAX_CLASSES    20
+
+
 /**
  * UCP communication resource descriptor
  */
@@ -164,6 +185,28 @@ typedef struct ucp_context {
         ucs_queue_head_t          unexpected; /* Unexpected received descriptors */
     } tag;
 
+    struct {
+        ucs_spinlock_t            lock;       /* Protects the arenas */
+        ucs_list_link_t           list;       /* Registered arenas, current first */
+        void                      *free[UCP_MEM_ARENA_MAX_CLASSES]; /* Free
+                                                 regions, by size class */
+        unsigned                  max_class;  /* Largest size class to carve */
+    } mem_arena;
+
+    struct {
+        pthread_mutex_t           lock;       /* Protects the queue and the
+                                                 registration state of handles */
+        pthread_cond_t            cond;       /* Signaled on new handles, on
+                                                 completion, and on stop */
+        ucs_list_link_t           queue;      /* Handles waiting for registration */
+        ucs_list_link_t           memhs;      /* All handles mapped in the
+                                                 background, for rendezvous */
+        volatile unsigned         num_memhs;  /* Length of the above list */
+        pthread_t                 thread;     /* Registration thread */
+        int                       thread_started; /* Whether the thread runs */
+        int                       stop;       /* Whether the thread should exit */
+    } mem_reg;
+
     struct {
 
         /* Bitmap of features supported by the context */
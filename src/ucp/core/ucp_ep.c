@@ -27,7 +27,7 @@ ucs_status_t ucp_ep_new(ucp_worker_h worker, uint64_t dest_uuid,
     khiter_t hash_it;
     int hash_extra_status = 0;
 
-    ep = ucs_calloc(1, sizeof(*ep), "ucp ep");
+    ep = ucs_mpool_get(&worker->ep_mp);
     if (ep == NULL) {
         ucs_error("Failed to allocate ep");
         status = UCS_ERR_NO_MEMORY;
@@ -50,12 +50,21 @@ ucs_status_t ucp_ep_new(ucp_worker_h worker, uint64_t dest_uuid,
     ep->cfg_index        = ucp_worker_get_ep_config(worker, &key);
     ep->am_lane          = UCP_NULL_LANE;
     ep->flags            = 0;
+    ep->status           = UCS_OK;
+    ep->uct_eps          = NULL;
+    ep->lazy_address     = NULL;
 #if ENABLE_DEBUG_DATA
     ucs_snprintf_zero(ep->peer_name, UCP_WORKER_NAME_MAX, "%s", peer_name);
 #endif
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
     hash_it = kh_put(ucp_worker_ep_hash, &worker->ep_hash, dest_uuid,
                      &hash_extra_status);
+    if (ucs_likely(hash_it != kh_end(&worker->ep_hash))) {
+        kh_value(&worker->ep_hash, hash_it) = ep;
+    }
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+
     if (ucs_unlikely(hash_it == kh_end(&worker->ep_hash))) {
         ucs_error("Hash failed with ep %p to %s 0x%"PRIx64"->0x%"PRIx64" %s "
                   "with status %d", ep, peer_name, worker->uuid, ep->dest_uuid,
@@ -63,7 +72,6 @@ ucs_status_t ucp_ep_new(ucp_worker_h worker, uint64_t dest_uuid,
         status = UCS_ERR_NO_RESOURCE;
         goto err_free_ep;
     }
-    kh_value(&worker->ep_hash, hash_it) = ep;
 
     *ep_p = ep;
     ucs_debug("created ep %p to %s 0x%"PRIx64"->0x%"PRIx64" %s", ep, peer_name,
@@ -71,25 +79,88 @@ ucs_status_t ucp_ep_new(ucp_worker_h worker, uint64_t dest_uuid,
     return UCS_OK;
 
 err_free_ep:
-    ucs_free(ep);
+    ucs_mpool_put(ep);
 err:
     return status;
 }
 
+static void ucp_ep_release_lanes(ucp_ep_h ep)
+{
+    if (ep->uct_eps != NULL) {
+        ucs_mpool_put(ep->uct_eps);
+        ep->uct_eps = NULL;
+    }
+}
+
+ucs_status_t ucp_ep_set_cfg_index(ucp_ep_h ep, uint16_t cfg_index)
+{
+    ucp_worker_h worker = ep->worker;
+    ucp_lane_index_t old_num_lanes, new_num_lanes, lane;
+    uct_ep_h *uct_eps;
+
+    old_num_lanes = ucp_ep_num_lanes(ep);
+    new_num_lanes = worker->ep_config[cfg_index].key.num_lanes;
+
+    if (new_num_lanes != old_num_lanes) {
+        /* Move the existing transports to a lanes array of the new size */
+        if (new_num_lanes > 0) {
+            uct_eps = ucs_mpool_get(&worker->ep_lanes_mp[new_num_lanes - 1]);
+            if (uct_eps == NULL) {
+                ucs_error("failed to allocate %d lanes for ep %p",
+                          new_num_lanes, ep);
+                return UCS_ERR_NO_MEMORY;
+            }
+
+            for (lane = 0; lane < new_num_lanes; ++lane) {
+                uct_eps[lane] = (lane < old_num_lanes) ? ep->uct_eps[lane] : NULL;
+            }
+        } else {
+            uct_eps = NULL;
+        }
+
+        for (lane = new_num_lanes; lane < old_num_lanes; ++lane) {
+            ucs_assert(ep->uct_eps[lane] == NULL);
+        }
+
+        ucp_ep_release_lanes(ep);
+        ep->uct_eps = uct_eps;
+    }
+
+    ep->cfg_index = cfg_index;
+    return UCS_OK;
+}
+
+size_t ucp_ep_memory_usage(ucp_ep_h ep)
+{
+    size_t size = sizeof(ucs_mpool_elem_t) + sizeof(*ep);
+
+    if (ep->uct_eps != NULL) {
+        size += sizeof(ucs_mpool_elem_t) +
+                (ucp_ep_num_lanes(ep) * sizeof(*ep->uct_eps));
+    }
+    if (ep->lazy_address != NULL) {
+        size += ucp_address_length(ep->lazy_address);
+    }
+    return size;
+}
+
 static void ucp_ep_delete_from_hash(ucp_ep_h ep)
 {
     khiter_t hash_it;
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
     hash_it = kh_get(ucp_worker_ep_hash, &ep->worker->ep_hash, ep->dest_uuid);
     if (hash_it != kh_end(&ep->worker->ep_hash)) {
         kh_del(ucp_worker_ep_hash, &ep->worker->ep_hash, hash_it);
     }
+    UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
 }
 
 static void ucp_ep_delete(ucp_ep_h ep)
 {
     ucp_ep_delete_from_hash(ep);
-    ucs_free(ep);
+    ucp_ep_release_lanes(ep);
+    ucs_mpool_put(ep);
 }
 
 ucs_status_t ucp_ep_create_stub(ucp_worker_h worker, uint64_t dest_uuid,
@@ -116,19 +187,22 @@ ucs_status_t ucp_ep_create_stub(ucp_worker_h worker, uint64_t dest_uuid,
     key.num_lanes        = 1;
     memset(key.amo_lanes, UCP_NULL_LANE, sizeof(key.amo_lanes));
 
-    ep->cfg_index        = ucp_worker_get_ep_config(worker, &key);
+    status = ucp_ep_set_cfg_index(ep, ucp_worker_get_ep_config(worker, &key));
+    if (status != UCS_OK) {
+        goto err_delete_ep;
+    }
+
     ep->am_lane          = 0;
 
     status = ucp_stub_ep_create(ep, &ep->uct_eps[0]);
     if (status != UCS_OK) {
-        goto err_destroy_uct_eps;
+        goto err_delete_ep;
     }
 
     *ep_p = ep;
     return UCS_OK;
 
-err_destroy_uct_eps:
-    uct_ep_destroy(ep->uct_eps[0]);
+err_delete_ep:
     ucp_ep_delete(ep);
 err:
     return status;
@@ -139,11 +213,105 @@ int ucp_ep_is_stub(ucp_ep_h ep)
     return ucp_ep_get_rsc_index(ep, 0) == UCP_NULL_RESOURCE;
 }
 
+static ucs_status_t ucp_ep_connect_address(ucp_ep_h ep, unsigned address_count,
+                                           const ucp_address_entry_t *address_list)
+{
+    uint8_t addr_indices[UCP_MAX_LANES];
+    ucs_status_t status;
+
+    /* initialize transport endpoints */
+    status = ucp_wireup_init_lanes(ep, address_count, address_list, addr_indices);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* send initial wireup message */
+    if (!(ep->flags & UCP_EP_FLAG_LOCAL_CONNECTED)) {
+        return ucp_wireup_send_request(ep);
+    }
+
+    return UCS_OK;
+}
+
+static ucs_status_t ucp_ep_save_lazy_address(ucp_ep_h ep,
+                                             const ucp_address_t *address)
+{
+    size_t length = ucp_address_length(address);
+
+    ep->lazy_address = ucs_malloc(length, "ucp_ep_lazy_address");
+    if (ep->lazy_address == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    memcpy(ep->lazy_address, address, length);
+    ep->flags |= UCP_EP_FLAG_LAZY_CONNECT;
+    ucs_trace("ep %p: saved %zu bytes of remote address for lazy connect",
+              ep, length);
+    return UCS_OK;
+}
+
+void ucp_ep_lazy_release(ucp_ep_h ep)
+{
+    ep->flags &= ~UCP_EP_FLAG_LAZY_CONNECT;
+    ucs_free(ep->lazy_address);
+    ep->lazy_address = NULL;
+}
+
+ucs_status_t ucp_ep_connect_lazy(ucp_ep_h ep)
+{
+    ucp_worker_h worker = ep->worker;
+    char peer_name[UCP_WORKER_NAME_MAX];
+    ucp_address_entry_t *address_list;
+    unsigned address_count;
+    ucs_status_t status;
+    uint64_t dest_uuid;
+
+    UCS_ASYNC_BLOCK(&worker->async);
+
+    /* A failed endpoint has no usable lanes, keep reporting the error */
+    if (ep->flags & UCP_EP_FLAG_FAILED) {
+        status = ep->status;
+        goto out;
+    }
+
+    /* Could have been connected by a wireup request from the remote side */
+    if (!(ep->flags & UCP_EP_FLAG_LAZY_CONNECT)) {
+        status = UCS_OK;
+        goto out;
+    }
+
+    ucs_debug("ep %p: lazy connect to %s", ep, ucp_ep_peer_name(ep));
+
+    status = ucp_address_unpack(ep->lazy_address, &dest_uuid, peer_name,
+                                sizeof(peer_name), &address_count,
+                                &address_list);
+    if (status != UCS_OK) {
+        ucs_error("failed to unpack remote address: %s", ucs_status_string(status));
+        goto out_release;
+    }
+
+    ucs_assert(dest_uuid == ep->dest_uuid);
+    status = ucp_ep_connect_address(ep, address_count, address_list);
+    if (status != UCS_OK) {
+        ucs_error("ep %p: lazy connect failed: %s", ep, ucs_status_string(status));
+    }
+
+    ucs_free(address_list);
+out_release:
+    ucp_ep_lazy_release(ep);
+    if (status != UCS_OK) {
+        ep->flags |= UCP_EP_FLAG_FAILED;
+        ep->status = status;
+    }
+out:
+    UCS_ASYNC_UNBLOCK(&worker->async);
+    return status;
+}
+
 ucs_status_t ucp_ep_create(ucp_worker_h worker, const ucp_address_t *address,
                            ucp_ep_h *ep_p)
 {
     char peer_name[UCP_WORKER_NAME_MAX];
-    uint8_t addr_indices[UCP_MAX_LANES];
     ucp_address_entry_t *address_list;
     unsigned address_count;
     ucs_status_t status;
@@ -173,20 +341,16 @@ ucs_status_t ucp_ep_create(ucp_worker_h worker, const ucp_address_t *address,
         goto out_free_address;
     }
 
-    /* initialize transport endpoints */
-    status = ucp_wireup_init_lanes(ep, address_count, address_list, addr_indices);
+    /* lanes would be created by the first operation on the endpoint */
+    if (worker->context->config.ext.ep_lazy_connect) {
+        status = ucp_ep_save_lazy_address(ep, address);
+    } else {
+        status = ucp_ep_connect_address(ep, address_count, address_list);
+    }
     if (status != UCS_OK) {
         goto err_destroy_ep;
     }
 
-    /* send initial wireup message */
-    if (!(ep->flags & UCP_EP_FLAG_LOCAL_CONNECTED)) {
-        status = ucp_wireup_send_request(ep);
-        if (status != UCS_OK) {
-            goto err_destroy_ep;
-        }
-    }
-
     *ep_p = ep;
     goto out_free_address;
 
@@ -384,6 +548,13 @@ void ucp_ep_destroy_internal(ucp_ep_h ep, const char *message)
 
     ucs_debug("destroy ep %p%s", ep, message);
 
+    if ((ep->flags & UCP_EP_FLAG_CONNECT_REP_SENT) &&
+        !(ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED)) {
+        /* Do not wait for the acknowledgement of our wireup reply anymore */
+        ucs_assert(ep->worker->wireup_ack_wait > 0);
+        --ep->worker->wireup_ack_wait;
+    }
+
     for (lane = 0; lane < ucp_ep_num_lanes(ep); ++lane) {
         uct_ep = ep->uct_eps[lane];
         if (uct_ep == NULL) {
@@ -395,12 +566,15 @@ void ucp_ep_destroy_internal(ucp_ep_h ep, const char *message)
         uct_ep_destroy(uct_ep);
     }
 
-    ucs_free(ep);
+    ucs_free(ep->lazy_address);
+    ucp_ep_release_lanes(ep);
+    ucs_mpool_put(ep);
 }
 
 static void ucp_ep_disconnected(ucp_request_t *req)
 {
-    ucp_ep_h ep = req->send.ep;
+    ucp_ep_h ep         = req->send.ep;
+    ucp_worker_h worker = ep->worker;
 
     if (ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED) {
         /* Endpoints which have remote connection are destroyed only when the
@@ -411,8 +585,11 @@ static void ucp_ep_disconnected(ucp_request_t *req)
         return;
     }
 
+    /* The endpoint memory pools are shared with async wireup handlers */
+    UCS_ASYNC_BLOCK(&worker->async);
     ucp_ep_delete_from_hash(ep);
     ucp_ep_destroy_internal(ep, " from disconnect");
+    UCS_ASYNC_UNBLOCK(&worker->async);
 }
 
 static ucs_status_ptr_t ucp_disconnect_nb_internal(ucp_ep_h ep)
@@ -422,7 +599,7 @@ static ucs_status_ptr_t ucp_disconnect_nb_internal(ucp_ep_h ep)
 
     ucs_debug("disconnect ep %p", ep);
 
-    req = ucs_mpool_get(&ep->worker->req_mp);
+    req = ucp_request_get(ep->worker);
     if (req == NULL) {
         return UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
     }
@@ -457,7 +634,7 @@ static ucs_status_ptr_t ucp_disconnect_nb_internal(ucp_ep_h ep)
         ucp_ep_disconnected(req);
         ucs_trace_req("ep %p: releasing flush request %p, returning status %s",
                       ep, req, ucs_status_string(status));
-        ucs_mpool_put(req);
+        ucp_request_mpool_put(req);
         return UCS_STATUS_PTR(status);
     }
 
@@ -526,6 +703,29 @@ int ucp_ep_config_is_equal(const ucp_ep_config_key_t *key1,
     return 1;
 }
 
+khint32_t ucp_ep_config_key_hash(const ucp_ep_config_key_t *key)
+{
+    ucp_lane_index_t lane;
+    uint64_t hash;
+
+    /* Use the same fields which are compared by ucp_ep_config_is_equal() */
+    hash = key->rma_lane_map;
+    hash = (hash * 31) + key->amo_lane_map;
+    hash = (hash * 31) + key->reachable_md_map;
+    hash = (hash * 31) + ((uint64_t)key->am_lane           |
+                          ((uint64_t)key->rndv_lane << 8)  |
+                          ((uint64_t)key->wireup_msg_lane << 16) |
+                          ((uint64_t)key->num_lanes << 24));
+    for (lane = 0; lane < key->num_lanes; ++lane) {
+        hash = (hash * 31) + key->lanes[lane];
+    }
+    for (lane = 0; lane < UCP_MAX_LANES; ++lane) {
+        hash = (hash * 31) + key->amo_lanes[lane];
+    }
+
+    return kh_int64_hash_func(hash);
+}
+
 void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config)
 {
     ucp_context_h context = worker->context;
@@ -11,6 +11,7 @@
 #include "ucp_context.h"
 
 #include <uct/api/uct.h>
+#include <ucs/datastruct/khash.h>
 #include <ucs/debug/log.h>
 #include <limits.h>
 
@@ -23,6 +24,16 @@ enum {
     UCP_EP_FLAG_REMOTE_CONNECTED = UCS_BIT(1), /* All remote endpoints are connected */
     UCP_EP_FLAG_CONNECT_REQ_SENT = UCS_BIT(2), /* Connection request was sent */
     UCP_EP_FLAG_CONNECT_REP_SENT = UCS_BIT(3), /* Debug: Connection reply was sent */
+    UCP_EP_FLAG_LAZY_CONNECT     = UCS_BIT(4), /* Lanes are not created yet, connect
+                                                  on first use */
+    UCP_EP_FLAG_CONNECT_REQ_RECVD= UCS_BIT(5), /* Connection request was received
+                                                  and the remote endpoint waits
+                                                  for our reply to be acked */
+    UCP_EP_FLAG_IMPLICIT_ACK     = UCS_BIT(6), /* A request which requires a reply
+                                                  was posted before the remote
+                                                  endpoints were connected */
+    UCP_EP_FLAG_FAILED           = UCS_BIT(7), /* Lazy connect failed, the error
+                                                  is kept in ep->status */
 };
 
 
@@ -117,16 +128,23 @@ typedef struct ucp_ep {
     uint16_t                      cfg_index;     /* Configuration index */
     ucp_lane_index_t              am_lane;       /* Cached value */
     uint8_t                       flags;         /* Endpoint flags */
+    ucs_status_t                  status;        /* Error status, valid if
+                                                    UCP_EP_FLAG_FAILED is set */
+
+    /* Transports for every lane. The array is allocated from a worker memory
+     * pool which matches the number of lanes in the configuration.
+     */
+    uct_ep_h                      *uct_eps;
 
     uint64_t                      dest_uuid;     /* Destination worker uuid */
 
+    void                          *lazy_address; /* Packed remote address, kept
+                                                    until lazy connect */
+
 #if ENABLE_DEBUG_DATA
     char                          peer_name[UCP_WORKER_NAME_MAX];
 #endif
 
-    /* TODO allocate ep dynamically according to number of lanes */
-    uct_ep_h                      uct_eps[UCP_MAX_LANES]; /* Transports for every lane */
-
 } ucp_ep_t;
 
 
@@ -134,11 +152,19 @@ ucs_status_t ucp_ep_new(ucp_worker_h worker, uint64_t dest_uuid,
                         const char *peer_name, const char *message,
                         ucp_ep_h *ep_p);
 
+ucs_status_t ucp_ep_set_cfg_index(ucp_ep_h ep, uint16_t cfg_index);
+
+size_t ucp_ep_memory_usage(ucp_ep_h ep);
+
 ucs_status_t ucp_ep_create_stub(ucp_worker_h worker, uint64_t dest_uuid,
                                 const char *message, ucp_ep_h *ep_p);
 
 void ucp_ep_destroy_internal(ucp_ep_h ep, const char *message);
 
+ucs_status_t ucp_ep_connect_lazy(ucp_ep_h ep);
+
+void ucp_ep_lazy_release(ucp_ep_h ep);
+
 int ucp_ep_is_stub(ucp_ep_h ep);
 
 void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config);
@@ -146,6 +172,8 @@ void ucp_ep_config_init(ucp_worker_h worker, ucp_ep_config_t *config);
 int ucp_ep_config_is_equal(const ucp_ep_config_key_t *key1,
                            const ucp_ep_config_key_t *key2);
 
+khint32_t ucp_ep_config_key_hash(const ucp_ep_config_key_t *key);
+
 ucp_md_map_t ucp_ep_config_get_rma_md_map(const ucp_ep_config_key_t *key,
                                           ucp_lane_index_t lane);
 
@@ -87,6 +87,16 @@ static inline const uct_md_attr_t* ucp_ep_md_attr(ucp_ep_h ep, ucp_lane_index_t
     return &context->md_attrs[ucp_ep_md_index(ep, lane)];
 }
 
+/* Create the lanes of an endpoint which was created with lazy connect */
+static UCS_F_ALWAYS_INLINE ucs_status_t ucp_ep_resolve_lazy(ucp_ep_h ep)
+{
+    if (ucs_likely(!(ep->flags & (UCP_EP_FLAG_LAZY_CONNECT |
+                                  UCP_EP_FLAG_FAILED)))) {
+        return UCS_OK;
+    }
+    return ucp_ep_connect_lazy(ep);
+}
+
 static inline const char* ucp_ep_peer_name(ucp_ep_h ep)
 {
 #if ENABLE_DEBUG_DATA
@@ -109,50 +119,39 @@ static inline ucp_md_lane_map_t ucp_ep_md_map_expand(ucp_md_map_t md_map)
 }
 
 /*
- * Calculate lane and rkey index based of the lane_map in ep configuration: the
- * lane_map holds the md_index which each lane supports, so we do 'and' between
- * that, and the md_map of the rkey (we duplicate the md_map in rkey to fill the
- * mask for each possible lane). The first set bit in the 'and' product represents
- * the first matching lane and its md_index.
+ * Get the lane and UCT rkey to use for a remote memory access. The lane and
+ * the rkey index are resolved once per endpoint configuration, and saved in
+ * the rkey, so usually this is just a compare and load.
  */
-#define UCP_EP_RESOLVE_RKEY(_ep, _rkey, _name, _config, _lane, _uct_rkey) \
+#define UCP_EP_RESOLVE_RKEY(_ep, _rkey, _name, _lane, _uct_rkey) \
     { \
-        ucp_md_lane_map_t ep_lane_map, rkey_md_map; \
-        ucp_rsc_index_t dst_md_index, rkey_index; \
-        uint8_t bit_index; \
+        ucs_status_t resolve_status; \
+        uint32_t resolved; \
         \
-        _config     = ucp_ep_config(_ep); \
-        ep_lane_map = (_config)->key._name##_lane_map; \
-        rkey_md_map = ucp_ep_md_map_expand((_rkey)->md_map); \
+        resolve_status = ucp_ep_resolve_lazy(_ep); \
+        if (ucs_unlikely(resolve_status != UCS_OK)) { \
+            return resolve_status; \
+        } \
         \
-        if (ENABLE_PARAMS_CHECK && !(ep_lane_map & rkey_md_map)) { \
-            ucs_error("Remote memory is unreachable"); \
-            return UCS_ERR_UNREACHABLE; \
+        resolved = (_rkey)->_name##_resolved; \
+        if (ucs_unlikely(UCP_RKEY_RESOLVED_CFG(resolved) != (_ep)->cfg_index)) { \
+            resolve_status = ucp_rkey_resolve_##_name(_ep, _rkey, &resolved); \
+            if (ucs_unlikely(resolve_status != UCS_OK)) { \
+                return resolve_status; \
+            } \
         } \
         \
-        /* Find the first lane which supports one of the remote md's in the rkey*/ \
-        bit_index    = ucs_ffs64(ep_lane_map & rkey_md_map); \
-        _lane        = bit_index / UCP_MD_INDEX_BITS; \
-        dst_md_index = bit_index % UCP_MD_INDEX_BITS; \
-        rkey_index   = ucs_count_one_bits(rkey_md_map & UCS_MASK(dst_md_index)); \
-        _uct_rkey    = (_rkey)->uct[rkey_index].rkey; \
+        _lane     = UCP_RKEY_RESOLVED_LANE(resolved); \
+        _uct_rkey = (_rkey)->uct[UCP_RKEY_RESOLVED_INDEX(resolved)].rkey; \
     }
 
 #define UCP_EP_RESOLVE_RKEY_RMA(_ep, _rkey, _lane, _uct_rkey, _rma_config) \
     { \
-        ucp_ep_config_t *config; \
-        \
-        UCP_EP_RESOLVE_RKEY(_ep, _rkey, rma, config, _lane, _uct_rkey); \
-        _rma_config  = &config->rma[(_lane)]; \
+        UCP_EP_RESOLVE_RKEY(_ep, _rkey, rma, _lane, _uct_rkey); \
+        _rma_config  = &ucp_ep_config(_ep)->rma[(_lane)]; \
     }
 
 #define UCP_EP_RESOLVE_RKEY_AMO(_ep, _rkey, _lane, _uct_rkey) \
-    { \
-        ucp_ep_config_t *config; \
-        ucp_lane_index_t amo_index; \
-        \
-        UCP_EP_RESOLVE_RKEY(_ep, _rkey, amo, config, amo_index, _uct_rkey); \
-        _lane        = config->key.amo_lanes[amo_index]; \
-    }
+    UCP_EP_RESOLVE_RKEY(_ep, _rkey, amo, _lane, _uct_rkey)
 
 #endif
@@ -0,0 +1,733 @@
+/**
+ * Copyright (C) Mellanox Technologies Ltd. 2001-2016.  ALL RIGHTS RESERVED.
+ *
+ * See file LICENSE for terms.
+ */
+
+#include "ucp_listener.h"
+#include "ucp_worker.h"
+
+#include <ucs/async/async.h>
+#include <ucs/datastruct/queue.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+#include <ucs/sys/sys.h>
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+
+/* Maximal length of a worker address received on a socket */
+#define UCP_SOCKADDR_ADDRESS_MAX     UCS_MBYTE
+
+/* Maximal number of socket events handled at once */
+#define UCP_LISTENER_MAX_EVENTS      16
+
+
+/**
+ * Create a stream socket, and either bind and listen on the address, or
+ * connect to it.
+ *
+ * @return The socket, or -1 with errno set.
+ */
+static int ucp_sockaddr_try(int family, const struct sockaddr *addr,
+                            socklen_t addrlen, int is_listen)
+{
+    int fd, optval, saved_errno;
+
+    fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (is_listen) {
+        optval = 1;
+        if ((family == AF_UNIX) ||
+            !setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)))
+        {
+            if (!bind(fd, addr, addrlen) && !listen(fd, SOMAXCONN)) {
+                return fd;
+            }
+        }
+    } else if (!connect(fd, addr, addrlen)) {
+        return fd;
+    }
+
+    saved_errno = errno;
+    close(fd);
+    errno = saved_errno;
+    return -1;
+}
+
+static ucs_status_t ucp_sockaddr_open_unix(const char *path, int is_listen,
+                                           int *fd_p)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        ucs_error("socket path '%s' is too long", path);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    *fd_p = ucp_sockaddr_try(AF_UNIX, (struct sockaddr*)&addr, sizeof(addr),
+                             is_listen);
+    if (*fd_p < 0) {
+        ucs_error("failed to %s on '%s': %m", is_listen ? "listen" : "connect",
+                  path);
+        return is_listen ? UCS_ERR_IO_ERROR : UCS_ERR_UNREACHABLE;
+    }
+
+    return UCS_OK;
+}
+
+static ucs_status_t ucp_sockaddr_open_inet(const char *sockaddr, int is_listen,
+                                           int *fd_p)
+{
+    char host[UCP_SOCKADDR_STRING_MAX];
+    struct addrinfo hints, *res, *ai;
+    const char *port, *host_start;
+    int host_len, ret;
+
+    port = strrchr(sockaddr, ':');
+    if (port == NULL) {
+        ucs_error("invalid socket address '%s', expected <host>:<port> or "
+                  UCP_SOCKADDR_UNIX_PREFIX "<path>", sockaddr);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    /* IPv6 hosts may be enclosed in brackets */
+    host_start = sockaddr;
+    host_len   = port - sockaddr;
+    if ((host_len >= 2) && (sockaddr[0] == '[') &&
+        (sockaddr[host_len - 1] == ']')) {
+        ++host_start;
+        host_len -= 2;
+    }
+    snprintf(host, sizeof(host), "%.*s", host_len, host_start);
+    ++port;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = is_listen ? AI_PASSIVE : 0;
+
+    /* A listener binds to all interfaces if the host is empty or "*" */
+    ret = getaddrinfo((!strlen(host) || !strcmp(host, "*")) ? NULL : host,
+                      port, &hints, &res);
+    if (ret != 0) {
+        ucs_error("failed to resolve '%s': %s", sockaddr, gai_strerror(ret));
+        return UCS_ERR_INVALID_ADDR;
+    }
+
+    *fd_p = -1;
+    for (ai = res; (ai != NULL) && (*fd_p < 0); ai = ai->ai_next) {
+        *fd_p = ucp_sockaddr_try(ai->ai_family, ai->ai_addr, ai->ai_addrlen,
+                                 is_listen);
+    }
+    freeaddrinfo(res);
+
+    if (*fd_p < 0) {
+        ucs_error("failed to %s on '%s': %m", is_listen ? "listen" : "connect",
+                  sockaddr);
+        return is_listen ? UCS_ERR_IO_ERROR : UCS_ERR_UNREACHABLE;
+    }
+
+    return UCS_OK;
+}
+
+/**
+ * Open a socket on an address string, which is either "unix:<path>" or
+ * "<host>:<port>".
+ */
+static ucs_status_t ucp_sockaddr_open(const char *sockaddr, int is_listen,
+                                      int *fd_p)
+{
+    if (!strncmp(sockaddr, UCP_SOCKADDR_UNIX_PREFIX,
+                 UCP_SOCKADDR_UNIX_PREFIX_LEN)) {
+        return ucp_sockaddr_open_unix(sockaddr + UCP_SOCKADDR_UNIX_PREFIX_LEN,
+                                      is_listen, fd_p);
+    } else {
+        return ucp_sockaddr_open_inet(sockaddr, is_listen, fd_p);
+    }
+}
+
+static ucs_status_t ucp_sockaddr_set_timeout(int fd)
+{
+    struct timeval tv;
+
+    tv.tv_sec  = UCP_SOCKADDR_IO_TIMEOUT_SEC;
+    tv.tv_usec = 0;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv))) {
+        ucs_error("failed to set socket timeout: %m");
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return UCS_OK;
+}
+
+/**
+ * Send or receive the rest of a buffer, until the socket would block.
+ *
+ * @return UCS_OK if done, UCS_INPROGRESS if the socket would block, or
+ *         UCS_ERR_IO_ERROR with errno set.
+ */
+static ucs_status_t ucp_sockaddr_io_nb(int fd, void *buffer, size_t length,
+                                       size_t *offset_p, int is_send)
+{
+    ssize_t ret;
+
+    while (*offset_p < length) {
+        if (is_send) {
+            ret = send(fd, buffer + *offset_p, length - *offset_p, MSG_NOSIGNAL);
+        } else {
+            ret = recv(fd, buffer + *offset_p, length - *offset_p, 0);
+        }
+
+        if (ret > 0) {
+            *offset_p += ret;
+        } else if (ret == 0) {
+            errno = ECONNRESET;
+            return UCS_ERR_IO_ERROR;
+        } else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            return UCS_INPROGRESS;
+        } else if (errno != EINTR) {
+            return UCS_ERR_IO_ERROR;
+        }
+    }
+
+    return UCS_OK;
+}
+
+/* Send or receive a buffer on a socket with a timeout */
+static ucs_status_t ucp_sockaddr_io(int fd, void *buffer, size_t length,
+                                    int is_send)
+{
+    ucs_status_t status;
+    size_t offset;
+
+    offset = 0;
+    status = ucp_sockaddr_io_nb(fd, buffer, length, &offset, is_send);
+    if (status == UCS_INPROGRESS) {
+        ucs_error("timed out to %s worker address", is_send ? "send" : "receive");
+        return UCS_ERR_TIMED_OUT;
+    } else if (status != UCS_OK) {
+        ucs_error("failed to %s worker address: %m", is_send ? "send" : "receive");
+    }
+
+    return status;
+}
+
+/* Send a worker address, preceded by its length */
+static ucs_status_t ucp_sockaddr_send_address(int fd, ucp_address_t *address,
+                                              size_t length)
+{
+    uint32_t length32 = length;
+    ucs_status_t status;
+
+    status = ucp_sockaddr_io(fd, &length32, sizeof(length32), 1);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    return ucp_sockaddr_io(fd, address, length, 1);
+}
+
+static ucs_status_t ucp_sockaddr_recv_address(int fd, ucp_address_t **address_p)
+{
+    ucp_address_t *address;
+    ucs_status_t status;
+    uint32_t length;
+
+    status = ucp_sockaddr_io(fd, &length, sizeof(length), 0);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    if ((length == 0) || (length > UCP_SOCKADDR_ADDRESS_MAX)) {
+        ucs_error("invalid worker address length: %u", length);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    address = ucs_malloc(length, "ucp_sockaddr_address");
+    if (address == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    status = ucp_sockaddr_io(fd, address, length, 0);
+    if (status != UCS_OK) {
+        ucs_free(address);
+        return status;
+    }
+
+    *address_p = address;
+    return UCS_OK;
+}
+
+/* Remove a client from the connections list, and close its socket */
+static void ucp_listener_conn_close(ucp_listener_t *listener,
+                                    ucp_listener_conn_t *conn)
+{
+    ucs_list_del(&conn->list);
+    epoll_ctl(listener->epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+}
+
+static void ucp_listener_conn_drop(ucp_listener_t *listener,
+                                   ucp_listener_conn_t *conn)
+{
+    ucp_listener_conn_close(listener, conn);
+    ucs_free(conn->address);
+    ucs_free(conn);
+}
+
+/**
+ * Advance the address exchange with a client as far as its socket allows.
+ *
+ * @return UCS_OK if done, UCS_INPROGRESS if the socket would block, or error.
+ */
+static ucs_status_t ucp_listener_conn_progress(ucp_listener_t *listener,
+                                               ucp_listener_conn_t *conn)
+{
+    struct epoll_event event;
+    ucs_status_t status;
+
+    switch (conn->state) {
+    case UCP_LISTENER_CONN_RECV_LENGTH:
+        status = ucp_sockaddr_io_nb(conn->fd, &conn->length,
+                                    sizeof(conn->length), &conn->offset, 0);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        if ((conn->length == 0) || (conn->length > UCP_SOCKADDR_ADDRESS_MAX)) {
+            ucs_debug("listener %p: invalid worker address length %u from fd %d",
+                      listener, conn->length, conn->fd);
+            return UCS_ERR_INVALID_PARAM;
+        }
+
+        conn->address = ucs_malloc(conn->length, "ucp_sockaddr_address");
+        if (conn->address == NULL) {
+            return UCS_ERR_NO_MEMORY;
+        }
+
+        conn->state  = UCP_LISTENER_CONN_RECV_ADDRESS;
+        conn->offset = 0;
+        /* fall through */
+    case UCP_LISTENER_CONN_RECV_ADDRESS:
+        status = ucp_sockaddr_io_nb(conn->fd, conn->address, conn->length,
+                                    &conn->offset, 0);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        conn->state  = UCP_LISTENER_CONN_SEND_REPLY;
+        conn->offset = 0;
+        /* fall through */
+    case UCP_LISTENER_CONN_SEND_REPLY:
+        status = ucp_sockaddr_io_nb(conn->fd, listener->reply,
+                                    listener->reply_length, &conn->offset, 1);
+        if (status != UCS_INPROGRESS) {
+            return status;
+        }
+
+        /* Continue when the socket is writable */
+        memset(&event, 0, sizeof(event));
+        event.events   = EPOLLOUT;
+        event.data.ptr = conn;
+        if (epoll_ctl(listener->epfd, EPOLL_CTL_MOD, conn->fd, &event) < 0) {
+            return UCS_ERR_IO_ERROR;
+        }
+        return UCS_INPROGRESS;
+    default:
+        ucs_fatal("invalid listener connection state %d", conn->state);
+    }
+}
+
+/* Queue the client once the addresses are exchanged, or drop it on error */
+static void ucp_listener_conn_handle(ucp_listener_t *listener,
+                                     ucp_listener_conn_t *conn)
+{
+    ucs_status_t status;
+
+    status = ucp_listener_conn_progress(listener, conn);
+    if (status == UCS_INPROGRESS) {
+        return;
+    } else if (status != UCS_OK) {
+        ucs_debug("listener %p: dropping client on fd %d: %s", listener,
+                  conn->fd, ucs_status_string(status));
+        ucp_listener_conn_drop(listener, conn);
+        return;
+    }
+
+    ucp_listener_conn_close(listener, conn);
+    ucs_queue_push(&listener->pending, &conn->queue);
+}
+
+static void ucp_listener_accept_conn(ucp_listener_t *listener, int fd)
+{
+    struct epoll_event event;
+    ucp_listener_conn_t *conn;
+
+    if (ucs_sys_fcntl_modfl(fd, O_NONBLOCK, 0) != UCS_OK) {
+        goto err_close;
+    }
+
+    conn = ucs_malloc(sizeof(*conn), "ucp_listener_conn");
+    if (conn == NULL) {
+        ucs_error("failed to allocate listener connection");
+        goto err_close;
+    }
+
+    conn->fd       = fd;
+    conn->state    = UCP_LISTENER_CONN_RECV_LENGTH;
+    conn->offset   = 0;
+    conn->address  = NULL;
+    conn->deadline = ucs_get_time() +
+                     ucs_time_from_sec(UCP_SOCKADDR_IO_TIMEOUT_SEC);
+
+    memset(&event, 0, sizeof(event));
+    event.events   = EPOLLIN;
+    event.data.ptr = conn;
+    if (epoll_ctl(listener->epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        ucs_error("epoll_ctl(ADD, fd=%d) failed: %m", fd);
+        goto err_free;
+    }
+
+    ucs_list_add_tail(&listener->conns, &conn->list);
+    return;
+
+err_free:
+    ucs_free(conn);
+err_close:
+    close(fd);
+}
+
+static void ucp_listener_accept(ucp_listener_t *listener)
+{
+    int fd;
+
+    for (;;) {
+        fd = accept(listener->fd, NULL, NULL);
+        if (fd >= 0) {
+            ucp_listener_accept_conn(listener, fd);
+        } else if (errno != EINTR) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                ucs_error("failed to accept connection: %m");
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * Called from the async context when the listening socket or a client socket
+ * is ready. Handlers of other sockets cannot be added from an async handler,
+ * so all sockets of the listener are watched by its own epoll set.
+ */
+static void ucp_listener_event_handler(void *arg)
+{
+    ucp_listener_t *listener = arg;
+    struct epoll_event events[UCP_LISTENER_MAX_EVENTS];
+    int i, nready;
+
+    nready = epoll_wait(listener->epfd, events, UCP_LISTENER_MAX_EVENTS, 0);
+    if ((nready < 0) && (errno != EINTR)) {
+        ucs_error("epoll_wait(epfd=%d) failed: %m", listener->epfd);
+        return;
+    }
+
+    for (i = 0; i < nready; ++i) {
+        if (events[i].data.ptr == NULL) {
+            ucp_listener_accept(listener);
+        } else {
+            ucp_listener_conn_handle(listener, events[i].data.ptr);
+        }
+    }
+}
+
+/* Drop the clients which did not complete the address exchange in time */
+static void ucp_listener_timer_handler(void *arg)
+{
+    ucp_listener_t *listener = arg;
+    ucp_listener_conn_t *conn, *tmp;
+    ucs_time_t now;
+
+    now = ucs_get_time();
+    ucs_list_for_each_safe(conn, tmp, &listener->conns, list) {
+        if (now >= conn->deadline) {
+            ucs_debug("listener %p: client on fd %d timed out", listener,
+                      conn->fd);
+            ucp_listener_conn_drop(listener, conn);
+        }
+    }
+}
+
+/*
+ * Create the endpoints from the progress, since the worker lock must not be
+ * taken from the async context.
+ */
+static void ucp_listener_progress(void *arg)
+{
+    ucp_listener_t *listener = arg;
+    ucp_worker_h worker      = listener->worker;
+    ucp_listener_conn_t *conn;
+    ucs_status_t status;
+    ucp_ep_h ep;
+
+    if (ucs_likely(ucs_queue_is_empty(&listener->pending))) {
+        return;
+    }
+
+    UCS_ASYNC_BLOCK(&worker->async);
+    conn = ucs_queue_pull_elem_non_empty(&listener->pending, ucp_listener_conn_t,
+                                         queue);
+    UCS_ASYNC_UNBLOCK(&worker->async);
+
+    status = ucp_ep_create(worker, conn->address, &ep);
+    if (status == UCS_OK) {
+        ucs_debug("listener %p accepted ep %p", listener, ep);
+        listener->accept_cb(ep, listener->arg);
+    } else {
+        ucs_error("failed to create endpoint to accepted client: %s",
+                  ucs_status_string(status));
+    }
+
+    ucs_free(conn->address);
+    ucs_free(conn);
+}
+
+ucs_status_t ucp_listener_create(ucp_worker_h worker, const char *sockaddr,
+                                 ucp_listener_accept_callback_t accept_cb,
+                                 void *arg, ucp_listener_h *listener_p)
+{
+    struct epoll_event event;
+    ucp_listener_t *listener;
+    ucp_address_t *address;
+    size_t address_length;
+    ucs_status_t status;
+
+    listener = ucs_calloc(1, sizeof(*listener), "ucp_listener");
+    if (listener == NULL) {
+        status = UCS_ERR_NO_MEMORY;
+        goto err;
+    }
+
+    listener->worker    = worker;
+    listener->accept_cb = accept_cb;
+    listener->arg       = arg;
+    ucs_list_head_init(&listener->conns);
+    ucs_queue_head_init(&listener->pending);
+
+    status = ucp_worker_get_address(worker, &address, &address_length);
+    if (status != UCS_OK) {
+        goto err_free;
+    }
+
+    /* Every client gets the same reply */
+    listener->reply_length = sizeof(uint32_t) + address_length;
+    listener->reply        = ucs_malloc(listener->reply_length,
+                                        "ucp_listener_reply");
+    if (listener->reply == NULL) {
+        ucp_worker_release_address(worker, address);
+        status = UCS_ERR_NO_MEMORY;
+        goto err_free;
+    }
+
+    *(uint32_t*)listener->reply = address_length;
+    memcpy(listener->reply + sizeof(uint32_t), address, address_length);
+    ucp_worker_release_address(worker, address);
+
+    status = ucp_sockaddr_open(sockaddr, 1, &listener->fd);
+    if (status != UCS_OK) {
+        goto err_free_reply;
+    }
+
+    if (!strncmp(sockaddr, UCP_SOCKADDR_UNIX_PREFIX,
+                 UCP_SOCKADDR_UNIX_PREFIX_LEN)) {
+        strncpy(listener->unix_path, sockaddr + UCP_SOCKADDR_UNIX_PREFIX_LEN,
+                sizeof(listener->unix_path) - 1);
+    }
+
+    status = ucs_sys_fcntl_modfl(listener->fd, O_NONBLOCK, 0);
+    if (status != UCS_OK) {
+        goto err_close;
+    }
+
+    listener->epfd = epoll_create(1);
+    if (listener->epfd < 0) {
+        ucs_error("epoll_create() failed: %m");
+        status = UCS_ERR_IO_ERROR;
+        goto err_close;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events   = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epoll_ctl(listener->epfd, EPOLL_CTL_ADD, listener->fd, &event) < 0) {
+        ucs_error("epoll_ctl(ADD, fd=%d) failed: %m", listener->fd);
+        status = UCS_ERR_IO_ERROR;
+        goto err_close_epfd;
+    }
+
+    status = ucs_async_add_timer(worker->async.mode,
+                                 ucs_time_from_sec(UCP_SOCKADDR_IO_TIMEOUT_SEC),
+                                 ucp_listener_timer_handler, listener,
+                                 &worker->async, &listener->timer_id);
+    if (status != UCS_OK) {
+        goto err_close_epfd;
+    }
+
+    status = ucs_async_set_event_handler(worker->async.mode, listener->epfd,
+                                         POLLIN, ucp_listener_event_handler,
+                                         listener, &worker->async);
+    if (status != UCS_OK) {
+        goto err_remove_timer;
+    }
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+    uct_worker_progress_register(worker->uct, ucp_listener_progress, listener);
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+
+    ucs_debug("worker %p listening on %s, listener %p", worker, sockaddr,
+              listener);
+    *listener_p = listener;
+    return UCS_OK;
+
+err_remove_timer:
+    ucs_async_remove_timer(listener->timer_id);
+err_close_epfd:
+    close(listener->epfd);
+err_close:
+    close(listener->fd);
+    if (listener->unix_path[0] != '\0') {
+        unlink(listener->unix_path);
+    }
+err_free_reply:
+    ucs_free(listener->reply);
+err_free:
+    ucs_free(listener);
+err:
+    return status;
+}
+
+void ucp_listener_destroy(ucp_listener_h listener)
+{
+    ucp_worker_h worker = listener->worker;
+    ucp_listener_conn_t *conn, *tmp;
+
+    ucs_debug("destroying listener %p", listener);
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+    uct_worker_progress_unregister(worker->uct, ucp_listener_progress, listener);
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+
+    ucs_async_unset_event_handler(listener->epfd);
+    ucs_async_remove_timer(listener->timer_id);
+
+    /* Clients which did not complete the address exchange */
+    ucs_list_for_each_safe(conn, tmp, &listener->conns, list) {
+        ucp_listener_conn_drop(listener, conn);
+    }
+
+    close(listener->epfd);
+    close(listener->fd);
+    if (listener->unix_path[0] != '\0') {
+        unlink(listener->unix_path);
+    }
+
+    /* Clients which did not get an endpoint yet */
+    while (!ucs_queue_is_empty(&listener->pending)) {
+        conn = ucs_queue_pull_elem_non_empty(&listener->pending,
+                                             ucp_listener_conn_t, queue);
+        ucs_free(conn->address);
+        ucs_free(conn);
+    }
+
+    ucs_free(listener->reply);
+    ucs_free(listener);
+}
+
+ucs_status_t ucp_listener_get_sockaddr(ucp_listener_h listener, char *buf,
+                                       size_t max)
+{
+    char host[NI_MAXHOST], port[NI_MAXSERV];
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    int ret;
+
+    addrlen = sizeof(addr);
+    if (getsockname(listener->fd, (struct sockaddr*)&addr, &addrlen) < 0) {
+        ucs_error("getsockname() failed: %m");
+        return UCS_ERR_IO_ERROR;
+    }
+
+    if (addr.ss_family == AF_UNIX) {
+        ret = snprintf(buf, max, "%s%s", UCP_SOCKADDR_UNIX_PREFIX,
+                       listener->unix_path);
+    } else {
+        ret = getnameinfo((struct sockaddr*)&addr, addrlen, host, sizeof(host),
+                          port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+        if (ret != 0) {
+            ucs_error("getnameinfo() failed: %s", gai_strerror(ret));
+            return UCS_ERR_IO_ERROR;
+        }
+
+        ret = snprintf(buf, max, (addr.ss_family == AF_INET6) ? "[%s]:%s" :
+                       "%s:%s", host, port);
+    }
+
+    return ((ret >= 0) && (ret < max)) ? UCS_OK : UCS_ERR_BUFFER_TOO_SMALL;
+}
+
+ucs_status_t ucp_ep_create_sockaddr(ucp_worker_h worker, const char *sockaddr,
+                                    ucp_ep_h *ep_p)
+{
+    ucp_address_t *address, *remote_address;
+    size_t address_length;
+    ucs_status_t status;
+    int fd;
+
+    status = ucp_sockaddr_open(sockaddr, 0, &fd);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    status = ucp_sockaddr_set_timeout(fd);
+    if (status != UCS_OK) {
+        goto out_close;
+    }
+
+    status = ucp_worker_get_address(worker, &address, &address_length);
+    if (status != UCS_OK) {
+        goto out_close;
+    }
+
+    status = ucp_sockaddr_send_address(fd, address, address_length);
+    ucp_worker_release_address(worker, address);
+    if (status != UCS_OK) {
+        goto out_close;
+    }
+
+    /* The listener replies from its async context */
+    status = ucp_sockaddr_recv_address(fd, &remote_address);
+    if (status != UCS_OK) {
+        goto out_close;
+    }
+
+    status = ucp_ep_create(worker, remote_address, ep_p);
+    ucs_free(remote_address);
+
+out_close:
+    close(fd);
+    return status;
+}
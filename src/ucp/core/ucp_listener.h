@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) Mellanox Technologies Ltd. 2001-2016.  ALL RIGHTS RESERVED.
+ *
+ * See file LICENSE for terms.
+ */
+
+
+#ifndef UCP_LISTENER_H_
+#define UCP_LISTENER_H_
+
+#include <ucp/api/ucp.h>
+#include <ucs/datastruct/list.h>
+#include <ucs/datastruct/queue_types.h>
+#include <ucs/time/time.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/* Prefix of a Unix domain socket address, followed by the path */
+#define UCP_SOCKADDR_UNIX_PREFIX     "unix:"
+#define UCP_SOCKADDR_UNIX_PREFIX_LEN (sizeof(UCP_SOCKADDR_UNIX_PREFIX) - 1)
+
+/* Maximal length of a socket address string */
+#define UCP_SOCKADDR_STRING_MAX      (sizeof(UCP_SOCKADDR_UNIX_PREFIX) + \
+                                      sizeof(((struct sockaddr_un*)0)->sun_path))
+
+/* Timeout of sending or receiving a worker address on a socket */
+#define UCP_SOCKADDR_IO_TIMEOUT_SEC  5
+
+
+/**
+ * Listener, which exchanges worker addresses with every connecting client.
+ * Connections are accepted and replied to from the async context, so a client
+ * does not depend on the progress of the listening worker. The sockets are
+ * non-blocking, and are watched by an epoll set of the listener, so a slow
+ * client does not hold back the others. Endpoints to the clients are created
+ * from the progress of the worker.
+ */
+typedef struct ucp_listener {
+    ucp_worker_h                   worker;         /* Worker to create endpoints on */
+    int                            fd;             /* Listening socket */
+    int                            epfd;           /* Listening and connected sockets */
+    int                            timer_id;       /* Timer to drop stalled clients */
+    ucp_listener_accept_callback_t accept_cb;      /* Callback for new endpoints */
+    void                           *arg;           /* User argument for the callback */
+    void                           *reply;         /* Worker address, preceded by
+                                                      its length, sent to clients */
+    size_t                         reply_length;   /* Length of the reply */
+    ucs_list_link_t                conns;          /* Clients exchanging addresses */
+    ucs_queue_head_t               pending;        /* Clients which have no endpoint yet */
+    char                           unix_path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+                                                   /* Path to remove, for Unix sockets */
+} ucp_listener_t;
+
+
+/**
+ * State of a client connection, in the order of the address exchange.
+ */
+typedef enum {
+    UCP_LISTENER_CONN_RECV_LENGTH,                 /* Receiving the address length */
+    UCP_LISTENER_CONN_RECV_ADDRESS,                /* Receiving the address */
+    UCP_LISTENER_CONN_SEND_REPLY                   /* Sending the listener address */
+} ucp_listener_conn_state_t;
+
+
+/**
+ * Client which connected to a listener. It is on the connections list while
+ * the addresses are exchanged, and then waits for its endpoint on the pending
+ * queue.
+ */
+typedef struct ucp_listener_conn {
+    union {
+        ucs_list_link_t            list;           /* Entry in the connections list */
+        ucs_queue_elem_t           queue;          /* Entry in the pending queue */
+    };
+    int                            fd;             /* Connected socket */
+    ucp_listener_conn_state_t      state;          /* Address exchange state */
+    size_t                         offset;         /* Bytes done in the current state */
+    uint32_t                       length;         /* Worker address length of the client */
+    ucp_address_t                  *address;       /* Worker address of the client */
+    ucs_time_t                     deadline;       /* Time to drop the client */
+} ucp_listener_conn_t;
+
+
+#endif
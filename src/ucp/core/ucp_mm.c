@@ -6,6 +6,8 @@
 
 #include "ucp_mm.h"
 
+#include <ucs/arch/atomic.h>
+#include <ucs/arch/cpu.h>
 #include <ucs/debug/log.h>
 #include <ucs/debug/memtrack.h>
 
@@ -13,11 +15,34 @@
 #include <inttypes.h>
 
 
+/**
+ * Memory arena: a large registered buffer, which small allocations are carved
+ * out of. Regions are never returned to the arena, but kept on a free list of
+ * their size class for reuse.
+ */
+typedef struct ucp_mem_arena {
+    ucs_list_link_t               list;         /* Entry in the context list */
+    ucp_mem_h                     memh;         /* Registered arena buffer */
+    size_t                        offset;       /* Size of the carved part */
+} ucp_mem_arena_t;
+
+
+/**
+ * Header of a free region, kept on the free list of its size class.
+ */
+typedef struct ucp_mem_arena_region {
+    struct ucp_mem_arena_region   *next;        /* Next free region */
+    ucp_mem_h                     arena_memh;   /* Arena of the region */
+} ucp_mem_arena_region_t;
+
+
 static ucp_mem_t ucp_mem_dummy_handle = {
     .address      = NULL,
     .length       = 0,
     .alloc_method = UCT_ALLOC_METHOD_LAST,
     .alloc_md     = NULL,
+    .arena_memh   = NULL,
+    .reg_status   = UCS_OK,
     .md_map       = 0
 };
 
@@ -103,6 +128,322 @@ static ucs_status_t ucp_memh_reg_mds(ucp_context_h context, ucp_mem_h memh,
     return UCS_OK;
 }
 
+/**
+ * Register the memory in chunks, on all MDs which support registration, and
+ * publish every chunk as soon as it's registered on all of them. Then, a handle
+ * for the whole region is published for every MD, which remote keys require.
+ * Runs on the registration thread, while the memory handle may already be used
+ * with the chunks and the MDs which were registered so far. The registration
+ * may be canceled between any two uct registrations.
+ */
+static ucs_status_t ucp_memh_reg_mds_progress(ucp_context_h context,
+                                              ucp_mem_h memh)
+{
+    unsigned chunk, md_index, uct_memh_count;
+    size_t offset, length;
+    uct_mem_h *chunk_memh;
+    ucs_status_t status;
+
+    uct_memh_count = 0;
+    for (chunk = 0; chunk < memh->reg_num_chunks; ++chunk) {
+        offset = chunk * memh->reg_chunk;
+        length = ucs_min(memh->reg_chunk, memh->length - offset);
+
+        for (md_index = 0; md_index < context->num_mds; ++md_index) {
+            if (!(context->md_attrs[md_index].cap.flags & UCT_MD_FLAG_REG)) {
+                continue;
+            }
+
+            if (memh->reg_cancel) {
+                return UCS_ERR_CANCELED;
+            }
+
+            chunk_memh = &memh->reg_chunks[(chunk * context->num_mds) + md_index];
+            status     = uct_md_mem_reg(context->mds[md_index],
+                                        memh->address + offset, length,
+                                        memh->reg_flags, chunk_memh);
+            if (status != UCS_OK) {
+                goto err;
+            }
+
+            ++memh->reg_num_handles;
+            if (memh->reg_num_chunks == 1) {
+                /* The chunk is the whole region. The handle must be visible
+                 * before the MD is marked as registered. */
+                memh->uct[uct_memh_count++] = *chunk_memh;
+                ucs_memory_cpu_store_fence();
+                memh->md_map |= UCS_BIT(md_index);
+            }
+        }
+
+        /* The chunk handles must be visible before the length is advanced */
+        ucs_memory_cpu_store_fence();
+        memh->reg_length = offset + length;
+    }
+
+    if (memh->reg_num_chunks == 1) {
+        return UCS_OK;
+    }
+
+    offset = 0;
+    length = memh->length;
+    for (md_index = 0; md_index < context->num_mds; ++md_index) {
+        if (!(context->md_attrs[md_index].cap.flags & UCT_MD_FLAG_REG)) {
+            continue;
+        }
+
+        if (memh->reg_cancel) {
+            return UCS_ERR_CANCELED;
+        }
+
+        status = uct_md_mem_reg(context->mds[md_index], memh->address,
+                                memh->length, memh->reg_flags,
+                                &memh->uct[uct_memh_count]);
+        if (status != UCS_OK) {
+            goto err;
+        }
+
+        ucs_memory_cpu_store_fence();
+        memh->md_map |= UCS_BIT(md_index);
+        ++uct_memh_count;
+    }
+    return UCS_OK;
+
+err:
+    ucs_debug("failed to register address %p length %zu on md %s: %s",
+              memh->address + offset, length,
+              context->md_rscs[md_index].md_name, ucs_status_string(status));
+    return status;
+}
+
+/* Release the chunk handles which were registered in the background */
+static void ucp_memh_dereg_chunks(ucp_context_h context, ucp_mem_h memh)
+{
+    unsigned chunk, md_index, count;
+
+    count = 0;
+    for (chunk = 0; chunk < memh->reg_num_chunks; ++chunk) {
+        for (md_index = 0; md_index < context->num_mds; ++md_index) {
+            if (!(context->md_attrs[md_index].cap.flags & UCT_MD_FLAG_REG)) {
+                continue;
+            }
+
+            if (count++ == memh->reg_num_handles) {
+                return;
+            }
+
+            uct_md_mem_dereg(context->mds[md_index],
+                             memh->reg_chunks[(chunk * context->num_mds) +
+                                              md_index]);
+        }
+    }
+}
+
+static void *ucp_mem_reg_thread_func(void *arg)
+{
+    ucp_context_h context = arg;
+    ucs_status_t status;
+    ucp_mem_h memh;
+
+    pthread_mutex_lock(&context->mem_reg.lock);
+    for (;;) {
+        while (ucs_list_is_empty(&context->mem_reg.queue) &&
+               !context->mem_reg.stop) {
+            pthread_cond_wait(&context->mem_reg.cond, &context->mem_reg.lock);
+        }
+
+        /* Pending handles are registered before exiting */
+        if (ucs_list_is_empty(&context->mem_reg.queue)) {
+            break;
+        }
+
+        memh = ucs_list_extract_head(&context->mem_reg.queue, ucp_mem_t,
+                                     reg_list);
+        ucs_list_head_init(&memh->reg_list);
+        pthread_mutex_unlock(&context->mem_reg.lock);
+
+        status = ucp_memh_reg_mds_progress(context, memh);
+        ucs_debug("background registration of %p length %zu memh %p "
+                  "md_map 0x%x: %s", memh->address, memh->length, memh,
+                  memh->md_map, ucs_status_string(status));
+
+        pthread_mutex_lock(&context->mem_reg.lock);
+        memh->reg_status = status;
+        pthread_cond_broadcast(&context->mem_reg.cond);
+    }
+    pthread_mutex_unlock(&context->mem_reg.lock);
+    return NULL;
+}
+
+ucs_status_t ucp_mem_reg_init(ucp_context_h context)
+{
+    int ret;
+
+    ret = pthread_mutex_init(&context->mem_reg.lock, NULL);
+    if (ret != 0) {
+        ucs_error("failed to initialize mutex: %s", strerror(ret));
+        return UCS_ERR_IO_ERROR;
+    }
+
+    ret = pthread_cond_init(&context->mem_reg.cond, NULL);
+    if (ret != 0) {
+        ucs_error("failed to initialize condition: %s", strerror(ret));
+        pthread_mutex_destroy(&context->mem_reg.lock);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    ucs_list_head_init(&context->mem_reg.queue);
+    ucs_list_head_init(&context->mem_reg.memhs);
+    context->mem_reg.num_memhs      = 0;
+    context->mem_reg.thread_started = 0;
+    context->mem_reg.stop           = 0;
+    return UCS_OK;
+}
+
+void ucp_mem_reg_cleanup(ucp_context_h context)
+{
+    pthread_mutex_lock(&context->mem_reg.lock);
+    context->mem_reg.stop = 1;
+    pthread_cond_broadcast(&context->mem_reg.cond);
+    pthread_mutex_unlock(&context->mem_reg.lock);
+
+    if (context->mem_reg.thread_started) {
+        pthread_join(context->mem_reg.thread, NULL);
+    }
+
+    pthread_cond_destroy(&context->mem_reg.cond);
+    pthread_mutex_destroy(&context->mem_reg.lock);
+}
+
+/* Split the memory handle to registration chunks */
+static ucs_status_t ucp_mem_reg_chunks_init(ucp_context_h context,
+                                            ucp_mem_h memh)
+{
+    size_t chunk = context->config.ext.mem_reg_chunk;
+
+    if ((chunk == 0) || (chunk >= memh->length)) {
+        memh->reg_chunk      = memh->length;
+        memh->reg_num_chunks = 1;
+    } else {
+        memh->reg_chunk      = chunk;
+        memh->reg_num_chunks = ucs_div_round_up(memh->length, chunk);
+    }
+
+    memh->reg_num_handles = 0;
+    memh->reg_length      = 0;
+    memh->reg_chunks      = ucs_calloc(memh->reg_num_chunks * context->num_mds,
+                                       sizeof(*memh->reg_chunks),
+                                       "ucp_memh_chunks");
+    if (memh->reg_chunks == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    return UCS_OK;
+}
+
+/* Queue the memory handle for registration, and start the thread if needed */
+static ucs_status_t ucp_mem_reg_start(ucp_context_h context, ucp_mem_h memh)
+{
+    int ret;
+
+    pthread_mutex_lock(&context->mem_reg.lock);
+
+    if (!context->mem_reg.thread_started) {
+        ret = pthread_create(&context->mem_reg.thread, NULL,
+                             ucp_mem_reg_thread_func, context);
+        if (ret != 0) {
+            pthread_mutex_unlock(&context->mem_reg.lock);
+            ucs_error("failed to create memory registration thread: %s",
+                      strerror(ret));
+            return UCS_ERR_IO_ERROR;
+        }
+        context->mem_reg.thread_started = 1;
+    }
+
+    memh->reg_status   = UCS_INPROGRESS;
+    memh->reg_refcount = 1;
+    ucs_list_add_tail(&context->mem_reg.queue, &memh->reg_list);
+    ucs_list_add_tail(&context->mem_reg.memhs, &memh->reg_memhs);
+    ++context->mem_reg.num_memhs;
+    pthread_cond_broadcast(&context->mem_reg.cond);
+
+    pthread_mutex_unlock(&context->mem_reg.lock);
+    return UCS_OK;
+}
+
+/* Stop the background registration, wait until the thread leaves memh, and
+ * release what was registered. Called when the last reference is released. */
+static ucs_status_t ucp_mem_reg_release(ucp_context_h context, ucp_mem_h memh)
+{
+    uct_mem_h dummy_md_memh;
+    ucs_status_t status;
+
+    pthread_mutex_lock(&context->mem_reg.lock);
+
+    if (memh->reg_status == UCS_INPROGRESS) {
+        memh->reg_cancel = 1;
+        if (!ucs_list_is_empty(&memh->reg_list)) {
+            /* Not started yet */
+            ucs_list_del(&memh->reg_list);
+            memh->reg_status = UCS_ERR_CANCELED;
+        }
+
+        while (memh->reg_status == UCS_INPROGRESS) {
+            pthread_cond_wait(&context->mem_reg.cond, &context->mem_reg.lock);
+        }
+    }
+
+    pthread_mutex_unlock(&context->mem_reg.lock);
+
+    /* A single chunk is also the handle of the whole region */
+    status = UCS_OK;
+    if (memh->reg_num_chunks > 1) {
+        status = ucp_memh_dereg_mds(context, memh, &dummy_md_memh);
+    }
+    ucp_memh_dereg_chunks(context, memh);
+    ucs_free(memh->reg_chunks);
+    return status;
+}
+
+/* Find a handle mapped in the background which covers the given range, and
+ * take a reference to it, which must be released by ucp_mem_reg_put() */
+ucp_mem_h ucp_mem_reg_find(ucp_context_h context, const void *address,
+                           size_t length)
+{
+    ucp_mem_h memh;
+
+    if (context->mem_reg.num_memhs == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&context->mem_reg.lock);
+    ucs_list_for_each(memh, &context->mem_reg.memhs, reg_memhs) {
+        if ((address >= memh->address) &&
+            (address + length <= memh->address + memh->length))
+        {
+            ucs_atomic_add32(&memh->reg_refcount, 1);
+            goto out;
+        }
+    }
+    memh = NULL;
+out:
+    pthread_mutex_unlock(&context->mem_reg.lock);
+    return memh;
+}
+
+ucs_status_t ucp_mem_reg_put(ucp_context_h context, ucp_mem_h memh)
+{
+    ucs_status_t status;
+
+    if (ucs_atomic_fadd32(&memh->reg_refcount, -1) > 1) {
+        return UCS_OK;
+    }
+
+    status = ucp_mem_reg_release(context, memh);
+    ucs_free(memh);
+    return status;
+}
+
 /**
  * @return Whether MD number 'md_index' is selected by the configuration as part
  *         of allocation method number 'config_method_index'.
@@ -165,6 +506,7 @@ allocated:
     memh->length       = mem.length;
     memh->alloc_method = mem.method;
     memh->alloc_md     = mem.md;
+    memh->arena_memh   = NULL;
     status = ucp_memh_reg_mds(context, memh, uct_flags, mem.memh);
     if (status != UCS_OK) {
         uct_mem_free(&mem);
@@ -174,6 +516,184 @@ out:
     return status;
 }
 
+static unsigned ucp_mem_arena_class(size_t length)
+{
+    if (length <= UCS_BIT(UCP_MEM_ARENA_MIN_SHIFT)) {
+        return 0;
+    }
+    return ucs_ilog2(length - 1) + 1 - UCP_MEM_ARENA_MIN_SHIFT;
+}
+
+ucs_status_t ucp_mem_arena_init(ucp_context_h context)
+{
+    size_t thresh = context->config.ext.mem_arena_thresh;
+    unsigned i;
+
+    ucs_list_head_init(&context->mem_arena.list);
+    for (i = 0; i < UCP_MEM_ARENA_MAX_CLASSES; ++i) {
+        context->mem_arena.free[i] = NULL;
+    }
+
+    if ((thresh == 0) || (thresh == UCS_CONFIG_MEMUNITS_AUTO)) {
+        context->mem_arena.max_class = 0;
+        context->config.ext.mem_arena_thresh = 0;
+        return UCS_OK;
+    }
+
+    /* Arenas should be allocated directly, and hold several of the largest
+     * regions */
+    context->mem_arena.max_class = ucs_min(ucp_mem_arena_class(thresh),
+                                           UCP_MEM_ARENA_MAX_CLASSES - 1);
+    thresh = ucs_min(UCS_BIT(context->mem_arena.max_class +
+                             UCP_MEM_ARENA_MIN_SHIFT),
+                     context->config.ext.mem_arena_size / 2);
+    context->config.ext.mem_arena_thresh = thresh;
+    if (thresh < UCS_BIT(UCP_MEM_ARENA_MIN_SHIFT)) {
+        ucs_error("memory arena size (%zu) is too small",
+                  context->config.ext.mem_arena_size);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    return ucs_spinlock_init(&context->mem_arena.lock);
+}
+
+void ucp_mem_arena_cleanup(ucp_context_h context)
+{
+    ucp_mem_arena_t *arena;
+
+    if (context->config.ext.mem_arena_thresh == 0) {
+        return;
+    }
+
+    while (!ucs_list_is_empty(&context->mem_arena.list)) {
+        arena = ucs_list_extract_head(&context->mem_arena.list, ucp_mem_arena_t,
+                                      list);
+        ucp_mem_unmap(context, arena->memh);
+        ucs_free(arena);
+    }
+    ucs_spinlock_destroy(&context->mem_arena.lock);
+}
+
+/* Allocate and register a new arena. Called without the arena lock, since it
+ * allocates and registers a large buffer. */
+static ucs_status_t ucp_mem_arena_create(ucp_context_h context,
+                                         ucp_mem_arena_t **arena_p)
+{
+    ucp_mem_arena_t *arena;
+    ucs_status_t status;
+    void *address;
+
+    arena = ucs_malloc(sizeof(*arena), "ucp_mem_arena");
+    if (arena == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    address = NULL;
+    status  = ucp_mem_map(context, &address, context->config.ext.mem_arena_size,
+                          0, &arena->memh);
+    if (status != UCS_OK) {
+        ucs_free(arena);
+        return status;
+    }
+
+    ucs_debug("allocated memory arena %p length %zu md_map 0x%x",
+              arena->memh->address, arena->memh->length, arena->memh->md_map);
+    arena->offset = 0;
+    *arena_p      = arena;
+    return UCS_OK;
+}
+
+static void ucp_mem_arena_destroy(ucp_context_h context, ucp_mem_arena_t *arena)
+{
+    ucp_mem_unmap(context, arena->memh);
+    ucs_free(arena);
+}
+
+/* Check whether the current arena has room for a region of the given size */
+static int ucp_mem_arena_has_room(ucp_context_h context, size_t size)
+{
+    return !ucs_list_is_empty(&context->mem_arena.list) &&
+           (ucs_list_head(&context->mem_arena.list, ucp_mem_arena_t, list)->offset +
+            size <= context->config.ext.mem_arena_size);
+}
+
+/* Carve a region out of a memory arena, and point memh to it */
+static ucs_status_t ucp_mem_arena_get(ucp_context_h context, size_t length,
+                                      ucp_mem_h memh)
+{
+    unsigned class_index = ucp_mem_arena_class(length);
+    size_t size          = UCS_BIT(class_index + UCP_MEM_ARENA_MIN_SHIFT);
+    ucp_mem_arena_region_t *region;
+    ucp_mem_arena_t *arena, *new_arena;
+    ucp_mem_h arena_memh;
+    ucs_status_t status;
+    void *address;
+
+    ucs_spin_lock(&context->mem_arena.lock);
+
+    for (;;) {
+        region = context->mem_arena.free[class_index];
+        if (region != NULL) {
+            context->mem_arena.free[class_index] = region->next;
+            address    = region;
+            arena_memh = region->arena_memh;
+            goto out;
+        }
+
+        if (ucp_mem_arena_has_room(context, size)) {
+            break;
+        }
+
+        /* Grow without the lock, so other threads can use the free lists */
+        ucs_spin_unlock(&context->mem_arena.lock);
+        status = ucp_mem_arena_create(context, &new_arena);
+        if (status != UCS_OK) {
+            return status;
+        }
+        ucs_spin_lock(&context->mem_arena.lock);
+
+        if (!ucp_mem_arena_has_room(context, size)) {
+            ucs_list_add_head(&context->mem_arena.list, &new_arena->list);
+            break;
+        }
+
+        /* Another thread has grown the arena meanwhile */
+        ucs_spin_unlock(&context->mem_arena.lock);
+        ucp_mem_arena_destroy(context, new_arena);
+        ucs_spin_lock(&context->mem_arena.lock);
+    }
+
+    arena          = ucs_list_head(&context->mem_arena.list, ucp_mem_arena_t, list);
+    arena_memh     = arena->memh;
+    address        = arena_memh->address + arena->offset;
+    arena->offset += size;
+
+out:
+    ucs_spin_unlock(&context->mem_arena.lock);
+
+    /* The region uses the registration of the whole arena */
+    memh->address      = address;
+    memh->length       = length;
+    memh->alloc_method = UCT_ALLOC_METHOD_LAST;
+    memh->alloc_md     = NULL;
+    memh->arena_memh   = arena_memh;
+    memh->md_map       = arena_memh->md_map;
+    memcpy(memh->uct, arena_memh->uct,
+           ucs_count_one_bits(memh->md_map) * sizeof(memh->uct[0]));
+    return UCS_OK;
+}
+
+static void ucp_mem_arena_put(ucp_context_h context, ucp_mem_h memh)
+{
+    unsigned class_index           = ucp_mem_arena_class(memh->length);
+    ucp_mem_arena_region_t *region = memh->address;
+
+    ucs_spin_lock(&context->mem_arena.lock);
+    region->next                         = context->mem_arena.free[class_index];
+    region->arena_memh                   = memh->arena_memh;
+    context->mem_arena.free[class_index] = region;
+    ucs_spin_unlock(&context->mem_arena.lock);
+}
 
 ucs_status_t ucp_mem_map(ucp_context_h context, void **address_p, size_t length,
                          unsigned flags, ucp_mem_h *memh_p)
@@ -197,24 +717,59 @@ ucs_status_t ucp_mem_map(ucp_context_h context, void **address_p, size_t length,
         goto err;
     }
 
+    memh->reg_status = UCS_OK;
+    memh->reg_cancel = 0;
+    memh->reg_chunks = NULL;
+
     uct_flags = 0;
     if (flags & UCP_MEM_MAP_NONBLOCK) {
         uct_flags |= UCT_MD_MEM_FLAG_NONBLOCK;
     }
 
-    if (*address_p == NULL) {
+    if ((*address_p == NULL) && (length <= context->config.ext.mem_arena_thresh)) {
+        status = ucp_mem_arena_get(context, length, memh);
+        if (status != UCS_OK) {
+            goto err_free_memh;
+        }
+
+        *address_p = memh->address;
+    } else if (*address_p == NULL) {
         status = ucp_mem_alloc(context, length, uct_flags, "user allocation", memh);
         if (status != UCS_OK) {
             goto err_free_memh;
         }
 
         *address_p = memh->address;
+    } else if (flags & UCP_MEM_MAP_ASYNC) {
+        memh->address      = *address_p;
+        memh->length       = length;
+        memh->alloc_method = UCT_ALLOC_METHOD_LAST;
+        memh->alloc_md     = NULL;
+        memh->arena_memh   = NULL;
+        memh->reg_flags    = uct_flags;
+        memh->md_map       = 0;
+        status = ucp_mem_reg_chunks_init(context, memh);
+        if (status != UCS_OK) {
+            goto err_free_memh;
+        }
+
+        status = ucp_mem_reg_start(context, memh);
+        if (status != UCS_OK) {
+            ucs_free(memh->reg_chunks);
+            goto err_free_memh;
+        }
+
+        ucs_debug("registering user memory at %p length %zu memh %p in the "
+                  "background", memh->address, memh->length, memh);
+        *memh_p = memh;
+        return UCS_INPROGRESS;
     } else {
         ucs_debug("registering user memory at %p length %zu", *address_p, length);
         memh->address      = *address_p;
         memh->length       = length;
         memh->alloc_method = UCT_ALLOC_METHOD_LAST;
         memh->alloc_md     = NULL;
+        memh->arena_memh   = NULL;
         status = ucp_memh_reg_mds(context, memh, uct_flags, UCT_INVALID_MEM_HANDLE);
         if (status != UCS_OK) {
             goto err_free_memh;
@@ -222,6 +777,7 @@ ucs_status_t ucp_mem_map(ucp_context_h context, void **address_p, size_t length,
     }
 
     ucs_debug("%s buffer %p length %zu memh %p md_map 0x%x",
+              (memh->arena_memh != NULL) ? "carved" :
               (memh->alloc_method == UCT_ALLOC_METHOD_LAST) ? "mapped" : "allocated",
               memh->address, memh->length, memh, memh->md_map);
     *memh_p = memh;
@@ -233,6 +789,11 @@ err:
     return status;
 }
 
+ucs_status_t ucp_mem_map_test(ucp_context_h context, ucp_mem_h memh)
+{
+    return memh->reg_status;
+}
+
 ucs_status_t ucp_mem_unmap(ucp_context_h context, ucp_mem_h memh)
 {
     uct_allocated_memory_t mem;
@@ -244,6 +805,23 @@ ucs_status_t ucp_mem_unmap(ucp_context_h context, ucp_mem_h memh)
         return UCS_OK;
     }
 
+    /* Rendezvous requests which are using the handle keep it registered until
+     * they complete, but it can't be found by new requests */
+    if (memh->reg_chunks != NULL) {
+        pthread_mutex_lock(&context->mem_reg.lock);
+        ucs_list_del(&memh->reg_memhs);
+        --context->mem_reg.num_memhs;
+        pthread_mutex_unlock(&context->mem_reg.lock);
+        return ucp_mem_reg_put(context, memh);
+    }
+
+    /* Regions of an arena are kept registered for reuse */
+    if (memh->arena_memh != NULL) {
+        ucp_mem_arena_put(context, memh);
+        ucs_free(memh);
+        return UCS_OK;
+    }
+
     /* Unregister from all memory domains */
     status = ucp_memh_dereg_mds(context, memh, &alloc_md_memh);
     if (status != UCS_OK) {
@@ -9,23 +9,58 @@
 #define UCP_MM_H_
 
 #include <ucp/api/ucp_def.h>
+#include <ucp/core/ucp_context.h>
 #include <ucp/core/ucp_ep.h>
 #include <uct/api/uct.h>
 #include <ucs/arch/bitops.h>
+#include <ucs/arch/cpu.h>
+#include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/list.h>
 #include <ucs/debug/log.h>
 
 #include <inttypes.h>
 
 
+/*
+ * Lane and rkey index resolved for an endpoint configuration. They are packed
+ * to a single word, so a concurrent update would never be seen partially:
+ * <cfg_index(16 bit)><lane(8 bit)><rkey index(8 bit)>
+ */
+#define UCP_RKEY_RESOLVED_INVALID       ((uint32_t)-1)
+#define UCP_RKEY_RESOLVED_CFG(_r)       ((_r) >> 16)
+#define UCP_RKEY_RESOLVED_LANE(_r)      (((_r) >> 8) & UCS_MASK(8))
+#define UCP_RKEY_RESOLVED_INDEX(_r)     ((_r) & UCS_MASK(8))
+#define UCP_RKEY_RESOLVED(_cfg_index, _lane, _rkey_index) \
+    (((uint32_t)(_cfg_index) << 16) | ((uint32_t)(_lane) << 8) | (_rkey_index))
+
+
+/**
+ * Key of the worker remote key cache. The unpacked rkey depends on the packed
+ * buffer, and on which remote MDs are reachable by the endpoint configuration.
+ */
+typedef struct ucp_rkey_cache_key {
+    const void                    *buffer;           /* Packed rkey */
+    size_t                        length;            /* Packed rkey length */
+    ucp_md_map_t                  reachable_md_map;  /* Reachable remote MDs */
+} ucp_rkey_cache_key_t;
+
+
 /**
  * Remote memory key structure.
  * Contains remote keys for UCT MDs.
  * md_map specifies which MDs from the current context are present in the array.
  * The array itself contains only the MDs specified in md_map, without gaps.
+ * A cached rkey is followed by a copy of its packed buffer, which is pointed
+ * to by cache_key.
  */
 typedef struct ucp_rkey {
-    ucp_md_map_t                  md_map;  /* Which *remote* MDs have valid memory handles */
-    uct_rkey_bundle_t             uct[0];  /* Remote key for every MD */
+    ucp_md_map_t                  md_map;    /* Which *remote* MDs have valid memory handles */
+    volatile uint32_t             rma_resolved; /* RMA lane and rkey index */
+    volatile uint32_t             amo_resolved; /* AMO lane and rkey index */
+    volatile uint32_t             refcount;  /* Number of users, including the cache */
+    ucs_list_link_t               lru_list;  /* Entry in the worker rkey cache */
+    ucp_rkey_cache_key_t          cache_key; /* Key in the worker rkey cache */
+    uct_rkey_bundle_t             uct[0];    /* Remote key for every MD */
 } ucp_rkey_t;
 
 
@@ -34,15 +69,114 @@ typedef struct ucp_rkey {
  * Contains general information, and a list of UCT handles.
  * md_map specifies which MDs from the current context are present in the array.
  * The array itself contains only the MDs specified in md_map, without gaps.
+ * During background registration, the memory is registered in chunks, on all
+ * MDs for every chunk, and reg_length is advanced after the chunk handles are
+ * stored. An MD is added to md_map once a handle for the whole region is ready,
+ * so the registered MDs are usable.
  */
 typedef struct ucp_mem {
     void                          *address;     /* Region start address */
     size_t                        length;       /* Region length */
     uct_alloc_method_t            alloc_method; /* Method used to allocate the memory */
     uct_md_h                      alloc_md;     /* MD used to allocated the memory */
-    ucp_md_map_t                  md_map;       /* Which MDs have valid memory handles */
+    struct ucp_mem                *arena_memh;  /* Registered arena which the region
+                                                   was carved out of, or NULL */
+    volatile ucs_status_t         reg_status;   /* UCS_INPROGRESS while registered
+                                                   in the background */
+    volatile int                  reg_cancel;   /* Stop background registration */
+    unsigned                      reg_flags;    /* UCT flags for background registration */
+    ucs_list_link_t               reg_list;     /* Entry in the registration queue */
+    ucs_list_link_t               reg_memhs;    /* Entry in the list of handles
+                                                   mapped in the background */
+    volatile uint32_t             reg_refcount; /* The mapping, and rendezvous
+                                                   requests using the handle */
+    size_t                        reg_chunk;    /* Size of a registration chunk */
+    unsigned                      reg_num_chunks; /* Number of chunks */
+    unsigned                      reg_num_handles; /* Chunk handles registered so far */
+    volatile size_t               reg_length;   /* Length registered on all MDs */
+    uct_mem_h                     *reg_chunks;  /* Chunk handles, by chunk and MD */
+    volatile ucp_md_map_t         md_map;       /* Which MDs have valid memory handles */
     uct_mem_h                     uct[0];       /* Valid memory handles, as popcount(md_map) */
 } ucp_mem_t;
 
 
+ucs_status_t ucp_mem_arena_init(ucp_context_h context);
+
+void ucp_mem_arena_cleanup(ucp_context_h context);
+
+ucs_status_t ucp_mem_reg_init(ucp_context_h context);
+
+void ucp_mem_reg_cleanup(ucp_context_h context);
+
+ucp_mem_h ucp_mem_reg_find(ucp_context_h context, const void *address,
+                           size_t length);
+
+ucs_status_t ucp_mem_reg_put(ucp_context_h context, ucp_mem_h memh);
+
+khint32_t ucp_rkey_cache_key_hash(const ucp_rkey_cache_key_t *key);
+
+int ucp_rkey_cache_key_is_equal(const ucp_rkey_cache_key_t *key1,
+                                const ucp_rkey_cache_key_t *key2);
+
+void ucp_rkey_cache_cleanup(ucp_worker_h worker);
+
+ucs_status_t ucp_rkey_resolve_rma(ucp_ep_h ep, ucp_rkey_h rkey,
+                                  uint32_t *resolved_p);
+
+ucs_status_t ucp_rkey_resolve_amo(ucp_ep_h ep, ucp_rkey_h rkey,
+                                  uint32_t *resolved_p);
+
+
+/**
+ * @return Handle of MD number 'md_index' for the whole memory region, or
+ *         UCT_INVALID_MEM_HANDLE if it's not registered on this MD (yet).
+ */
+static inline uct_mem_h ucp_memh_md_handle(ucp_mem_h memh, unsigned md_index)
+{
+    ucp_md_map_t md_map = memh->md_map;
+
+    if (!(md_map & UCS_BIT(md_index))) {
+        return UCT_INVALID_MEM_HANDLE;
+    }
+
+    ucs_memory_cpu_load_fence();
+    return memh->uct[ucs_count_one_bits(md_map & UCS_MASK(md_index))];
+}
+
+
+/**
+ * @return 'length', limited to the end of the registration chunk of a memory
+ *         handle mapped in the background, which contains 'address'.
+ */
+static inline size_t ucp_memh_chunk_length(ucp_mem_h memh, const void *address,
+                                           size_t length)
+{
+    size_t offset = (uintptr_t)address - (uintptr_t)memh->address;
+
+    return ucs_min(length, memh->reg_chunk - (offset % memh->reg_chunk));
+}
+
+
+/**
+ * @return Handle of MD number 'md_index' for the registration chunk of a memory
+ *         handle mapped in the background, which contains the given range, or
+ *         UCT_INVALID_MEM_HANDLE if the range is not registered yet.
+ */
+static inline uct_mem_h ucp_memh_chunk_handle(ucp_context_h context,
+                                              ucp_mem_h memh, unsigned md_index,
+                                              const void *address, size_t length)
+{
+    size_t offset = (uintptr_t)address - (uintptr_t)memh->address;
+
+    ucs_assert(ucp_memh_chunk_length(memh, address, length) == length);
+    if (offset + length > memh->reg_length) {
+        return UCT_INVALID_MEM_HANDLE;
+    }
+
+    ucs_memory_cpu_load_fence();
+    return memh->reg_chunks[((offset / memh->reg_chunk) * context->num_mds) +
+                            md_index];
+}
+
+
 #endif
@@ -37,6 +37,10 @@ ucs_status_t ucp_request_test(void *request, ucp_tag_recv_info_t *info)
 void ucp_request_release(void *request)
 {
     ucp_request_t *req = (ucp_request_t*)request - 1;
+    ucp_worker_h worker = ucs_container_of(ucs_mpool_obj_owner(req),
+                                           ucp_worker_t, req_mp);
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
 
     ucs_trace_data("release request %p (%p) flags: 0x%x", req, req + 1, req->flags);
 
@@ -47,20 +51,27 @@ void ucp_request_release(void *request)
         ucs_trace_data("put %p to mpool", req);
         ucs_mpool_put_inline(req);
     }
+
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
 }
 
 void ucp_request_cancel(ucp_worker_h worker, void *request)
 {
     ucp_request_t *req = (ucp_request_t*)request - 1;
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+
     if (req->flags & UCP_REQUEST_FLAG_COMPLETED) {
-        return;
+        goto out;
     }
 
     if (req->flags & UCP_REQUEST_FLAG_EXPECTED) {
         ucp_tag_cancel_expected(worker->context, req);
         ucp_request_complete_recv(req, UCS_ERR_CANCELED, NULL);
     }
+
+out:
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
 }
 
 static void ucp_worker_request_init_proxy(ucs_mpool_t *mp, void *obj, void *chunk)
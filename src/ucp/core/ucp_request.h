@@ -15,6 +15,7 @@
 #include <uct/api/uct.h>
 #include <ucs/datastruct/mpool.h>
 #include <ucs/datastruct/queue_types.h>
+#include <ucs/stats/stats.h>
 #include <ucp/wireup/wireup.h>
 
 
@@ -54,6 +55,8 @@ typedef struct ucp_frag_state {
     union {
         struct {
             uct_mem_h             memh;
+            ucp_mem_h             ucp_memh;  /* Referenced user memory handle
+                                                which owns 'memh', or NULL */
         } contig;
         struct {
             size_t                iov_offset;     /* Offset in the IOV item */
@@ -73,6 +76,14 @@ struct ucp_request {
     ucs_status_t                  status;  /* Operation status */
     uint16_t                      flags;   /* Request flags */
 
+#if ENABLE_STATS
+    struct {
+        ucs_stats_node_t          *node;       /* Worker statistics, or NULL if
+                                                  latency is not recorded */
+        ucs_time_t                start_time;  /* Operation start time */
+    } stats;
+#endif
+
     union {
         struct {
             ucp_ep_h              ep;
@@ -108,6 +119,10 @@ struct ucp_request {
                     uintptr_t     remote_request; /* pointer to the sender's send request */
                     uct_rkey_bundle_t rkey_bundle;
                     ucp_request_t *rreq;    /* receive request on the recv side */
+                    ucp_mem_h     memh;     /* Referenced handle of a receive
+                                               buffer mapped in the background,
+                                               or NULL */
+                    ucs_callbackq_slow_elem_t cbq_elem; /* Waits for memh chunks */
                 } rndv_get;
 
                 struct {
@@ -151,6 +166,31 @@ typedef struct ucp_recv_desc {
 } ucp_recv_desc_t;
 
 
+#if ENABLE_STATS
+/* Start measuring request completion latency */
+#define UCP_REQUEST_STATS_START(_req, _node) \
+    { \
+        (_req)->stats.node = (_node); \
+        if ((_node) != NULL) { \
+            UCS_STATS_START_TIME((_req)->stats.start_time); \
+        } \
+    }
+
+/* Do not record latency for this request */
+#define UCP_REQUEST_STATS_RESET(_req) \
+    (_req)->stats.node = NULL;
+
+/* Record request completion latency to worker histogram */
+#define UCP_REQUEST_STATS_COMPLETE(_req, _hist) \
+    UCS_STATS_UPDATE_HISTOGRAM_TIME((_req)->stats.node, _hist, \
+                                    (_req)->stats.start_time)
+#else
+#define UCP_REQUEST_STATS_START(_req, _node)
+#define UCP_REQUEST_STATS_RESET(_req)
+#define UCP_REQUEST_STATS_COMPLETE(_req, _hist)
+#endif
+
+
 extern ucs_mpool_ops_t ucp_request_mpool_ops;
 
 /**
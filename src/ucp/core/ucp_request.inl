@@ -7,6 +7,7 @@
 #include "ucp_request.h"
 #include "ucp_worker.h"
 #include "ucp_ep.inl"
+#include "ucp_mm.h"
 
 #include <ucp/core/ucp_worker.h>
 #include <ucp/dt/dt.h>
@@ -18,14 +19,30 @@
 static UCS_F_ALWAYS_INLINE ucp_request_t*
 ucp_request_get(ucp_worker_h worker)
 {
-    ucp_request_t *req = ucs_mpool_get_inline(&worker->req_mp);
+    ucp_request_t *req;
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+    req = ucs_mpool_get_inline(&worker->req_mp);
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
 
     if (req != NULL) {
         VALGRIND_MAKE_MEM_DEFINED(req + 1,  worker->context->config.request.size);
+        UCP_REQUEST_STATS_RESET(req);
     }
     return req;
 }
 
+/* Return a request to the memory pool of the worker it was allocated from */
+static UCS_F_ALWAYS_INLINE void ucp_request_mpool_put(ucp_request_t *req)
+{
+    ucp_worker_h worker = ucs_container_of(ucs_mpool_obj_owner(req),
+                                           ucp_worker_t, req_mp);
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+    ucs_mpool_put_inline(req);
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+}
+
 static UCS_F_ALWAYS_INLINE void
 ucp_request_put(ucp_request_t *req, ucs_status_t status)
 {
@@ -33,7 +50,7 @@ ucp_request_put(ucp_request_t *req, ucs_status_t status)
     if ((req->flags |= UCP_REQUEST_FLAG_COMPLETED) & UCP_REQUEST_FLAG_RELEASED) {
         /* Release should not be called for external requests */
         ucs_assert(!(req->flags & UCP_REQUEST_FLAG_EXTERNAL));
-        ucs_mpool_put(req);
+        ucp_request_mpool_put(req);
     }
 }
 
@@ -42,6 +59,7 @@ ucp_request_complete_send(ucp_request_t *req, ucs_status_t status)
 {
     ucs_trace_data("completing send request %p (%p), %s", req, req + 1,
                    ucs_status_string(status));
+    UCP_REQUEST_STATS_COMPLETE(req, UCP_WORKER_STAT_HIST_TX_LATENCY);
     req->send.cb(req + 1, status);
 
     UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_TX,
@@ -58,6 +76,10 @@ ucp_request_complete_recv(ucp_request_t *req, ucs_status_t status,
                    req, req + 1, info->sender_tag, info->length,
                    ucs_status_string(status));
 
+    /* Cancelled and failed receives would skew the latency */
+    if (ucs_likely(status == UCS_OK)) {
+        UCP_REQUEST_STATS_COMPLETE(req, UCP_WORKER_STAT_HIST_RX_LATENCY);
+    }
     if (!(req->flags & UCP_REQUEST_FLAG_EXTERNAL)) {
         /* In the current API callbacks are defined for internal reqs only. */
         req->recv.cb(req + 1, status, info);
@@ -97,6 +119,7 @@ ucp_request_send_buffer_reg(ucp_request_t *req, ucp_lane_index_t lane)
     uct_md_h uct_md = ucp_ep_md(req->send.ep, lane);
     ucs_status_t status;
 
+    req->send.state.dt.contig.ucp_memh = NULL;
     status = uct_md_mem_reg(uct_md, (void*)req->send.buffer, req->send.length, 0,
                             &req->send.state.dt.contig.memh);
     if (status != UCS_OK) {
@@ -112,5 +135,11 @@ static UCS_F_ALWAYS_INLINE void
 ucp_request_send_buffer_dereg(ucp_request_t *req, ucp_lane_index_t lane)
 {
     uct_md_h uct_md = ucp_ep_md(req->send.ep, lane);
-    (void)uct_md_mem_dereg(uct_md, req->send.state.dt.contig.memh);
+
+    if (req->send.state.dt.contig.ucp_memh == NULL) {
+        (void)uct_md_mem_dereg(uct_md, req->send.state.dt.contig.memh);
+    } else {
+        (void)ucp_mem_reg_put(req->send.ep->worker->context,
+                              req->send.state.dt.contig.ucp_memh);
+    }
 }
@@ -6,13 +6,19 @@
 
 #include "ucp_mm.h"
 #include "ucp_request.h"
+#include "ucp_worker.h"
 #include "ucp_ep.inl"
 
+#include <ucs/arch/atomic.h>
+#include <ucs/arch/cpu.h>
+#include <ucs/sys/math.h>
 #include <inttypes.h>
 
 
 static ucp_rkey_t ucp_mem_dummy_rkey = {
-    .md_map = 0
+    .md_map       = 0,
+    .rma_resolved = UCP_RKEY_RESOLVED_INVALID,
+    .amo_resolved = UCP_RKEY_RESOLVED_INVALID
 };
 
 static ucp_md_map_t ucp_mem_dummy_buffer = 0;
@@ -23,11 +29,17 @@ ucs_status_t ucp_rkey_pack(ucp_context_h context, ucp_mem_h memh,
     unsigned md_index, uct_memh_index;
     void *rkey_buffer, *p;
     size_t size, md_size;
+    ucp_md_map_t md_map;
     ucs_status_t status;
     char UCS_V_UNUSED buf[128];
 
+    /* The map may grow during background registration, so use a snapshot of
+     * it, and the handles which were stored before it */
+    md_map = memh->md_map;
+    ucs_memory_cpu_load_fence();
+
     ucs_trace("packing rkeys for buffer %p memh %p md_map 0x%x",
-              memh->address, memh, memh->md_map);
+              memh->address, memh, md_map);
 
     if (memh->length == 0) {
         /* dummy memh, return dummy key */
@@ -53,13 +65,13 @@ ucs_status_t ucp_rkey_pack(ucp_context_h context, ucp_mem_h memh,
     p = rkey_buffer;
 
     /* Write the MD map */
-    *(ucp_md_map_t*)p = memh->md_map;
+    *(ucp_md_map_t*)p = md_map;
     p += sizeof(ucp_md_map_t);
 
     /* Write both size and rkey_buffer for each UCT rkey */
     uct_memh_index = 0;
     for (md_index = 0; md_index < context->num_mds; ++md_index) {
-        if (!(memh->md_map & UCS_BIT(md_index))) {
+        if (!(md_map & UCS_BIT(md_index))) {
             continue;
         }
 
@@ -76,7 +88,9 @@ ucs_status_t ucp_rkey_pack(ucp_context_h context, ucp_mem_h memh,
     }
 
     if (uct_memh_index == 0) {
-        status = UCS_ERR_UNSUPPORTED;
+        /* Nothing is registered yet, or would ever be */
+        status = (memh->reg_status == UCS_INPROGRESS) ? UCS_ERR_NO_RESOURCE :
+                 UCS_ERR_UNSUPPORTED;
         goto err_destroy;
     }
 
@@ -99,7 +113,34 @@ void ucp_rkey_buffer_release(void *rkey_buffer)
     ucs_free(rkey_buffer);
 }
 
-ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey_p)
+khint32_t ucp_rkey_cache_key_hash(const ucp_rkey_cache_key_t *key)
+{
+    return ucs_calc_crc32(key->reachable_md_map, key->buffer, key->length);
+}
+
+int ucp_rkey_cache_key_is_equal(const ucp_rkey_cache_key_t *key1,
+                                const ucp_rkey_cache_key_t *key2)
+{
+    return (key1->reachable_md_map == key2->reachable_md_map) &&
+           (key1->length           == key2->length) &&
+           !memcmp(key1->buffer, key2->buffer, key1->length);
+}
+
+/* Get the size of a packed rkey buffer, as created by ucp_rkey_pack() */
+static size_t ucp_rkey_packed_size(const void *rkey_buffer)
+{
+    ucp_md_map_t md_map = *(const ucp_md_map_t*)rkey_buffer;
+    const void *p       = rkey_buffer + sizeof(ucp_md_map_t);
+
+    for (; md_map != 0; md_map &= md_map - 1) {
+        p += sizeof(uint8_t) + *(const uint8_t*)p;
+    }
+    return p - rkey_buffer;
+}
+
+static ucs_status_t ucp_rkey_unpack_uct(const void *rkey_buffer,
+                                        ucp_md_map_t reachable_md_map,
+                                        size_t cache_size, ucp_rkey_h *rkey_p)
 {
     unsigned remote_md_index, remote_md_gap;
     unsigned rkey_index;
@@ -108,35 +149,31 @@ ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey
     ucp_rkey_h rkey;
     uint8_t md_size;
     ucp_md_map_t md_map;
-    void *p;
+    const void *p;
 
     /* Count the number of remote MDs in the rkey buffer */
     p = rkey_buffer;
 
     /* Read remote MD map */
     md_map   = *(ucp_md_map_t*)p;
-
-    ucs_trace("unpacking rkey with md_map 0x%x", md_map);
-
-    if (md_map == 0) {
-        /* Dummy key return ok */
-        *rkey_p = &ucp_mem_dummy_rkey;
-        return UCS_OK;
-    }
-
     md_count = ucs_count_one_bits(md_map);
     p       += sizeof(ucp_md_map_t);
 
     /* Allocate rkey handle which holds UCT rkeys for all remote MDs.
      * We keep all of them to handle a future transport switch.
+     * If the rkey would be cached, make room for a copy of the packed buffer.
      */
-    rkey = ucs_malloc(sizeof(*rkey) + (sizeof(rkey->uct[0]) * md_count), "ucp_rkey");
+    rkey = ucs_malloc(sizeof(*rkey) + (sizeof(rkey->uct[0]) * md_count) +
+                      cache_size, "ucp_rkey");
     if (rkey == NULL) {
         status = UCS_ERR_NO_MEMORY;
         goto err;
     }
 
-    rkey->md_map    = 0;
+    rkey->md_map       = 0;
+    rkey->refcount     = 1;
+    rkey->rma_resolved = UCP_RKEY_RESOLVED_INVALID;
+    rkey->amo_resolved = UCP_RKEY_RESOLVED_INVALID;
     remote_md_index = 0; /* Index of remote MD */
     rkey_index      = 0; /* Index of the rkey in the array */
 
@@ -157,7 +194,7 @@ ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey
         ucs_assert_always(remote_md_index <= UCP_MD_INDEX_BITS);
 
         /* Unpack only reachable rkeys */
-        if (UCS_BIT(remote_md_index) & ucp_ep_config(ep)->key.reachable_md_map) {
+        if (UCS_BIT(remote_md_index) & reachable_md_map) {
             ucs_assert(rkey_index < md_count);
             status = uct_rkey_unpack(p, &rkey->uct[rkey_index]);
             if (status != UCS_OK) {
@@ -183,6 +220,14 @@ ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey
         goto err_destroy;
     }
 
+    if (cache_size > 0) {
+        /* The copy of the packed buffer is placed after the used UCT rkeys */
+        rkey->cache_key.buffer           = &rkey->uct[rkey_index];
+        rkey->cache_key.length           = cache_size;
+        rkey->cache_key.reachable_md_map = reachable_md_map;
+        memcpy((void*)rkey->cache_key.buffer, rkey_buffer, cache_size);
+    }
+
     *rkey_p = rkey;
     return UCS_OK;
 
@@ -192,6 +237,177 @@ err:
     return status;
 }
 
+static void ucp_rkey_cache_remove(ucp_worker_h worker, ucp_rkey_h rkey)
+{
+    khiter_t hash_it;
+
+    hash_it = kh_get(ucp_worker_rkey_cache, &worker->rkey_cache, rkey->cache_key);
+    ucs_assert(hash_it != kh_end(&worker->rkey_cache));
+    kh_del(ucp_worker_rkey_cache, &worker->rkey_cache, hash_it);
+    ucs_list_del(&rkey->lru_list);
+    --worker->rkey_cache_count;
+
+    /* Release the reference of the cache */
+    ucp_rkey_destroy(rkey);
+}
+
+static void ucp_rkey_cache_add(ucp_worker_h worker, ucp_rkey_h rkey)
+{
+    ucp_rkey_h victim;
+    khiter_t hash_it;
+    int hash_extra_status;
+
+    hash_it = kh_put(ucp_worker_rkey_cache, &worker->rkey_cache,
+                     rkey->cache_key, &hash_extra_status);
+    if (ucs_unlikely(hash_it == kh_end(&worker->rkey_cache))) {
+        ucs_debug("failed to add rkey %p to the cache", rkey);
+        return;
+    }
+
+    ucs_assert(hash_extra_status != 0);
+    kh_value(&worker->rkey_cache, hash_it) = rkey;
+    ucs_list_add_head(&worker->rkey_cache_lru, &rkey->lru_list);
+    ++worker->rkey_cache_count;
+    ++rkey->refcount; /* Not shared yet */
+
+    if (worker->rkey_cache_count > worker->context->config.ext.rkey_cache_size) {
+        victim = ucs_list_tail(&worker->rkey_cache_lru, ucp_rkey_t, lru_list);
+        ucs_trace("evicting rkey %p from the cache", victim);
+        ucp_rkey_cache_remove(worker, victim);
+    }
+}
+
+void ucp_rkey_cache_cleanup(ucp_worker_h worker)
+{
+    while (!ucs_list_is_empty(&worker->rkey_cache_lru)) {
+        ucp_rkey_cache_remove(worker, ucs_list_head(&worker->rkey_cache_lru,
+                                                    ucp_rkey_t, lru_list));
+    }
+}
+
+ucs_status_t ucp_ep_rkey_unpack(ucp_ep_h ep, void *rkey_buffer, ucp_rkey_h *rkey_p)
+{
+    ucp_worker_h worker = ep->worker;
+    ucp_rkey_cache_key_t cache_key;
+    ucs_status_t status;
+    khiter_t hash_it;
+    ucp_rkey_h rkey;
+
+    ucs_trace("unpacking rkey with md_map 0x%x", *(ucp_md_map_t*)rkey_buffer);
+
+    if (*(ucp_md_map_t*)rkey_buffer == 0) {
+        /* Dummy key return ok */
+        *rkey_p = &ucp_mem_dummy_rkey;
+        return UCS_OK;
+    }
+
+    if (worker->context->config.ext.rkey_cache_size == 0) {
+        return ucp_rkey_unpack_uct(rkey_buffer,
+                                   ucp_ep_config(ep)->key.reachable_md_map, 0,
+                                   rkey_p);
+    }
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+
+    cache_key.buffer           = rkey_buffer;
+    cache_key.length           = ucp_rkey_packed_size(rkey_buffer);
+    cache_key.reachable_md_map = ucp_ep_config(ep)->key.reachable_md_map;
+
+    hash_it = kh_get(ucp_worker_rkey_cache, &worker->rkey_cache, cache_key);
+    if (hash_it != kh_end(&worker->rkey_cache)) {
+        rkey = kh_value(&worker->rkey_cache, hash_it);
+        ucs_atomic_add32(&rkey->refcount, 1);
+        ucs_list_del(&rkey->lru_list);
+        ucs_list_add_head(&worker->rkey_cache_lru, &rkey->lru_list);
+        ucs_trace("found rkey %p in the cache", rkey);
+        status = UCS_OK;
+        goto out;
+    }
+
+    status = ucp_rkey_unpack_uct(rkey_buffer, cache_key.reachable_md_map,
+                                 cache_key.length, &rkey);
+    if (status != UCS_OK) {
+        goto out;
+    }
+
+    ucp_rkey_cache_add(worker, rkey);
+
+out:
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+    if (status == UCS_OK) {
+        *rkey_p = rkey;
+    }
+    return status;
+}
+
+/*
+ * Calculate lane and rkey index based of the lane_map in ep configuration: the
+ * lane_map holds the md_index which each lane supports, so we do 'and' between
+ * that, and the md_map of the rkey (we duplicate the md_map in rkey to fill the
+ * mask for each possible lane). The first set bit in the 'and' product represents
+ * the first matching lane and its md_index.
+ */
+static ucs_status_t ucp_rkey_resolve_lane(ucp_rkey_h rkey,
+                                          ucp_md_lane_map_t ep_lane_map,
+                                          ucp_lane_index_t *lane_p,
+                                          ucp_rsc_index_t *rkey_index_p)
+{
+    ucp_md_lane_map_t rkey_md_map;
+    ucp_rsc_index_t dst_md_index;
+    uint8_t bit_index;
+
+    rkey_md_map = ucp_ep_md_map_expand(rkey->md_map);
+    if (!(ep_lane_map & rkey_md_map)) {
+        ucs_error("Remote memory is unreachable");
+        return UCS_ERR_UNREACHABLE;
+    }
+
+    /* Find the first lane which supports one of the remote md's in the rkey*/
+    bit_index     = ucs_ffs64(ep_lane_map & rkey_md_map);
+    *lane_p       = bit_index / UCP_MD_INDEX_BITS;
+    dst_md_index  = bit_index % UCP_MD_INDEX_BITS;
+    *rkey_index_p = ucs_count_one_bits(rkey_md_map & UCS_MASK(dst_md_index));
+    return UCS_OK;
+}
+
+ucs_status_t ucp_rkey_resolve_rma(ucp_ep_h ep, ucp_rkey_h rkey,
+                                  uint32_t *resolved_p)
+{
+    ucp_rsc_index_t rkey_index;
+    ucp_lane_index_t lane;
+    ucs_status_t status;
+
+    status = ucp_rkey_resolve_lane(rkey, ucp_ep_config(ep)->key.rma_lane_map,
+                                   &lane, &rkey_index);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    *resolved_p        = UCP_RKEY_RESOLVED(ep->cfg_index, lane, rkey_index);
+    rkey->rma_resolved = *resolved_p;
+    return UCS_OK;
+}
+
+ucs_status_t ucp_rkey_resolve_amo(ucp_ep_h ep, ucp_rkey_h rkey,
+                                  uint32_t *resolved_p)
+{
+    ucp_rsc_index_t rkey_index;
+    ucp_lane_index_t amo_index;
+    ucs_status_t status;
+
+    status = ucp_rkey_resolve_lane(rkey, ucp_ep_config(ep)->key.amo_lane_map,
+                                   &amo_index, &rkey_index);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    *resolved_p        = UCP_RKEY_RESOLVED(ep->cfg_index,
+                                           ucp_ep_config(ep)->key.amo_lanes[amo_index],
+                                           rkey_index);
+    rkey->amo_resolved = *resolved_p;
+    return UCS_OK;
+}
+
 void ucp_rkey_destroy(ucp_rkey_h rkey)
 {
     unsigned num_rkeys;
@@ -201,6 +417,11 @@ void ucp_rkey_destroy(ucp_rkey_h rkey)
         return;
     }
 
+    /* A cached rkey is released when both the cache and all users are done */
+    if (ucs_atomic_fadd32(&rkey->refcount, -1) > 1) {
+        return;
+    }
+
     num_rkeys = ucs_count_one_bits(rkey->md_map);
 
     for (i = 0; i < num_rkeys; ++i) {
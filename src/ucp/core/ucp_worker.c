@@ -14,6 +14,38 @@
 #include <ucs/datastruct/mpool.inl>
 
 
+#if ENABLE_STATS
+static const char *ucp_worker_stats_histogram_names[] = {
+    [UCP_WORKER_STAT_HIST_TX_LATENCY] = "tx_latency",
+    [UCP_WORKER_STAT_HIST_RX_LATENCY] = "rx_latency"
+};
+
+static ucs_stats_class_t ucp_worker_stats_class = {
+    .name            = "ucp_worker",
+    .num_counters    = UCP_WORKER_STAT_LAST,
+    .num_histograms  = UCP_WORKER_STAT_HIST_LAST,
+    .histogram_names = ucp_worker_stats_histogram_names,
+    .counter_names   = {
+        [UCP_WORKER_STAT_TX_WIREUP_REQUEST]      = "tx_wireup_request",
+        [UCP_WORKER_STAT_TX_WIREUP_REPLY]        = "tx_wireup_reply",
+        [UCP_WORKER_STAT_TX_WIREUP_ACK]          = "tx_wireup_ack",
+        [UCP_WORKER_STAT_TX_WIREUP_ACK_SKIPPED]  = "tx_wireup_ack_skipped",
+        [UCP_WORKER_STAT_RX_WIREUP_IMPLICIT_ACK] = "rx_wireup_implicit_ack"
+    }
+};
+#endif
+
+/* Initial size of endpoint configurations table */
+#define UCP_WORKER_EP_CONFIG_INIT_SIZE  16
+
+static ucs_mpool_ops_t ucp_worker_ep_mpool_ops = {
+    .chunk_alloc   = ucs_mpool_chunk_malloc,
+    .chunk_release = ucs_mpool_chunk_free,
+    .obj_init      = NULL,
+    .obj_cleanup   = NULL
+};
+
+
 static void ucp_worker_close_ifaces(ucp_worker_h worker)
 {
     ucp_rsc_index_t rsc_index;
@@ -405,51 +437,155 @@ static void ucp_worker_init_atomic_tls(ucp_worker_h worker)
  * A 'key' identifies an entry in the ep_config array. An entry holds the key and
  * additional configuration parameters and thresholds.
  */
+static ucs_status_t ucp_worker_ep_config_grow(ucp_worker_h worker,
+                                              unsigned new_max)
+{
+    ucp_worker_ep_config_table_t *table;
+
+    table = ucs_malloc(sizeof(*table) + (sizeof(*table->config) * new_max),
+                       "ucp_ep_config_table");
+    if (table == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    if (worker->ep_config != NULL) {
+        memcpy(table->config, worker->ep_config,
+               sizeof(*table->config) * worker->ep_config_count);
+        table->prev = ucs_container_of(worker->ep_config,
+                                       ucp_worker_ep_config_table_t, config);
+    } else {
+        table->prev = NULL;
+    }
+
+    /* Publish the copied configurations before switching to the new table */
+    ucs_memory_cpu_store_fence();
+    worker->ep_config     = table->config;
+    worker->ep_config_max = new_max;
+    ucs_debug("worker %p: ep configuration table resized to %u entries",
+              worker, new_max);
+    return UCS_OK;
+}
+
+static void ucp_worker_ep_config_cleanup(ucp_worker_h worker)
+{
+    ucp_worker_ep_config_table_t *table, *prev;
+
+    if (worker->ep_config == NULL) {
+        return;
+    }
+
+    table = ucs_container_of(worker->ep_config, ucp_worker_ep_config_table_t,
+                             config);
+    while (table != NULL) {
+        prev = table->prev;
+        ucs_free(table);
+        table = prev;
+    }
+
+    worker->ep_config = NULL;
+}
+
 unsigned ucp_worker_get_ep_config(ucp_worker_h worker,
                                   const ucp_ep_config_key_t *key)
 {
     ucp_ep_config_t *config;
     unsigned config_idx;
+    ucs_status_t status;
+    khiter_t hash_it;
+    int hash_status;
 
-    /* Search for the given key in the ep_config array */
-    for (config_idx = 0; config_idx < worker->ep_config_count; ++config_idx) {
-        if (ucp_ep_config_is_equal(&worker->ep_config[config_idx].key, key)) {
-            goto out;
-        }
+    /* Search for the given key in the configurations hash */
+    hash_it = kh_get(ucp_worker_ep_config_hash, &worker->ep_config_hash, *key);
+    if (hash_it != kh_end(&worker->ep_config_hash)) {
+        return kh_value(&worker->ep_config_hash, hash_it);
     }
 
     if (worker->ep_config_count >= worker->ep_config_max) {
-        /* TODO support larger number of configurations */
-        ucs_fatal("too many ep configurations: %d", worker->ep_config_count);
+        if (worker->ep_config_max >= UINT16_MAX) {
+            /* Endpoint configuration index is 16 bit */
+            ucs_fatal("too many ep configurations: %d", worker->ep_config_count);
+        }
+
+        status = ucp_worker_ep_config_grow(worker,
+                                           ucs_min(worker->ep_config_max * 2,
+                                                   UINT16_MAX));
+        if (status != UCS_OK) {
+            ucs_fatal("failed to grow ep configurations table: %s",
+                      ucs_status_string(status));
+        }
     }
 
-    /* Create new configuration */
-    config_idx = worker->ep_config_count++;
+    /* Create new configuration, derived thresholds are calculated once here */
+    config_idx = worker->ep_config_count;
     config     = &worker->ep_config[config_idx];
 
     memset(config, 0, sizeof(*config));
     config->key = *key;
     ucp_ep_config_init(worker, config);
 
-out:
+    hash_it = kh_put(ucp_worker_ep_config_hash, &worker->ep_config_hash,
+                     config->key, &hash_status);
+    if (hash_it == kh_end(&worker->ep_config_hash)) {
+        ucs_fatal("failed to add ep configuration to hash: %d", hash_status);
+    }
+
+    kh_value(&worker->ep_config_hash, hash_it) = config_idx;
+    ++worker->ep_config_count;
     return config_idx;
 }
 
+static void ucp_worker_cleanup_ep_mpools(ucp_worker_h worker,
+                                         ucp_lane_index_t num_lanes_mps)
+{
+    ucp_lane_index_t i;
+
+    for (i = 0; i < num_lanes_mps; ++i) {
+        ucs_mpool_cleanup(&worker->ep_lanes_mp[i], 1);
+    }
+    ucs_mpool_cleanup(&worker->ep_mp, 1);
+}
+
+/*
+ * Endpoints are allocated from a memory pool, and their lane arrays from a
+ * memory pool which matches the number of lanes, to keep the memory footprint
+ * of a large number of endpoints small.
+ */
+static ucs_status_t ucp_worker_init_ep_mpools(ucp_worker_h worker)
+{
+    char name[32];
+    ucs_status_t status;
+    ucp_lane_index_t i;
+
+    status = ucs_mpool_init(&worker->ep_mp, 0, sizeof(ucp_ep_t), 0,
+                            sizeof(void*), 256, UINT_MAX,
+                            &ucp_worker_ep_mpool_ops, "ucp_eps");
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    for (i = 0; i < UCP_MAX_LANES; ++i) {
+        snprintf(name, sizeof(name), "ucp_ep_lanes_%d", i + 1);
+        status = ucs_mpool_init(&worker->ep_lanes_mp[i], 0,
+                                (i + 1) * sizeof(uct_ep_h), 0, sizeof(void*),
+                                256, UINT_MAX, &ucp_worker_ep_mpool_ops, name);
+        if (status != UCS_OK) {
+            ucp_worker_cleanup_ep_mpools(worker, i);
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
 ucs_status_t ucp_worker_create(ucp_context_h context, ucs_thread_mode_t thread_mode,
                                ucp_worker_h *worker_p)
 {
     ucp_rsc_index_t tl_id;
     ucp_worker_h worker;
     ucs_status_t status;
-    unsigned config_count;
     unsigned name_length;
 
-    config_count = ucs_min((context->num_tls + 1) * (context->num_tls + 1) * context->num_tls,
-                           UINT8_MAX);
-
-    worker = ucs_calloc(1, sizeof(*worker) +
-                           sizeof(*worker->ep_config) * config_count,
-                        "ucp worker");
+    worker = ucs_calloc(1, sizeof(*worker), "ucp worker");
     if (worker == NULL) {
         status = UCS_ERR_NO_MEMORY;
         goto err;
@@ -458,23 +594,46 @@ ucs_status_t ucp_worker_create(ucp_context_h context, ucs_thread_mode_t thread_m
     worker->context         = context;
     worker->uuid            = ucs_generate_uuid((uintptr_t)worker);
     worker->stub_pend_count = 0;
+    worker->wireup_ack_wait = 0;
     worker->inprogress      = 0;
-    worker->ep_config_max   = config_count;
+    worker->ep_config       = NULL;
+    worker->ep_config_max   = 0;
     worker->ep_config_count = 0;
+    worker->flags           = 0;
     ucs_list_head_init(&worker->stub_ep_list);
 
+    if (thread_mode == UCS_THREAD_MODE_MULTI) {
+        worker->flags |= UCP_WORKER_FLAG_MT;
+    }
+
     name_length = ucs_min(UCP_WORKER_NAME_MAX,
                           context->config.ext.max_worker_name + 1);
     ucs_snprintf_zero(worker->name, name_length, "%s:%d", ucs_get_host_name(),
                       getpid());
 
     kh_init_inplace(ucp_worker_ep_hash, &worker->ep_hash);
+    kh_init_inplace(ucp_worker_ep_config_hash, &worker->ep_config_hash);
+    kh_init_inplace(ucp_worker_rkey_cache, &worker->rkey_cache);
+    ucs_list_head_init(&worker->rkey_cache_lru);
+    worker->rkey_cache_count = 0;
+
+    /* Configurations table grows on demand */
+    status = ucp_worker_ep_config_grow(worker, UCP_WORKER_EP_CONFIG_INIT_SIZE);
+    if (status != UCS_OK) {
+        goto err_free;
+    }
+
+    status = UCS_STATS_NODE_ALLOC(&worker->stats, &ucp_worker_stats_class,
+                                  NULL, "-%p", worker);
+    if (status != UCS_OK) {
+        goto err_free_ep_config;
+    }
 
     worker->ifaces = ucs_calloc(context->num_tls, sizeof(*worker->ifaces),
                                 "ucp iface");
     if (worker->ifaces == NULL) {
         status = UCS_ERR_NO_MEMORY;
-        goto err_free;
+        goto err_free_stats;
     }
 
     worker->iface_attrs = ucs_calloc(context->num_tls,
@@ -510,6 +669,12 @@ ucs_status_t ucp_worker_create(ucp_context_h context, ucs_thread_mode_t thread_m
         goto err_destroy_uct_worker;
     }
 
+    /* Create memory pools for endpoints */
+    status = ucp_worker_init_ep_mpools(worker);
+    if (status != UCS_OK) {
+        goto err_req_mp_cleanup;
+    }
+
     /* Open all resources as interfaces on this worker */
     for (tl_id = 0; tl_id < context->num_tls; ++tl_id) {
         status = ucp_worker_add_iface(worker, tl_id);
@@ -526,6 +691,8 @@ ucs_status_t ucp_worker_create(ucp_context_h context, ucs_thread_mode_t thread_m
 
 err_close_ifaces:
     ucp_worker_close_ifaces(worker);
+    ucp_worker_cleanup_ep_mpools(worker, UCP_MAX_LANES);
+err_req_mp_cleanup:
     ucs_mpool_cleanup(&worker->req_mp, 1);
 err_destroy_uct_worker:
     uct_worker_destroy(worker->uct);
@@ -537,6 +704,12 @@ err_free_attrs:
     ucs_free(worker->iface_attrs);
 err_free_ifaces:
     ucs_free(worker->ifaces);
+err_free_stats:
+    UCS_STATS_NODE_FREE(worker->stats);
+err_free_ep_config:
+    ucp_worker_ep_config_cleanup(worker);
+    kh_destroy_inplace(ucp_worker_ep_config_hash, &worker->ep_config_hash);
+    kh_destroy_inplace(ucp_worker_rkey_cache, &worker->rkey_cache);
 err_free:
     ucs_free(worker);
 err:
@@ -557,7 +730,9 @@ void ucp_worker_destroy(ucp_worker_h worker)
     ucs_trace_func("worker=%p", worker);
     ucp_worker_remove_am_handlers(worker);
     ucp_worker_destroy_eps(worker);
+    ucp_rkey_cache_cleanup(worker);
     ucp_worker_close_ifaces(worker);
+    ucp_worker_cleanup_ep_mpools(worker, UCP_MAX_LANES);
     ucs_mpool_cleanup(&worker->req_mp, 1);
     uct_worker_destroy(worker->uct);
     ucs_async_context_cleanup(&worker->async);
@@ -565,20 +740,30 @@ void ucp_worker_destroy(ucp_worker_h worker)
     ucs_free(worker->iface_attrs);
     ucs_free(worker->ifaces);
     kh_destroy_inplace(ucp_worker_ep_hash, &worker->ep_hash);
+    ucp_worker_ep_config_cleanup(worker);
+    kh_destroy_inplace(ucp_worker_ep_config_hash, &worker->ep_config_hash);
+    kh_destroy_inplace(ucp_worker_rkey_cache, &worker->rkey_cache);
+    UCS_STATS_NODE_FREE(worker->stats);
     ucs_free(worker);
 }
 
 void ucp_worker_progress(ucp_worker_h worker)
 {
+    UCS_MEMTRACK_HOT_PATH_ENTER();
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+
     /* worker->inprogress is used only for assertion check.
      * coverity[assert_side_effect]
      */
     ucs_assert(worker->inprogress++ == 0);
     uct_worker_progress(worker->uct);
-    ucs_async_check_miss(&worker->async);
 
     /* coverity[assert_side_effect] */
     ucs_assert(--worker->inprogress == 0);
+
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+    ucs_async_check_miss(&worker->async);
+    UCS_MEMTRACK_HOT_PATH_EXIT();
 }
 
 ucs_status_t ucp_worker_get_efd(ucp_worker_h worker, int *fd)
@@ -717,7 +902,10 @@ ucs_status_t ucp_worker_signal(ucp_worker_h worker)
 ucs_status_t ucp_worker_get_address(ucp_worker_h worker, ucp_address_t **address_p,
                                     size_t *address_length_p)
 {
-    return ucp_address_pack(worker, NULL, -1, NULL, address_length_p,
+    unsigned flags = worker->context->config.ext.address_short ?
+                     UCP_ADDRESS_PACK_FLAG_SHORT : 0;
+
+    return ucp_address_pack(worker, NULL, -1, flags, NULL, address_length_p,
                             (void**)address_p);
 }
 
@@ -741,6 +929,10 @@ ucp_ep_h ucp_worker_get_reply_ep(ucp_worker_h worker, uint64_t dest_uuid)
         }
     } else {
         ucs_debug("found ep %p", ep);
+        status = ucp_ep_resolve_lazy(ep);
+        if (status != UCS_OK) {
+            goto err;
+        }
     }
 
     UCS_ASYNC_UNBLOCK(&worker->async);
@@ -811,6 +1003,9 @@ void ucp_worker_print_info(ucp_worker_h worker, FILE *stream)
     size_t address_length;
     ucs_status_t status;
     ucp_rsc_index_t rsc_index;
+    size_t total_size;
+    unsigned num_eps;
+    ucp_ep_h ep;
     int first;
 
     fprintf(stream, "#\n");
@@ -839,5 +1034,14 @@ void ucp_worker_print_info(ucp_worker_h worker, FILE *stream)
     }
     fprintf(stream, "\n");
 
+    num_eps    = 0;
+    total_size = 0;
+    kh_foreach_value(&worker->ep_hash, ep, {
+        ++num_eps;
+        total_size += ucp_ep_memory_usage(ep);
+    })
+    fprintf(stream, "#            endpoints: %u, %zu bytes per endpoint\n",
+            num_eps, (num_eps > 0) ? (total_size / num_eps) : 0);
+
     fprintf(stream, "#\n");
 }
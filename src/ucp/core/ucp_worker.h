@@ -9,13 +9,29 @@
 #define UCP_WORKER_H_
 
 #include "ucp_ep.h"
+#include "ucp_mm.h"
 
 #include <ucs/datastruct/mpool.h>
 #include <ucs/datastruct/khash.h>
 #include <ucs/async/async.h>
+#include <ucs/stats/stats.h>
 
 KHASH_MAP_INIT_INT64(ucp_worker_ep_hash, ucp_ep_t *);
 
+#define ucp_worker_ep_config_hash_func(_key) \
+    ucp_ep_config_key_hash(&(_key))
+#define ucp_worker_ep_config_equal_func(_key1, _key2) \
+    ucp_ep_config_is_equal(&(_key1), &(_key2))
+KHASH_INIT(ucp_worker_ep_config_hash, ucp_ep_config_key_t, unsigned, 1,
+           ucp_worker_ep_config_hash_func, ucp_worker_ep_config_equal_func);
+
+#define ucp_worker_rkey_cache_hash_func(_key) \
+    ucp_rkey_cache_key_hash(&(_key))
+#define ucp_worker_rkey_cache_equal_func(_key1, _key2) \
+    ucp_rkey_cache_key_is_equal(&(_key1), &(_key2))
+KHASH_INIT(ucp_worker_rkey_cache, ucp_rkey_cache_key_t, ucp_rkey_h, 1,
+           ucp_worker_rkey_cache_hash_func, ucp_worker_rkey_cache_equal_func);
+
 
 enum {
     UCP_UCT_IFACE_ATOMIC32_FLAGS =
@@ -31,6 +47,69 @@ enum {
 };
 
 
+/**
+ * UCP worker flags
+ */
+enum {
+    UCP_WORKER_FLAG_MT = UCS_BIT(0)  /* Worker is accessed concurrently by
+                                        multiple threads (UCS_THREAD_MODE_MULTI) */
+};
+
+
+/**
+ * UCP worker statistics counters
+ */
+enum {
+    /* Wireup messages sent, by message type */
+    UCP_WORKER_STAT_TX_WIREUP_REQUEST,
+    UCP_WORKER_STAT_TX_WIREUP_REPLY,
+    UCP_WORKER_STAT_TX_WIREUP_ACK,
+    UCP_WORKER_STAT_TX_WIREUP_ACK_SKIPPED,  /* Acks left to a queued request */
+    UCP_WORKER_STAT_RX_WIREUP_IMPLICIT_ACK, /* Replies acknowledged by a request */
+    UCP_WORKER_STAT_LAST
+};
+
+
+/**
+ * UCP worker statistics histograms
+ */
+enum {
+    UCP_WORKER_STAT_HIST_TX_LATENCY,  /* Send request completion time, nsec */
+    UCP_WORKER_STAT_HIST_RX_LATENCY,  /* Receive request completion time, nsec */
+    UCP_WORKER_STAT_HIST_LAST
+};
+
+
+/**
+ * Enter/exit a critical section on a worker which is shared by multiple
+ * threads. It is held only while accessing the structures which are shared
+ * between the threads: the tag matching queues, the request memory pool, the
+ * endpoint hash, and the transport interfaces of the worker (UCT interfaces do
+ * not support concurrent access, so sends, flushes and progress are serialized
+ * too). Active message handlers are invoked from UCT progress, and therefore
+ * always run inside the critical section.
+ *
+ * The lock is the worker's async context lock, which is a recursive spinlock,
+ * so entry points may call each other (e.g a completion callback invoked from
+ * progress may post new operations), and async events, which already run with
+ * that lock held, may access the same structures without lock-order inversion.
+ * Workers created with a single-thread mode do not take any lock.
+ */
+#define UCP_THREAD_CS_ENTER_CONDITIONAL(_worker) \
+    do { \
+        if (ucs_unlikely((_worker)->flags & UCP_WORKER_FLAG_MT)) { \
+            UCS_ASYNC_BLOCK(&(_worker)->async); \
+        } \
+    } while (0)
+
+#define UCP_THREAD_CS_EXIT_CONDITIONAL(_worker) \
+    do { \
+        if (ucs_unlikely((_worker)->flags & UCP_WORKER_FLAG_MT)) { \
+            UCS_ASYNC_UNBLOCK(&(_worker)->async); \
+        } \
+    } while (0)
+
+
 /**
  * UCP worker wake-up context.
  */
@@ -41,6 +120,17 @@ typedef struct ucp_worker_wakeup {
 } ucp_worker_wakeup_t;
 
 
+/**
+ * Table of endpoint configurations. When the table is full, the configurations
+ * are copied to a larger one, and the old table is kept until the worker is
+ * destroyed, since it may still be accessed by a concurrent fast-path.
+ */
+typedef struct ucp_worker_ep_config_table {
+    struct ucp_worker_ep_config_table *prev;     /* Previous (smaller) table */
+    ucp_ep_config_t               config[0];     /* Endpoint configurations */
+} ucp_worker_ep_config_table_t;
+
+
 /**
  * UCP worker (thread context).
  */
@@ -50,21 +140,35 @@ typedef struct ucp_worker {
     uint64_t                      uuid;          /* Unique ID for wireup */
     uct_worker_h                  uct;           /* UCT worker handle */
     ucs_mpool_t                   req_mp;        /* Memory pool for requests */
+    ucs_mpool_t                   ep_mp;         /* Memory pool for endpoints */
+    ucs_mpool_t                   ep_lanes_mp[UCP_MAX_LANES]; /* Memory pools for
+                                                    endpoint lane arrays, by
+                                                    number of lanes */
     ucp_worker_wakeup_t           wakeup;        /* Wakeup-related context */
     uint64_t                      atomic_tls;    /* Which resources can be used for atomics */
+    unsigned                      flags;         /* Worker flags */
 
     int                           inprogress;
     char                          name[UCP_WORKER_NAME_MAX]; /* Worker name */
 
     unsigned                      stub_pend_count;/* Number of pending requests on stub endpoints*/
+    volatile unsigned             wireup_ack_wait;/* Number of endpoints which sent a
+                                                    wireup reply and wait for an ack */
     ucs_list_link_t               stub_ep_list;  /* List of stub endpoints to progress */
 
+    UCS_STATS_NODE_DECLARE(stats);               /* Statistics */
+
     khash_t(ucp_worker_ep_hash)   ep_hash;       /* Hash table of all endpoints */
     uct_iface_h                   *ifaces;       /* Array of interfaces, one for each resource */
     uct_iface_attr_t              *iface_attrs;  /* Array of interface attributes */
-    unsigned                      ep_config_max; /* Maximal number of configurations */
+    unsigned                      ep_config_max; /* Size of configurations table */
     unsigned                      ep_config_count; /* Current number of configurations */
-    ucp_ep_config_t               ep_config[0];  /* Array of transport limits and thresholds */
+    ucp_ep_config_t               *ep_config;    /* Array of transport limits and thresholds */
+    khash_t(ucp_worker_ep_config_hash) ep_config_hash; /* Configuration key to index */
+    khash_t(ucp_worker_rkey_cache) rkey_cache;   /* Unpacked remote keys, by packed buffer */
+    ucs_list_link_t               rkey_cache_lru; /* Cached remote keys, most
+                                                    recently used first */
+    unsigned                      rkey_cache_count; /* Number of cached remote keys */
 } ucp_worker_t;
 
 
@@ -90,13 +194,18 @@ static inline const char* ucp_worker_get_name(ucp_worker_h worker)
 static inline ucp_ep_h ucp_worker_ep_find(ucp_worker_h worker, uint64_t dest_uuid)
 {
     khiter_t hash_it;
+    ucp_ep_h ep;
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
     hash_it = kh_get(ucp_worker_ep_hash, &worker->ep_hash, dest_uuid);
     if (ucs_unlikely(hash_it == kh_end(&worker->ep_hash))) {
-        return NULL;
+        ep = NULL;
+    } else {
+        ep = kh_value(&worker->ep_hash, hash_it);
     }
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
 
-    return kh_value(&worker->ep_hash, hash_it);
+    return ep;
 }
 
 #endif
@@ -55,13 +55,21 @@ ucs_status_t ucp_proto_progress_am_bcopy_single(uct_pending_req_t *self);
 
 /*
  * Make sure the remote worker would be able to send replies to our endpoint.
- * Should be used before sending a message which requires a reply.
+ * Should be used before sending a message which requires a reply. While the
+ * connection requested by the remote worker is being established, it has an
+ * endpoint to us. Afterwards it may have destroyed it, so a request is sent.
+ * If the connection is not complete yet, the message is queued until it is, and
+ * it will acknowledge the wireup reply, see ucp_wireup_process_reply().
  */
 static inline void ucp_ep_connect_remote(ucp_ep_h ep)
 {
-    if (ucs_unlikely(!(ep->flags & UCP_EP_FLAG_CONNECT_REQ_SENT))) {
+    if (ucs_unlikely(!(ep->flags & (UCP_EP_FLAG_CONNECT_REQ_SENT |
+                                    UCP_EP_FLAG_CONNECT_REQ_RECVD)))) {
         ucp_wireup_send_request(ep);
     }
+    if (ucs_unlikely(!(ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED))) {
+        ep->flags |= UCP_EP_FLAG_IMPLICIT_ACK;
+    }
 }
 
 
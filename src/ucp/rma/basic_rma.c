@@ -13,6 +13,7 @@
 
 #include <ucp/core/ucp_request.inl>
 #include <ucs/datastruct/mpool.inl>
+#include <ucs/debug/profile.h>
 #include <ucp/core/ucp_ep.inl>
 
 
@@ -24,8 +25,10 @@
         return UCS_ERR_INVALID_PARAM; \
     }
 
-ucs_status_t ucp_put(ucp_ep_h ep, const void *buffer, size_t length,
-                     uint64_t remote_addr, ucp_rkey_h rkey)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_put,
+                 (ep, buffer, length, remote_addr, rkey),
+                 ucp_ep_h ep, const void *buffer, size_t length,
+                 uint64_t remote_addr, ucp_rkey_h rkey)
 {
     ucp_ep_rma_config_t *rma_config;
     ucs_status_t status;
@@ -42,45 +45,49 @@ ucs_status_t ucp_put(ucp_ep_h ep, const void *buffer, size_t length,
      */
     for (;;) {
         UCP_EP_RESOLVE_RKEY_RMA(ep, rkey, lane, uct_rkey, rma_config);
+
+        UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
         if (length <= rma_config->max_put_short) {
-            status = uct_ep_put_short(ep->uct_eps[lane], buffer, length,
+            frag_length = length;
+            status = uct_ep_put_short(ep->uct_eps[lane], buffer, frag_length,
+                                      remote_addr, uct_rkey);
+        } else if (length <= ucp_ep_config(ep)->bcopy_thresh) {
+            frag_length = ucs_min(length, rma_config->max_put_short);
+            status = uct_ep_put_short(ep->uct_eps[lane], buffer, frag_length,
                                       remote_addr, uct_rkey);
-            if (ucs_likely(status != UCS_ERR_NO_RESOURCE)) {
-                break;
-            }
         } else {
-            if (length <= ucp_ep_config(ep)->bcopy_thresh) {
-                frag_length = ucs_min(length, rma_config->max_put_short);
-                status = uct_ep_put_short(ep->uct_eps[lane], buffer, frag_length,
-                                          remote_addr, uct_rkey);
-            } else {
-                ucp_memcpy_pack_context_t pack_ctx;
-                pack_ctx.src    = buffer;
-                pack_ctx.length = frag_length =
-                                ucs_min(length, rma_config->max_put_bcopy);
-                packed_len = uct_ep_put_bcopy(ep->uct_eps[lane], ucp_memcpy_pack,
-                                              &pack_ctx, remote_addr, uct_rkey);
-                status = (packed_len > 0) ? UCS_OK : (ucs_status_t)packed_len;
-            }
-            if (ucs_likely(status == UCS_OK)) {
-                length      -= frag_length;
-                if (length == 0) {
-                    break;
-                }
-
-                buffer      += frag_length;
-                remote_addr += frag_length;
-            } else if (status != UCS_ERR_NO_RESOURCE) {
+            ucp_memcpy_pack_context_t pack_ctx;
+            pack_ctx.src    = buffer;
+            pack_ctx.length = frag_length =
+                            ucs_min(length, rma_config->max_put_bcopy);
+            packed_len = uct_ep_put_bcopy(ep->uct_eps[lane], ucp_memcpy_pack,
+                                          &pack_ctx, remote_addr, uct_rkey);
+            status = (packed_len > 0) ? UCS_OK : (ucs_status_t)packed_len;
+        }
+        UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+
+        if (ucs_likely(status == UCS_OK)) {
+            length      -= frag_length;
+            if (length == 0) {
                 break;
             }
+
+            buffer      += frag_length;
+            remote_addr += frag_length;
+        } else if (status != UCS_ERR_NO_RESOURCE) {
+            break;
         }
+
+        /* Progress must not be called with the worker lock held, so other
+         * threads can make progress while we wait for resources */
         ucp_worker_progress(ep->worker);
     }
 
     return status;
 }
 
-static ucs_status_t ucp_progress_put_nbi(uct_pending_req_t *self)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_progress_put_nbi, (self),
+                        uct_pending_req_t *self)
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct);
     ucp_rkey_h rkey    = req->send.rma.rkey;
@@ -136,10 +143,15 @@ ucp_rma_start_nbi(ucp_ep_h ep, const void *buffer, size_t length,
                   uct_pending_callback_t cb)
 {
     ucp_request_t *req;
+    ucs_status_t status;
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
+    UCS_MEMTRACK_HOT_PATH_ENTER();
 
     req = ucp_request_get(ep->worker);
     if (req == NULL) {
-        return UCS_ERR_NO_MEMORY;
+        status = UCS_ERR_NO_MEMORY;
+        goto out;
     }
 
     req->flags                = UCP_REQUEST_FLAG_RELEASED; /* Implicit release */
@@ -153,11 +165,18 @@ ucp_rma_start_nbi(ucp_ep_h ep, const void *buffer, size_t length,
     req->send.cb              = NULL;
     req->send.lane            = UCP_NULL_LANE;
 #endif
-    return ucp_request_start_send(req);
+    status = ucp_request_start_send(req);
+
+out:
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+    return status;
 }
 
-ucs_status_t ucp_put_nbi(ucp_ep_h ep, const void *buffer, size_t length,
-                         uint64_t remote_addr, ucp_rkey_h rkey)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_put_nbi,
+                 (ep, buffer, length, remote_addr, rkey),
+                 ucp_ep_h ep, const void *buffer, size_t length,
+                 uint64_t remote_addr, ucp_rkey_h rkey)
 {
     ucp_ep_rma_config_t *rma_config;
     ucp_lane_index_t lane;
@@ -169,8 +188,10 @@ ucs_status_t ucp_put_nbi(ucp_ep_h ep, const void *buffer, size_t length,
 
     /* Fast path for a single short message */
     if (length <= rma_config->max_put_short) {
+        UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
         status = uct_ep_put_short(ep->uct_eps[lane], buffer, length, remote_addr,
                                   uct_rkey);
+        UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
         if (ucs_likely(status != UCS_ERR_NO_RESOURCE)) {
             /* Return on error or success */
             return status;
@@ -182,8 +203,10 @@ ucs_status_t ucp_put_nbi(ucp_ep_h ep, const void *buffer, size_t length,
     return UCS_INPROGRESS;
 }
 
-ucs_status_t ucp_get(ucp_ep_h ep, void *buffer, size_t length,
-                     uint64_t remote_addr, ucp_rkey_h rkey)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_get,
+                 (ep, buffer, length, remote_addr, rkey),
+                 ucp_ep_h ep, void *buffer, size_t length,
+                 uint64_t remote_addr, ucp_rkey_h rkey)
 {
     ucp_ep_rma_config_t *rma_config;
     uct_completion_t comp;
@@ -203,13 +226,19 @@ ucs_status_t ucp_get(ucp_ep_h ep, void *buffer, size_t length,
          * fragment.
          */
         frag_length = ucs_min(rma_config->max_get_bcopy, length);
+
+        /* The completion counter is also updated from progress, so it is
+         * incremented under the same lock */
+        UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
         status = uct_ep_get_bcopy(ep->uct_eps[lane], (uct_unpack_callback_t)memcpy,
                                   (void*)buffer, frag_length, remote_addr,
                                   uct_rkey, &comp);
-        if (ucs_likely(status == UCS_OK)) {
-            goto posted;
-        } else if (status == UCS_INPROGRESS) {
+        if (status == UCS_INPROGRESS) {
             ++comp.count;
+        }
+        UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+
+        if (ucs_likely((status == UCS_OK) || (status == UCS_INPROGRESS))) {
             goto posted;
         } else if (status == UCS_ERR_NO_RESOURCE) {
             goto retry;
@@ -236,7 +265,8 @@ retry:
     return UCS_OK;
 }
 
-static ucs_status_t ucp_progress_get_nbi(uct_pending_req_t *self)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_progress_get_nbi, (self),
+                        uct_pending_req_t *self)
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct);
     ucp_rkey_h rkey    = req->send.rma.rkey;
@@ -273,8 +303,10 @@ static ucs_status_t ucp_progress_get_nbi(uct_pending_req_t *self)
     }
 }
 
-ucs_status_t ucp_get_nbi(ucp_ep_h ep, void *buffer, size_t length,
-                         uint64_t remote_addr, ucp_rkey_h rkey)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_get_nbi,
+                 (ep, buffer, length, remote_addr, rkey),
+                 ucp_ep_h ep, void *buffer, size_t length,
+                 uint64_t remote_addr, ucp_rkey_h rkey)
 {
     ucp_ep_rma_config_t *rma_config;
     ucp_lane_index_t lane;
@@ -285,6 +317,7 @@ ucs_status_t ucp_get_nbi(ucp_ep_h ep, void *buffer, size_t length,
     UCP_EP_RESOLVE_RKEY_RMA(ep, rkey, lane, uct_rkey, rma_config);
 
     if (length <= rma_config->max_get_bcopy) {
+        UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
         status = uct_ep_get_bcopy(ep->uct_eps[lane],
                                   (uct_unpack_callback_t)memcpy,
                                   (void*)buffer,
@@ -292,6 +325,7 @@ ucs_status_t ucp_get_nbi(ucp_ep_h ep, void *buffer, size_t length,
                                   remote_addr,
                                   uct_rkey,
                                   NULL);
+        UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
         if (ucs_likely(status != UCS_ERR_NO_RESOURCE)) {
             /* Return on error or success */
             return status;
@@ -308,6 +342,7 @@ ucs_status_t ucp_worker_fence(ucp_worker_h worker)
     unsigned rsc_index;
     ucs_status_t status;
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
     for (rsc_index = 0; rsc_index < worker->context->num_tls; ++rsc_index) {
         if (worker->ifaces[rsc_index] == NULL) {
             continue;
@@ -315,16 +350,20 @@ ucs_status_t ucp_worker_fence(ucp_worker_h worker)
 
         status = uct_iface_fence(worker->ifaces[rsc_index], 0);
         if (status != UCS_OK) {
-            return status;
+            goto out;
         }
     }
 
-    return UCS_OK;
+    status = UCS_OK;
+out:
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+    return status;
 }
 
-ucs_status_t ucp_worker_flush(ucp_worker_h worker)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_worker_flush, (worker), ucp_worker_h worker)
 {
     unsigned rsc_index;
+    ucs_status_t status;
 
     while (worker->stub_pend_count > 0) {
         ucp_worker_progress(worker);
@@ -336,7 +375,13 @@ ucs_status_t ucp_worker_flush(ucp_worker_h worker)
             continue;
         }
 
-        while (uct_iface_flush(worker->ifaces[rsc_index], 0, NULL) != UCS_OK) {
+        for (;;) {
+            UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+            status = uct_iface_flush(worker->ifaces[rsc_index], 0, NULL);
+            UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+            if (status == UCS_OK) {
+                break;
+            }
             ucp_worker_progress(worker);
         }
     }
@@ -344,14 +389,16 @@ ucs_status_t ucp_worker_flush(ucp_worker_h worker)
     return UCS_OK;
 }
 
-ucs_status_t ucp_ep_flush(ucp_ep_h ep)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_ep_flush, (ep), ucp_ep_h ep)
 {
     ucp_lane_index_t lane;
     ucs_status_t status;
 
     for (lane = 0; lane < ucp_ep_num_lanes(ep); ++lane) {
         for (;;) {
+            UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
             status = uct_ep_flush(ep->uct_eps[lane], 0, NULL);
+            UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
             if (status == UCS_OK) {
                 break;
             } else if ((status != UCS_INPROGRESS) && (status != UCS_ERR_NO_RESOURCE)) {
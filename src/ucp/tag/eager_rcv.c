@@ -9,7 +9,9 @@
 
 #include <ucp/core/ucp_context.h>
 #include <ucp/core/ucp_worker.h>
+#include <ucp/wireup/wireup.h>
 #include <ucs/datastruct/queue.h>
+#include <ucs/debug/profile.h>
 #include <ucp/core/ucp_request.inl>
 
 
@@ -40,10 +42,10 @@ ucp_eager_handler(void *arg, void *data, size_t length, void *desc,
             ucp_tag_log_match(recv_tag, req, req->recv.tag, req->recv.tag_mask,
                               req->recv.state.offset, "expected");
             recv_len = length - hdr_len;
-            status = ucp_tag_process_recv(req->recv.buffer, req->recv.count,
-                                          req->recv.datatype, &req->recv.state,
-                                          data + hdr_len, recv_len,
-                                          flags & UCP_RECV_DESC_FLAG_LAST);
+            status = UCS_PROFILE_CALL(ucp_tag_process_recv, req->recv.buffer,
+                                      req->recv.count, req->recv.datatype,
+                                      &req->recv.state, data + hdr_len,
+                                      recv_len, flags & UCP_RECV_DESC_FLAG_LAST);
 
             /* First fragment fills the receive information */
             if (flags & UCP_RECV_DESC_FLAG_FIRST) {
@@ -83,8 +85,9 @@ ucp_eager_handler(void *arg, void *data, size_t length, void *desc,
     return UCS_INPROGRESS;
 }
 
-static ucs_status_t ucp_eager_only_handler(void *arg, void *data, size_t length,
-                                           void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_only_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     return ucp_eager_handler(arg, data, length, desc,
                              UCP_RECV_DESC_FLAG_EAGER|
@@ -93,8 +96,9 @@ static ucs_status_t ucp_eager_only_handler(void *arg, void *data, size_t length,
                              sizeof(ucp_eager_hdr_t));
 }
 
-static ucs_status_t ucp_eager_first_handler(void *arg, void *data, size_t length,
-                                            void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_first_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     return ucp_eager_handler(arg, data, length, desc,
                              UCP_RECV_DESC_FLAG_EAGER|
@@ -102,16 +106,18 @@ static ucs_status_t ucp_eager_first_handler(void *arg, void *data, size_t length
                              sizeof(ucp_eager_first_hdr_t));
 }
 
-static ucs_status_t ucp_eager_middle_handler(void *arg, void *data, size_t length,
-                                             void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_middle_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     return ucp_eager_handler(arg, data, length, desc,
                              UCP_RECV_DESC_FLAG_EAGER,
                              sizeof(ucp_eager_hdr_t));
 }
 
-static ucs_status_t ucp_eager_last_handler(void *arg, void *data, size_t length,
-                                           void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_last_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     return ucp_eager_handler(arg, data, length, desc,
                              UCP_RECV_DESC_FLAG_EAGER|
@@ -119,12 +125,15 @@ static ucs_status_t ucp_eager_last_handler(void *arg, void *data, size_t length,
                              sizeof(ucp_eager_hdr_t));
 }
 
-static ucs_status_t ucp_eager_sync_only_handler(void *arg, void *data,
-                                                size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_sync_only_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
-    ucp_eager_sync_hdr_t *eagers_hdr;
+    ucp_eager_sync_hdr_t *eagers_hdr = data;
     ucs_status_t status;
 
+    ucp_wireup_check_implicit_ack(arg, eagers_hdr->req.sender_uuid);
+
     status = ucp_eager_handler(arg, data, length, desc,
                                UCP_RECV_DESC_FLAG_EAGER|
                                UCP_RECV_DESC_FLAG_FIRST|
@@ -132,34 +141,36 @@ static ucs_status_t ucp_eager_sync_only_handler(void *arg, void *data,
                                UCP_RECV_DESC_FLAG_SYNC,
                                sizeof(ucp_eager_sync_hdr_t));
     if (status == UCS_OK) {
-        eagers_hdr = data;
         ucp_tag_eager_sync_send_ack(arg, eagers_hdr->req.sender_uuid,
                                     eagers_hdr->req.reqptr);
     }
     return status;
 }
 
-static ucs_status_t ucp_eager_sync_first_handler(void *arg, void *data,
-                                                 size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_sync_first_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
-    ucp_eager_sync_first_hdr_t *eagers_first_hdr;
+    ucp_eager_sync_first_hdr_t *eagers_first_hdr = data;
     ucs_status_t status;
 
+    ucp_wireup_check_implicit_ack(arg, eagers_first_hdr->req.sender_uuid);
+
     status = ucp_eager_handler(arg, data, length, desc,
                                UCP_RECV_DESC_FLAG_EAGER|
                                UCP_RECV_DESC_FLAG_FIRST|
                                UCP_RECV_DESC_FLAG_SYNC,
                                sizeof(ucp_eager_sync_first_hdr_t));
     if (status == UCS_OK) {
-        eagers_first_hdr = data;
         ucp_tag_eager_sync_send_ack(arg, eagers_first_hdr->req.sender_uuid,
                                     eagers_first_hdr->req.reqptr);
     }
     return status;
 }
 
-static ucs_status_t ucp_eager_sync_ack_handler(void *arg, void *data,
-                                               size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_eager_sync_ack_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_reply_hdr_t *rep_hdr = data;
     ucp_request_t *req;
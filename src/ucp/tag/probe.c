@@ -11,6 +11,7 @@
 #include <ucp/api/ucp.h>
 #include <ucp/core/ucp_worker.h>
 #include <ucs/datastruct/queue.h>
+#include <ucs/debug/profile.h>
 
 
 static UCS_F_ALWAYS_INLINE ucp_recv_desc_t*
@@ -52,12 +53,21 @@ ucp_tag_probe_search(ucp_context_h context, ucp_tag_t tag, uint64_t tag_mask,
     return NULL;
 }
 
-ucp_tag_message_h ucp_tag_probe_nb(ucp_worker_h worker, ucp_tag_t tag,
-                                   ucp_tag_t tag_mask, int remove,
-                                   ucp_tag_recv_info_t *info)
+UCS_PROFILE_FUNC(ucp_tag_message_h, ucp_tag_probe_nb,
+                 (worker, tag, tag_mask, remove, info),
+                 ucp_worker_h worker, ucp_tag_t tag, ucp_tag_t tag_mask,
+                 int remove, ucp_tag_recv_info_t *info)
 {
     ucp_context_h context = worker->context;
+    ucp_recv_desc_t *rdesc;
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+    UCS_MEMTRACK_HOT_PATH_ENTER();
 
     ucs_trace_req("probe_nb tag %"PRIx64"/%"PRIx64, tag, tag_mask);
-    return ucp_tag_probe_search(context, tag, tag_mask, info, remove);
+    rdesc = ucp_tag_probe_search(context, tag, tag_mask, info, remove);
+
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+    return rdesc;
 }
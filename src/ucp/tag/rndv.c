@@ -7,7 +7,9 @@
 #include "rndv.h"
 #include <ucp/proto/proto_am.inl>
 #include <ucp/core/ucp_request.inl>
+#include <ucp/wireup/wireup.h>
 #include <ucs/datastruct/queue.h>
+#include <ucs/debug/profile.h>
 
 #define UCP_ALIGN 256
 #define UCP_MTU_SIZE 4096
@@ -36,7 +38,8 @@ static size_t ucp_tag_rndv_rts_pack(void *dest, void *arg)
     }
 }
 
-static ucs_status_t ucp_proto_progress_rndv_rts(uct_pending_req_t *self)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_proto_progress_rndv_rts, (self),
+                        uct_pending_req_t *self)
 {
     /* send the RTS. the pack_cb will pack all the necessary fields in the RTS */
     return ucp_do_am_bcopy_single(self, UCP_AM_ID_RNDV_RTS, ucp_tag_rndv_rts_pack);
@@ -57,7 +60,8 @@ static size_t ucp_tag_rndv_rtr_pack(void *dest, void *arg)
     return sizeof(*rndv_rtr_hdr);
 }
 
-static ucs_status_t ucp_proto_progress_rndv_rtr(uct_pending_req_t *self)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_proto_progress_rndv_rtr, (self),
+                        uct_pending_req_t *self)
 {
     ucp_request_t *op_req = ucs_container_of(self, ucp_request_t, send.uct);
     ucs_status_t status;
@@ -65,13 +69,37 @@ static ucs_status_t ucp_proto_progress_rndv_rtr(uct_pending_req_t *self)
     /* send the RTR. the pack_cb will pack all the necessary fields in the RTR */
     status = ucp_do_am_bcopy_single(self, UCP_AM_ID_RNDV_RTR, ucp_tag_rndv_rtr_pack);
     if (status == UCS_OK) {
-        ucs_mpool_put(op_req);
+        ucp_request_mpool_put(op_req);
     }
 
     return status;
 }
 
-ucs_status_t ucp_tag_send_start_rndv(ucp_request_t *sreq)
+/* Use the registration of a send buffer mapped in the background, if it's
+ * ready on the rendezvous lane */
+static ucs_status_t ucp_rndv_send_buffer_reg(ucp_request_t *sreq,
+                                             ucp_lane_index_t lane)
+{
+    ucp_context_h context = sreq->send.ep->worker->context;
+    ucp_mem_h memh;
+
+    memh = ucp_mem_reg_find(context, sreq->send.buffer, sreq->send.length);
+    if (memh != NULL) {
+        sreq->send.state.dt.contig.memh =
+                        ucp_memh_md_handle(memh, ucp_ep_md_index(sreq->send.ep, lane));
+        if (sreq->send.state.dt.contig.memh != UCT_INVALID_MEM_HANDLE) {
+            sreq->send.state.dt.contig.ucp_memh = memh;
+            return UCS_OK;
+        }
+
+        (void)ucp_mem_reg_put(context, memh);
+    }
+
+    return ucp_request_send_buffer_reg(sreq, lane);
+}
+
+UCS_PROFILE_FUNC(ucs_status_t, ucp_tag_send_start_rndv, (sreq),
+                 ucp_request_t *sreq)
 {
     ucs_status_t status;
 
@@ -81,7 +109,7 @@ ucs_status_t ucp_tag_send_start_rndv(ucp_request_t *sreq)
     ucp_ep_connect_remote(sreq->send.ep);
 
     /* zcopy */
-    status = ucp_request_send_buffer_reg(sreq, ucp_ep_get_rndv_get_lane(sreq->send.ep));
+    status = ucp_rndv_send_buffer_reg(sreq, ucp_ep_get_rndv_get_lane(sreq->send.ep));
     if (status != UCS_OK) {
         return status;
     }
@@ -112,18 +140,80 @@ static void ucp_rndv_complete_rndv_get(ucp_request_t *rndv_req)
 
     ucp_request_complete_recv(rreq, UCS_OK, &rreq->recv.info);
     uct_rkey_release(&rndv_req->send.rndv_get.rkey_bundle);
-    ucp_request_send_buffer_dereg(rndv_req,
-                                  ucp_ep_get_rndv_get_lane(rndv_req->send.ep));
+    if (rndv_req->send.state.dt.contig.memh != UCT_INVALID_MEM_HANDLE) {
+        ucp_request_send_buffer_dereg(rndv_req,
+                                      ucp_ep_get_rndv_get_lane(rndv_req->send.ep));
+    }
+    if (rndv_req->send.rndv_get.memh != NULL) {
+        (void)ucp_mem_reg_put(rndv_req->send.ep->worker->context,
+                              rndv_req->send.rndv_get.memh);
+    }
 
     ucp_rndv_send_ats(rndv_req, rndv_req->send.rndv_get.remote_request);
 }
 
-ucs_status_t ucp_proto_progress_rndv_get(uct_pending_req_t *self)
+/* Length of the get operation at the given offset of the receive buffer */
+static size_t ucp_rndv_get_frag_length(ucp_request_t *rndv_req, size_t offset)
+{
+    size_t remainder = (uintptr_t)rndv_req->send.buffer % UCP_ALIGN; /* TODO make UCP_ALIGN come from the transport */
+    size_t length;
+
+    if ((offset == 0) && remainder && (rndv_req->send.length > UCP_MTU_SIZE)) {
+        length = UCP_MTU_SIZE - remainder;
+    } else {
+        length = ucs_min(rndv_req->send.length - offset,
+                         ucp_ep_config(rndv_req->send.ep)->max_rndv_get_zcopy);
+    }
+
+    /* Every operation must be covered by a single registration chunk */
+    if (rndv_req->send.rndv_get.memh != NULL) {
+        length = ucp_memh_chunk_length(rndv_req->send.rndv_get.memh,
+                                       rndv_req->send.buffer + offset, length);
+    }
+    return length;
+}
+
+static void ucp_rndv_get_reg_slow_path_callback(ucs_callbackq_slow_elem_t *self)
+{
+    ucp_request_t *rndv_req = ucs_container_of(self, ucp_request_t,
+                                               send.rndv_get.cbq_elem);
+
+    uct_worker_slowpath_progress_unregister(rndv_req->send.ep->worker->uct,
+                                            &rndv_req->send.rndv_get.cbq_elem);
+    ucp_request_start_send(rndv_req);
+}
+
+/*
+ * The receive buffer is mapped in the background, and the next part of it is
+ * not registered yet. Resume from worker progress, or register the buffer here
+ * if the background registration has failed.
+ */
+static ucs_status_t ucp_rndv_get_wait_reg(ucp_request_t *rndv_req)
+{
+    ucs_status_t status;
+
+    if (rndv_req->send.rndv_get.memh->reg_status == UCS_INPROGRESS) {
+        ucs_trace_data("rndv_req %p: waiting for registration of offset %zu",
+                       rndv_req, rndv_req->send.state.offset);
+        rndv_req->send.rndv_get.cbq_elem.cb = ucp_rndv_get_reg_slow_path_callback;
+        uct_worker_slowpath_progress_register(rndv_req->send.ep->worker->uct,
+                                              &rndv_req->send.rndv_get.cbq_elem);
+        return UCS_OK;
+    }
+
+    status = ucp_request_send_buffer_reg(rndv_req, rndv_req->send.lane);
+    ucs_assert_always(status == UCS_OK);
+    return UCS_INPROGRESS;
+}
+
+UCS_PROFILE_FUNC(ucs_status_t, ucp_proto_progress_rndv_get, (self),
+                 uct_pending_req_t *self)
 {
     ucp_request_t *rndv_req = ucs_container_of(self, ucp_request_t, send.uct);
     ucs_status_t status;
     size_t offset, length;
     uct_iov_t iov[1];
+    uct_mem_h memh;
 
     if (ucp_ep_is_stub(rndv_req->send.ep)) {
         return UCS_ERR_NO_RESOURCE;
@@ -136,33 +226,44 @@ ucs_status_t ucp_proto_progress_rndv_get(uct_pending_req_t *self)
                    rndv_req->send.ep, rndv_req, rndv_req->send.lane);
 
     /* rndv_req is the internal request to perform the get operation */
-    if (rndv_req->send.state.dt.contig.memh == UCT_INVALID_MEM_HANDLE) {
-        /* TODO Not all UCTs need registration on the recv side */
-        status = ucp_request_send_buffer_reg(rndv_req, rndv_req->send.lane);
-        ucs_assert_always(status == UCS_OK);
+    if ((rndv_req->send.state.dt.contig.memh == UCT_INVALID_MEM_HANDLE) &&
+        (rndv_req->send.rndv_get.memh == NULL)) {
+        /* Use the chunks of a buffer mapped in the background as soon as they
+         * are registered */
+        if (ucp_ep_md_attr(rndv_req->send.ep, rndv_req->send.lane)->cap.flags &
+            UCT_MD_FLAG_REG) {
+            rndv_req->send.rndv_get.memh =
+                            ucp_mem_reg_find(rndv_req->send.ep->worker->context,
+                                             rndv_req->send.buffer,
+                                             rndv_req->send.length);
+        }
 
-        {
-            size_t max_get_zcopy = ucp_ep_config(rndv_req->send.ep)->max_rndv_get_zcopy;
-            size_t remainder = (uintptr_t) rndv_req->send.buffer % UCP_ALIGN; /* TODO make UCP_ALIGN come from the transport */
-
-            if (remainder && (rndv_req->send.length > UCP_MTU_SIZE )) {
-                rndv_req->send.uct_comp.count = 1 +
-                                               (rndv_req->send.length - (UCP_MTU_SIZE - remainder) +
-                                               max_get_zcopy - 1) / max_get_zcopy;
-            } else {
-                rndv_req->send.uct_comp.count = (rndv_req->send.length + max_get_zcopy - 1) / max_get_zcopy;
-            }
+        if (rndv_req->send.rndv_get.memh == NULL) {
+            /* TODO Not all UCTs need registration on the recv side */
+            status = ucp_request_send_buffer_reg(rndv_req, rndv_req->send.lane);
+            ucs_assert_always(status == UCS_OK);
+        }
+
+        rndv_req->send.uct_comp.count = 0;
+        for (offset = 0; offset < rndv_req->send.length; offset += length) {
+            length = ucp_rndv_get_frag_length(rndv_req, offset);
+            ++rndv_req->send.uct_comp.count;
         }
     }
 
     offset = rndv_req->send.state.offset;
-
-    if ((offset == 0) && ((uintptr_t)rndv_req->send.buffer % UCP_ALIGN) &&
-        (rndv_req->send.length > UCP_MTU_SIZE )) {
-        length = UCP_MTU_SIZE - ((uintptr_t)rndv_req->send.buffer % UCP_ALIGN);
-    } else {
-        length = ucs_min(rndv_req->send.length - offset,
-                         ucp_ep_config(rndv_req->send.ep)->max_rndv_get_zcopy);
+    length = ucp_rndv_get_frag_length(rndv_req, offset);
+
+    memh = rndv_req->send.state.dt.contig.memh;
+    if (memh == UCT_INVALID_MEM_HANDLE) {
+        memh = ucp_memh_chunk_handle(rndv_req->send.ep->worker->context,
+                                     rndv_req->send.rndv_get.memh,
+                                     ucp_ep_md_index(rndv_req->send.ep,
+                                                     rndv_req->send.lane),
+                                     rndv_req->send.buffer + offset, length);
+        if (memh == UCT_INVALID_MEM_HANDLE) {
+            return ucp_rndv_get_wait_reg(rndv_req);
+        }
     }
 
     ucs_trace_data("offset %zu remainder %zu. read to %p len %zu",
@@ -171,7 +272,7 @@ ucs_status_t ucp_proto_progress_rndv_get(uct_pending_req_t *self)
 
     iov[0].buffer = (void*)rndv_req->send.buffer + offset;
     iov[0].length = length;
-    iov[0].memh   = rndv_req->send.state.dt.contig.memh;
+    iov[0].memh   = memh;
     iov[0].count  = 1;
     iov[0].stride = 0;
     status = uct_ep_get_zcopy(ucp_ep_get_rndv_data_uct_ep(rndv_req->send.ep),
@@ -252,6 +353,7 @@ static void ucp_rndv_handle_recv_contig(ucp_request_t *rndv_req, ucp_request_t *
         rndv_req->send.state.offset   = 0;
         rndv_req->send.lane           = ucp_ep_get_rndv_get_lane(rndv_req->send.ep);
         rndv_req->send.state.dt.contig.memh = UCT_INVALID_MEM_HANDLE;
+        rndv_req->send.rndv_get.memh        = NULL;
     }
     ucp_request_start_send(rndv_req);
 }
@@ -285,7 +387,8 @@ static void ucp_rndv_handle_recv_generic(ucp_request_t *rndv_req, ucp_request_t
     ucp_request_start_send(rndv_req);
 }
 
-void ucp_rndv_matched(ucp_worker_h worker, ucp_request_t *rreq,
+UCS_PROFILE_FUNC_VOID(ucp_rndv_matched, (worker, rreq, rndv_rts_hdr),
+                      ucp_worker_h worker, ucp_request_t *rreq,
                       ucp_rndv_rts_hdr_t *rndv_rts_hdr)
 {
     ucp_request_t *rndv_req;
@@ -326,8 +429,9 @@ void ucp_rndv_matched(ucp_worker_h worker, ucp_request_t *rreq,
     UCS_ASYNC_UNBLOCK(&worker->async);
 }
 
-static ucs_status_t
-ucp_rndv_rts_handler(void *arg, void *data, size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_rts_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_worker_h worker = arg;
     ucp_rndv_rts_hdr_t *rndv_rts_hdr = data;
@@ -337,6 +441,8 @@ ucp_rndv_rts_handler(void *arg, void *data, size_t length, void *desc)
     ucp_request_t *rreq;
     ucs_queue_iter_t iter;
 
+    ucp_wireup_check_implicit_ack(worker, rndv_rts_hdr->sreq.sender_uuid);
+
     /* Search in expected queue */
     ucs_queue_for_each_safe(rreq, iter, &context->tag.expected, recv.queue) {
         rreq = ucs_container_of(*iter, ucp_request_t, recv.queue);
@@ -366,8 +472,9 @@ ucp_rndv_rts_handler(void *arg, void *data, size_t length, void *desc)
     return UCS_INPROGRESS;
 }
 
-static ucs_status_t
-ucp_rndv_ats_handler(void *arg, void *data, size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_ats_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_reply_hdr_t *rep_hdr = data;
     ucp_request_t *sreq = (ucp_request_t*) rep_hdr->reqptr;
@@ -422,7 +529,8 @@ static size_t ucp_rndv_pack_multi_data_last(void *dest, void *arg)
                                                sreq->send.datatype);
 }
 
-static ucs_status_t ucp_rndv_progress_send(uct_pending_req_t *self)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_progress_send, (self),
+                        uct_pending_req_t *self)
 {
     ucp_request_t *sreq = ucs_container_of(self, ucp_request_t, send.uct);
     ucp_ep_t *ep = sreq->send.ep;
@@ -455,8 +563,9 @@ static ucs_status_t ucp_rndv_progress_send(uct_pending_req_t *self)
     return status;
 }
 
-static ucs_status_t
-ucp_rndv_rtr_handler(void *arg, void *data, size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_rtr_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_rndv_rtr_hdr_t *rndv_rtr_hdr = data;
     ucp_request_t *sreq = (ucp_request_t*) rndv_rtr_hdr->sreq_ptr;
@@ -475,8 +584,9 @@ ucp_rndv_rtr_handler(void *arg, void *data, size_t length, void *desc)
     return UCS_OK;
 }
 
-static ucs_status_t
-ucp_rndv_data_handler(void *arg, void *data, size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_data_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_rndv_data_hdr_t *rndv_data_hdr = data;
     ucp_request_t *rreq = (ucp_request_t*) rndv_data_hdr->rreq_ptr;
@@ -497,8 +607,9 @@ ucp_rndv_data_handler(void *arg, void *data, size_t length, void *desc)
     return status;
 }
 
-static ucs_status_t
-ucp_rndv_data_last_handler(void *arg, void *data, size_t length, void *desc)
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_rndv_data_last_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_rndv_data_hdr_t *rndv_data_hdr = data;
     ucp_request_t *rreq = (ucp_request_t*) rndv_data_hdr->rreq_ptr;
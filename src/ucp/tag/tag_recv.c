@@ -13,6 +13,7 @@
 #include <ucs/datastruct/mpool.inl>
 #include <ucs/datastruct/queue.h>
 #include <ucs/debug/instrument.h>
+#include <ucs/debug/profile.h>
 
 
 static UCS_F_ALWAYS_INLINE ucs_status_t
@@ -80,6 +81,7 @@ ucp_tag_recv_request_init(ucp_request_t *req, ucp_worker_h worker, void* buffer,
     ucp_dt_generic_t *dt_gen;
     req->flags = UCP_REQUEST_FLAG_EXPECTED | UCP_REQUEST_FLAG_RECV | req_flags;
     req->recv.state.offset = 0;
+    UCP_REQUEST_STATS_START(req, worker->stats);
 
     switch (datatype & UCP_DATATYPE_CLASS_MASK) {
     case UCP_DATATYPE_IOV:
@@ -146,11 +148,14 @@ ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t count,
                   (req->flags & UCP_REQUEST_FLAG_EXTERNAL) ? 'r' : ' ',
                   buffer, count, tag, tag_mask);
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+
     /* First, search in unexpected list */
-    status = ucp_tag_search_unexp(worker, buffer, count, datatype, tag,
-                                  tag_mask, req, &req->recv.info, &save_rreq);
+    status = UCS_PROFILE_CALL(ucp_tag_search_unexp, worker, buffer, count,
+                              datatype, tag, tag_mask, req, &req->recv.info,
+                              &save_rreq);
     if (status != UCS_INPROGRESS) {
-        return status;
+        goto out;
     } else if (save_rreq) {
         /* If not found on unexpected, wait until it arrives.
          * If was found but need this receive request for later completion, save it */
@@ -165,16 +170,22 @@ ucp_tag_recv_common(ucp_worker_h worker, void *buffer, size_t count,
                       req, req + 1);
     }
 
+out:
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
     return status;
 }
 
-ucs_status_t ucp_tag_recv_nbr(ucp_worker_h worker, void *buffer, size_t count,
-                              uintptr_t datatype, ucp_tag_t tag,
-                              ucp_tag_t tag_mask, void *request)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_tag_recv_nbr,
+                 (worker, buffer, count, datatype, tag, tag_mask, request),
+                 ucp_worker_h worker, void *buffer, size_t count,
+                 uintptr_t datatype, ucp_tag_t tag, ucp_tag_t tag_mask,
+                 void *request)
 {
     ucp_request_t  *req = (ucp_request_t *)request - 1;
     ucs_status_t status;
 
+    UCS_MEMTRACK_HOT_PATH_ENTER();
+
     ucp_tag_recv_request_init(req, worker, buffer, count, datatype,
                               UCP_REQUEST_FLAG_EXTERNAL);
 
@@ -189,20 +200,26 @@ ucs_status_t ucp_tag_recv_nbr(ucp_worker_h worker, void *buffer, size_t count,
         ucp_tag_recv_request_completed(req, status, &req->recv.info, "recv_nbr");
     }
 
+    UCS_MEMTRACK_HOT_PATH_EXIT();
     return status;
 }
 
-ucs_status_ptr_t ucp_tag_recv_nb(ucp_worker_h worker, void *buffer,
-                                 size_t count, uintptr_t datatype,
-                                 ucp_tag_t tag, ucp_tag_t tag_mask,
-                                 ucp_tag_recv_callback_t cb)
+UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_recv_nb,
+                 (worker, buffer, count, datatype, tag, tag_mask, cb),
+                 ucp_worker_h worker, void *buffer, size_t count,
+                 uintptr_t datatype, ucp_tag_t tag, ucp_tag_t tag_mask,
+                 ucp_tag_recv_callback_t cb)
 {
     ucp_request_t *req;
     ucs_status_t status;
+    ucs_status_ptr_t ret;
+
+    UCS_MEMTRACK_HOT_PATH_ENTER();
 
     req = ucp_tag_recv_request_get(worker, buffer, count, datatype);
     if (ucs_unlikely(req == NULL)) {
-        return UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        ret = UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        goto out;
     }
 
     UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_RX, "ucp_tag_recv_nb", req,
@@ -217,26 +234,35 @@ ucs_status_ptr_t ucp_tag_recv_nb(ucp_worker_h worker, void *buffer,
         cb(req + 1, status, &req->recv.info);
         ucp_tag_recv_request_completed(req, status, &req->recv.info, "recv_nb");
     }
-    return req + 1;
+    ret = req + 1;
+
+out:
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    return ret;
 }
 
-ucs_status_ptr_t ucp_tag_msg_recv_nb(ucp_worker_h worker, void *buffer,
-                                     size_t count, ucp_datatype_t datatype,
-                                     ucp_tag_message_h message,
-                                     ucp_tag_recv_callback_t cb)
+UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_msg_recv_nb,
+                 (worker, buffer, count, datatype, message, cb),
+                 ucp_worker_h worker, void *buffer, size_t count,
+                 ucp_datatype_t datatype, ucp_tag_message_h message,
+                 ucp_tag_recv_callback_t cb)
 {
     ucp_recv_desc_t *rdesc = message;
     ucs_status_t status;
     ucp_request_t *req;
     ucp_tag_t tag;
     unsigned save_rreq = 1;
+    ucs_status_ptr_t ret;
+
+    UCS_MEMTRACK_HOT_PATH_ENTER();
 
     ucs_trace_req("msg_recv_nb buffer %p count %zu message %p", buffer, count,
                   message);
 
     req = ucp_tag_recv_request_get(worker, buffer, count, datatype);
     if (req == NULL) {
-        return UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        ret = UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        goto out;
     }
 
     UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_RX, "ucp_tag_msg_recv_nb", req,
@@ -244,6 +270,8 @@ ucs_status_ptr_t ucp_tag_msg_recv_nb(ucp_worker_h worker, void *buffer,
 
     req->recv.cb       = cb;
 
+    UCP_THREAD_CS_ENTER_CONDITIONAL(worker);
+
     /* First, handle the first packet that was already matched */
     if (rdesc->flags & UCP_RECV_DESC_FLAG_EAGER) {
         tag = ((ucp_tag_hdr_t*)(rdesc + 1))->tag;
@@ -261,8 +289,10 @@ ucs_status_ptr_t ucp_tag_msg_recv_nb(ucp_worker_h worker, void *buffer,
         status = UCS_INPROGRESS;
         save_rreq = 0;
     } else {
-        ucs_mpool_put(req);
-        return UCS_STATUS_PTR(UCS_ERR_INVALID_PARAM);
+        UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+        ucp_request_mpool_put(req);
+        ret = UCS_STATUS_PTR(UCS_ERR_INVALID_PARAM);
+        goto out;
     }
 
     /* Since the message contains only the first fragment, we might want
@@ -287,7 +317,12 @@ ucs_status_ptr_t ucp_tag_msg_recv_nb(ucp_worker_h worker, void *buffer,
         req->recv.datatype = datatype;
         ucs_queue_push(&worker->context->tag.expected, &req->recv.queue);
     }
-    return req + 1;
+    UCP_THREAD_CS_EXIT_CONDITIONAL(worker);
+    ret = req + 1;
+
+out:
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    return ret;
 }
 
 void ucp_tag_cancel_expected(ucp_context_h context, ucp_request_t *req)
@@ -14,6 +14,7 @@
 #include <ucp/core/ucp_request.inl>
 #include <ucs/datastruct/mpool.inl>
 #include <ucs/debug/instrument.h>
+#include <ucs/debug/profile.h>
 #include <string.h>
 
 static ucs_status_t ucp_tag_req_start_contig(ucp_request_t *req, size_t count,
@@ -155,7 +156,7 @@ ucp_tag_send_req(ucp_request_t *req, size_t count, ssize_t max_short,
     if (req->flags & UCP_REQUEST_FLAG_COMPLETED) {
         ucs_trace_req("releasing send request %p, returning status %s", req,
                       ucs_status_string(status));
-        ucs_mpool_put(req);
+        ucp_request_mpool_put(req);
         return UCS_STATUS_PTR(status);
     }
 
@@ -184,38 +185,54 @@ static void ucp_tag_send_req_init(ucp_request_t* req, ucp_ep_h ep,
 #if ENABLE_ASSERT
     req->send.lane         = UCP_NULL_LANE;
 #endif
+    UCP_REQUEST_STATS_START(req, ep->worker->stats);
 }
 
-ucs_status_ptr_t ucp_tag_send_nb(ucp_ep_h ep, const void *buffer, size_t count,
-                                 uintptr_t datatype, ucp_tag_t tag,
-                                 ucp_send_callback_t cb)
+UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_send_nb,
+                 (ep, buffer, count, datatype, tag, cb),
+                 ucp_ep_h ep, const void *buffer, size_t count,
+                 uintptr_t datatype, ucp_tag_t tag, ucp_send_callback_t cb)
 {
     ucs_status_t status;
     ucp_request_t *req;
     size_t length;
+    ucs_status_ptr_t ret;
+
+    UCS_MEMTRACK_HOT_PATH_ENTER();
 
     ucs_trace_req("send_nb buffer %p count %zu tag %"PRIx64" to %s cb %p",
                   buffer, count, tag, ucp_ep_peer_name(ep), cb);
 
+    status = ucp_ep_resolve_lazy(ep);
+    if (ucs_unlikely(status != UCS_OK)) {
+        ret = UCS_STATUS_PTR(status);
+        goto out;
+    }
+
     if (ucs_likely(UCP_DT_IS_CONTIG(datatype))) {
         length = ucp_contig_dt_length(datatype, count);
         UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_TX,
                               "ucp_tag_send_nb (eager - start)",
                               buffer, length);
         if (ucs_likely(length <= ucp_ep_config(ep)->max_eager_short)) {
-            status = ucp_tag_send_eager_short(ep, tag, buffer, length);
+            UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
+            status = UCS_PROFILE_CALL(ucp_tag_send_eager_short, ep, tag,
+                                      buffer, length);
+            UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
             if (ucs_likely(status != UCS_ERR_NO_RESOURCE)) {
                 UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_TX,
                                       "ucp_tag_send_nb (eager - finish)",
                                       buffer, length);
-                return UCS_STATUS_PTR(status); /* UCS_OK also goes here */
+                ret = UCS_STATUS_PTR(status); /* UCS_OK also goes here */
+                goto out;
             }
         }
     }
 
     req = ucp_request_get(ep->worker);
     if (req == NULL) {
-        return UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        ret = UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        goto out;
     }
 
     UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_TX, "ucp_tag_send_nb", req,
@@ -223,40 +240,63 @@ ucs_status_ptr_t ucp_tag_send_nb(ucp_ep_h ep, const void *buffer, size_t count,
 
     ucp_tag_send_req_init(req, ep, buffer, datatype, tag);
 
-    return ucp_tag_send_req(req, count,
-                            ucp_ep_config(ep)->max_eager_short,
-                            ucp_ep_config(ep)->zcopy_thresh,
-                            ucp_ep_config(ep)->rndv_thresh,
-                            cb, &ucp_tag_eager_proto);
+    UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
+    ret = ucp_tag_send_req(req, count,
+                           ucp_ep_config(ep)->max_eager_short,
+                           ucp_ep_config(ep)->zcopy_thresh,
+                           ucp_ep_config(ep)->rndv_thresh,
+                           cb, &ucp_tag_eager_proto);
+    UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+out:
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    return ret;
 }
 
-ucs_status_ptr_t ucp_tag_send_sync_nb(ucp_ep_h ep, const void *buffer, size_t count,
-                                      ucp_datatype_t datatype, ucp_tag_t tag,
-                                      ucp_send_callback_t cb)
+UCS_PROFILE_FUNC(ucs_status_ptr_t, ucp_tag_send_sync_nb,
+                 (ep, buffer, count, datatype, tag, cb),
+                 ucp_ep_h ep, const void *buffer, size_t count,
+                 ucp_datatype_t datatype, ucp_tag_t tag, ucp_send_callback_t cb)
 {
+    ucs_status_t status;
     ucp_request_t *req;
+    ucs_status_ptr_t ret;
+
+    UCS_MEMTRACK_HOT_PATH_ENTER();
 
     ucs_trace_req("send_sync_nb buffer %p count %zu tag %"PRIx64" to %s cb %p",
                   buffer, count, tag, ucp_ep_peer_name(ep), cb);
 
+    status = ucp_ep_resolve_lazy(ep);
+    if (ucs_unlikely(status != UCS_OK)) {
+        ret = UCS_STATUS_PTR(status);
+        goto out;
+    }
+
     req = ucp_request_get(ep->worker);
     if (req == NULL) {
-        return UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        ret = UCS_STATUS_PTR(UCS_ERR_NO_MEMORY);
+        goto out;
     }
 
     UCS_INSTRUMENT_RECORD(UCS_INSTRUMENT_TYPE_UCP_TX, "ucp_tag_send_sync_nb", req,
                           ucp_dt_length(datatype, count, buffer, &req->send.state));
 
+    ucp_tag_send_req_init(req, ep, buffer, datatype, tag);
+
+    UCP_THREAD_CS_ENTER_CONDITIONAL(ep->worker);
+
     /* Remote side needs to send reply, so have it connect to us */
     ucp_ep_connect_remote(ep);
 
-    ucp_tag_send_req_init(req, ep, buffer, datatype, tag);
-
-    return ucp_tag_send_req(req, count,
-                            -1, /* disable short method */
-                            ucp_ep_config(ep)->sync_zcopy_thresh,
-                            ucp_ep_config(ep)->sync_rndv_thresh,
-                            cb, &ucp_tag_eager_sync_proto);
+    ret = ucp_tag_send_req(req, count,
+                           -1, /* disable short method */
+                           ucp_ep_config(ep)->sync_zcopy_thresh,
+                           ucp_ep_config(ep)->sync_rndv_thresh,
+                           cb, &ucp_tag_eager_sync_proto);
+    UCP_THREAD_CS_EXIT_CONDITIONAL(ep->worker);
+out:
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    return ret;
 }
 
 void ucp_tag_eager_sync_send_ack(ucp_worker_h worker, uint64_t sender_uuid,
@@ -11,54 +11,75 @@
 #include <ucp/core/ucp_ep.inl>
 #include <ucs/arch/bitops.h>
 #include <ucs/debug/log.h>
+#include <float.h>
 #include <string.h>
 
 
 /*
  * Packed address layout:
  *
- * [ uuid(64bit) | worker_name(string) ]
- * [ device1_md_index | device1_address(var) ]
- *    [ tl1_name_csum(string) | tl1_info | tl1_address(var) ]
- *    [ tl2_name_csum(string) | tl2_info | tl2_address(var) ]
+ * [ uuid(64bit) | header_flags(8bit) | worker_name(string, if not short) ]
+ * [ device1_md_index | device1_address_length | device1_address(var) ]
+ *    [ tl1_name_csum(16bit) | tl1_address_length | tl1_info | tl1_address(var) ]
+ *    [ tl2_name_csum(16bit) | tl2_address_length | tl2_info | tl2_address(var) ]
  *    ...
- * [ device2_md_index | device2_address(var) ]
+ * [ device2_md_index | device2_address_length | device2_address(var) ]
  *    ...
  *
- *   * Last address in the tl address list, it's address will have the flag LAST.
+ *   * Last address in the tl address list, it's address length will have the
+ *     flag LAST. The same goes for the last device.
  *   * If a device does not have tl addresses, it's md_index will have the flag
  *     EMPTY.
  *   * If the address list is empty, then it will contain only a single md_index
  *     which equals to UCP_NULL_RESOURCE.
+ *   * If a device address is identical to the address of a previous device, it
+ *     is replaced by the 8-bit number of that device, and the device address
+ *     length has the flag DUP_DEV.
+ *   * If tl_info is identical to the tl_info of the previous transport, it is
+ *     omitted, and the tl address length has the flag SAME_ATTR.
+ *   * In a short address (header flag SHORT), tl_info contains only the
+ *     priority and capability flags, without performance estimations.
  *
  */
 
 
+#define UCP_ADDRESS_HDR_FLAG_NAME     0x01   /* Worker name is packed */
+#define UCP_ADDRESS_HDR_FLAG_SHORT    0x02   /* No performance attributes */
+
+#define UCP_ADDRESS_FLAG_LAST         0x80   /* Last address in the list */
+#define UCP_ADDRESS_FLAG_SAME_ATTR    0x40   /* Same tl_info as previous tl */
+#define UCP_ADDRESS_FLAG_DUP_DEV      0x40   /* Reference to a previous device */
+#define UCP_ADDRESS_FLAG_LEN_MASK     UCS_MASK(6)
+#define UCP_ADDRESS_FLAG_EMPTY        0x80   /* Device without TL addresses */
+#define UCP_ADDRESS_FLAG_MD_ALLOC     0x40   /* MD can register  */
+#define UCP_ADDRESS_FLAG_MD_REG       0x20   /* MD can allocate */
+#define UCP_ADDRESS_FLAG_MD_MASK      ~(UCP_ADDRESS_FLAG_EMPTY | \
+                                        UCP_ADDRESS_FLAG_MD_ALLOC | \
+                                        UCP_ADDRESS_FLAG_MD_REG)
+
+
 typedef struct {
     const char       *dev_name;
     size_t           dev_addr_len;
     uint64_t         tl_bitmap;
+    uint64_t         same_attr_map;  /* Transports which have the same
+                                        attributes as the previous one */
     ucp_rsc_index_t  rsc_index;
+    ucp_rsc_index_t  dup_index;      /* Previous device with the same address,
+                                        or UCP_NULL_RESOURCE */
     ucp_rsc_index_t  tl_count;
     size_t           tl_addrs_size;
+    uint8_t          dev_addr[UCP_ADDRESS_FLAG_LEN_MASK];
 } ucp_address_packed_device_t;
 
 
 typedef struct {
+    uint32_t         prio_cap_flags; /* 8 lsb: prio, 24 msb - cap flags */
     float            overhead;
     float            bandwidth;
-    uint32_t         prio_cap_flags; /* 8 lsb: prio, 24 msb - cap flags */
 } ucp_address_packed_iface_attr_t;
 
 
-#define UCP_ADDRESS_FLAG_LAST         0x80   /* Last address in the list */
-#define UCP_ADDRESS_FLAG_EMPTY        0x80   /* Device without TL addresses */
-#define UCP_ADDRESS_FLAG_MD_ALLOC     0x40   /* MD can register  */
-#define UCP_ADDRESS_FLAG_MD_REG       0x20   /* MD can allocate */
-#define UCP_ADDRESS_FLAG_MD_MASK      ~(UCP_ADDRESS_FLAG_EMPTY | \
-                                        UCP_ADDRESS_FLAG_MD_ALLOC | \
-                                        UCP_ADDRESS_FLAG_MD_REG)
-
 static size_t ucp_address_string_packed_size(const char *s)
 {
     return strlen(s) + 1;
@@ -88,6 +109,84 @@ static const void* ucp_address_unpack_string(const void *src, char *s, size_t ma
     return src + length + 1;
 }
 
+static uint8_t ucp_address_header_flags(unsigned flags)
+{
+    /* The name identifies the peer in errors, a short address drops it */
+    return (flags & UCP_ADDRESS_PACK_FLAG_SHORT) ? UCP_ADDRESS_HDR_FLAG_SHORT :
+                                                   UCP_ADDRESS_HDR_FLAG_NAME;
+}
+
+/* Size of the transport information, as packed in the address */
+static size_t ucp_address_iface_attr_size(uint8_t hdr_flags)
+{
+    return (hdr_flags & UCP_ADDRESS_HDR_FLAG_SHORT) ?
+           ucs_offsetof(ucp_address_packed_iface_attr_t, overhead) :
+           sizeof(ucp_address_packed_iface_attr_t);
+}
+
+static void ucp_address_pack_iface_attr(ucp_address_packed_iface_attr_t *packed,
+                                        const uct_iface_attr_t *iface_attr,
+                                        int enable_atomics)
+{
+    uint32_t packed_flag;
+    uint64_t cap_flags;
+    uint64_t bit;
+
+    cap_flags = iface_attr->cap.flags;
+    if (!enable_atomics) {
+        cap_flags &= ~(UCP_UCT_IFACE_ATOMIC32_FLAGS | UCP_UCT_IFACE_ATOMIC64_FLAGS);
+    }
+
+    packed->prio_cap_flags = ((uint8_t)iface_attr->priority);
+    packed->overhead       = iface_attr->overhead;
+    packed->bandwidth      = iface_attr->bandwidth;
+
+    /* Keep only the bits defined by UCP_ADDRESS_IFACE_FLAGS, to shrink address. */
+    packed_flag = UCS_BIT(8);
+    bit         = 1;
+    while (UCP_ADDRESS_IFACE_FLAGS & ~(bit - 1)) {
+        if (UCP_ADDRESS_IFACE_FLAGS & bit) {
+            if (cap_flags & bit) {
+                packed->prio_cap_flags |= packed_flag;
+            }
+            packed_flag <<= 1;
+        }
+        bit <<= 1;
+    }
+}
+
+static void
+ucp_address_unpack_iface_attr(ucp_address_iface_attr_t *iface_attr,
+                              const void *ptr, size_t attr_size)
+{
+    ucp_address_packed_iface_attr_t packed;
+    uint32_t packed_flag;
+    uint64_t bit;
+
+    /* A short address does not carry performance estimations, so assume the
+     * remote interface is not slower than the local one */
+    packed.overhead  = 0;
+    packed.bandwidth = FLT_MAX;
+    memcpy(&packed, ptr, attr_size);
+
+    iface_attr->cap_flags = 0;
+    iface_attr->priority  = packed.prio_cap_flags & UCS_MASK(8);
+    iface_attr->overhead  = packed.overhead;
+    iface_attr->bandwidth = packed.bandwidth;
+
+    packed_flag = UCS_BIT(8);
+    bit         = 1;
+    while (UCP_ADDRESS_IFACE_FLAGS & ~(bit - 1)) {
+        if (UCP_ADDRESS_IFACE_FLAGS & bit) {
+            if (packed.prio_cap_flags & packed_flag) {
+                iface_attr->cap_flags |= bit;
+            }
+            packed_flag <<= 1;
+        }
+        bit <<= 1;
+    }
+}
+
 static ucp_address_packed_device_t*
 ucp_address_get_device(const char *name, ucp_address_packed_device_t *devices,
                        ucp_rsc_index_t *num_devices_p)
@@ -107,8 +206,77 @@ out:
     return dev;
 }
 
+/* Get device addresses, and find devices whose address was already packed */
+static ucs_status_t
+ucp_address_gather_dev_addrs(ucp_worker_h worker,
+                             ucp_address_packed_device_t *devices,
+                             ucp_rsc_index_t num_devices)
+{
+    ucp_address_packed_device_t *dev, *prev;
+    ucs_status_t status;
+
+    for (dev = devices; dev < devices + num_devices; ++dev) {
+        dev->dup_index = UCP_NULL_RESOURCE;
+        if (dev->dev_addr_len == 0) {
+            continue;
+        }
+
+        ucs_assert_always(dev->dev_addr_len <= sizeof(dev->dev_addr));
+        status = uct_iface_get_device_address(worker->ifaces[dev->rsc_index],
+                                              (uct_device_addr_t*)dev->dev_addr);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        for (prev = devices; prev < dev; ++prev) {
+            if ((prev->dup_index == UCP_NULL_RESOURCE) &&
+                (prev->dev_addr_len == dev->dev_addr_len) &&
+                !memcmp(prev->dev_addr, dev->dev_addr, dev->dev_addr_len))
+            {
+                dev->dup_index = prev - devices;
+                break;
+            }
+        }
+    }
+
+    return UCS_OK;
+}
+
+/* Find transports whose packed attributes are the same as the previous one's */
+static void ucp_address_gather_same_attrs(ucp_worker_h worker,
+                                          ucp_address_packed_device_t *devices,
+                                          ucp_rsc_index_t num_devices,
+                                          size_t attr_size)
+{
+    ucp_context_h context = worker->context;
+    ucp_address_packed_iface_attr_t attr, prev_attr;
+    ucp_address_packed_device_t *dev;
+    ucp_rsc_index_t i;
+    int has_prev;
+
+    has_prev = 0;
+    for (dev = devices; dev < devices + num_devices; ++dev) {
+        for (i = 0; i < context->num_tls; ++i) {
+            if (!(UCS_BIT(i) & dev->tl_bitmap)) {
+                continue;
+            }
+
+            ucp_address_pack_iface_attr(&attr, &worker->iface_attrs[i],
+                                        worker->atomic_tls & UCS_BIT(i));
+            if (has_prev && !memcmp(&attr, &prev_attr, attr_size)) {
+                dev->same_attr_map |= UCS_BIT(i);
+                dev->tl_addrs_size -= attr_size;
+            }
+
+            prev_attr = attr;
+            has_prev  = 1;
+        }
+    }
+}
+
 static ucs_status_t
 ucp_address_gather_devices(ucp_worker_h worker, uint64_t tl_bitmap, int has_ep,
+                           size_t attr_size,
                            ucp_address_packed_device_t **devices_p,
                            ucp_rsc_index_t *num_devices_p)
 {
@@ -116,6 +284,7 @@ ucp_address_gather_devices(ucp_worker_h worker, uint64_t tl_bitmap, int has_ep,
     ucp_address_packed_device_t *dev, *devices;
     uct_iface_attr_t *iface_attr;
     ucp_rsc_index_t num_devices;
+    ucs_status_t status;
     ucp_rsc_index_t i;
     uint64_t mask;
 
@@ -149,27 +318,37 @@ ucp_address_gather_devices(ucp_worker_h worker, uint64_t tl_bitmap, int has_ep,
         }
 
         dev->tl_addrs_size += sizeof(uint16_t); /* tl name checksum */
-        dev->tl_addrs_size += sizeof(ucp_address_packed_iface_attr_t); /* iface attr */
         dev->tl_addrs_size += 1;                /* address length */
+        dev->tl_addrs_size += attr_size;        /* iface attr */
         dev->rsc_index      = i;
         dev->dev_addr_len   = iface_attr->device_addr_len;
         dev->tl_bitmap     |= mask;
     }
 
+    status = ucp_address_gather_dev_addrs(worker, devices, num_devices);
+    if (status != UCS_OK) {
+        ucs_free(devices);
+        return status;
+    }
+
+    ucp_address_gather_same_attrs(worker, devices, num_devices, attr_size);
+
     *devices_p     = devices;
     *num_devices_p = num_devices;
     return UCS_OK;
 }
 
-static size_t ucp_address_packed_size(ucp_worker_h worker,
+static size_t ucp_address_packed_size(ucp_worker_h worker, uint8_t hdr_flags,
                                       const ucp_address_packed_device_t *devices,
                                       ucp_rsc_index_t num_devices)
 {
     const ucp_address_packed_device_t *dev;
     size_t size;
 
-    size = sizeof(uint64_t) +
-           ucp_address_string_packed_size(ucp_worker_get_name(worker));
+    size = sizeof(uint64_t) + 1;        /* uuid, header flags */
+    if (hdr_flags & UCP_ADDRESS_HDR_FLAG_NAME) {
+        size += ucp_address_string_packed_size(ucp_worker_get_name(worker));
+    }
 
     if (num_devices == 0) {
         size += 1;                      /* NULL md_index */
@@ -177,7 +356,11 @@ static size_t ucp_address_packed_size(ucp_worker_h worker,
         for (dev = devices; dev < devices + num_devices; ++dev) {
             size += 1;                  /* device md_index */
             size += 1;                  /* device address length */
-            size += dev->dev_addr_len;  /* device address */
+            if (dev->dup_index != UCP_NULL_RESOURCE) {
+                size += 1;              /* previous device number */
+            } else {
+                size += dev->dev_addr_len; /* device address */
+            }
             size += dev->tl_addrs_size; /* transport addresses */
         }
     }
@@ -218,75 +401,23 @@ ucp_address_pack_ep_address(ucp_ep_h ep, ucp_rsc_index_t tl_index,
     return UCS_ERR_INVALID_ADDR;
 }
 
-static void ucp_address_pack_iface_attr(ucp_address_packed_iface_attr_t *packed,
-                                        const uct_iface_attr_t *iface_attr,
-                                        int enable_atomics)
-{
-    uint32_t packed_flag;
-    uint64_t cap_flags;
-    uint64_t bit;
-
-    cap_flags = iface_attr->cap.flags;
-    if (!enable_atomics) {
-        cap_flags &= ~(UCP_UCT_IFACE_ATOMIC32_FLAGS | UCP_UCT_IFACE_ATOMIC64_FLAGS);
-    }
-
-    packed->prio_cap_flags = ((uint8_t)iface_attr->priority);
-    packed->overhead       = iface_attr->overhead;
-    packed->bandwidth      = iface_attr->bandwidth;
-
-    /* Keep only the bits defined by UCP_ADDRESS_IFACE_FLAGS, to shrink address. */
-    packed_flag = 8;
-    bit         = 1;
-    while (UCP_ADDRESS_IFACE_FLAGS & ~(bit - 1)) {
-        if (UCP_ADDRESS_IFACE_FLAGS & bit) {
-            if (cap_flags & bit) {
-                packed->prio_cap_flags |= packed_flag;
-            }
-            packed_flag <<= 1;
-        }
-        bit <<= 1;
-    }
-}
-
-static void
-ucp_address_unpack_iface_attr(ucp_address_iface_attr_t *iface_attr,
-                              const ucp_address_packed_iface_attr_t *packed)
-{
-    uint32_t packed_flag;
-    uint64_t bit;
-
-    iface_attr->cap_flags = 0;
-    iface_attr->priority  = packed->prio_cap_flags & UCS_MASK(8);
-    iface_attr->overhead  = packed->overhead;
-    iface_attr->bandwidth = packed->bandwidth;
-
-    packed_flag = 8;
-    bit         = 1;
-    while (UCP_ADDRESS_IFACE_FLAGS & ~(bit - 1)) {
-        if (UCP_ADDRESS_IFACE_FLAGS & bit) {
-            if (packed->prio_cap_flags & packed_flag) {
-                iface_attr->cap_flags |= bit;
-            }
-            packed_flag <<= 1;
-        }
-        bit <<= 1;
-    }
-}
-
 static ucs_status_t ucp_address_do_pack(ucp_worker_h worker, ucp_ep_h ep,
                                         void *buffer, size_t size,
-                                        uint64_t tl_bitmap, unsigned *order,
+                                        uint64_t tl_bitmap, uint8_t hdr_flags,
+                                        unsigned *order,
                                         const ucp_address_packed_device_t *devices,
                                         ucp_rsc_index_t num_devices)
 {
     ucp_context_h context = worker->context;
+    size_t attr_size      = ucp_address_iface_attr_size(hdr_flags);
     const ucp_address_packed_device_t *dev;
+    ucp_address_packed_iface_attr_t attr;
     uct_iface_attr_t *iface_attr;
     ucp_rsc_index_t md_index;
     ucs_status_t status;
     ucp_rsc_index_t i;
     size_t tl_addr_len;
+    uint8_t *addr_len_ptr;
     uint64_t md_flags;
     unsigned index;
     void *ptr;
@@ -296,7 +427,11 @@ static ucs_status_t ucp_address_do_pack(ucp_worker_h worker, ucp_ep_h ep,
 
     *(uint64_t*)ptr = worker->uuid;
     ptr += sizeof(uint64_t);
-    ptr = ucp_address_pack_string(ucp_worker_get_name(worker), ptr);
+    *(uint8_t*)ptr = hdr_flags;
+    ++ptr;
+    if (hdr_flags & UCP_ADDRESS_HDR_FLAG_NAME) {
+        ptr = ucp_address_pack_string(ucp_worker_get_name(worker), ptr);
+    }
 
     if (num_devices == 0) {
         *((uint8_t*)ptr) = UCP_NULL_RESOURCE;
@@ -318,20 +453,27 @@ static ucs_status_t ucp_address_do_pack(ucp_worker_h worker, ucp_ep_h ep,
         ++ptr;
 
         /* Device address length */
-        ucs_assert(dev->dev_addr_len < UCP_ADDRESS_FLAG_LAST);
-        *(uint8_t*)ptr = dev->dev_addr_len | ((dev == (devices + num_devices - 1)) ?
-                                              UCP_ADDRESS_FLAG_LAST : 0);
+        if (dev->dev_addr_len > UCP_ADDRESS_FLAG_LEN_MASK) {
+            ucs_error("device %s address length %zu exceeds %d", dev->dev_name,
+                      dev->dev_addr_len, (int)UCP_ADDRESS_FLAG_LEN_MASK);
+            return UCS_ERR_UNSUPPORTED;
+        }
+        *(uint8_t*)ptr = dev->dev_addr_len |
+                         ((dev->dup_index != UCP_NULL_RESOURCE) ?
+                          UCP_ADDRESS_FLAG_DUP_DEV : 0) |
+                         ((dev == (devices + num_devices - 1)) ?
+                          UCP_ADDRESS_FLAG_LAST : 0);
         ++ptr;
 
-        /* Device address */
-        status = uct_iface_get_device_address(worker->ifaces[dev->rsc_index],
-                                              (uct_device_addr_t*)ptr);
-        if (status != UCS_OK) {
-            return status;
+        /* Device address, or the number of a device with the same address */
+        if (dev->dup_index != UCP_NULL_RESOURCE) {
+            *(uint8_t*)ptr = dev->dup_index;
+            ++ptr;
+        } else {
+            memcpy(ptr, dev->dev_addr, dev->dev_addr_len);
+            ptr += dev->dev_addr_len;
         }
 
-        ptr += dev->dev_addr_len;
-
         for (i = 0; i < context->num_tls; ++i) {
 
             if (!(UCS_BIT(i) & dev->tl_bitmap)) {
@@ -342,24 +484,31 @@ static ucs_status_t ucp_address_do_pack(ucp_worker_h worker, ucp_ep_h ep,
             *(uint16_t*)ptr = context->tl_rscs[i].tl_name_csum;
             ptr += sizeof(uint16_t);
 
+            /* Transport address length, filled after packing the address */
+            addr_len_ptr = ptr;
+            ++ptr;
+
             /* Transport information */
-            ucp_address_pack_iface_attr(ptr, &worker->iface_attrs[i],
-                                        worker->atomic_tls & UCS_BIT(i));
-            ptr += sizeof(ucp_address_packed_iface_attr_t);
+            if (!(UCS_BIT(i) & dev->same_attr_map)) {
+                ucp_address_pack_iface_attr(&attr, &worker->iface_attrs[i],
+                                            worker->atomic_tls & UCS_BIT(i));
+                memcpy(ptr, &attr, attr_size);
+                ptr += attr_size;
+            }
 
-            /* Transport address length */
+            /* Transport address */
             iface_attr = &worker->iface_attrs[i];
             if (iface_attr->cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE) {
                 tl_addr_len = iface_attr->iface_addr_len;
                 status = uct_iface_get_address(worker->ifaces[i],
-                                               (uct_iface_addr_t*)(ptr + 1));
+                                               (uct_iface_addr_t*)ptr);
             } else if (iface_attr->cap.flags & UCT_IFACE_FLAG_CONNECT_TO_EP) {
                 if (ep == NULL) {
                     tl_addr_len = 0;
                     status      = UCS_OK;
                 } else {
                     tl_addr_len = iface_attr->ep_addr_len;
-                    status      = ucp_address_pack_ep_address(ep, i, ptr + 1);
+                    status      = ucp_address_pack_ep_address(ep, i, ptr);
                 }
             } else {
                 status      = UCS_ERR_INVALID_ADDR;
@@ -368,7 +517,7 @@ static ucs_status_t ucp_address_do_pack(ucp_worker_h worker, ucp_ep_h ep,
                 return status;
             }
 
-            ucp_address_memchek(ptr + 1, tl_addr_len,
+            ucp_address_memchek(ptr, tl_addr_len,
                                 &context->tl_rscs[dev->rsc_index].tl_rsc);
 
             /* Save the address index of this transport */
@@ -376,10 +525,19 @@ static ucs_status_t ucp_address_do_pack(ucp_worker_h worker, ucp_ep_h ep,
                 order[ucs_count_one_bits(tl_bitmap & UCS_MASK(i))] = index;
             }
 
-            ucs_assert(tl_addr_len < UCP_ADDRESS_FLAG_LAST);
-            *(uint8_t*)ptr = tl_addr_len | ((i == ucs_ilog2(dev->tl_bitmap)) ?
-                                            UCP_ADDRESS_FLAG_LAST : 0);
-            ptr += 1 + tl_addr_len;
+            if (tl_addr_len > UCP_ADDRESS_FLAG_LEN_MASK) {
+                ucs_error("transport "UCT_TL_RESOURCE_DESC_FMT" address length "
+                          "%zu exceeds %d",
+                          UCT_TL_RESOURCE_DESC_ARG(&context->tl_rscs[i].tl_rsc),
+                          tl_addr_len, (int)UCP_ADDRESS_FLAG_LEN_MASK);
+                return UCS_ERR_UNSUPPORTED;
+            }
+            *addr_len_ptr = tl_addr_len |
+                            ((UCS_BIT(i) & dev->same_attr_map) ?
+                             UCP_ADDRESS_FLAG_SAME_ATTR : 0) |
+                            ((i == ucs_ilog2(dev->tl_bitmap)) ?
+                             UCP_ADDRESS_FLAG_LAST : 0);
+            ptr += tl_addr_len;
 
 
             ucs_trace("pack addr[%d] : "UCT_TL_RESOURCE_DESC_FMT
@@ -400,8 +558,10 @@ out:
 }
 
 ucs_status_t ucp_address_pack(ucp_worker_h worker, ucp_ep_h ep, uint64_t tl_bitmap,
-                              unsigned *order, size_t *size_p, void **buffer_p)
+                              unsigned flags, unsigned *order, size_t *size_p,
+                              void **buffer_p)
 {
+    uint8_t hdr_flags = ucp_address_header_flags(flags);
     ucp_address_packed_device_t *devices;
     ucp_rsc_index_t num_devices;
     ucs_status_t status;
@@ -410,13 +570,14 @@ ucs_status_t ucp_address_pack(ucp_worker_h worker, ucp_ep_h ep, uint64_t tl_bitm
 
     /* Collect all devices we want to pack */
     status = ucp_address_gather_devices(worker, tl_bitmap, ep != NULL,
+                                        ucp_address_iface_attr_size(hdr_flags),
                                         &devices, &num_devices);
     if (status != UCS_OK) {
         goto out;
     }
 
     /* Calculate packed size */
-    size = ucp_address_packed_size(worker, devices, num_devices);
+    size = ucp_address_packed_size(worker, hdr_flags, devices, num_devices);
 
     /* Allocate address */
     buffer = ucs_malloc(size, "ucp_address");
@@ -428,8 +589,8 @@ ucs_status_t ucp_address_pack(ucp_worker_h worker, ucp_ep_h ep, uint64_t tl_bitm
     memset(buffer, 0, size);
 
     /* Pack the address */
-    status = ucp_address_do_pack(worker, ep, buffer, size, tl_bitmap, order,
-                                 devices, num_devices);
+    status = ucp_address_do_pack(worker, ep, buffer, size, tl_bitmap, hdr_flags,
+                                 order, devices, num_devices);
     if (status != UCS_OK) {
         ucs_free(buffer);
         goto out_free_devices;
@@ -447,36 +608,47 @@ out:
     return status;
 }
 
-ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
-                                char *remote_name, size_t max,
-                                unsigned *address_count_p,
-                                ucp_address_entry_t **address_list_p)
+/* Unpack the address header and return a pointer to the first device */
+static const void *ucp_address_unpack_header(const void *buffer,
+                                             uint64_t *remote_uuid_p,
+                                             char *remote_name, size_t max,
+                                             size_t *attr_size_p)
 {
-    ucp_address_entry_t *address_list, *address;
-    const uct_device_addr_t *dev_addr;
-    ucp_rsc_index_t md_index;
-    unsigned address_count;
-    int last_dev, last_tl;
-    int empty_dev;
-    uint64_t md_flags;
-    size_t dev_addr_len;
-    size_t tl_addr_len;
-    uint8_t md_byte;
-    const void *ptr;
-    const void *aptr;
+    const void *ptr = buffer;
+    uint8_t hdr_flags;
 
-    ptr = buffer;
     *remote_uuid_p = *(uint64_t*)ptr;
     ptr += sizeof(uint64_t);
 
-    aptr = ucp_address_unpack_string(ptr, remote_name, max);
+    hdr_flags = *(const uint8_t*)ptr;
+    ++ptr;
 
-    address_count = 0;
+    if (hdr_flags & UCP_ADDRESS_HDR_FLAG_NAME) {
+        if (remote_name != NULL) {
+            ptr = ucp_address_unpack_string(ptr, remote_name, max);
+        } else {
+            ptr += 1 + *(const uint8_t*)ptr;
+        }
+    } else if (remote_name != NULL) {
+        ucs_snprintf_zero(remote_name, max, "%s", "<no name>");
+    }
 
-    /* Count addresses */
-    ptr = aptr;
+    *attr_size_p = ucp_address_iface_attr_size(hdr_flags);
+    return ptr;
+}
+
+static const void *ucp_address_count_entries(const void *ptr, size_t attr_size,
+                                             unsigned *address_count_p)
+{
+    unsigned address_count;
+    int last_dev, last_tl;
+    int empty_dev;
+    uint8_t len_byte;
+
+    address_count = 0;
     do {
         if (*(uint8_t*)ptr == UCP_NULL_RESOURCE) {
+            ++ptr;
             break;
         }
 
@@ -485,30 +657,78 @@ ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
         ++ptr;
 
         /* device address length */
-        dev_addr_len = (*(uint8_t*)ptr) & ~UCP_ADDRESS_FLAG_LAST;
-        last_dev     = (*(uint8_t*)ptr) & UCP_ADDRESS_FLAG_LAST;
+        len_byte     = *(uint8_t*)ptr;
+        last_dev     = len_byte & UCP_ADDRESS_FLAG_LAST;
         ++ptr;
 
-        ptr += dev_addr_len;
+        /* device address or device reference */
+        ptr += (len_byte & UCP_ADDRESS_FLAG_DUP_DEV) ? 1 :
+               (len_byte & UCP_ADDRESS_FLAG_LEN_MASK);
 
         last_tl = empty_dev;
         while (!last_tl) {
             ptr += sizeof(uint16_t);                        /* tl_name_csum */
-            ptr += sizeof(ucp_address_packed_iface_attr_t); /* iface attr */
 
             /* tl address length */
-            tl_addr_len = (*(uint8_t*)ptr) & ~UCP_ADDRESS_FLAG_LAST;
-            last_tl     = (*(uint8_t*)ptr) & UCP_ADDRESS_FLAG_LAST;
+            len_byte = *(uint8_t*)ptr;
+            last_tl  = len_byte & UCP_ADDRESS_FLAG_LAST;
             ++ptr;
 
+            if (!(len_byte & UCP_ADDRESS_FLAG_SAME_ATTR)) {
+                ptr += attr_size;                           /* iface attr */
+            }
+
             ++address_count;
             ucs_assert(address_count <= UCP_MAX_RESOURCES);
 
-            ptr += tl_addr_len;
+            ptr += len_byte & UCP_ADDRESS_FLAG_LEN_MASK;
         }
 
     } while (!last_dev);
 
+    *address_count_p = address_count;
+    return ptr; /* End of the packed address */
+}
+
+size_t ucp_address_length(const void *buffer)
+{
+    unsigned address_count;
+    uint64_t remote_uuid;
+    size_t attr_size;
+    const void *ptr;
+
+    ptr = ucp_address_unpack_header(buffer, &remote_uuid, NULL, 0, &attr_size);
+    ptr = ucp_address_count_entries(ptr, attr_size, &address_count);
+    return ptr - buffer;
+}
+
+ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
+                                char *remote_name, size_t max,
+                                unsigned *address_count_p,
+                                ucp_address_entry_t **address_list_p)
+{
+    const uct_device_addr_t *dev_addrs[UCP_MAX_RESOURCES];
+    ucp_address_entry_t *address_list, *address;
+    const uct_device_addr_t *dev_addr;
+    ucp_rsc_index_t md_index;
+    ucp_rsc_index_t dev_index;
+    unsigned address_count;
+    int last_dev, last_tl;
+    int empty_dev;
+    uint64_t md_flags;
+    size_t dev_addr_len;
+    size_t tl_addr_len;
+    size_t attr_size;
+    uint8_t md_byte;
+    uint8_t len_byte;
+    const void *ptr;
+    const void *aptr;
+
+    aptr = ucp_address_unpack_header(buffer, remote_uuid_p, remote_name, max,
+                                     &attr_size);
+
+    /* Count addresses */
+    ucp_address_count_entries(aptr, attr_size, &address_count);
 
     /* Allocate address list */
     address_list = ucs_calloc(address_count, sizeof(*address_list),
@@ -518,8 +738,9 @@ ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
     }
 
     /* Unpack addresses */
-    address = address_list;
-    ptr     = aptr;
+    address   = address_list;
+    dev_index = 0;
+    ptr       = aptr;
     do {
         if (*(uint8_t*)ptr == UCP_NULL_RESOURCE) {
             break;
@@ -534,29 +755,46 @@ ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
         ++ptr;
 
         /* device address length */
-        dev_addr_len = (*(uint8_t*)ptr) & ~UCP_ADDRESS_FLAG_LAST;
-        last_dev     = (*(uint8_t*)ptr) & UCP_ADDRESS_FLAG_LAST;
+        len_byte     = *(uint8_t*)ptr;
+        dev_addr_len = len_byte & UCP_ADDRESS_FLAG_LEN_MASK;
+        last_dev     = len_byte & UCP_ADDRESS_FLAG_LAST;
         ++ptr;
 
-        dev_addr = ptr;
+        /* device address, or a reference to a previous device */
+        if (len_byte & UCP_ADDRESS_FLAG_DUP_DEV) {
+            ucs_assert(*(uint8_t*)ptr < dev_index);
+            dev_addr = dev_addrs[*(uint8_t*)ptr];
+            ++ptr;
+        } else {
+            dev_addr = ptr;
+            ptr += dev_addr_len;
+        }
 
-        ptr += dev_addr_len;
+        ucs_assert(dev_index < UCP_MAX_RESOURCES);
+        dev_addrs[dev_index++] = dev_addr;
 
         last_tl = empty_dev;
         while (!last_tl) {
-            /* tl name */
+            /* tl_name_csum */
             address->tl_name_csum = *(uint16_t*)ptr;
             ptr += sizeof(uint16_t);
 
-            /* tl_name_csum */
-            ucp_address_unpack_iface_attr(&address->iface_attr, ptr);
-            ptr += sizeof(ucp_address_packed_iface_attr_t);
-
             /* tl address length */
-            tl_addr_len = (*(uint8_t*)ptr) & ~UCP_ADDRESS_FLAG_LAST;
-            last_tl     = (*(uint8_t*)ptr) & UCP_ADDRESS_FLAG_LAST;
+            len_byte    = *(uint8_t*)ptr;
+            tl_addr_len = len_byte & UCP_ADDRESS_FLAG_LEN_MASK;
+            last_tl     = len_byte & UCP_ADDRESS_FLAG_LAST;
             ++ptr;
 
+            /* tl info */
+            if (len_byte & UCP_ADDRESS_FLAG_SAME_ATTR) {
+                ucs_assert(address > address_list);
+                address->iface_attr = (address - 1)->iface_attr;
+            } else {
+                ucp_address_unpack_iface_attr(&address->iface_attr, ptr,
+                                              attr_size);
+                ptr += attr_size;
+            }
+
             address->dev_addr     = (dev_addr_len > 0) ? dev_addr : NULL;
             address->dev_addr_len = dev_addr_len;
             address->md_index     = md_index;
@@ -578,4 +816,3 @@ ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
     *address_list_p  = address_list;
     return UCS_OK;
 }
-
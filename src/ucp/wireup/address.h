@@ -34,6 +34,16 @@ enum {
 };
 
 
+/* Flags for ucp_address_pack() */
+enum {
+    UCP_ADDRESS_PACK_FLAG_SHORT = UCS_BIT(0)  /* Pack only the information needed
+                                                 to check reachability and to
+                                                 connect, without performance
+                                                 estimations of the transports
+                                                 and the worker name */
+};
+
+
 /**
  * Remote interface attributes.
  */
@@ -76,6 +86,7 @@ struct ucp_address_entry {
  *                            Can be set to NULL, to take addresses only from worker.
  * @param [in]  tl_bitmap   Specifies the resources whose transport address
  *                           (ep or iface) should be packed.
+ * @param [in]  flags       Packing flags, see UCP_ADDRESS_PACK_FLAG_xx.
  * @param [out] order       If != NULL, filled with the order of addresses as they
  *                           were packed. For example: first entry in the array is
  *                           the address index of the first transport specified
@@ -86,14 +97,16 @@ struct ucp_address_entry {
  *                           released by ucs_free().
  */
 ucs_status_t ucp_address_pack(ucp_worker_h worker, ucp_ep_h ep, uint64_t tl_bitmap,
-                              unsigned *order, size_t *size_p, void **buffer_p);
+                              unsigned flags, unsigned *order, size_t *size_p,
+                              void **buffer_p);
 
 
 /**
  * Unpack a list of addresses.
  *
  * @param [in]  buffer           Buffer with data to unpack.
- * @param [out] name             Filled with remote worker name.
+ * @param [out] name             Filled with remote worker name, if the address
+ *                                contains it (not in short addresses).
  * @param [in]  max              Maximal length on 'name'.
  * @param [out] remote_uuid_p    Filled with remote worker uuid.
  * @param [out] address_count_p  Filled with amount of addresses in the list.
@@ -111,4 +124,14 @@ ucs_status_t ucp_address_unpack(const void *buffer, uint64_t *remote_uuid_p,
                                 ucp_address_entry_t **address_list_p);
 
 
+/**
+ * Get the length of a packed address.
+ *
+ * @param [in]  buffer           Packed address, as returned from @ref ucp_address_pack.
+ *
+ * @return Total size of the packed address, in bytes.
+ */
+size_t ucp_address_length(const void *buffer);
+
+
 #endif
@@ -7,7 +7,7 @@
 #include "stub_ep.h"
 #include "wireup.h"
 
-#include <ucp/core/ucp_request.h>
+#include <ucp/core/ucp_request.inl>
 #include <ucp/core/ucp_worker.h>
 #include <ucs/arch/atomic.h>
 #include <ucs/datastruct/queue.h>
@@ -137,7 +137,7 @@ static ucs_status_t ucp_stub_ep_progress_pending(uct_pending_req_t *self)
     status = req->func(req);
     if (status == UCS_OK) {
         ucs_atomic_add32(&stub_ep->pending_count, -1);
-        ucs_mpool_put(proxy_req);
+        ucp_request_mpool_put(proxy_req);
     }
     return status;
 }
@@ -151,7 +151,7 @@ static void ucp_stub_ep_pending_req_release(uct_pending_req_t *self,
 
     parg->cb(proxy_req->send.proxy.req, parg->arg);
     ucs_atomic_add32(&stub_ep->pending_count, -1);
-    ucs_mpool_put(proxy_req);
+    ucp_request_mpool_put(proxy_req);
 }
 
 static ucs_status_t ucp_stub_pending_add(uct_ep_h uct_ep, uct_pending_req_t *req)
@@ -165,7 +165,7 @@ static ucs_status_t ucp_stub_pending_add(uct_ep_h uct_ep, uct_pending_req_t *req
 
     UCS_ASYNC_BLOCK(&worker->async);
     if (req->func == ucp_wireup_msg_progress) {
-        proxy_req = ucs_mpool_get(&worker->req_mp);
+        proxy_req = ucp_request_get(worker);
         if (proxy_req == NULL) {
             status = UCS_ERR_NO_MEMORY;
             goto out;
@@ -180,7 +180,7 @@ static ucs_status_t ucp_stub_pending_add(uct_ep_h uct_ep, uct_pending_req_t *req
         if (status == UCS_OK) {
             ucs_atomic_add32(&stub_ep->pending_count, +1);
         } else {
-            ucs_mpool_put(proxy_req);
+            ucp_request_mpool_put(proxy_req);
         }
     } else {
         ucs_queue_push(&stub_ep->pending_q, ucp_stub_ep_req_priv(req));
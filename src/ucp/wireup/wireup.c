@@ -15,6 +15,7 @@
 #include <ucs/arch/bitops.h>
 #include <ucs/async/async.h>
 #include <ucs/datastruct/queue.h>
+#include <ucs/debug/profile.h>
 
 /*
  * Description of the protocol in UCX wiki:
@@ -29,7 +30,8 @@ static size_t ucp_wireup_msg_pack(void *dest, void *arg)
     return sizeof(ucp_wireup_msg_t) + req->send.length;
 }
 
-ucs_status_t ucp_wireup_msg_progress(uct_pending_req_t *self)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_wireup_msg_progress, (self),
+                 uct_pending_req_t *self)
 {
     ucp_request_t *req = ucs_container_of(self, ucp_request_t, send.uct);
     ucp_ep_h ep = req->send.ep;
@@ -41,6 +43,15 @@ ucs_status_t ucp_wireup_msg_progress(uct_pending_req_t *self)
                       ep);
             goto out;
         }
+
+        /* The remote side sent its own request while ours was queued, and it
+         * is waiting for our reply. It will connect using the reply, so the
+         * request is redundant. */
+        if (ep->flags & UCP_EP_FLAG_CONNECT_REQ_RECVD) {
+            ucs_trace("ep %p: not sending wireup message - got remote request",
+                      ep);
+            goto out;
+        }
     }
 
     /* send the active message */
@@ -58,6 +69,12 @@ ucs_status_t ucp_wireup_msg_progress(uct_pending_req_t *self)
         return (ucs_status_t)packed_len;
     }
 
+    UCS_STATIC_ASSERT(UCP_WORKER_STAT_TX_WIREUP_REQUEST + UCP_WIREUP_MSG_ACK ==
+                      UCP_WORKER_STAT_TX_WIREUP_ACK);
+    UCS_STATS_UPDATE_COUNTER(ep->worker->stats,
+                             UCP_WORKER_STAT_TX_WIREUP_REQUEST +
+                             req->send.wireup.type, 1);
+
 out:
     ucs_free((void*)req->send.buffer);
     ucs_free(req);
@@ -85,7 +102,7 @@ static ucs_status_t ucp_wireup_msg_send(ucp_ep_h ep, uint8_t type,
     ucs_status_t status;
     void *address;
 
-    ucs_assert(ep->cfg_index != (uint8_t)-1);
+    ucs_assert(ep->cfg_index < ep->worker->ep_config_count);
 
     /* We cannot allocate from memory pool because it's not thread safe
      * and this function may be called from any thread
@@ -101,7 +118,7 @@ static ucs_status_t ucp_wireup_msg_send(ucp_ep_h ep, uint8_t type,
     req->send.uct.func           = ucp_wireup_msg_progress;
 
     /* pack all addresses */
-    status = ucp_address_pack(ep->worker, ep, tl_bitmap, order,
+    status = ucp_address_pack(ep->worker, ep, tl_bitmap, 0, order,
                               &req->send.length, &address);
     if (status != UCS_OK) {
         ucs_free(req);
@@ -171,12 +188,26 @@ static void ucp_wireup_ep_remote_connected(ucp_ep_h ep)
 {
     ucp_lane_index_t lane;
 
+    if (ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED) {
+        return;
+    }
+
     ucs_trace("ep %p: remote connected", ep);
     for (lane = 0; lane < ucp_ep_num_lanes(ep); ++lane) {
         if (ucp_ep_is_lane_p2p(ep, lane)) {
             ucp_stub_ep_remote_connected(ep->uct_eps[lane]);
         }
     }
+
+    if (ep->flags & UCP_EP_FLAG_CONNECT_REP_SENT) {
+        ucs_assert(ep->worker->wireup_ack_wait > 0);
+        --ep->worker->wireup_ack_wait;
+    }
+
+    /* The remote endpoint is not tracked after the connection is established,
+     * so it may be destroyed and a later request would be needed again */
+    ep->flags &= ~UCP_EP_FLAG_CONNECT_REQ_RECVD;
+    ep->flags |= UCP_EP_FLAG_REMOTE_CONNECTED;
 }
 
 static void ucp_wireup_process_request(ucp_worker_h worker, const ucp_wireup_msg_t *msg,
@@ -200,6 +231,14 @@ static void ucp_wireup_process_request(ucp_worker_h worker, const ucp_wireup_msg
         if (status != UCS_OK) {
             return;
         }
+    } else if (ep->flags & UCP_EP_FLAG_FAILED) {
+        /* Lanes of a failed endpoint may be half-initialized, do not reuse them */
+        ucs_debug("ep %p: ignoring wireup request, lazy connect failed: %s",
+                  ep, ucs_status_string(ep->status));
+        return;
+    } else if (ep->flags & UCP_EP_FLAG_LAZY_CONNECT) {
+        /* Remote side connects first, lanes are selected from its request */
+        ucp_ep_lazy_release(ep);
     }
 
     /* Initialize lanes (possible destroy existing lanes) */
@@ -216,7 +255,12 @@ static void ucp_wireup_process_request(ucp_worker_h worker, const ucp_wireup_msg
             return;
         }
 
+        /* The reply replaces our own request, if it was not sent yet. The
+         * remote endpoint is alive at least until it gets the reply. */
         ep->flags |= UCP_EP_FLAG_LOCAL_CONNECTED;
+        if (!(ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED)) {
+            ep->flags |= UCP_EP_FLAG_CONNECT_REQ_RECVD;
+        }
 
         /* Construct the list that tells the remote side with which address we
          * have connected to each of its lanes.
@@ -240,7 +284,12 @@ static void ucp_wireup_process_request(ucp_worker_h worker, const ucp_wireup_msg
             return;
         }
 
+        /* Wait for an acknowledgement, unless the reply of the remote side
+         * has already arrived */
         ep->flags |= UCP_EP_FLAG_CONNECT_REP_SENT;
+        if (!(ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED)) {
+            ++worker->wireup_ack_wait;
+        }
     }
 }
 
@@ -273,9 +322,17 @@ static void ucp_wireup_process_reply(ucp_worker_h worker, ucp_wireup_msg_t *msg,
         ack = 0;
     }
 
-    if (!(ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED)) {
-        ucp_wireup_ep_remote_connected(ep);
-        ep->flags |= UCP_EP_FLAG_REMOTE_CONNECTED;
+    ucp_wireup_ep_remote_connected(ep);
+
+    if (ack && (ep->flags & UCP_EP_FLAG_IMPLICIT_ACK) &&
+        ucp_ep_is_lane_p2p(ep, ucp_ep_get_am_lane(ep))) {
+        /* A request which requires a reply is queued on the AM lane, so it is
+         * sent only now that we are connected. The remote side would take it
+         * as the acknowledgement, see ucp_wireup_process_implicit_ack(). */
+        ucs_trace("ep %p: wireup ack is carried by a queued request", ep);
+        UCS_STATS_UPDATE_COUNTER(worker->stats,
+                                 UCP_WORKER_STAT_TX_WIREUP_ACK_SKIPPED, 1);
+        ack = 0;
     }
 
     if (ack) {
@@ -303,12 +360,37 @@ static void ucp_wireup_process_ack(ucp_worker_h worker, uint64_t uuid)
     ucs_assert(ep->flags & UCP_EP_FLAG_CONNECT_REP_SENT);
     ucs_assert(ep->flags & UCP_EP_FLAG_LOCAL_CONNECTED);
 
-    ep->flags |= UCP_EP_FLAG_REMOTE_CONNECTED;
     ucp_wireup_ep_remote_connected(ep);
 }
 
-static ucs_status_t ucp_wireup_msg_handler(void *arg, void *data,
-                                           size_t length, void *desc)
+/*
+ * A request which requires a reply arrived from the remote worker. If it was
+ * sent on a p2p AM lane, the remote side has connected its endpoints before
+ * sending it, so it acknowledges our wireup reply instead of a separate ACK.
+ */
+void ucp_wireup_process_implicit_ack(ucp_worker_h worker, uint64_t uuid)
+{
+    ucp_ep_h ep;
+
+    UCS_ASYNC_BLOCK(&worker->async);
+
+    ep = ucp_worker_ep_find(worker, uuid);
+    if ((ep != NULL) && (ep->flags & UCP_EP_FLAG_CONNECT_REP_SENT) &&
+        !(ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED) &&
+        ucp_ep_is_lane_p2p(ep, ucp_ep_get_am_lane(ep)))
+    {
+        ucs_trace("ep %p: wireup reply is acknowledged by a request", ep);
+        UCS_STATS_UPDATE_COUNTER(worker->stats,
+                                 UCP_WORKER_STAT_RX_WIREUP_IMPLICIT_ACK, 1);
+        ucp_wireup_ep_remote_connected(ep);
+    }
+
+    UCS_ASYNC_UNBLOCK(&worker->async);
+}
+
+static UCS_PROFILE_FUNC(ucs_status_t, ucp_wireup_msg_handler,
+                        (arg, data, length, desc),
+                        void *arg, void *data, size_t length, void *desc)
 {
     ucp_worker_h worker   = arg;
     ucp_wireup_msg_t *msg = data;
@@ -476,9 +558,11 @@ static void ucp_wireup_print_config(ucp_context_h context,
     }
 }
 
-ucs_status_t ucp_wireup_init_lanes(ucp_ep_h ep, unsigned address_count,
-                                   const ucp_address_entry_t *address_list,
-                                   uint8_t *addr_indices)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_wireup_init_lanes,
+                 (ep, address_count, address_list, addr_indices),
+                 ucp_ep_h ep, unsigned address_count,
+                 const ucp_address_entry_t *address_list,
+                 uint8_t *addr_indices)
 {
     ucp_worker_h worker = ep->worker;
     ucp_ep_config_key_t key;
@@ -502,7 +586,7 @@ ucs_status_t ucp_wireup_init_lanes(ucp_ep_h ep, unsigned address_count,
         return UCS_OK; /* No change */
     }
 
-    if ((ep->cfg_index != 0) && !ucp_ep_is_stub(ep)) {
+    if ((ucp_ep_num_lanes(ep) != 0) && !ucp_ep_is_stub(ep)) {
         /*
          * TODO handle a case where we have to change lanes and reconfigure the ep:
          *
@@ -520,7 +604,11 @@ ucs_status_t ucp_wireup_init_lanes(ucp_ep_h ep, unsigned address_count,
         ucs_fatal("endpoint reconfiguration not supported yet");
     }
 
-    ep->cfg_index = new_cfg_index;
+    status = ucp_ep_set_cfg_index(ep, new_cfg_index);
+    if (status != UCS_OK) {
+        return status;
+    }
+
     ep->am_lane   = key.am_lane;
 
     snprintf(str, sizeof(str), "ep %p", ep);
@@ -555,7 +643,7 @@ err:
     return status;
 }
 
-ucs_status_t ucp_wireup_send_request(ucp_ep_h ep)
+UCS_PROFILE_FUNC(ucs_status_t, ucp_wireup_send_request, (ep), ucp_ep_h ep)
 {
     ucp_worker_h worker = ep->worker;
     ucp_rsc_index_t rsc_tli[UCP_MAX_LANES];
@@ -564,7 +652,8 @@ ucs_status_t ucp_wireup_send_request(ucp_ep_h ep)
     ucp_lane_index_t lane;
     ucs_status_t status;
 
-    if (ep->flags & UCP_EP_FLAG_CONNECT_REQ_SENT) {
+    if (ep->flags & (UCP_EP_FLAG_CONNECT_REQ_SENT |
+                     UCP_EP_FLAG_CONNECT_REQ_RECVD)) {
         return UCS_OK;
     }
 
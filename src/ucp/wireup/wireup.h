@@ -65,6 +65,8 @@ typedef struct ucp_wireup_msg {
 
 ucs_status_t ucp_wireup_send_request(ucp_ep_h ep);
 
+void ucp_wireup_process_implicit_ack(ucp_worker_h worker, uint64_t uuid);
+
 ucs_status_t ucp_wireup_select_aux_transport(ucp_ep_h ep,
                                              const ucp_address_entry_t *address_list,
                                              unsigned address_count,
@@ -91,5 +93,18 @@ static inline int ucp_worker_is_tl_p2p(ucp_worker_h worker, ucp_rsc_index_t rsc_
     return !(worker->iface_attrs[rsc_index].cap.flags & UCT_IFACE_FLAG_CONNECT_TO_IFACE);
 }
 
+/*
+ * Should be called when a request which requires a reply arrives from a remote
+ * worker. It acknowledges our wireup reply to that worker, if we still wait for
+ * the acknowledgement.
+ */
+static inline void ucp_wireup_check_implicit_ack(ucp_worker_h worker,
+                                                 uint64_t uuid)
+{
+    if (ucs_unlikely(worker->wireup_ack_wait > 0)) {
+        ucp_wireup_process_implicit_ack(worker, uuid);
+    }
+}
+
 
 #endif
@@ -420,16 +420,21 @@ ucs_async_signal_alloc_timerq_cb(ucs_async_signal_timerq_t *search, void *arg,
     }
 
     timerq->tid = search->tid;
-    ucs_timerq_init(&timerq->timerq);
+    status = ucs_timerq_init(&timerq->timerq);
+    if (status != UCS_OK) {
+        goto err_timer_delete;
+    }
 
     status = ucs_async_signal_timerq_add_timer(timerq, arg);
     if (status != UCS_OK) {
-        goto err_timer_delete;
+        goto err_timerq_cleanup;
     }
 
     *elem = timerq;
     return UCS_OK;
 
+err_timerq_cleanup:
+    ucs_timerq_cleanup(&timerq->timerq);
 err_timer_delete:
     ucs_async_signal_sys_timer_delete(timerq->sys_timer_id);
 err_free:
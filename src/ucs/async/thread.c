@@ -12,42 +12,103 @@
 #include "async_int.h"
 #include "pipe.h"
 
+#include <ucs/arch/atomic.h>
 #include <ucs/time/timerq.h>
+#include <sys/timerfd.h>
 
 
 #define UCS_ASYNC_EPOLL_MAX_EVENTS      16
-#define UCS_ASYNC_EPOLL_MIN_TIMEOUT_MS  2.0
+#define UCS_ASYNC_MAX_THREADS           64
 
 
-static struct {
+/*
+ * Async progress thread. Every async context is attached to one of the
+ * threads in the pool, so that a slow handler delays only the contexts
+ * which share its thread.
+ */
+typedef struct ucs_async_thread {
     ucs_async_pipe_t   wakeup;
     int                epfd;
+    int                timerfd;   /* High resolution wakeup for timers */
     ucs_timer_queue_t  timerq;
     pthread_t          thread_id;
+    unsigned           index;
     unsigned           use_count;
+} ucs_async_thread_t;
+
+
+static struct {
+    ucs_async_thread_t threads[UCS_ASYNC_MAX_THREADS];
+    volatile uint32_t  next_index; /* Round-robin counter for new contexts */
     pthread_mutex_t    lock;
 } ucs_async_thread_global_context = {
-    .thread_id       = -1,
-    .epfd            = -1,
-    .use_count       = 0,
+    .next_index      = 0,
     .lock            = PTHREAD_MUTEX_INITIALIZER,
 };
 
 
+static unsigned ucs_async_thread_num()
+{
+    return ucs_max(1, ucs_min(ucs_global_opts.async_num_threads,
+                              UCS_ASYNC_MAX_THREADS));
+}
+
+static ucs_async_thread_t *ucs_async_thread_get(ucs_async_context_t *async)
+{
+    /* Handlers without a context are served by the first thread */
+    return &ucs_async_thread_global_context.threads[(async == NULL) ? 0 :
+                                                    async->thread.index];
+}
+
+/*
+ * Arm the timer fd to expire after the given interval. epoll_wait() timeout
+ * has only millisecond resolution, so sub-millisecond timers would otherwise
+ * be rounded down to busy polling, or coalesced.
+ */
+static void ucs_async_thread_arm_timer(ucs_async_thread_t *thread,
+                                       ucs_time_t interval)
+{
+    struct itimerspec its;
+    int ret;
+
+    memset(&its, 0, sizeof(its));
+    if (interval != UCS_TIME_INFINITY) {
+        ucs_sec_to_timespec(ucs_time_to_sec(interval), &its.it_value);
+        if ((its.it_value.tv_sec == 0) && (its.it_value.tv_nsec == 0)) {
+            its.it_value.tv_nsec = 1; /* Zero value would disarm the timer */
+        }
+    }
+
+    ret = timerfd_settime(thread->timerfd, 0, &its, NULL);
+    if (ret < 0) {
+        ucs_fatal("timerfd_settime(fd=%d) failed: %m", thread->timerfd);
+    }
+}
+
+static void ucs_async_thread_drain_timer(ucs_async_thread_t *thread)
+{
+    uint64_t expirations;
+    ssize_t ret;
+
+    ret = read(thread->timerfd, &expirations, sizeof(expirations));
+    if ((ret < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+        ucs_error("read(timerfd=%d) failed: %m", thread->timerfd);
+    }
+}
+
 static void *ucs_async_thread_func(void *arg)
 {
+    ucs_async_thread_t *thread = arg;
     struct epoll_event events[UCS_ASYNC_EPOLL_MAX_EVENTS];
-    ucs_time_t last_time, curr_time, timer_interval, time_spent;
-    int i, nready, is_missed, timeout_ms;
+    ucs_time_t curr_time, next_expiration;
+    int i, nready, is_missed;
     ucs_timer_t *timer;
     ucs_status_t status;
     int fd;
 
     is_missed  = 0;
-    curr_time  = ucs_get_time();
-    last_time  = ucs_get_time();
 
-    while (ucs_async_thread_global_context.use_count > 0) {
+    while (thread->use_count > 0) {
 
         /* If we didn't get the lock, give other threads priority */
         if (is_missed) {
@@ -55,17 +116,22 @@ static void *ucs_async_thread_func(void *arg)
             is_missed = 0;
         }
 
-        /* Wait until the remainder of current period */
-        timer_interval = ucs_timerq_min_interval(&ucs_async_thread_global_context.timerq);
-        time_spent     = curr_time - last_time;
-        timeout_ms     = ucs_time_to_msec(timer_interval - ucs_min(time_spent, timer_interval));
-        nready = epoll_wait(ucs_async_thread_global_context.epfd, events,
-                            UCS_ASYNC_EPOLL_MAX_EVENTS, timeout_ms);
+        /* Wait until the next timer expires */
+        next_expiration = ucs_timerq_next_expiration(&thread->timerq);
+        if (next_expiration != UCS_TIME_INFINITY) {
+            curr_time = ucs_get_time();
+            ucs_async_thread_arm_timer(thread, next_expiration -
+                                       ucs_min(curr_time, next_expiration));
+        } else {
+            ucs_async_thread_arm_timer(thread, UCS_TIME_INFINITY);
+        }
+
+        nready = epoll_wait(thread->epfd, events, UCS_ASYNC_EPOLL_MAX_EVENTS, -1);
         if ((nready < 0) && (errno != EINTR)) {
             ucs_fatal("epoll_wait() failed: %m");
         }
-        ucs_trace_async("epoll_wait(epfd=%d, timeout=%d) returned %d",
-                        ucs_async_thread_global_context.epfd, timeout_ms, nready);
+        ucs_trace_async("thread %u: epoll_wait(epfd=%d) returned %d",
+                        thread->index, thread->epfd, nready);
 
         /* Check ready files */
         if (nready > 0) {
@@ -73,9 +139,15 @@ static void *ucs_async_thread_func(void *arg)
                 fd = events[i].data.fd;
 
                 /* Check wakeup pipe */
-                if (fd == ucs_async_pipe_rfd(&ucs_async_thread_global_context.wakeup)) {
-                    ucs_trace_async("progress thread woken up");
-                    ucs_async_pipe_drain(&ucs_async_thread_global_context.wakeup);
+                if (fd == ucs_async_pipe_rfd(&thread->wakeup)) {
+                    ucs_trace_async("progress thread %u woken up", thread->index);
+                    ucs_async_pipe_drain(&thread->wakeup);
+                    continue;
+                }
+
+                /* Timers are checked below */
+                if (fd == thread->timerfd) {
+                    ucs_async_thread_drain_timer(thread);
                     continue;
                 }
 
@@ -88,110 +160,167 @@ static void *ucs_async_thread_func(void *arg)
 
         /* Check timers */
         curr_time = ucs_get_time();
-        if (curr_time - last_time > timer_interval) {
+        if (curr_time >= next_expiration) {
             /*
              * This will not deadlock with main thread trying to add/remove
              * timers, because dispatch_timers uses trylock.
              */
-            ucs_timerq_for_each_expired(timer, &ucs_async_thread_global_context.timerq, curr_time) {
+            ucs_timerq_for_each_expired(timer, &thread->timerq, curr_time) {
                 ucs_async_dispatch_handler(timer->id, 1);
             }
-            last_time = curr_time;
         }
     }
 
     return NULL;
 }
 
+static void ucs_async_thread_set_affinity(ucs_async_thread_t *thread)
+{
+    unsigned num_cpus = ucs_global_opts.async_thread_cpus.count;
+    cpu_set_t cpu_mask;
+    unsigned cpu;
+    int ret;
+
+    if (num_cpus == 0) {
+        return;
+    }
+
+    cpu = ucs_global_opts.async_thread_cpus.cpus[thread->index % num_cpus];
+    CPU_ZERO(&cpu_mask);
+    CPU_SET(cpu, &cpu_mask);
 
-static ucs_status_t ucs_async_thread_start()
+    ret = pthread_setaffinity_np(thread->thread_id, sizeof(cpu_mask), &cpu_mask);
+    if (ret != 0) {
+        ucs_warn("failed to bind async thread %u to cpu %u: %s", thread->index,
+                 cpu, strerror(ret));
+        return;
+    }
+
+    ucs_debug("async thread %u bound to cpu %u", thread->index, cpu);
+}
+
+static ucs_status_t ucs_async_thread_epoll_add(ucs_async_thread_t *thread,
+                                               int fd)
 {
     struct epoll_event event;
+    int ret;
+
+    memset(&event, 0, sizeof(event));
+    event.events  = EPOLLIN;
+    event.data.fd = fd;
+    ret = epoll_ctl(thread->epfd, EPOLL_CTL_ADD, fd, &event);
+    if (ret < 0) {
+        ucs_error("epoll_ctl(ADD, fd=%d) failed: %m", fd);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    return UCS_OK;
+}
+
+static ucs_status_t ucs_async_thread_start(ucs_async_thread_t *thread)
+{
     ucs_status_t status;
-    int wakeup_rfd;
     int ret;
 
-    ucs_trace_func("");
+    ucs_trace_func("thread=%u", thread->index);
 
     pthread_mutex_lock(&ucs_async_thread_global_context.lock);
-    if (ucs_async_thread_global_context.use_count++ > 0) {
+    if (thread->use_count++ > 0) {
         /* Thread already started */
         goto out_unlock;
     }
 
-    status = ucs_timerq_init(&ucs_async_thread_global_context.timerq);
+    status = ucs_timerq_init(&thread->timerq);
     if (status != UCS_OK) {
         goto err;
     }
 
-    status = ucs_async_pipe_create(&ucs_async_thread_global_context.wakeup);
+    status = ucs_async_pipe_create(&thread->wakeup);
     if (status != UCS_OK) {
         goto err_timerq_cleanup;
     }
 
     /* Create epoll set the thread will wait on */
-    ucs_async_thread_global_context.epfd = epoll_create(1);
-    if (ucs_async_thread_global_context.epfd < 0) {
+    thread->epfd = epoll_create(1);
+    if (thread->epfd < 0) {
         ucs_error("epoll_create() failed: %m");
         status = UCS_ERR_IO_ERROR;
         goto err_close_pipe;
     }
 
-    /* Add wakeup pipe to epoll set */
-    wakeup_rfd    = ucs_async_pipe_rfd(&ucs_async_thread_global_context.wakeup);
-    memset(&event, 0, sizeof(event));
-    event.events  = EPOLLIN;
-    event.data.fd = wakeup_rfd;
-    ret = epoll_ctl(ucs_async_thread_global_context.epfd, EPOLL_CTL_ADD,
-                    wakeup_rfd, &event);
-    if (ret < 0) {
-        ucs_error("epoll_ctl(ADD) failed: %m");
+    thread->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (thread->timerfd < 0) {
+        ucs_error("timerfd_create() failed: %m");
         status = UCS_ERR_IO_ERROR;
         goto err_close_epfd;
     }
 
-    ret = pthread_create(&ucs_async_thread_global_context.thread_id, NULL,
-                         ucs_async_thread_func, NULL);
+    /* Add wakeup pipe and timer to epoll set */
+    status = ucs_async_thread_epoll_add(thread,
+                                        ucs_async_pipe_rfd(&thread->wakeup));
+    if (status != UCS_OK) {
+        goto err_close_timerfd;
+    }
+
+    status = ucs_async_thread_epoll_add(thread, thread->timerfd);
+    if (status != UCS_OK) {
+        goto err_close_timerfd;
+    }
+
+    ret = pthread_create(&thread->thread_id, NULL, ucs_async_thread_func,
+                         thread);
     if (ret != 0) {
         ucs_error("pthread_create() returned %d: %m", ret);
         status = UCS_ERR_IO_ERROR;
-        goto err_close_epfd;
+        goto err_close_timerfd;
     }
 
+    ucs_async_thread_set_affinity(thread);
+
 out_unlock:
     pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
     return UCS_OK;
 
+err_close_timerfd:
+    close(thread->timerfd);
+    thread->timerfd = -1;
 err_close_epfd:
-    close(ucs_async_thread_global_context.epfd);
+    close(thread->epfd);
+    thread->epfd = -1;
 err_close_pipe:
-    ucs_async_pipe_destroy(&ucs_async_thread_global_context.wakeup);
+    ucs_async_pipe_destroy(&thread->wakeup);
 err_timerq_cleanup:
-    ucs_timerq_cleanup(&ucs_async_thread_global_context.timerq);
+    ucs_timerq_cleanup(&thread->timerq);
 err:
+    --thread->use_count;
     pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
     return status;
 }
 
-static void ucs_async_thread_stop()
+static void ucs_async_thread_stop(ucs_async_thread_t *thread)
 {
-    ucs_trace_func("");
+    ucs_trace_func("thread=%u", thread->index);
 
     pthread_mutex_lock(&ucs_async_thread_global_context.lock);
-    if (--ucs_async_thread_global_context.use_count == 0) {
-        ucs_async_pipe_push(&ucs_async_thread_global_context.wakeup);
-        pthread_join(ucs_async_thread_global_context.thread_id, NULL);
-        ucs_async_thread_global_context.thread_id = -1;
-        close(ucs_async_thread_global_context.epfd);
-        ucs_async_thread_global_context.epfd = -1;
-        ucs_async_pipe_destroy(&ucs_async_thread_global_context.wakeup);
-        ucs_timerq_cleanup(&ucs_async_thread_global_context.timerq);
+    if (--thread->use_count == 0) {
+        ucs_async_pipe_push(&thread->wakeup);
+        pthread_join(thread->thread_id, NULL);
+        thread->thread_id = -1;
+        close(thread->timerfd);
+        thread->timerfd = -1;
+        close(thread->epfd);
+        thread->epfd = -1;
+        ucs_async_pipe_destroy(&thread->wakeup);
+        ucs_timerq_cleanup(&thread->timerq);
     }
     pthread_mutex_unlock(&ucs_async_thread_global_context.lock);
 }
 
 static ucs_status_t ucs_async_thread_init(ucs_async_context_t *async)
 {
+    async->thread.index = ucs_atomic_fadd32(&ucs_async_thread_global_context.next_index,
+                                            1) % ucs_async_thread_num();
+
 #if !(NVALGRIND)
     pthread_mutexattr_t attr;
     int ret;
@@ -214,11 +343,12 @@ static ucs_status_t ucs_async_thread_init(ucs_async_context_t *async)
 static ucs_status_t ucs_async_thread_add_event_fd(ucs_async_context_t *async,
                                                   int event_fd, int events)
 {
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
     struct epoll_event event;
     ucs_status_t status;
     int ret;
 
-    status = ucs_async_thread_start();
+    status = ucs_async_thread_start(thread);
     if (status != UCS_OK) {
         goto err;
     }
@@ -226,20 +356,19 @@ static ucs_status_t ucs_async_thread_add_event_fd(ucs_async_context_t *async,
     memset(&event, 0, sizeof(event));
     event.events  = events;
     event.data.fd = event_fd;
-    ret = epoll_ctl(ucs_async_thread_global_context.epfd, EPOLL_CTL_ADD,
-                    event_fd, &event);
+    ret = epoll_ctl(thread->epfd, EPOLL_CTL_ADD, event_fd, &event);
     if (ret < 0) {
-        ucs_error("epoll_ctl(epfd=%d, ADD, fd=%d) failed: %m",
-                  ucs_async_thread_global_context.epfd, event_fd);
+        ucs_error("epoll_ctl(epfd=%d, ADD, fd=%d) failed: %m", thread->epfd,
+                  event_fd);
         status = UCS_ERR_IO_ERROR;
         goto err_removed;
     }
 
-    ucs_async_pipe_push(&ucs_async_thread_global_context.wakeup);
+    ucs_async_pipe_push(&thread->wakeup);
     return UCS_OK;
 
 err_removed:
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(thread);
 err:
     return status;
 }
@@ -247,16 +376,16 @@ err:
 static ucs_status_t ucs_async_thread_remove_event_fd(ucs_async_context_t *async,
                                                      int event_fd)
 {
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
     int ret;
 
-    ret = epoll_ctl(ucs_async_thread_global_context.epfd, EPOLL_CTL_DEL,
-                    event_fd, NULL);
+    ret = epoll_ctl(thread->epfd, EPOLL_CTL_DEL, event_fd, NULL);
     if (ret < 0) {
         ucs_error("epoll_ctl(DEL) failed: %m");
         return UCS_ERR_INVALID_PARAM;
     }
 
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(thread);
     return UCS_OK;
 }
 
@@ -278,6 +407,7 @@ static void ucs_async_thread_unblock(ucs_async_context_t *async)
 static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
                                                int timer_id, ucs_time_t interval)
 {
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
     ucs_status_t status;
 
     if (ucs_time_to_msec(interval) == 0) {
@@ -286,21 +416,21 @@ static ucs_status_t ucs_async_thread_add_timer(ucs_async_context_t *async,
         goto err;
     }
 
-    status = ucs_async_thread_start();
+    status = ucs_async_thread_start(thread);
     if (status != UCS_OK) {
         goto err;
     }
 
-    status = ucs_timerq_add(&ucs_async_thread_global_context.timerq, timer_id, interval);
+    status = ucs_timerq_add(&thread->timerq, timer_id, interval);
     if (status != UCS_OK) {
         goto err_stop;
     }
 
-    ucs_async_pipe_push(&ucs_async_thread_global_context.wakeup);
+    ucs_async_pipe_push(&thread->wakeup);
     return UCS_OK;
 
 err_stop:
-    ucs_async_thread_stop();
+    ucs_async_thread_stop(thread);
 err:
     return status;
 }
@@ -308,23 +438,46 @@ err:
 static ucs_status_t ucs_async_thread_remove_timer(ucs_async_context_t *async,
                                                   int timer_id)
 {
-    ucs_timerq_remove(&ucs_async_thread_global_context.timerq, timer_id);
-    ucs_async_pipe_push(&ucs_async_thread_global_context.wakeup);
-    ucs_async_thread_stop();
+    ucs_async_thread_t *thread = ucs_async_thread_get(async);
+
+    ucs_timerq_remove(&thread->timerq, timer_id);
+    ucs_async_pipe_push(&thread->wakeup);
+    ucs_async_thread_stop(thread);
     return UCS_OK;
 }
 
-static void ucs_async_signal_global_cleanup()
+static void ucs_async_thread_global_init()
+{
+    ucs_async_thread_t *thread;
+    unsigned i;
+
+    for (i = 0; i < UCS_ASYNC_MAX_THREADS; ++i) {
+        thread            = &ucs_async_thread_global_context.threads[i];
+        thread->thread_id = -1;
+        thread->epfd      = -1;
+        thread->timerfd   = -1;
+        thread->index     = i;
+        thread->use_count = 0;
+    }
+}
+
+static void ucs_async_thread_global_cleanup()
 {
-    if (ucs_async_thread_global_context.thread_id != -1) {
-        ucs_warn("async thread still running (use count %d)",
-                 ucs_async_thread_global_context.use_count);
+    ucs_async_thread_t *thread;
+    unsigned i;
+
+    for (i = 0; i < UCS_ASYNC_MAX_THREADS; ++i) {
+        thread = &ucs_async_thread_global_context.threads[i];
+        if (thread->thread_id != -1) {
+            ucs_warn("async thread %u still running (use count %d)", i,
+                     thread->use_count);
+        }
     }
 }
 
 ucs_async_ops_t ucs_async_thread_ops = {
-    .init               = ucs_empty_function,
-    .cleanup            = ucs_async_signal_global_cleanup,
+    .init               = ucs_async_thread_global_init,
+    .cleanup            = ucs_async_thread_global_cleanup,
     .block              = ucs_empty_function,
     .unblock            = ucs_empty_function,
     .context_init       = ucs_async_thread_init,
@@ -18,6 +18,8 @@ typedef struct ucs_async_thread_context {
 #endif
         ucs_spinlock_t  spinlock;
     };
+    unsigned            index;     /* Index of the async thread serving
+                                      this context */
 } ucs_async_thread_context_t;
 
 
@@ -30,12 +30,17 @@ ucs_global_opts_t ucs_global_opts = {
     .memtrack_dest         = "",
     .stats_dest            = "",
     .stats_trigger         = "exit",
+    .stats_shards          = 0,
     .memtrack_dest         = "",
+    .memtrack_sites        = 0,
     .instrument_file       = "",
     .instrument_types      = 0,
     .instrument_max_size   = 1048576,
     .profile_mode          = 0,
-    .profile_file          = ""
+    .profile_file          = "",
+    .profile_stream_interval = 0,
+    .profile_stream_files  = 16,
+    .profile_sample_rate   = 1
 };
 
 static const char *handle_error_modes[] = {
@@ -58,6 +63,10 @@ static UCS_CONFIG_DEFINE_ARRAY(signo,
                                sizeof(int),
                                UCS_CONFIG_TYPE_SIGNO);
 
+static UCS_CONFIG_DEFINE_ARRAY(cpus,
+                               sizeof(unsigned),
+                               UCS_CONFIG_TYPE_UINT);
+
 static ucs_config_field_t ucs_global_opts_table[] = {
  {"LOG_LEVEL", "warn",
   "UCS logging level. Messages with a level higher or equal to the selected "
@@ -113,10 +122,23 @@ static ucs_config_field_t ucs_global_opts_table[] = {
   "Signal number used for async signaling.",
   ucs_offsetof(ucs_global_opts_t, async_signo), UCS_CONFIG_TYPE_SIGNO},
 
+ {"ASYNC_NUM_THREADS", "1",
+  "Number of progress threads used by async contexts in thread mode. Contexts\n"
+  "are assigned to threads in round-robin order, so that a slow handler delays\n"
+  "only the contexts which share its thread.",
+  ucs_offsetof(ucs_global_opts_t, async_num_threads), UCS_CONFIG_TYPE_UINT},
+
+ {"ASYNC_THREAD_CPUS", "",
+  "Comma-separated list of CPUs to bind async progress threads to. Thread i\n"
+  "is bound to the i-th CPU in the list, modulo the list size. If empty, the\n"
+  "threads are not bound.",
+  ucs_offsetof(ucs_global_opts_t, async_thread_cpus), UCS_CONFIG_TYPE_ARRAY(cpus)},
+
 #if ENABLE_STATS
  {"STATS_DEST", "",
   "Destination to send statistics to. If the value is empty, statistics are\n"
-  "not reported. Possible values are:\n"
+  "not collected, and counter updates cost only a pointer check. Possible\n"
+  "values are:\n"
   "  udp:<host>[:<port>]   - send over UDP to the given host:port.\n"
   "  stdout                - print to standard output.\n"
   "  stderr                - print to standard error.\n"
@@ -130,6 +152,15 @@ static ucs_config_field_t ucs_global_opts_table[] = {
   "  timer:<interval>  - dump in specified intervals (in seconds).",
   ucs_offsetof(ucs_global_opts_t, stats_trigger), UCS_CONFIG_TYPE_STRING},
 
+ {"STATS_SHARDS", "0",
+  "Number of per-thread shards of the counters in each statistics node. If 0,\n"
+  "counters are updated in place, which is not safe when several threads update\n"
+  "the same node. Otherwise, each of the first STATS_SHARDS-1 threads updates\n"
+  "its own cache-line aligned copy of the counters, the remaining threads share\n"
+  "the last copy using atomic operations, and the copies are summed only when\n"
+  "statistics are reported.",
+  ucs_offsetof(ucs_global_opts_t, stats_shards), UCS_CONFIG_TYPE_UINT},
+
 #endif
 
 #if ENABLE_MEMTRACK
@@ -140,6 +171,12 @@ static ucs_config_field_t ucs_global_opts_table[] = {
   "  stdout            - print to standard output.\n"
   "  stderr            - print to standard error.\n",
   ucs_offsetof(ucs_global_opts_t, memtrack_dest), UCS_CONFIG_TYPE_STRING},
+
+ {"MEMTRACK_SITES", "n",
+  "Track allocations per call site as well. The report then shows a histogram\n"
+  "of allocation sizes for every call site, and how many of its allocations\n"
+  "were made on the hot path - inside send, receive, or progress calls.",
+  ucs_offsetof(ucs_global_opts_t, memtrack_sites), UCS_CONFIG_TYPE_BOOL},
 #endif
 
 #if HAVE_INSTRUMENTATION
@@ -177,8 +214,27 @@ static ucs_config_field_t ucs_global_opts_table[] = {
    ucs_offsetof(ucs_global_opts_t, profile_file), UCS_CONFIG_TYPE_STRING},
 
   {"PROFILE_LOG_SIZE", "4mb",
-   "Maximal size of profiling log. New records will replace old records.",
+   "Maximal size of the profiling log of each thread. New records will replace\n"
+   "old records.",
    ucs_offsetof(ucs_global_opts_t, profile_log_size), UCS_CONFIG_TYPE_MEMUNITS},
+
+  {"PROFILE_STREAM_INTERVAL", "0",
+   "If nonzero, a background thread drains the profiling log of every thread at\n"
+   "this interval. Every drain is written to a separate file, which is named\n"
+   "after PROFILE_FILE with a running index suffix. The log of each thread must\n"
+   "be large enough to hold the records of a whole interval.",
+   ucs_offsetof(ucs_global_opts_t, profile_stream_interval), UCS_CONFIG_TYPE_TIME},
+
+  {"PROFILE_STREAM_FILES", "16",
+   "Number of most recent files to keep when streaming the profiling log. Older\n"
+   "files are removed, which bounds the disk usage. 0 keeps all files.",
+   ucs_offsetof(ucs_global_opts_t, profile_stream_files), UCS_CONFIG_TYPE_UINT},
+
+  {"PROFILE_SAMPLE_RATE", "1",
+   "Profile only one of this many top-level scopes and samples. Events nested\n"
+   "in a scope follow the decision of their top-level scope, so sampled scopes\n"
+   "are always complete. Location counters reflect only the sampled events.",
+   ucs_offsetof(ucs_global_opts_t, profile_sample_rate), UCS_CONFIG_TYPE_UINT},
 #endif
 
  {NULL}
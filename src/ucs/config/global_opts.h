@@ -67,6 +67,9 @@ typedef struct {
     /* Trigger to dump statistics */
     char                     *stats_trigger;
 
+    /* Number of per-thread counter shards in each statistics node */
+    unsigned                 stats_shards;
+
     /* Named pipe file path for tuning.
      */
     char                     *tuning_path;
@@ -77,10 +80,19 @@ typedef struct {
     /* Signal number used by async handler (for signal mode) */
     unsigned                 async_signo;
 
+    /* Number of async progress threads (for thread mode) */
+    unsigned                 async_num_threads;
+
+    /* CPUs to bind async progress threads to */
+    UCS_CONFIG_ARRAY_FIELD(unsigned, cpus) async_thread_cpus;
+
     /* Destination for detailed memory tracking results: none / stdout / stderr
      */
     char                     *memtrack_dest;
 
+    /* Whether to track allocations per call site */
+    int                      memtrack_sites;
+
     /* Profiling mode */
     unsigned                 profile_mode;
 
@@ -90,6 +102,15 @@ typedef struct {
     /* Limit for profiling log size */
      size_t                   profile_log_size;
 
+    /* Interval for streaming profiling log to files, 0 to disable */
+    double                   profile_stream_interval;
+
+    /* Number of streamed profiling files to keep */
+    unsigned                 profile_stream_files;
+
+    /* Record only one of this many top-level profiling events */
+    unsigned                 profile_sample_rate;
+
 } ucs_global_opts_t;
 
 
@@ -70,4 +70,16 @@ static inline void ucs_mpool_put_inline(void *obj)
     VALGRIND_MEMPOOL_FREE(mp, obj);
 }
 
+static inline ucs_mpool_t *ucs_mpool_obj_owner(void *obj)
+{
+    ucs_mpool_elem_t *elem = (ucs_mpool_elem_t*)obj - 1;
+    ucs_mpool_t *mp;
+
+    /* The element header holds the pool pointer while the object is in use */
+    VALGRIND_MAKE_MEM_DEFINED(elem, sizeof *elem);
+    mp = elem->mpool;
+    VALGRIND_MAKE_MEM_NOACCESS(elem, sizeof *elem);
+    return mp;
+}
+
 #endif
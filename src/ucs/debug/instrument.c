@@ -116,7 +116,7 @@ void ucs_instrument_init()
                   sizeof(ucs_instrument_record_t);
     ucs_instr_ctx.start = ucs_calloc(num_records,
                                      sizeof(ucs_instrument_record_t),
-                                     "instrument_data_buffer");
+                                     "instrument_data");
     if (ucs_instr_ctx.start == NULL) {
         ucs_warn("failed to allocate instrumentation buffer");
         goto disable_close_file;
@@ -177,7 +177,7 @@ uint32_t ucs_instrument_register(ucs_instrumentation_types_t type,
     }
 
     location_entry = ucs_calloc(1, sizeof(*location_entry),
-                                "instrument_location");
+                                "instrument_loc");
     if (location_entry == NULL) {
         return 0;
     }
@@ -10,6 +10,8 @@
 #include <string.h>
 #include <malloc.h>
 
+#include <ucs/arch/bitops.h>
+#include <ucs/debug/debug.h>
 #include <ucs/debug/log.h>
 #include <ucs/stats/stats.h>
 #include <ucs/datastruct/list.h>
@@ -25,6 +27,7 @@
 #define UCS_MEMTRACK_MAGIC            0x1ee7beefa880feedULL
 #define UCS_MEMTRACK_FORMAT_STRING    ("%22s: size: %9lu / %9lu\tcount: %9lu / %9lu\n")
 #define UCS_MEMTRACK_ENTRY_HASH_SIZE  127
+#define UCS_MEMTRACK_SITE_HASH_SIZE   127
 
 
 typedef struct ucs_memtrack_buffer {
@@ -36,10 +39,28 @@ typedef struct ucs_memtrack_buffer {
 } ucs_memtrack_buffer_t;
 
 
+/**
+ * Call site entry, used when MEMTRACK_SITES is enabled.
+ */
+typedef struct ucs_memtrack_site ucs_memtrack_site_t;
+struct ucs_memtrack_site {
+    const void            *caller;    /* Return address of allocation call */
+    char                  name[UCS_MEMTRACK_NAME_MAX];
+    size_t                count;      /* Total number of allocations */
+    size_t                hot_count;  /* Number of allocations on the hot path */
+    size_t                size_hist[UCS_MEMTRACK_SIZE_BINS]; /* Allocations per
+                                                                size bin */
+    ucs_memtrack_site_t   *next;
+};
+
+
 typedef struct ucs_memtrack_context {
     int                     enabled;
     pthread_mutex_t         lock;
     ucs_memtrack_entry_t    *entries[UCS_MEMTRACK_ENTRY_HASH_SIZE];
+    ucs_memtrack_site_t     *sites[UCS_MEMTRACK_SITE_HASH_SIZE];
+    size_t                  num_allocs;
+    size_t                  num_hot_path_allocs;
     UCS_STATS_NODE_DECLARE(stats);
 } ucs_memtrack_context_t;
 
@@ -50,10 +71,16 @@ static ucs_memtrack_context_t ucs_memtrack_context = {
     .lock    = PTHREAD_MUTEX_INITIALIZER
 };
 
+__thread unsigned ucs_memtrack_hot_path_depth = 0;
+
 SGLIB_DEFINE_LIST_PROTOTYPES(ucs_memtrack_entry_t, ucs_memtrack_entry_compare, next)
 SGLIB_DEFINE_HASHED_CONTAINER_PROTOTYPES(ucs_memtrack_entry_t,
                                          UCS_MEMTRACK_ENTRY_HASH_SIZE,
                                          ucs_memtrack_entry_hash)
+SGLIB_DEFINE_LIST_PROTOTYPES(ucs_memtrack_site_t, ucs_memtrack_site_compare, next)
+SGLIB_DEFINE_HASHED_CONTAINER_PROTOTYPES(ucs_memtrack_site_t,
+                                         UCS_MEMTRACK_SITE_HASH_SIZE,
+                                         ucs_memtrack_site_hash)
 
 #if ENABLE_STATS
 static ucs_stats_class_t ucs_memtrack_stats_class = {
@@ -85,9 +112,51 @@ static inline ucs_memtrack_entry_t* ucs_memtrack_entry_new(const char* name)
     return entry;
 }
 
+/* Bin 0 holds empty allocations, and bin i>0 holds sizes [2^(i-1), 2^i) */
+static unsigned ucs_memtrack_size_bin(size_t size)
+{
+    if (size == 0) {
+        return 0;
+    }
+
+    return ucs_min(ucs_ilog2(size) + 1, UCS_MEMTRACK_SIZE_BINS - 1);
+}
+
+static void ucs_memtrack_site_record(const void *caller, const char *name,
+                                     size_t size, int is_hot)
+{
+    ucs_memtrack_site_t *site, search;
+
+    search.caller = caller;
+    site = sglib_hashed_ucs_memtrack_site_t_find_member(ucs_memtrack_context.sites,
+                                                        &search);
+    if (site == NULL) {
+        site = calloc(1, sizeof(*site));
+        if (site == NULL) {
+            return;
+        }
+
+        site->caller = caller;
+        ucs_snprintf_zero(site->name, UCS_MEMTRACK_NAME_MAX, "%s", name);
+        sglib_hashed_ucs_memtrack_site_t_add(ucs_memtrack_context.sites, site);
+    }
+
+    ++site->count;
+    ++site->size_hist[ucs_memtrack_size_bin(size)];
+    if (is_hot) {
+        if (site->hot_count++ == 0) {
+            ucs_debug("first hot-path allocation of '%s' (%zu bytes) from %p",
+                      name, size, caller);
+        }
+    }
+}
+
 static void ucs_memtrack_record_alloc(ucs_memtrack_buffer_t* buffer, size_t size,
-                                      off_t offset, const char *name)
+                                      off_t offset, const char *name,
+                                      const void *caller)
 {
+    int is_hot;
+
     ucs_memtrack_entry_t *entry, search;
     if (!ucs_memtrack_is_enabled()) {
         goto out;
@@ -129,6 +198,14 @@ static void ucs_memtrack_record_alloc(ucs_memtrack_buffer_t* buffer, size_t size
     UCS_STATS_UPDATE_COUNTER(ucs_memtrack_context.stats, UCS_MEMTRACK_STAT_ALLOCATION_SIZE, size);
     entry->peak_size = ucs_max(entry->peak_size, entry->size);
 
+    /* Update cumulative counters */
+    is_hot = (ucs_memtrack_hot_path_depth > 0);
+    ++ucs_memtrack_context.num_allocs;
+    ucs_memtrack_context.num_hot_path_allocs += is_hot;
+    if (ucs_global_opts.memtrack_sites) {
+        ucs_memtrack_site_record(caller, name, size, is_hot);
+    }
+
 out_unlock:
     pthread_mutex_unlock(&ucs_memtrack_context.lock);
 out:
@@ -176,7 +253,8 @@ void *ucs_malloc(size_t size, const char *name)
         return buffer;
     }
 
-    ucs_memtrack_record_alloc(buffer, size, 0, name);
+    ucs_memtrack_record_alloc(buffer, size, 0, name,
+                              __builtin_return_address(0));
     return buffer + 1;
 }
 
@@ -189,7 +267,8 @@ void *ucs_calloc(size_t nmemb, size_t size, const char *name)
         return buffer;
     }
 
-    ucs_memtrack_record_alloc(buffer, nmemb * size, 0, name);
+    ucs_memtrack_record_alloc(buffer, nmemb * size, 0, name,
+                              __builtin_return_address(0));
     return buffer + 1;
 }
 
@@ -203,7 +282,14 @@ void *ucs_realloc(void *ptr, size_t size, const char *name)
     }
 
     if (ptr == NULL) {
-        return ucs_malloc(size, name);
+        buffer = malloc(size + sizeof(*buffer));
+        if (buffer == NULL) {
+            return NULL;
+        }
+
+        ucs_memtrack_record_alloc(buffer, size, 0, name,
+                                  __builtin_return_address(0));
+        return buffer + 1;
     }
 
     entry = ucs_memtrack_record_release(buffer, 0);
@@ -213,7 +299,8 @@ void *ucs_realloc(void *ptr, size_t size, const char *name)
         return NULL;
     }
 
-    ucs_memtrack_record_alloc(buffer, size, 0, entry->name);
+    ucs_memtrack_record_alloc(buffer, size, 0, entry->name,
+                              __builtin_return_address(0));
     return buffer + 1;
 }
 
@@ -242,7 +329,8 @@ void *ucs_memalign(size_t boundary, size_t size, const char *name)
     }
 
     buffer = (void*)buffer + offset;
-    ucs_memtrack_record_alloc(buffer, size, offset, name);
+    ucs_memtrack_record_alloc(buffer, size, offset, name,
+                              __builtin_return_address(0));
     return buffer + 1;
 }
 
@@ -279,7 +367,8 @@ void *ucs_mmap(void *addr, size_t length, int prot, int flags, int fd,
         memmove(buffer + 1, buffer, length);
     }
 
-    ucs_memtrack_record_alloc(buffer, length, 0, name);
+    ucs_memtrack_record_alloc(buffer, length, 0, name,
+                              __builtin_return_address(0));
     return buffer + 1;
 }
 
@@ -303,7 +392,8 @@ void *ucs_mmap64(void *addr, size_t size, int prot, int flags, int fd,
         memmove(buffer + 1, buffer, size);
     }
 
-    ucs_memtrack_record_alloc(buffer, size, 0, name);
+    ucs_memtrack_record_alloc(buffer, size, 0, name,
+                              __builtin_return_address(0));
     return buffer + 1;
 }
 #endif
@@ -356,6 +446,16 @@ void ucs_memtrack_total(ucs_memtrack_entry_t* total)
     pthread_mutex_unlock(&ucs_memtrack_context.lock);
 }
 
+size_t ucs_memtrack_num_allocs()
+{
+    return ucs_memtrack_context.num_allocs;
+}
+
+size_t ucs_memtrack_num_hot_path_allocs()
+{
+    return ucs_memtrack_context.num_hot_path_allocs;
+}
+
 static int ucs_memtrack_cmp_entries(const void *ptr1, const void *ptr2)
 {
     const ucs_memtrack_entry_t *e1 = ptr1;
@@ -364,6 +464,84 @@ static int ucs_memtrack_cmp_entries(const void *ptr1, const void *ptr2)
     return (int)((ssize_t)e2->peak_size - (ssize_t)e1->peak_size);
 }
 
+static int ucs_memtrack_cmp_sites(const void *ptr1, const void *ptr2)
+{
+    const ucs_memtrack_site_t *s1 = *(ucs_memtrack_site_t* const*)ptr1;
+    const ucs_memtrack_site_t *s2 = *(ucs_memtrack_site_t* const*)ptr2;
+
+    if (s1->hot_count != s2->hot_count) {
+        return (s1->hot_count < s2->hot_count) ? 1 : -1;
+    }
+    return (s1->count < s2->count) ? 1 : (s1->count > s2->count) ? -1 : 0;
+}
+
+static void ucs_memtrack_dump_sites(FILE* output_stream)
+{
+    struct sglib_hashed_ucs_memtrack_site_t_iterator site_it;
+    ucs_memtrack_site_t *site, **all_sites;
+    ucs_debug_address_info_t info;
+    unsigned num_sites, i, bin;
+    char location[sizeof(info.function) + sizeof(info.source_file) + 16];
+
+    num_sites = 0;
+    for (site = sglib_hashed_ucs_memtrack_site_t_it_init(&site_it,
+                                                         ucs_memtrack_context.sites);
+         site != NULL;
+         site = sglib_hashed_ucs_memtrack_site_t_it_next(&site_it))
+    {
+        ++num_sites;
+    }
+
+    all_sites = malloc(sizeof(*all_sites) * num_sites);
+    if (all_sites == NULL) {
+        return;
+    }
+
+    i = 0;
+    for (site = sglib_hashed_ucs_memtrack_site_t_it_init(&site_it,
+                                                         ucs_memtrack_context.sites);
+         site != NULL;
+         site = sglib_hashed_ucs_memtrack_site_t_it_next(&site_it))
+    {
+        all_sites[i++] = site;
+    }
+
+    /* Hot-path sites first, then from most to least frequent */
+    qsort(all_sites, num_sites, sizeof(*all_sites), ucs_memtrack_cmp_sites);
+
+    fprintf(output_stream, "\n%-48s %-20s %9s %9s  %s\n", "call site", "name",
+            "count", "hot path", "size histogram (min_size:count)");
+    for (i = 0; i < num_sites; ++i) {
+        site = all_sites[i];
+        if (ucs_debug_lookup_address((void*)site->caller, &info) != UCS_OK) {
+            snprintf(location, sizeof(location), "%p", site->caller);
+        } else if (strlen(info.function) == 0) {
+            /* No debug info, print an offset which addr2line can resolve */
+            snprintf(location, sizeof(location), "%s+0x%lx",
+                     basename(info.file.path),
+                     (uintptr_t)site->caller - info.file.base);
+        } else if (info.line_number > 0) {
+            snprintf(location, sizeof(location), "%s() %s:%u", info.function,
+                     basename(info.source_file), info.line_number);
+        } else {
+            snprintf(location, sizeof(location), "%s()", info.function);
+        }
+
+        fprintf(output_stream, "%-48s %-20s %9zu %9zu ", location, site->name,
+                site->count, site->hot_count);
+        for (bin = 0; bin < UCS_MEMTRACK_SIZE_BINS; ++bin) {
+            if (site->size_hist[bin] > 0) {
+                fprintf(output_stream, " %zu:%zu",
+                        (bin == 0) ? 0 : (size_t)1 << (bin - 1),
+                        site->size_hist[bin]);
+            }
+        }
+        fprintf(output_stream, "\n");
+    }
+
+    free(all_sites);
+}
+
 static void ucs_memtrack_dump_internal(FILE* output_stream)
 {
     struct sglib_hashed_ucs_memtrack_entry_t_iterator entry_it;
@@ -404,6 +582,14 @@ static void ucs_memtrack_dump_internal(FILE* output_stream)
     }
 
     free(all_entries);
+
+    fprintf(output_stream, "%22s: %9zu of %9zu allocations\n", "hot path",
+            ucs_memtrack_context.num_hot_path_allocs,
+            ucs_memtrack_context.num_allocs);
+
+    if (ucs_global_opts.memtrack_sites) {
+        ucs_memtrack_dump_sites(output_stream);
+    }
 }
 
 void ucs_memtrack_dump(FILE* output_stream)
@@ -445,6 +631,9 @@ void ucs_memtrack_init()
     }
 
     sglib_hashed_ucs_memtrack_entry_t_init(ucs_memtrack_context.entries);
+    sglib_hashed_ucs_memtrack_site_t_init(ucs_memtrack_context.sites);
+    ucs_memtrack_context.num_allocs          = 0;
+    ucs_memtrack_context.num_hot_path_allocs = 0;
     status = UCS_STATS_NODE_ALLOC(&ucs_memtrack_context.stats, &ucs_memtrack_stats_class, NULL);
     if (status != UCS_OK) {
         return;
@@ -457,7 +646,9 @@ void ucs_memtrack_init()
 void ucs_memtrack_cleanup()
 {
     struct sglib_hashed_ucs_memtrack_entry_t_iterator entry_it;
+    struct sglib_hashed_ucs_memtrack_site_t_iterator site_it;
     ucs_memtrack_entry_t *entry;
+    ucs_memtrack_site_t *site;
 
     if (!ucs_memtrack_context.enabled) {
         return;
@@ -478,6 +669,14 @@ void ucs_memtrack_cleanup()
         sglib_hashed_ucs_memtrack_entry_t_delete(ucs_memtrack_context.entries, entry);
         free(entry);
     }
+    for (site = sglib_hashed_ucs_memtrack_site_t_it_init(&site_it,
+                                                         ucs_memtrack_context.sites);
+         site != NULL;
+         site = sglib_hashed_ucs_memtrack_site_t_it_next(&site_it))
+    {
+        sglib_hashed_ucs_memtrack_site_t_delete(ucs_memtrack_context.sites, site);
+        free(site);
+    }
     pthread_mutex_unlock(&ucs_memtrack_context.lock);
 }
 
@@ -502,7 +701,8 @@ void ucs_memtrack_allocated(void **ptr_p, size_t *size_p, const char *name)
     buffer   = *ptr_p;
     *ptr_p   = buffer + 1;
     *size_p -= sizeof(*buffer);
-    ucs_memtrack_record_alloc(buffer, *size_p, 0, name);
+    ucs_memtrack_record_alloc(buffer, *size_p, 0, name,
+                              __builtin_return_address(0));
 }
 
 void ucs_memtrack_releasing(void **ptr_p)
@@ -533,10 +733,26 @@ static int ucs_memtrack_entry_compare(ucs_memtrack_entry_t *entry1,
     return strcmp(entry1->name, entry2->name);
 }
 
+static uint64_t ucs_memtrack_site_hash(ucs_memtrack_site_t *site)
+{
+    return (uintptr_t)site->caller;
+}
+
+static int ucs_memtrack_site_compare(ucs_memtrack_site_t *site1,
+                                     ucs_memtrack_site_t *site2)
+{
+    return (site1->caller < site2->caller) ? -1 :
+           (site1->caller > site2->caller) ?  1 : 0;
+}
+
 SGLIB_DEFINE_LIST_FUNCTIONS(ucs_memtrack_entry_t, ucs_memtrack_entry_compare, next)
 SGLIB_DEFINE_HASHED_CONTAINER_FUNCTIONS(ucs_memtrack_entry_t,
                                         UCS_MEMTRACK_ENTRY_HASH_SIZE,
                                         ucs_memtrack_entry_hash)
+SGLIB_DEFINE_LIST_FUNCTIONS(ucs_memtrack_site_t, ucs_memtrack_site_compare, next)
+SGLIB_DEFINE_HASHED_CONTAINER_FUNCTIONS(ucs_memtrack_site_t,
+                                        UCS_MEMTRACK_SITE_HASH_SIZE,
+                                        ucs_memtrack_site_hash)
 
 #endif
 
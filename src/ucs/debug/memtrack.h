@@ -24,6 +24,7 @@ enum {
 };
 
 #define UCS_MEMTRACK_NAME_MAX  20
+#define UCS_MEMTRACK_SIZE_BINS 32 /* Power-of-2 size bins of call-site histograms */
 
 /**
  * Allocation site entry.
@@ -53,6 +54,17 @@ void ucs_memtrack_total_reset(ucs_memtrack_entry_t* total);
 #define UCS_MEMTRACK_NAME(_n)   , _n
 
 
+extern __thread unsigned ucs_memtrack_hot_path_depth;
+
+
+/**
+ * Mark entry to and exit from a fast-path function, such as send, receive, or
+ * progress. Allocations made in between are counted as hot-path allocations.
+ */
+#define UCS_MEMTRACK_HOT_PATH_ENTER()   (++ucs_memtrack_hot_path_depth)
+#define UCS_MEMTRACK_HOT_PATH_EXIT()    (--ucs_memtrack_hot_path_depth)
+
+
 /**
  * Start trakcing memory (or increment reference count).
  */
@@ -82,6 +94,18 @@ void ucs_memtrack_dump(FILE* output);
  */
 void ucs_memtrack_total(ucs_memtrack_entry_t* total);
 
+/**
+ * @return Total number of allocations made since memtrack was enabled,
+ *         including ones which were already released.
+ */
+size_t ucs_memtrack_num_allocs();
+
+/**
+ * @return Number of allocations made on the hot path since memtrack was
+ *         enabled.
+ */
+size_t ucs_memtrack_num_hot_path_allocs();
+
 /**
  * Adjust size before doing custom allocation. Need to be called in order to
  * obtain the size of a custom allocation to have room for memtrack descriptor.
@@ -134,11 +158,16 @@ int ucs_munmap(void *addr, size_t length);
 #define UCS_MEMTRACK_VAL_ALWAYS                    ""
 #define UCS_MEMTRACK_NAME(_n)
 
+#define UCS_MEMTRACK_HOT_PATH_ENTER()              UCS_EMPTY_STATEMENT
+#define UCS_MEMTRACK_HOT_PATH_EXIT()               UCS_EMPTY_STATEMENT
+
 #define ucs_memtrack_init()                        UCS_EMPTY_STATEMENT
 #define ucs_memtrack_cleanup()                     UCS_EMPTY_STATEMENT
 #define ucs_memtrack_is_enabled()                  0
 #define ucs_memtrack_dump(_output)                 UCS_EMPTY_STATEMENT
 #define ucs_memtrack_total(_total)                 ucs_memtrack_total_init(_total)
+#define ucs_memtrack_num_allocs()                  0
+#define ucs_memtrack_num_hot_path_allocs()         0
 
 #define ucs_memtrack_adjust_alloc_size(_size)      (_size)
 #define ucs_memtrack_allocated(_ptr_p, _sz_p, ...) UCS_EMPTY_STATEMENT
@@ -18,15 +18,24 @@ const char *ucs_profile_mode_names[] = {
 
 ucs_profile_global_context_t ucs_profile_ctx = {
     .locations       = NULL,
-    .log.start       = NULL,
-    .log.end         = NULL,
-    .log.current     = NULL,
-    .log.wraparound  = 0,
-    .accum.stack_top = -1,
     .num_locations   = 0,
     .max_locations   = 0,
+    .generation      = 0,
+    .dump_generation = 0,
+    .mutex           = PTHREAD_MUTEX_INITIALIZER,
+    .thread_list     = UCS_LIST_INITIALIZER(&ucs_profile_ctx.thread_list,
+                                            &ucs_profile_ctx.thread_list),
+    .tls_key_valid   = 0,
+    .stream          = {
+        .enabled     = 0,
+        .stop        = 0,
+        .cond        = PTHREAD_COND_INITIALIZER
+    }
 };
 
+__thread ucs_profile_thread_context_t *ucs_profile_thread_ctx = NULL;
+
+
 static void ucs_profile_file_write_data(int fd, void *data, size_t size)
 {
     ssize_t written = write(fd, data, size);
@@ -44,20 +53,77 @@ static void ucs_profile_file_write_records(int fd, ucs_profile_record_t *begin,
     ucs_profile_file_write_data(fd, begin, (void*)end - (void*)begin);
 }
 
-static void ucs_profile_write()
+static int ucs_profile_thread_is_active(ucs_profile_thread_context_t *ctx)
 {
-    ucs_profile_header_t header;
-    char fullpath[1024] = {0};
-    char filename[1024] = {0};
-    int fd;
+    return ctx->generation == ucs_profile_ctx.generation;
+}
 
-    if (!ucs_global_opts.profile_mode) {
+/*
+ * The thread has not recorded anything since its buffers were written by the
+ * last dump. Only the thread itself resets them, see ucs_profile_dump().
+ */
+static int ucs_profile_thread_is_dumped(ucs_profile_thread_context_t *ctx)
+{
+    return ctx->dump_generation != ucs_profile_ctx.dump_generation;
+}
+
+static uint64_t ucs_profile_thread_num_records(ucs_profile_thread_context_t *ctx)
+{
+    if (ucs_profile_ctx.stream.enabled) {
+        return ctx->stream.num_records;
+    } else if (ucs_profile_thread_is_dumped(ctx)) {
+        return 0;
+    }
+
+    return ctx->log.wraparound ? (ctx->log.end     - ctx->log.start) :
+                                 (ctx->log.current - ctx->log.start);
+}
+
+static void ucs_profile_write_thread(int fd, ucs_profile_thread_context_t *ctx)
+{
+    ucs_profile_thread_location_t empty_location = {0};
+    ucs_profile_thread_header_t thread_header;
+    unsigned i, num_locations;
+
+    /* write thread header */
+    thread_header.tid         = ctx->tid;
+    thread_header.num_records = ucs_profile_thread_num_records(ctx);
+    ucs_profile_file_write_data(fd, &thread_header, sizeof(thread_header));
+
+    /* write thread location counters, including ones registered after the
+     * thread has made its last record */
+    num_locations = ucs_profile_thread_is_dumped(ctx) ? 0 :
+                    ctx->accum.num_locations;
+    ucs_profile_file_write_data(fd, ctx->accum.locations,
+                                sizeof(*ctx->accum.locations) * num_locations);
+    for (i = num_locations; i < ucs_profile_ctx.num_locations; ++i) {
+        ucs_profile_file_write_data(fd, &empty_location, sizeof(empty_location));
+    }
+
+    /* write thread records */
+    if (ucs_profile_ctx.stream.enabled) {
+        ucs_profile_file_write_records(fd, ctx->stream.records,
+                                       ctx->stream.records +
+                                       ctx->stream.num_records);
+        return;
+    } else if (ucs_profile_thread_is_dumped(ctx)) {
         return;
     }
 
-    ucs_fill_filename_template(ucs_global_opts.profile_file,
-                               filename, sizeof(filename));
-    ucs_expand_path(filename, fullpath, sizeof(fullpath) - 1);
+    if (ctx->log.wraparound > 0) {
+        ucs_profile_file_write_records(fd, ctx->log.current, ctx->log.end);
+    }
+    ucs_profile_file_write_records(fd, ctx->log.start, ctx->log.current);
+}
+
+/* Must be called with the mutex held */
+static void ucs_profile_write_file(const char *fullpath)
+{
+    ucs_profile_thread_context_t *ctx;
+    ucs_profile_header_t header;
+    ucs_profile_location_t *locations;
+    unsigned i;
+    int fd;
 
     fd = open(fullpath, O_WRONLY|O_CREAT|O_TRUNC, 0600);
     if (fd < 0) {
@@ -67,39 +133,243 @@ static void ucs_profile_write()
 
     /* write header */
     memset(&header, 0, sizeof(header));
+    header.version = UCS_PROFILE_FILE_VERSION;
     ucs_read_file(header.cmdline, sizeof(header.cmdline), 1, "/proc/self/cmdline");
     strncpy(header.hostname, ucs_get_host_name(), sizeof(header.hostname) - 1);
     header.pid = getpid();
     header.mode = ucs_global_opts.profile_mode;
     header.num_locations = ucs_profile_ctx.num_locations;
-    header.num_records   = ucs_profile_ctx.log.wraparound ?
-                    (ucs_profile_ctx.log.end     - ucs_profile_ctx.log.start) :
-                    (ucs_profile_ctx.log.current - ucs_profile_ctx.log.start);
     header.one_second    = ucs_time_from_sec(1.0);
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        if (ucs_profile_thread_is_active(ctx)) {
+            header.num_records += ucs_profile_thread_num_records(ctx);
+            ++header.num_threads;
+        }
+    }
     ucs_profile_file_write_data(fd, &header, sizeof(header));
 
-    /* write locations */
-    ucs_profile_file_write_data(fd, ucs_profile_ctx.locations,
-                                sizeof(*ucs_profile_ctx.locations) *
-                                ucs_profile_ctx.num_locations);
+    /* write locations, with counters summed over all threads */
+    locations = ucs_malloc(sizeof(*locations) * ucs_profile_ctx.num_locations,
+                           "profile_loc_sum");
+    if (locations != NULL) {
+        memcpy(locations, ucs_profile_ctx.locations,
+               sizeof(*locations) * ucs_profile_ctx.num_locations);
+        ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+            if (!ucs_profile_thread_is_active(ctx) ||
+                ucs_profile_thread_is_dumped(ctx)) {
+                continue;
+            }
+            for (i = 0; i < ctx->accum.num_locations; ++i) {
+                locations[i].total_time += ctx->accum.locations[i].total_time;
+                locations[i].count      += ctx->accum.locations[i].count;
+            }
+        }
+        ucs_profile_file_write_data(fd, locations,
+                                    sizeof(*locations) * ucs_profile_ctx.num_locations);
+        ucs_free(locations);
+    } else {
+        ucs_warn("failed to allocate locations array, writing without counters");
+        ucs_profile_file_write_data(fd, ucs_profile_ctx.locations,
+                                    sizeof(*ucs_profile_ctx.locations) *
+                                    ucs_profile_ctx.num_locations);
+    }
 
-    /* write records */
-    if (ucs_profile_ctx.log.wraparound > 0) {
-        ucs_profile_file_write_records(fd, ucs_profile_ctx.log.current,
-                                       ucs_profile_ctx.log.end);
+    /* write per-thread data */
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        if (ucs_profile_thread_is_active(ctx)) {
+            ucs_profile_write_thread(fd, ctx);
+        }
     }
-    ucs_profile_file_write_records(fd, ucs_profile_ctx.log.start,
-                                   ucs_profile_ctx.log.current);
 
     close(fd);
 }
 
+static void ucs_profile_full_path(char *fullpath, size_t max)
+{
+    char filename[1024] = {0};
+
+    ucs_fill_filename_template(ucs_global_opts.profile_file,
+                               filename, sizeof(filename));
+    ucs_expand_path(filename, fullpath, max - 1);
+}
+
+/*
+ * Copy the records the thread has made since the last drain. The thread keeps
+ * recording meanwhile, and may overwrite the oldest records while they are
+ * being copied. Those are detected by reading the record count again after the
+ * copy, and dropped.
+ */
+static void ucs_profile_thread_drain(ucs_profile_thread_context_t *ctx)
+{
+    uint64_t capacity, head, first, valid, i;
+
+    ctx->stream.num_records = 0;
+    if (ctx->log.start == NULL) {
+        return;
+    }
+
+    capacity = ctx->log.end - ctx->log.start;
+    if (ctx->stream.records == NULL) {
+        ctx->stream.records = ucs_malloc(sizeof(*ctx->stream.records) * capacity,
+                                         "profile_stream");
+        if (ctx->stream.records == NULL) {
+            ucs_warn("failed to allocate profiling stream buffer");
+            return;
+        }
+    }
+
+    head = ctx->log.count;
+    ucs_memory_cpu_load_fence();
+    first = ucs_max(ctx->stream.flushed, (head > capacity) ? (head - capacity) : 0);
+    for (i = first; i < head; ++i) {
+        ctx->stream.records[i - first] = ctx->log.start[i % capacity];
+    }
+    ucs_memory_cpu_load_fence();
+
+    /* The record being made now overwrites the slot of (count - capacity) */
+    valid = ctx->log.count + 1;
+    valid = (valid > capacity) ? (valid - capacity) : 0;
+    if (valid > first) {
+        valid = ucs_min(valid, head);
+        memmove(ctx->stream.records, ctx->stream.records + (valid - first),
+                sizeof(*ctx->stream.records) * (head - valid));
+        first = valid;
+    }
+
+    ctx->stream.dropped    += first - ctx->stream.flushed;
+    ctx->stream.num_records = head - first;
+    ctx->stream.flushed     = head;
+}
+
+/* Must be called with the mutex held */
+static void ucs_profile_stream_flush()
+{
+    ucs_profile_thread_context_t *ctx;
+    char path[sizeof(ucs_profile_ctx.stream.path) + 16];
+    unsigned files;
+
+    ucs_list_for_each(ctx, &ucs_profile_ctx.thread_list, list) {
+        if (ucs_profile_thread_is_active(ctx)) {
+            ucs_profile_thread_drain(ctx);
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s.%u", ucs_profile_ctx.stream.path,
+             ucs_profile_ctx.stream.index);
+    ucs_profile_write_file(path);
+
+    /* remove the oldest file to bound disk usage */
+    files = ucs_global_opts.profile_stream_files;
+    if ((files > 0) && (ucs_profile_ctx.stream.index >= files)) {
+        snprintf(path, sizeof(path), "%s.%u", ucs_profile_ctx.stream.path,
+                 ucs_profile_ctx.stream.index - files);
+        unlink(path);
+    }
+
+    ++ucs_profile_ctx.stream.index;
+}
+
+static void ucs_profile_write(int reset)
+{
+    char fullpath[1024] = {0};
+
+    if (!ucs_global_opts.profile_mode) {
+        return;
+    }
+
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+    if (ucs_profile_ctx.stream.enabled) {
+        ucs_profile_stream_flush();
+    } else {
+        ucs_profile_full_path(fullpath, sizeof(fullpath));
+        ucs_profile_write_file(fullpath);
+    }
+
+    if (reset) {
+        /* Other threads may be recording now, so each thread resets its own
+         * buffers on its next record. Until then, it is written as empty. */
+        ++ucs_profile_ctx.dump_generation;
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+}
+
+static void *ucs_profile_stream_thread_func(void *arg)
+{
+    struct timespec deadline, interval;
+    int ret;
+
+    ucs_sec_to_timespec(ucs_global_opts.profile_stream_interval, &interval);
+    clock_gettime(CLOCK_REALTIME, &deadline);
+
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+    while (!ucs_profile_ctx.stream.stop) {
+        deadline.tv_sec  += interval.tv_sec;
+        deadline.tv_nsec += interval.tv_nsec;
+        if (deadline.tv_nsec >= UCS_NSEC_PER_SEC) {
+            deadline.tv_nsec -= UCS_NSEC_PER_SEC;
+            ++deadline.tv_sec;
+        }
+
+        do {
+            ret = pthread_cond_timedwait(&ucs_profile_ctx.stream.cond,
+                                         &ucs_profile_ctx.mutex, &deadline);
+        } while (!ucs_profile_ctx.stream.stop && (ret != ETIMEDOUT));
+
+        if (!ucs_profile_ctx.stream.stop) {
+            ucs_profile_stream_flush();
+        }
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+    return NULL;
+}
+
+static void ucs_profile_stream_start()
+{
+    int ret;
+
+    ucs_profile_full_path(ucs_profile_ctx.stream.path,
+                          sizeof(ucs_profile_ctx.stream.path));
+    ucs_profile_ctx.stream.index   = 0;
+    ucs_profile_ctx.stream.stop    = 0;
+    ucs_profile_ctx.stream.enabled = 1;
+
+    ret = pthread_create(&ucs_profile_ctx.stream.thread, NULL,
+                         ucs_profile_stream_thread_func, NULL);
+    if (ret != 0) {
+        ucs_warn("failed to create profiling stream thread: %s, profiling "
+                 "data is written on exit only", strerror(ret));
+        ucs_profile_ctx.stream.enabled = 0;
+    }
+}
+
+static void ucs_profile_stream_stop()
+{
+    if (!ucs_profile_ctx.stream.enabled) {
+        return;
+    }
+
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+    ucs_profile_ctx.stream.stop = 1;
+    pthread_cond_signal(&ucs_profile_ctx.stream.cond);
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+    pthread_join(ucs_profile_ctx.stream.thread, NULL);
+}
+
 int ucs_profile_get_location(ucs_profile_type_t type, const char *name,
-                             const char *file, int line, const char *function)
+                             const char *file, int line, const char *function,
+                             volatile int *location_p)
 {
     ucs_profile_location_t *loc;
     int location;
 
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+
+    /* Another thread could have registered the location */
+    if (*location_p != -1) {
+        location = *location_p;
+        goto out_unlock;
+    }
+
     location = ucs_profile_ctx.num_locations++;
 
     /* Expand array if needed */
@@ -111,7 +381,8 @@ int ucs_profile_get_location(ucs_profile_type_t type, const char *name,
                                                 "profile_locations");
         if (ucs_profile_ctx.locations == NULL) {
             ucs_warn("failed to expand locations array");
-            return 0;
+            location = 0;
+            goto out_set;
         }
     }
 
@@ -124,14 +395,151 @@ int ucs_profile_get_location(ucs_profile_type_t type, const char *name,
     loc->type       = type;
     loc->total_time = 0;
     loc->count      = 0;
+    ++location;
 
-    return location + 1;
+out_set:
+    *location_p = location;
+out_unlock:
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+    return location;
 }
 
-void ucs_profile_global_init()
+static void ucs_profile_thread_release(ucs_profile_thread_context_t *ctx)
+{
+    if (ctx->stream.dropped > 0) {
+        ucs_warn("profiling log of thread %d overflowed between flushes, "
+                 "%"PRIu64" records were lost", ctx->tid, ctx->stream.dropped);
+    }
+
+    ucs_free(ctx->stream.records);
+    ctx->stream.records       = NULL;
+    ctx->stream.num_records   = 0;
+    ctx->stream.flushed       = 0;
+    ctx->stream.dropped       = 0;
+    ucs_free(ctx->log.start);
+    ctx->log.start            = NULL;
+    ctx->log.end              = NULL;
+    ctx->log.current          = NULL;
+    ctx->log.wraparound       = 0;
+    ctx->log.count            = 0;
+    ucs_free(ctx->accum.locations);
+    ctx->accum.locations      = NULL;
+    ctx->accum.num_locations  = 0;
+}
+
+static void ucs_profile_thread_exit(void *arg)
+{
+    ucs_profile_thread_context_t *ctx = arg;
+
+    /* Keep the data until it is written, and release it on cleanup */
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+    ctx->is_exited = 1;
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+}
+
+/* Reset the buffers of the calling thread after they were dumped */
+static void ucs_profile_thread_reset(ucs_profile_thread_context_t *ctx)
+{
+    memset(ctx->accum.locations, 0,
+           sizeof(*ctx->accum.locations) * ctx->accum.num_locations);
+    /* A streamed log is consumed by the flush itself */
+    if ((ctx->log.start != NULL) && !ucs_profile_ctx.stream.enabled) {
+        ctx->log.wraparound = 0;
+        ctx->log.current    = ctx->log.start;
+    }
+    ctx->dump_generation = ucs_profile_ctx.dump_generation;
+}
+
+static ucs_status_t ucs_profile_thread_start(ucs_profile_thread_context_t *ctx)
 {
     size_t num_records;
 
+    ucs_profile_thread_release(ctx);
+
+    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
+        num_records = ucs_global_opts.profile_log_size / sizeof(ucs_profile_record_t);
+        ctx->log.start = ucs_calloc(num_records, sizeof(ucs_profile_record_t),
+                                    "profile_log");
+        if (ctx->log.start == NULL) {
+            ucs_warn("failed to allocate profiling log");
+            return UCS_ERR_NO_MEMORY;
+        }
+
+        ctx->log.end     = ctx->log.start + num_records;
+        ctx->log.current = ctx->log.start;
+    }
+
+    ctx->accum.stack_top = -1;
+    ctx->sample.counter  = 0;
+    ctx->sample.depth    = 0;
+    ctx->sample.active   = 0;
+    ctx->generation      = ucs_profile_ctx.generation;
+    ctx->dump_generation = ucs_profile_ctx.dump_generation;
+    return UCS_OK;
+}
+
+ucs_profile_thread_context_t *ucs_profile_thread_context_get(unsigned num_locations)
+{
+    ucs_profile_thread_context_t *ctx = ucs_profile_thread_ctx;
+    ucs_profile_thread_location_t *locations;
+    ucs_status_t status;
+
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+
+    if (ctx == NULL) {
+        ctx = ucs_calloc(1, sizeof(*ctx), "profile_thread");
+        if (ctx == NULL) {
+            ucs_warn("failed to allocate profiling thread context");
+            goto err_unlock;
+        }
+
+        ctx->tid        = ucs_get_tid();
+        ctx->generation = ucs_profile_ctx.generation - 1;
+        ucs_list_add_tail(&ucs_profile_ctx.thread_list, &ctx->list);
+        if (ucs_profile_ctx.tls_key_valid) {
+            pthread_setspecific(ucs_profile_ctx.tls_key, ctx);
+        }
+        ucs_profile_thread_ctx = ctx;
+    }
+
+    if (!ucs_profile_thread_is_active(ctx)) {
+        status = ucs_profile_thread_start(ctx);
+        if (status != UCS_OK) {
+            goto err_unlock;
+        }
+    } else if (ucs_profile_thread_is_dumped(ctx)) {
+        ucs_profile_thread_reset(ctx);
+    }
+
+    if (num_locations > ctx->accum.num_locations) {
+        /* Allocate counters for all registered locations at once */
+        num_locations = ucs_max(num_locations, ucs_profile_ctx.num_locations);
+        locations     = ucs_realloc(ctx->accum.locations,
+                                    sizeof(*locations) * num_locations,
+                                    "profile_thread_loc");
+        if (locations == NULL) {
+            ucs_warn("failed to expand thread locations array");
+            goto err_unlock;
+        }
+
+        memset(locations + ctx->accum.num_locations, 0,
+               sizeof(*locations) * (num_locations - ctx->accum.num_locations));
+        ctx->accum.locations     = locations;
+        ctx->accum.num_locations = num_locations;
+    }
+
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+    return ctx;
+
+err_unlock:
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+    return NULL;
+}
+
+void ucs_profile_global_init()
+{
+    int ret;
+
     if (!ucs_global_opts.profile_mode) {
         goto off;
     }
@@ -141,22 +549,22 @@ void ucs_profile_global_init()
         goto disable;
     }
 
-    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
-        num_records = ucs_global_opts.profile_log_size / sizeof(ucs_profile_record_t);
-        ucs_profile_ctx.log.start = ucs_calloc(num_records,
-                                               sizeof(ucs_profile_record_t),
-                                               "profile_log");
-        if (ucs_profile_ctx.log.start == NULL) {
-            ucs_warn("failed to allocate profiling log");
-            goto disable;
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+    if (!ucs_profile_ctx.tls_key_valid) {
+        ret = pthread_key_create(&ucs_profile_ctx.tls_key, ucs_profile_thread_exit);
+        if (ret != 0) {
+            ucs_warn("failed to create profiling thread key: %s", strerror(ret));
+        } else {
+            ucs_profile_ctx.tls_key_valid = 1;
         }
-
-        ucs_profile_ctx.log.end     = ucs_profile_ctx.log.start + num_records;
-        ucs_profile_ctx.log.current = ucs_profile_ctx.log.start;
     }
 
-    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) {
-        ucs_profile_ctx.accum.stack_top = -1;
+    /* Threads set up their buffers on first record */
+    ++ucs_profile_ctx.generation;
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
+
+    if (ucs_global_opts.profile_stream_interval > 0) {
+        ucs_profile_stream_start();
     }
 
     ucs_info("profiling is enabled");
@@ -170,32 +578,29 @@ off:
 
 void ucs_profile_global_cleanup()
 {
-    ucs_profile_write();
-    ucs_free(ucs_profile_ctx.log.start);
-    ucs_profile_ctx.log.start      = NULL;
-    ucs_profile_ctx.log.end        = NULL;
-    ucs_profile_ctx.log.current    = NULL;
-    ucs_profile_ctx.log.wraparound = 0;
+    ucs_profile_thread_context_t *ctx, *tmp;
+
+    ucs_profile_stream_stop();
+    ucs_profile_write(0);
+
+    pthread_mutex_lock(&ucs_profile_ctx.mutex);
+    ucs_profile_ctx.stream.enabled = 0;
+    ++ucs_profile_ctx.generation;
+    /* Live threads may be recording now. They release their buffers when
+     * they start the next session, see ucs_profile_thread_start(). */
+    ucs_list_for_each_safe(ctx, tmp, &ucs_profile_ctx.thread_list, list) {
+        if (ctx->is_exited) {
+            ucs_profile_thread_release(ctx);
+            ucs_list_del(&ctx->list);
+            ucs_free(ctx);
+        }
+    }
+    pthread_mutex_unlock(&ucs_profile_ctx.mutex);
 }
 
 void ucs_profile_dump()
 {
-    ucs_profile_location_t *loc;
-
-    ucs_profile_write();
-
-    for (loc = ucs_profile_ctx.locations;
-         loc < ucs_profile_ctx.locations + ucs_profile_ctx.num_locations;
-         ++loc)
-    {
-        loc->count      = 0;
-        loc->total_time = 0;
-    }
-
-    if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
-        ucs_profile_ctx.log.wraparound = 0;
-        ucs_profile_ctx.log.current    = ucs_profile_ctx.log.start;
-    }
+    ucs_profile_write(1);
 }
 
 #else
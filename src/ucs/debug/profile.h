@@ -12,11 +12,15 @@
 #endif
 
 #include <ucs/sys/preprocessor.h>
+#include <ucs/datastruct/list.h>
 #include <ucs/time/time.h>
 #include <ucs/debug/log.h>
 
+#include <pthread.h>
+
 
 #define UCS_PROFILE_STACK_MAX 64
+#define UCS_PROFILE_FILE_VERSION 2u /* Version 2 adds per-thread sections */
 
 
 /**
@@ -44,16 +48,28 @@ typedef enum {
  * Profile output file header
  */
 typedef struct ucs_profile_header {
+    uint32_t                 version;       /**< File format version, UCS_PROFILE_FILE_VERSION */
     char                     cmdline[1024]; /**< Command line */
     char                     hostname[40];  /**< Host name */
     uint32_t                 pid;           /**< Process ID */
     uint32_t                 mode;          /**< Profiling mode */
     uint32_t                 num_locations; /**< Number of locations in the file */
-    uint64_t                 num_records;   /**< Number of records in the file */
+    uint64_t                 num_records;   /**< Total number of records in the file */
     uint64_t                 one_second;    /**< How much time is one second on the sampled machine */
+    uint32_t                 num_threads;   /**< Number of thread sections in the file */
 } UCS_S_PACKED ucs_profile_header_t;
 
 
+/**
+ * Profile output file thread section header. It is followed by the thread's
+ * location counters, and then by the thread's records.
+ */
+typedef struct ucs_profile_thread_header {
+    uint32_t                 tid;           /**< System thread ID */
+    uint64_t                 num_records;   /**< Number of records of the thread */
+} UCS_S_PACKED ucs_profile_thread_header_t;
+
+
 /**
  * Profile output file sample record
  */
@@ -78,25 +94,79 @@ typedef struct ucs_profile_location {
 
 
 /**
- * Profiling global context
+ * Per-thread location counters
  */
-typedef struct ucs_profile_global_context {
+typedef struct ucs_profile_thread_location {
+    uint64_t                 total_time;    /**< Total interval from previous location */
+    size_t                   count;         /**< Number of times we've hit this location */
+} UCS_S_PACKED ucs_profile_thread_location_t;
 
-    ucs_profile_location_t   *locations;    /**< Array of all locations */
-    unsigned                 num_locations; /**< Number of valid locations */
-    unsigned                 max_locations; /**< Size of locations array */
+
+/**
+ * Profiling context of a single thread
+ */
+typedef struct ucs_profile_thread_context {
+    pid_t                    tid;           /**< System thread ID */
+    unsigned                 generation;    /**< Profiling session of the buffers */
+    unsigned                 dump_generation; /**< Last dump the thread reset its buffers for */
+    int                      is_exited;     /**< Whether the thread has exited */
+    ucs_list_link_t          list;          /**< Entry in global threads list */
 
     struct {
         ucs_profile_record_t *start, *end;  /**< Circular log buffer */
         ucs_profile_record_t *current;      /**< Current log pointer */
         int                  wraparound;    /**< Whether log was rotated */
+        volatile uint64_t    count;         /**< Total number of records made */
     } log;
 
     struct {
         int                  stack_top;     /**< Index of stack top */
         ucs_time_t           stack[UCS_PROFILE_STACK_MAX]; /**< Timestamps for each nested scope */
+        ucs_profile_thread_location_t *locations; /**< Counters for each location */
+        unsigned             num_locations; /**< Size of locations array */
     } accum;
 
+    struct {
+        unsigned             counter;       /**< Top-level events since last sampled one */
+        unsigned             depth;         /**< Current scope nesting depth */
+        int                  active;        /**< Whether current top-level scope is sampled */
+    } sample;
+
+    struct {
+        uint64_t             flushed;       /**< Value of log.count at last drain */
+        ucs_profile_record_t *records;      /**< Records drained for writing */
+        uint64_t             num_records;   /**< Number of drained records */
+        uint64_t             dropped;       /**< Records overwritten before drain */
+    } stream;
+
+} ucs_profile_thread_context_t;
+
+
+/**
+ * Profiling global context
+ */
+typedef struct ucs_profile_global_context {
+
+    ucs_profile_location_t   *locations;    /**< Array of all locations */
+    unsigned                 num_locations; /**< Number of valid locations */
+    unsigned                 max_locations; /**< Size of locations array */
+
+    unsigned                 generation;    /**< Incremented on every init/cleanup */
+    unsigned                 dump_generation; /**< Incremented on every dump */
+    pthread_mutex_t          mutex;         /**< Protects locations and threads list */
+    ucs_list_link_t          thread_list;   /**< List of thread contexts */
+    pthread_key_t            tls_key;       /**< Used to detect thread exit */
+    int                      tls_key_valid; /**< Whether tls_key was created */
+
+    struct {
+        pthread_t            thread;        /**< Background flush thread */
+        int                  enabled;       /**< Whether streaming is enabled */
+        int                  stop;          /**< Set to stop the thread */
+        pthread_cond_t       cond;          /**< Signals the thread to stop */
+        char                 path[1024];    /**< Expanded output file name */
+        unsigned             index;         /**< Index of next output file */
+    } stream;
+
 } ucs_profile_global_context_t;
 
 
@@ -121,22 +191,75 @@ void ucs_profile_dump();
 #if HAVE_PROFILING
 
 extern const char *ucs_profile_mode_names[];
+extern ucs_profile_global_context_t ucs_profile_ctx;
+extern __thread ucs_profile_thread_context_t *ucs_profile_thread_ctx;
 
 /*
  * Register a profiling location - should be called once per location in the
  * code, before the first record of each such location is made.
  * Should not be used directly - use UCS_PROFILE macros instead.
  *
- * @param [in]  type      Location type.
- * @param [in]  file      Source file name.
- * @param [in]  line      Source line number.
- * @param [in]  function  Calling function name.
- * @param [in]  name      Location name.
+ * @param [in]     type        Location type.
+ * @param [in]     file        Source file name.
+ * @param [in]     line        Source line number.
+ * @param [in]     function    Calling function name.
+ * @param [in]     name        Location name.
+ * @param [in,out] location_p  Variable used to maintain the location ID. If
+ *                             another thread has already registered the
+ *                             location, its ID is returned.
  *
  * @return 0 for disabled record, positive instrumentation record id otherwise.
  */
 int ucs_profile_get_location(ucs_profile_type_t type, const char *name,
-                             const char *file, int line, const char *function);
+                             const char *file, int line, const char *function,
+                             volatile int *location_p);
+
+
+/*
+ * Get the profiling context of the calling thread, and make sure it is set up
+ * for the current profiling session, its buffers are reset if they were dumped,
+ * and it has counters for at least @a num_locations locations.
+ * Should not be used directly - use UCS_PROFILE macros instead.
+ *
+ * @return Thread context, or NULL if it could not be allocated.
+ */
+ucs_profile_thread_context_t *ucs_profile_thread_context_get(unsigned num_locations);
+
+
+/*
+ * Decide whether an event of the given type should be recorded, according to
+ * the sampling rate. Top-level events are sampled, and nested events follow the
+ * decision of their top-level scope.
+ */
+static inline int ucs_profile_thread_sample(ucs_profile_thread_context_t *ctx,
+                                            ucs_profile_type_t type)
+{
+    switch (type) {
+    case UCS_PROFILE_TYPE_SCOPE_BEGIN:
+        if (ctx->sample.depth++ > 0) {
+            return ctx->sample.active;
+        }
+        break;
+    case UCS_PROFILE_TYPE_SCOPE_END:
+        if (ctx->sample.depth > 0) {
+            --ctx->sample.depth;
+        }
+        return ctx->sample.active;
+    default:
+        if (ctx->sample.depth > 0) {
+            return ctx->sample.active;
+        }
+        break;
+    }
+
+    if (++ctx->sample.counter < ucs_global_opts.profile_sample_rate) {
+        ctx->sample.active = 0;
+    } else {
+        ctx->sample.counter = 0;
+        ctx->sample.active  = 1;
+    }
+    return ctx->sample.active;
+}
 
 
 /*
@@ -154,25 +277,46 @@ static inline void ucs_profile_record(ucs_profile_type_t type, const char *name,
                                       const char *file, int line,
                                       const char *function, int *location_p)
 {
-    extern ucs_profile_global_context_t ucs_profile_ctx;
-    ucs_profile_global_context_t *ctx = &ucs_profile_ctx;
-    ucs_profile_record_t   *rec;
-    ucs_profile_location_t *loc;
+    ucs_profile_thread_context_t  *ctx;
+    ucs_profile_record_t          *rec;
+    ucs_profile_thread_location_t *loc;
     ucs_time_t current_time;
+    int location;
 
 retry:
-    if (ucs_likely(*location_p == 0)) {
+    location = *location_p;
+    if (ucs_likely(location == 0)) {
         return;
     }
 
-    if (ucs_unlikely(*location_p == -1)) {
-        *location_p = ucs_profile_get_location(type, name, file, line, function);
+    if (ucs_unlikely(location == -1)) {
+        ucs_profile_get_location(type, name, file, line, function, location_p);
         goto retry;
     }
 
+    if (!ucs_global_opts.profile_mode) {
+        return;
+    }
+
+    ctx = ucs_profile_thread_ctx;
+    if (ucs_unlikely((ctx == NULL) ||
+                     (ctx->generation != ucs_profile_ctx.generation) ||
+                     (ctx->dump_generation != ucs_profile_ctx.dump_generation) ||
+                     (location > (int)ctx->accum.num_locations))) {
+        ctx = ucs_profile_thread_context_get(location);
+        if (ctx == NULL) {
+            return;
+        }
+    }
+
+    if (ucs_unlikely(ucs_global_opts.profile_sample_rate > 1) &&
+        !ucs_profile_thread_sample(ctx, type)) {
+        return;
+    }
+
     current_time = ucs_get_time();
     if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_ACCUM)) {
-        loc              = &ctx->locations[*location_p - 1];
+        loc              = &ctx->accum.locations[location - 1];
         switch (type) {
         case UCS_PROFILE_TYPE_SCOPE_BEGIN:
             ctx->accum.stack[++ctx->accum.stack_top] = current_time;
@@ -191,11 +335,14 @@ retry:
     if (ucs_global_opts.profile_mode & UCS_BIT(UCS_PROFILE_MODE_LOG)) {
         rec              = ctx->log.current;
         rec->timestamp   = current_time;
-        rec->location    = *location_p - 1;
+        rec->location    = location - 1;
         if (++ctx->log.current >= ctx->log.end) {
             ctx->log.current    = ctx->log.start;
             ctx->log.wraparound = 1;
         }
+        /* Publish the record to the stream thread */
+        ucs_memory_cpu_store_fence();
+        ++ctx->log.count;
     }
 }
 
@@ -282,12 +429,15 @@ retry:
  * Usage:
  *  UCS_PROFILE_FUNC(<retval>, <name>, (a, b), int a, char b)
  *
+ * The definition may be prefixed by "static".
+ *
  * @param _ret_type   Function return type.
  * @param _name       Function name.
  * @param _arglist    List of argument *names* only.
  * @param ...         Argument declarations (with types).
  */
 #define UCS_PROFILE_FUNC(_ret_type, _name, _arglist, ...) \
+    _ret_type _name(__VA_ARGS__); \
     static UCS_F_ALWAYS_INLINE _ret_type _name##_inner(__VA_ARGS__); \
     \
     _ret_type _name(__VA_ARGS__) { \
@@ -303,13 +453,16 @@ retry:
  * Create a profiled function whose return type is void.
  *
  * Usage:
- *  UCS_PROFILE_FUNC(<retval>, <name>, (a, b), int a, char b)
+ *  UCS_PROFILE_FUNC_VOID(<name>, (a, b), int a, char b)
+ *
+ * The definition may be prefixed by "static".
  *
  * @param _name       Function name.
  * @param _arglist    List of argument *names* only.
  * @param ...         Argument declarations (with types).
  */
 #define UCS_PROFILE_FUNC_VOID(_name, _arglist, ...) \
+    void _name(__VA_ARGS__); \
     static UCS_F_ALWAYS_INLINE void _name##_inner(__VA_ARGS__); \
     \
     void _name(__VA_ARGS__) { \
@@ -358,6 +511,7 @@ retry:
 #define UCS_PROFILE_SCOPE_END(_name)                        UCS_EMPTY_STATEMENT
 #define UCS_PROFILE_CODE(_name)
 #define UCS_PROFILE_FUNC(_ret_type, _name, _arglist, ...)   _ret_type _name(__VA_ARGS__)
+#define UCS_PROFILE_FUNC_VOID(_name, _arglist, ...)         void _name(__VA_ARGS__)
 #define UCS_PROFILE_CALL(_func, ...)                        _func(__VA_ARGS__)
 #define UCS_PROFILE_CALL_VOID(_func, ...)                   _func(__VA_ARGS__)
 
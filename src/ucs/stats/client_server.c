@@ -62,6 +62,8 @@ struct stats_entity {
     pthread_mutex_t     lock;
     volatile unsigned   refcount;
     void                *completed_buffer;  /* Completed buffer */
+    size_t              completed_size;     /* Size of data in completed buffer,
+                                               0 if none was assembled yet */
     struct timeval      update_time;
 };
 
@@ -237,6 +239,7 @@ static void ucs_stats_server_entity_reset_buffer(stats_entity_t * entity,
                                             new_size + sizeof(frag_hole_t));
         entity->completed_buffer  = realloc(entity->completed_buffer,
                                             new_size + sizeof(frag_hole_t));
+        entity->completed_size    = 0;
         pthread_mutex_unlock(&entity->lock);
     }
 
@@ -260,6 +263,7 @@ static stats_entity_t *ucs_stats_server_entity_alloc(struct sockaddr_in *addr)
     entity->buffer_size       = -1;
     entity->inprogress_buffer = NULL;
     entity->completed_buffer  = NULL;
+    entity->completed_size    = 0;
     entity->refcount          = 1;
     ucs_list_head_init(&entity->holes);
     pthread_mutex_init(&entity->lock, NULL);
@@ -395,6 +399,7 @@ ucs_stats_server_entity_update(ucs_stats_server_h server, stats_entity_t *entity
         ucs_debug("timestamp %"PRIu64" fully assembled", entity->timestamp);
         pthread_mutex_lock(&entity->lock);
         memcpy(entity->completed_buffer, entity->inprogress_buffer, entity->buffer_size);
+        entity->completed_size = entity->buffer_size;
         pthread_mutex_unlock(&entity->lock);
     }
 
@@ -619,7 +624,12 @@ ucs_list_link_t *ucs_stats_server_get_stats(ucs_stats_server_h server)
     {
         /* Parse the statistics data */
         pthread_mutex_lock(&entity->lock);
-        stream = fmemopen(entity->completed_buffer, entity->buffer_size, "rb");
+        if (entity->completed_size == 0) {
+            /* Nothing was fully assembled yet */
+            pthread_mutex_unlock(&entity->lock);
+            continue;
+        }
+        stream = fmemopen(entity->completed_buffer, entity->completed_size, "rb");
         status = ucs_stats_deserialize(stream, &node);
         fclose(stream);
         pthread_mutex_unlock(&entity->lock);
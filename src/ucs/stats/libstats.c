@@ -52,14 +52,62 @@ ucs_status_t ucs_stats_node_initv(ucs_stats_node_t *node, ucs_stats_class_t *cls
             return status;
         }
     }
+    for (i = 0; i < cls->num_histograms; ++i) {
+        status = ucs_stats_name_check(cls->histogram_names[i]);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
 
     /* Set up node */
     node->cls = cls;
     vsnprintf(node->name, UCS_STAT_NAME_MAX, name, ap);
     ucs_list_head_init(&node->children[UCS_STATS_INACTIVE_CHILDREN]);
     ucs_list_head_init(&node->children[UCS_STATS_ACTIVE_CHILDREN]);
-    memset(node->counters, 0, cls->num_counters * sizeof(ucs_stats_counter_t));
+    node->shards       = NULL;
+    node->num_shards   = 0;
+    node->shard_stride = 0;
+    memset(node->counters, 0,
+           ucs_stats_class_num_values(cls) * sizeof(ucs_stats_counter_t));
 
     return UCS_OK;
 }
 
+ucs_stats_counter_t ucs_stats_histogram_count(const ucs_stats_counter_t *buckets)
+{
+    ucs_stats_counter_t count;
+    unsigned i;
+
+    count = 0;
+    for (i = 0; i < UCS_STATS_HISTOGRAM_BUCKETS; ++i) {
+        count += buckets[i];
+    }
+    return count;
+}
+
+uint64_t ucs_stats_histogram_percentile(const ucs_stats_counter_t *buckets,
+                                        double percentile)
+{
+    ucs_stats_counter_t count, threshold, sum;
+    unsigned i;
+
+    count = ucs_stats_histogram_count(buckets);
+    if (count == 0) {
+        return 0;
+    }
+
+    /* Number of samples which must be less or equal to the result */
+    threshold = (ucs_stats_counter_t)(count * percentile / 100.0 + 0.5);
+    threshold = ucs_max(threshold, 1);
+
+    sum = 0;
+    for (i = 0; i < UCS_STATS_HISTOGRAM_BUCKETS; ++i) {
+        sum += buckets[i];
+        if (sum >= threshold) {
+            return ucs_stats_histogram_bucket_value(i);
+        }
+    }
+
+    return ucs_stats_histogram_bucket_value(UCS_STATS_HISTOGRAM_BUCKETS - 1);
+}
+
@@ -10,6 +10,7 @@
 #include <ucs/datastruct/list.h>
 #include <ucs/type/status.h>
 #include <ucs/sys/math.h>
+#include <ucs/arch/bitops.h>
 
 #include <stdint.h>
 #include <stdio.h>
@@ -29,6 +30,16 @@ enum {
 
 #define UCS_STAT_NAME_MAX          31
 
+/*
+ * Histograms are log-linear: every power of 2 is split into
+ * 2^UCS_STATS_HISTOGRAM_SUB_BITS equal-width buckets, so the relative error of
+ * a reported value is bounded by 2^-UCS_STATS_HISTOGRAM_SUB_BITS.
+ */
+#define UCS_STATS_HISTOGRAM_SUB_BITS    3
+#define UCS_STATS_HISTOGRAM_SUB_COUNT   UCS_BIT(UCS_STATS_HISTOGRAM_SUB_BITS)
+#define UCS_STATS_HISTOGRAM_BUCKETS     ((64 - UCS_STATS_HISTOGRAM_SUB_BITS + 1) * \
+                                         UCS_STATS_HISTOGRAM_SUB_COUNT)
+
 #define UCS_STATS_NODE_FMT \
     "%s%s"
 #define UCS_STATS_NODE_ARG(_node) \
@@ -53,6 +64,8 @@ typedef enum ucs_stats_children_sel {
 struct ucs_stats_class {
     const char           *name;
     unsigned             num_counters;
+    unsigned             num_histograms;
+    const char           **histogram_names;
     const char*          counter_names[];
 };
 
@@ -63,10 +76,103 @@ struct ucs_stats_node {
     char                 name[UCS_STAT_NAME_MAX + 1];
     ucs_list_link_t      list;
     ucs_list_link_t      children[UCS_STATS_CHILDREN_LAST];
-    ucs_stats_counter_t  counters[];
+    ucs_stats_counter_t  *shards;    /* Per-thread counter shards, or NULL */
+    unsigned             num_shards;
+    unsigned             shard_stride; /* Distance between shards, in counters */
+    ucs_stats_counter_t  counters[]; /* Counters, followed by histogram buckets */
 };
 
 
+/**
+ * @return Total number of counters and histogram buckets in a node of class
+ *         @a cls.
+ */
+static inline unsigned ucs_stats_class_num_values(ucs_stats_class_t *cls)
+{
+    return cls->num_counters + cls->num_histograms * UCS_STATS_HISTOGRAM_BUCKETS;
+}
+
+
+/**
+ * @return Value of counter @a index in @a node, summed over all its shards.
+ */
+static inline ucs_stats_counter_t
+ucs_stats_node_counter(const ucs_stats_node_t *node, unsigned index)
+{
+    ucs_stats_counter_t value = node->counters[index];
+    unsigned i;
+
+    for (i = 0; i < node->num_shards; ++i) {
+        value += node->shards[i * node->shard_stride + index];
+    }
+    return value;
+}
+
+
+/**
+ * @return Bucket array of histogram @a index in @a node.
+ */
+static inline ucs_stats_counter_t*
+ucs_stats_node_histogram(ucs_stats_node_t *node, unsigned index)
+{
+    return &node->counters[node->cls->num_counters +
+                           index * UCS_STATS_HISTOGRAM_BUCKETS];
+}
+
+
+/**
+ * @return Histogram bucket index for @a value.
+ */
+static inline unsigned ucs_stats_histogram_bucket(uint64_t value)
+{
+    unsigned msb;
+
+    if (value < UCS_STATS_HISTOGRAM_SUB_COUNT) {
+        return value;
+    }
+
+    msb = ucs_ilog2(value);
+    return ((msb - UCS_STATS_HISTOGRAM_SUB_BITS + 1) << UCS_STATS_HISTOGRAM_SUB_BITS) +
+           ((value >> (msb - UCS_STATS_HISTOGRAM_SUB_BITS)) &
+            (UCS_STATS_HISTOGRAM_SUB_COUNT - 1));
+}
+
+
+/**
+ * @return Lowest value which falls into histogram bucket @a bucket.
+ */
+static inline uint64_t ucs_stats_histogram_bucket_value(unsigned bucket)
+{
+    unsigned exp = bucket >> UCS_STATS_HISTOGRAM_SUB_BITS;
+
+    if (exp == 0) {
+        return bucket;
+    }
+
+    return (uint64_t)(UCS_STATS_HISTOGRAM_SUB_COUNT +
+                      (bucket & (UCS_STATS_HISTOGRAM_SUB_COUNT - 1))) << (exp - 1);
+}
+
+
+/**
+ * Calculate a percentile of a histogram.
+ *
+ * @param buckets     Histogram bucket array.
+ * @param percentile  Percentile to calculate, in the range [0..100].
+ *
+ * @return Lowest value of the bucket which contains the percentile, or 0 if
+ *         the histogram is empty.
+ */
+uint64_t ucs_stats_histogram_percentile(const ucs_stats_counter_t *buckets,
+                                        double percentile);
+
+
+/**
+ * @return Total number of samples recorded in a histogram.
+ */
+ucs_stats_counter_t ucs_stats_histogram_count(const ucs_stats_counter_t *buckets);
+
+
 /**
  * Initialize statistics node.
  *
@@ -29,6 +29,14 @@
 #define UCS_STATS_COUNTER_U64        3
 
 
+/* Histogram buckets are serialized in chunks, to limit stack usage */
+#define UCS_STATS_HISTOGRAM_CHUNK    (UCS_STATS_HISTOGRAM_BUCKETS / 4)
+
+
+/* Data format version. Version 2 adds histograms. */
+#define UCS_STATS_DATA_VERSION       2
+
+
 /* Compression mode */
 #define UCS_STATS_COMPRESSION_NONE   0
 #define UCS_STATS_COMPRESSION_BZIP2  1
@@ -217,6 +225,38 @@ static void ucs_stats_write_counters(ucs_stats_counter_t *counters,
     FWRITE(counter_data, pos - counter_data, stream);
 }
 
+static void ucs_stats_read_histograms(ucs_stats_node_t *node, FILE *stream)
+{
+    ucs_stats_counter_t *buckets;
+    unsigned i, offset;
+
+    for (i = 0; i < node->cls->num_histograms; ++i) {
+        buckets = ucs_stats_node_histogram(node, i);
+        for (offset = 0; offset < UCS_STATS_HISTOGRAM_BUCKETS;
+             offset += UCS_STATS_HISTOGRAM_CHUNK) {
+            ucs_stats_read_counters(buckets + offset, UCS_STATS_HISTOGRAM_CHUNK,
+                                    stream);
+        }
+    }
+}
+
+static void ucs_stats_write_histograms(ucs_stats_node_t *node, FILE *stream)
+{
+    ucs_stats_counter_t *buckets;
+    unsigned i, offset;
+
+    UCS_STATIC_ASSERT((UCS_STATS_HISTOGRAM_BUCKETS % UCS_STATS_HISTOGRAM_CHUNK) == 0);
+
+    for (i = 0; i < node->cls->num_histograms; ++i) {
+        buckets = ucs_stats_node_histogram(node, i);
+        for (offset = 0; offset < UCS_STATS_HISTOGRAM_BUCKETS;
+             offset += UCS_STATS_HISTOGRAM_CHUNK) {
+            ucs_stats_write_counters(buckets + offset, UCS_STATS_HISTOGRAM_CHUNK,
+                                     stream);
+        }
+    }
+}
+
 static void
 ucs_stats_serialize_binary_recurs(FILE *stream, ucs_stats_node_t *node,
                                   ucs_stats_children_sel_t sel,
@@ -224,8 +264,10 @@ ucs_stats_serialize_binary_recurs(FILE *stream, ucs_stats_node_t *node,
 {
     ucs_stats_class_t *cls = node->cls;
     ucs_stats_clsid_t *elem, search;
+    ucs_stats_counter_t *counters;
     ucs_stats_node_t *child;
     uint8_t sentinel;
+    unsigned i;
 
     /* Search the class */
     search.cls = cls;
@@ -238,8 +280,17 @@ ucs_stats_serialize_binary_recurs(FILE *stream, ucs_stats_node_t *node,
     /* Name */
     ucs_stats_write_str(node->name, stream);
 
-    /* Counters */
-    ucs_stats_write_counters(node->counters, cls->num_counters, stream);
+    /* Counters and histograms */
+    if (node->shards == NULL) {
+        counters = node->counters;
+    } else {
+        counters = ucs_alloca(cls->num_counters * sizeof(*counters));
+        for (i = 0; i < cls->num_counters; ++i) {
+            counters[i] = ucs_stats_node_counter(node, i);
+        }
+    }
+    ucs_stats_write_counters(counters, cls->num_counters, stream);
+    ucs_stats_write_histograms(node, stream);
 
     /* Children */
     ucs_list_for_each(child, &node->children[sel], list) {
@@ -265,7 +316,7 @@ ucs_stats_serialize_binary(FILE *stream, ucs_stats_node_t *root,
     sglib_hashed_ucs_stats_clsid_t_init(cls_hash);
 
     /* Write header */
-    hdr.version     = 1;
+    hdr.version     = UCS_STATS_DATA_VERSION;
     hdr.compression = UCS_STATS_COMPRESSION_NONE;
     hdr.reserved    = 0;
     hdr.num_classes = ucs_stats_get_all_classes_recurs(root, sel, cls_hash);
@@ -283,6 +334,10 @@ ucs_stats_serialize_binary(FILE *stream, ucs_stats_node_t *root,
         for (counter = 0; counter < cls->num_counters; ++counter) {
             ucs_stats_write_str(cls->counter_names[counter], stream);
         }
+        FWRITE_ONE(&cls->num_histograms, stream);
+        for (counter = 0; counter < cls->num_histograms; ++counter) {
+            ucs_stats_write_str(cls->histogram_names[counter], stream);
+        }
         elem->clsid = index++;
     }
 
@@ -305,6 +360,7 @@ static ucs_status_t
 ucs_stats_serialize_text_recurs(FILE *stream, ucs_stats_node_t *node,
                                 ucs_stats_children_sel_t sel, unsigned indent)
 {
+    ucs_stats_counter_t *buckets;
     ucs_stats_node_t *child;
     unsigned i;
 
@@ -313,7 +369,20 @@ ucs_stats_serialize_text_recurs(FILE *stream, ucs_stats_node_t *node,
 
     for (i = 0; i < node->cls->num_counters; ++i) {
         fprintf(stream, "%*s%s: %"PRIu64"\n", (indent + 1) * 2, "",
-                node->cls->counter_names[i], node->counters[i]);
+                node->cls->counter_names[i], ucs_stats_node_counter(node, i));
+    }
+
+    for (i = 0; i < node->cls->num_histograms; ++i) {
+        buckets = ucs_stats_node_histogram(node, i);
+        fprintf(stream, "%*s%s: count %"PRIu64" p50 %"PRIu64" p90 %"PRIu64
+                " p99 %"PRIu64" p99.9 %"PRIu64" max %"PRIu64"\n",
+                (indent + 1) * 2, "", node->cls->histogram_names[i],
+                ucs_stats_histogram_count(buckets),
+                ucs_stats_histogram_percentile(buckets, 50.0),
+                ucs_stats_histogram_percentile(buckets, 90.0),
+                ucs_stats_histogram_percentile(buckets, 99.0),
+                ucs_stats_histogram_percentile(buckets, 99.9),
+                ucs_stats_histogram_percentile(buckets, 100.0));
     }
 
     ucs_list_for_each(child, &node->children[sel], list) {
@@ -364,10 +433,12 @@ ucs_stats_deserialize_recurs(FILE *stream, ucs_stats_class_t **classes,
     }
 
     cls = classes[clsid];
-    ptr = malloc(headroom + sizeof *node + sizeof(ucs_stats_counter_t) * cls->num_counters);
+    ptr = malloc(headroom + sizeof *node +
+                 sizeof(ucs_stats_counter_t) * ucs_stats_class_num_values(cls));
     if (ptr == NULL) {
-        ucs_error("Failed to allocate statistics counters (headroom %zu, %u counters)",
-                  headroom, cls->num_counters);
+        ucs_error("Failed to allocate statistics counters (headroom %zu, %u counters,"
+                  " %u histograms)", headroom, cls->num_counters,
+                  cls->num_histograms);
         return UCS_ERR_NO_MEMORY;
     }
 
@@ -378,9 +449,13 @@ ucs_stats_deserialize_recurs(FILE *stream, ucs_stats_class_t **classes,
     node->name[namelen] = '\0';
     ucs_list_head_init(&node->children[UCS_STATS_INACTIVE_CHILDREN]);
     ucs_list_head_init(&node->children[UCS_STATS_ACTIVE_CHILDREN]);
+    node->shards       = NULL;
+    node->num_shards   = 0;
+    node->shard_stride = 0;
 
-    /* Read counters */
+    /* Read counters and histograms */
     ucs_stats_read_counters(node->counters, cls->num_counters, stream);
+    ucs_stats_read_histograms(node, stream);
 
     /* Read children */
     do {
@@ -409,6 +484,10 @@ static void ucs_stats_free_classes(ucs_stats_class_t **classes, unsigned num_cla
         for (j = 0; j < classes[i]->num_counters; ++j) {
             free((char*)classes[i]->counter_names[j]);
         }
+        for (j = 0; j < classes[i]->num_histograms; ++j) {
+            free((char*)classes[i]->histogram_names[j]);
+        }
+        free(classes[i]->histogram_names);
         free(classes[i]);
     }
     free(classes);
@@ -419,7 +498,7 @@ ucs_status_t ucs_stats_deserialize(FILE *stream, ucs_stats_node_t **p_root)
     ucs_stats_data_header_t hdr;
     ucs_stats_root_storage_t *s;
     ucs_stats_class_t **classes, *cls;
-    unsigned i, j, num_counters;
+    unsigned i, j, num_counters, num_histograms;
     ucs_status_t status;
     size_t nread;
     char *name;
@@ -430,7 +509,7 @@ ucs_status_t ucs_stats_deserialize(FILE *stream, ucs_stats_node_t **p_root)
         goto err;
     }
 
-    if (hdr.version != 1) {
+    if ((hdr.version < 1) || (hdr.version > UCS_STATS_DATA_VERSION)) {
         ucs_error("invalid file version");
         status = UCS_ERR_UNSUPPORTED;
         goto err;
@@ -455,6 +534,17 @@ ucs_status_t ucs_stats_deserialize(FILE *stream, ucs_stats_node_t **p_root)
         for (j = 0; j < cls->num_counters; ++j) {
             cls->counter_names[j] = ucs_stats_read_str(stream);
         }
+
+        num_histograms = 0;
+        if (hdr.version >= 2) {
+            FREAD_ONE(&num_histograms, stream);
+        }
+        cls->num_histograms  = num_histograms;
+        cls->histogram_names = malloc(num_histograms *
+                                      sizeof(*cls->histogram_names));
+        for (j = 0; j < cls->num_histograms; ++j) {
+            cls->histogram_names[j] = ucs_stats_read_str(stream);
+        }
         classes[i] = cls;
 
     }
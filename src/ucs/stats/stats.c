@@ -58,15 +58,19 @@ typedef struct {
 
     pthread_mutex_t      lock;
     pthread_t            thread;
+    volatile uint32_t    num_threads;  /* Threads which updated sharded counters */
 } ucs_stats_context_t;
 
 static ucs_stats_context_t ucs_stats_context = {
     .flags            = 0,
     .root_node        = {},
     .lock             = PTHREAD_MUTEX_INITIALIZER,
-    .thread           = 0xfffffffful
+    .thread           = 0xfffffffful,
+    .num_threads      = 0
 };
 
+__thread unsigned ucs_stats_thread_index = 0;
+
 static ucs_stats_class_t ucs_stats_root_node_class = {
     .name          = "",
     .num_counters  = UCS_ROOT_STATS_LAST,
@@ -133,12 +137,50 @@ static void ucs_stats_node_init_root(const char *name, ...)
     ucs_stats_context.root_node.parent = NULL;
 }
 
+unsigned ucs_stats_thread_index_init()
+{
+    ucs_stats_thread_index = ucs_atomic_fadd32(&ucs_stats_context.num_threads, 1) + 1;
+    return ucs_stats_thread_index;
+}
+
+static ucs_status_t ucs_stats_node_init_shards(ucs_stats_node_t *node)
+{
+    unsigned num_shards = ucs_global_opts.stats_shards;
+    size_t shard_size;
+
+    if ((num_shards == 0) || (node->cls->num_counters == 0)) {
+        return UCS_OK;
+    }
+
+    /* Every shard starts on its own cache line */
+    shard_size = ucs_align_up_pow2(node->cls->num_counters * sizeof(ucs_stats_counter_t),
+                                   UCS_SYS_CACHE_LINE_SIZE);
+    node->shards = ucs_memalign(UCS_SYS_CACHE_LINE_SIZE, shard_size * num_shards,
+                                "stats shards");
+    if (node->shards == NULL) {
+        ucs_error("Failed to allocate %u stats shards for %s", num_shards,
+                  node->cls->name);
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    memset(node->shards, 0, shard_size * num_shards);
+    node->num_shards   = num_shards;
+    node->shard_stride = shard_size / sizeof(ucs_stats_counter_t);
+    return UCS_OK;
+}
+
+static void ucs_stats_node_release(ucs_stats_node_t *node)
+{
+    ucs_free(node->shards);
+    ucs_free(node);
+}
+
 static ucs_status_t ucs_stats_node_new(ucs_stats_class_t *cls, ucs_stats_node_t **p_node)
 {
     ucs_stats_node_t *node;
 
     node = ucs_malloc(sizeof(ucs_stats_node_t) +
-                      sizeof(ucs_stats_counter_t) * cls->num_counters,
+                      sizeof(ucs_stats_counter_t) * ucs_stats_class_num_values(cls),
                       "stats node");
     if (node == NULL) {
         ucs_error("Failed to allocate stats node for %s", cls->name);
@@ -175,6 +217,12 @@ ucs_status_t ucs_stats_node_alloc(ucs_stats_node_t** p_node, ucs_stats_class_t *
         return status;
     }
 
+    status = ucs_stats_node_init_shards(node);
+    if (status != UCS_OK) {
+        ucs_free(node);
+        return status;
+    }
+
     ucs_trace("allocated stats node '"UCS_STATS_NODE_FMT"'", UCS_STATS_NODE_ARG(node));
 
     ucs_stats_node_add(node, parent);
@@ -195,7 +243,7 @@ void ucs_stats_node_free(ucs_stats_node_t *node)
         ucs_stats_node_remove(node, 1);
     } else {
         ucs_stats_node_remove(node, 0);
-        ucs_free(node);
+        ucs_stats_node_release(node);
     }
 }
 
@@ -397,7 +445,7 @@ static void ucs_stats_clean_node_recurs(ucs_stats_node_t *node)
     ucs_list_for_each_safe(child, tmp, &node->children[UCS_STATS_INACTIVE_CHILDREN], list) {
         ucs_stats_clean_node_recurs(child);
         ucs_stats_node_remove(child, 0);
-        ucs_free(child);
+        ucs_stats_node_release(child);
     }
 }
 
@@ -21,6 +21,8 @@ int ucs_stats_is_active();
 
 #include "libstats.h"
 
+#include <ucs/arch/atomic.h>
+
 /**
  * Allocate statistics node.
  *
@@ -34,6 +36,74 @@ ucs_status_t ucs_stats_node_alloc(ucs_stats_node_t** p_node, ucs_stats_class_t *
 void ucs_stats_node_free(ucs_stats_node_t *node);
 
 
+/*
+ * 1-based index of the calling thread, used to select its counter shard.
+ * Zero if not assigned yet.
+ */
+extern __thread unsigned ucs_stats_thread_index;
+
+unsigned ucs_stats_thread_index_init();
+
+
+/**
+ * Add @a delta to a counter of a sharded node. The first (num_shards - 1)
+ * threads own a shard each and update it without atomics, the rest share the
+ * last shard.
+ */
+static inline void ucs_stats_shard_update(ucs_stats_node_t *node,
+                                          unsigned index, int64_t delta)
+{
+    unsigned thread_index = ucs_stats_thread_index;
+
+    if (ucs_unlikely(thread_index == 0)) {
+        thread_index = ucs_stats_thread_index_init();
+    }
+
+    if (ucs_likely(thread_index < node->num_shards)) {
+        node->shards[(thread_index - 1) * node->shard_stride + index] += delta;
+    } else {
+        ucs_atomic_add64(&node->shards[(node->num_shards - 1) * node->shard_stride +
+                                       index], delta);
+    }
+}
+
+
+/**
+ * Set a counter to @a value. On a sharded node, the difference from the total
+ * of all shards is added to the shard of the calling thread, so concurrent
+ * updates of other threads are not lost.
+ */
+static inline void ucs_stats_node_set_counter(ucs_stats_node_t *node,
+                                              unsigned index,
+                                              ucs_stats_counter_t value)
+{
+    if (node->shards == NULL) {
+        node->counters[index] = value;
+    } else {
+        ucs_stats_shard_update(node, index,
+                               (int64_t)(value -
+                                         ucs_stats_node_counter(node, index)));
+    }
+}
+
+
+/**
+ * Raise a counter to @a value, comparing with the sum of all its shards.
+ */
+static inline void ucs_stats_node_update_max(ucs_stats_node_t *node,
+                                             unsigned index,
+                                             ucs_stats_counter_t value)
+{
+    if (node->shards == NULL) {
+        if (node->counters[index] < value) {
+            node->counters[index] = value;
+        }
+    } else if (ucs_stats_node_counter(node, index) < value) {
+        ucs_stats_node_set_counter(node, index, value);
+    }
+}
+
+
 #define UCS_STATS_ARG(_arg) , _arg
 
 #define UCS_STATS_NODE_DECLARE(_node) \
@@ -47,23 +117,31 @@ void ucs_stats_node_free(ucs_stats_node_t *node);
 
 #define UCS_STATS_UPDATE_COUNTER(_node, _index, _delta) \
     if (((_delta) != 0) && ((_node) != NULL)) { \
-        (_node)->counters[(_index)] += (_delta); \
+        if (ucs_likely((_node)->shards == NULL)) { \
+            (_node)->counters[(_index)] += (_delta); \
+        } else { \
+            ucs_stats_shard_update(_node, _index, _delta); \
+        } \
     }
 
 #define UCS_STATS_SET_COUNTER(_node, _index, _value) \
     if ((_node) != NULL) { \
-        (_node)->counters[(_index)] = (_value); \
+        ucs_stats_node_set_counter(_node, _index, _value); \
     }
 
 #define UCS_STATS_GET_COUNTER(_node, _index) \
     (((_node) != NULL) ?  \
-    (_node)->counters[(_index)] : 0) 
+    ucs_stats_node_counter(_node, _index) : 0)
 
 #define UCS_STATS_UPDATE_MAX(_node, _index, _value) \
     if ((_node) != NULL) { \
-        if ((_node)->counters[(_index)] < (_value)) { \
-            (_node)->counters[(_index)] = (_value); \
-        } \
+        ucs_stats_node_update_max(_node, _index, _value); \
+    }
+
+#define UCS_STATS_UPDATE_HISTOGRAM(_node, _index, _value) \
+    if ((_node) != NULL) { \
+        ucs_atomic_add64(&ucs_stats_node_histogram(_node, _index) \
+                             [ucs_stats_histogram_bucket(_value)], 1); \
     }
 
 #define UCS_STATS_START_TIME(_start_time) \
@@ -79,6 +157,13 @@ void ucs_stats_node_free(ucs_stats_node_t *node);
                                  (long)ucs_time_to_nsec(ucs_get_time() - (_start_time))); \
     }
 
+#define UCS_STATS_UPDATE_HISTOGRAM_TIME(_node, _index, _start_time) \
+    { \
+        ucs_compiler_fence(); \
+        UCS_STATS_UPDATE_HISTOGRAM(_node, _index, \
+                                   (uint64_t)ucs_time_to_nsec(ucs_get_time() - (_start_time))); \
+    }
+
 #define UCS_STATS_SET_TIME(_node, _index, _start_time) \
    { \
         ucs_compiler_fence(); \
@@ -96,8 +181,10 @@ void ucs_stats_node_free(ucs_stats_node_t *node);
 #define UCS_STATS_SET_COUNTER(_node, _index, _value)
 #define UCS_STATS_GET_COUNTER(_node, _index)    0
 #define UCS_STATS_UPDATE_MAX(_node, _index, _value)
+#define UCS_STATS_UPDATE_HISTOGRAM(_node, _index, _value)
 #define UCS_STATS_START_TIME(_start_time)
 #define UCS_STATS_UPDATE_TIME(_node, _index, _start_time)
+#define UCS_STATS_UPDATE_HISTOGRAM_TIME(_node, _index, _start_time)
 #define UCS_STATS_SET_TIME(_node, _index, _start_time)
 
 #endif
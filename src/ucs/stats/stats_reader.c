@@ -33,7 +33,7 @@ static GtkWidget               *g_treeview;
 static void fill_model(ucs_stats_node_t *node, GtkTreeIter *parent, int depth)
 {
     GtkTreeIter tree_elem, counter_elem;
-    ucs_stats_counter_t value;
+    ucs_stats_counter_t value, *buckets;
     ucs_stats_node_t *child;
     char buf[128];
     const char *name;
@@ -70,6 +70,22 @@ static void fill_model(ucs_stats_node_t *node, GtkTreeIter *parent, int depth)
         }
     }
 
+    for (i = 0; i < node->cls->num_histograms; ++i) {
+        gtk_tree_store_append(g_treestore, &counter_elem, &tree_elem);
+
+        buckets = ucs_stats_node_histogram(node, i);
+        g_snprintf(buf, sizeof(buf), "p50 %" PRIu64 " p99 %" PRIu64
+                   " p99.9 %" PRIu64 " max %" PRIu64,
+                   ucs_stats_histogram_percentile(buckets, 50.0),
+                   ucs_stats_histogram_percentile(buckets, 99.0),
+                   ucs_stats_histogram_percentile(buckets, 99.9),
+                   ucs_stats_histogram_percentile(buckets, 100.0));
+        gtk_tree_store_set(g_treestore, &counter_elem,
+                           COL_NAME,  node->cls->histogram_names[i],
+                           COL_VALUE, buf,
+                           -1);
+    }
+
     list_for_each(child, &node->children[UCS_STATS_ACTIVE_CHILDREN], list) {
         fill_model(child, &tree_elem, depth + 1);
     }
@@ -45,11 +45,26 @@ ucs_status_t ucs_wtimer_init(ucs_wtimer_t *t, ucs_twheel_callback_t cb)
     return UCS_OK;
 }
 
+static void ucs_twheel_insert(ucs_twheel_t *t, ucs_wtimer_t *timer,
+                              uint64_t slot)
+{
+    if (ucs_unlikely(slot >= t->num_slots)) {
+        /* Out of wheel range - will be re-inserted when its slot expires */
+        slot = t->num_slots - 1;
+    }
+
+    slot = (t->current + slot) % t->num_slots;
+    ucs_assert(slot != t->current);
+
+    ucs_list_add_tail(&t->wheel[slot], &timer->list);
+}
+
 void __ucs_wtimer_add(ucs_twheel_t *t, ucs_wtimer_t *timer, ucs_time_t delta)
 {
     uint64_t slot;
 
-    timer->is_active = 1;
+    timer->is_active  = 1;
+    timer->expiration = t->now + delta;
     slot = delta>>t->res_order;
     if (ucs_unlikely(slot == 0)) {
         /* nothing really wrong with adding timer to the current slot. However
@@ -60,19 +75,13 @@ void __ucs_wtimer_add(ucs_twheel_t *t, ucs_wtimer_t *timer, ucs_time_t delta)
     }
     ucs_assert(slot > 0);
 
-    if (ucs_unlikely(slot >= t->num_slots)) {
-        slot = t->num_slots - 1;
-    }
-
-    slot = (t->current + slot) % t->num_slots;
-    ucs_assert(slot != t->current);
-
-    ucs_list_add_tail(&t->wheel[slot], &timer->list);
+    ucs_twheel_insert(t, timer, slot);
 }
 
 void __ucs_twheel_sweep(ucs_twheel_t *t, ucs_time_t current_time)
 {
-    ucs_wtimer_t *timer;
+    ucs_wtimer_t *timer, *tmp;
+    UCS_LIST_HEAD(cascade);
     uint64_t slot;
 
     slot   = (current_time - t->now) >> t->res_order;
@@ -87,8 +96,21 @@ void __ucs_twheel_sweep(ucs_twheel_t *t, ucs_time_t current_time)
     for (; t->current != slot; t->current = (t->current+1) % t->num_slots) {
         while (!ucs_list_is_empty(&t->wheel[t->current])) {
             timer = ucs_list_extract_head(&t->wheel[t->current], ucs_wtimer_t, list);
+            if (ucs_unlikely((int64_t)(timer->expiration - current_time) >=
+                             (int64_t)t->res)) {
+                /* Parked beyond the wheel range and not due yet */
+                ucs_list_add_tail(&cascade, &timer->list);
+                continue;
+            }
+
             timer->is_active = 0;
             timer->cb(timer);
         }
     }
+
+    ucs_list_for_each_safe(timer, tmp, &cascade, list) {
+        ucs_list_del(&timer->list);
+        ucs_twheel_insert(t, timer,
+                          (timer->expiration - current_time) >> t->res_order);
+    }
 }
@@ -29,6 +29,7 @@ typedef void (*ucs_twheel_callback_t)(ucs_wtimer_t *self);
 struct ucs_wtimer {
     ucs_twheel_callback_t  cb;         /* User callback */
     ucs_list_link_t        list;       /* Link in the list of timers */
+    ucs_time_t             expiration; /* Absolute expiration time */
     int                    is_active;
 };
 
@@ -47,7 +48,9 @@ struct ucs_timer_wheel {
  * Initialize the timer queue.
  *
  * @param twheel        Timer queue to initialize.
- * @param resolution    Timer resolution. Timer wheel range is from now to now + UCS_TWHEEL_NSLOTS * res
+ * @param resolution    Timer resolution. Timers beyond the wheel range (num_slots * res)
+ *                      are cascaded: they are parked in the last slot and re-inserted
+ *                      until they are due, so they never fire early.
  * @param current_time  Current time to initialize the timer with.
  */
 ucs_status_t ucs_twheel_init(ucs_twheel_t *twheel, ucs_time_t resolution,
@@ -6,17 +6,172 @@
 
 #include "timerq.h"
 
+#include <ucs/arch/bitops.h>
 #include <ucs/debug/log.h>
 #include <ucs/debug/memtrack.h>
 #include <ucs/sys/math.h>
 
 
+#define UCS_TIMERQ_SLOT_MASK    (UCS_TIMERQ_NUM_SLOTS - 1)
+
+
+/* Bits of slots whose index is larger than 'index' */
+static inline uint64_t ucs_timerq_slots_above(unsigned index)
+{
+    return ~UCS_MASK_SAFE(index + 1);
+}
+
+static inline unsigned ucs_timerq_slot_index(ucs_time_t time, unsigned level)
+{
+    return (time >> (level * UCS_TIMERQ_SLOT_BITS)) & UCS_TIMERQ_SLOT_MASK;
+}
+
+static inline ucs_list_link_t *
+ucs_timerq_slot(ucs_timer_queue_t *timerq, unsigned level, unsigned index)
+{
+    return &timerq->slots[(level * UCS_TIMERQ_NUM_SLOTS) + index];
+}
+
+/*
+ * Timers in the wheel always expire after 'now', so the level of a timer is
+ * the highest digit in which its expiration differs from 'now'. The wheel is
+ * advanced in a way which keeps this true, so the slot of a timer can be
+ * calculated again when it's removed.
+ */
+static inline unsigned ucs_timerq_level(ucs_timer_queue_t *timerq,
+                                        ucs_time_t expiration)
+{
+    return ucs_ilog2(expiration ^ timerq->now) / UCS_TIMERQ_SLOT_BITS;
+}
+
+static void ucs_timerq_insert(ucs_timer_queue_t *timerq, ucs_timer_t *timer)
+{
+    unsigned level, index;
+
+    if (timer->expiration <= timerq->now) {
+        ucs_list_add_tail(&timerq->pending, &timer->list);
+        return;
+    }
+
+    level = ucs_timerq_level(timerq, timer->expiration);
+    index = ucs_timerq_slot_index(timer->expiration, level);
+    ucs_list_add_tail(ucs_timerq_slot(timerq, level, index), &timer->list);
+    timerq->slot_map[level] |= UCS_BIT(index);
+}
+
+static void ucs_timerq_unlink(ucs_timer_queue_t *timerq, ucs_timer_t *timer)
+{
+    unsigned level, index;
+    ucs_list_link_t *slot;
+
+    ucs_list_del(&timer->list);
+    if (timer->expiration <= timerq->now) {
+        return; /* Was on pending or expired list */
+    }
+
+    level = ucs_timerq_level(timerq, timer->expiration);
+    index = ucs_timerq_slot_index(timer->expiration, level);
+    slot  = ucs_timerq_slot(timerq, level, index);
+    if (ucs_list_is_empty(slot)) {
+        timerq->slot_map[level] &= ~UCS_BIT(index);
+    }
+}
+
+/* Move the timers of the given slots to the expired list */
+static void ucs_timerq_expire_slots(ucs_timer_queue_t *timerq, unsigned level,
+                                    uint64_t slots)
+{
+    ucs_list_link_t *slot;
+    unsigned index;
+
+    slots &= timerq->slot_map[level];
+    timerq->slot_map[level] &= ~slots;
+
+    while (slots != 0) {
+        index = ucs_ffs64(slots);
+        slot  = ucs_timerq_slot(timerq, level, index);
+        ucs_list_splice_tail(&timerq->expired, slot);
+        ucs_list_head_init(slot);
+        slots &= slots - 1;
+    }
+}
+
+/*
+ * Advance the wheel to 'time'. With D being the highest digit in which 'time'
+ * differs from 'now', all slots on lower levels which are after 'now' have
+ * expired, as well as the level D slots between 'now' and 'time'. The timers
+ * of the level D slot of 'time' are cascaded to lower levels.
+ */
+static void ucs_timerq_advance(ucs_timer_queue_t *timerq, ucs_time_t time)
+{
+    unsigned level, top, now_index, time_index;
+    ucs_timer_t *timer, *ttimer;
+    ucs_list_link_t *slot;
+    UCS_LIST_HEAD(cascade);
+
+    if (time > timerq->now) {
+        top = ucs_timerq_level(timerq, time);
+        for (level = 0; level < top; ++level) {
+            now_index = ucs_timerq_slot_index(timerq->now, level);
+            ucs_timerq_expire_slots(timerq, level,
+                                    ucs_timerq_slots_above(now_index));
+        }
+
+        now_index  = ucs_timerq_slot_index(timerq->now, top);
+        time_index = ucs_timerq_slot_index(time, top);
+        ucs_timerq_expire_slots(timerq, top, ucs_timerq_slots_above(now_index) &
+                                             UCS_MASK(time_index));
+
+        if (timerq->slot_map[top] & UCS_BIT(time_index)) {
+            slot = ucs_timerq_slot(timerq, top, time_index);
+            ucs_list_splice_tail(&cascade, slot);
+            ucs_list_head_init(slot);
+            timerq->slot_map[top] &= ~UCS_BIT(time_index);
+        }
+
+        timerq->now = time;
+        ucs_list_for_each_safe(timer, ttimer, &cascade, list) {
+            ucs_timerq_insert(timerq, timer);
+        }
+    }
+
+    ucs_list_splice_tail(&timerq->expired, &timerq->pending);
+    ucs_list_head_init(&timerq->pending);
+}
+
+static ucs_timer_t *ucs_timerq_pop_expired(ucs_timer_queue_t *timerq)
+{
+    if (ucs_list_is_empty(&timerq->expired)) {
+        pthread_spin_unlock(&timerq->lock);
+        return NULL;
+    }
+
+    return ucs_list_extract_head(&timerq->expired, ucs_timer_t, list);
+}
+
 ucs_status_t ucs_timerq_init(ucs_timer_queue_t *timerq)
 {
+    unsigned i;
+
     ucs_trace_func("timerq=%p", timerq);
 
+    timerq->slots = ucs_malloc(sizeof(*timerq->slots) * UCS_TIMERQ_NUM_LEVELS *
+                               UCS_TIMERQ_NUM_SLOTS, "timerq_slots");
+    if (timerq->slots == NULL) {
+        ucs_error("failed to allocate timer queue slots");
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    for (i = 0; i < UCS_TIMERQ_NUM_LEVELS * UCS_TIMERQ_NUM_SLOTS; ++i) {
+        ucs_list_head_init(&timerq->slots[i]);
+    }
+    memset(timerq->slot_map, 0, sizeof(timerq->slot_map));
+
     pthread_spin_init(&timerq->lock, 0);
-    timerq->timers       = NULL;
+    kh_init_inplace(ucs_timerq_hash, &timerq->hash);
+    ucs_list_head_init(&timerq->pending);
+    ucs_list_head_init(&timerq->expired);
+    timerq->now          = 0;
     timerq->num_timers   = 0;
     timerq->min_interval = UCS_TIME_INFINITY;
     return UCS_OK;
@@ -24,85 +179,141 @@ ucs_status_t ucs_timerq_init(ucs_timer_queue_t *timerq)
 
 void ucs_timerq_cleanup(ucs_timer_queue_t *timerq)
 {
+    ucs_timer_t *timer;
+
     ucs_trace_func("timerq=%p", timerq);
 
     if (timerq->num_timers > 0) {
         ucs_warn("timer queue with %d timers being destroyed", timerq->num_timers);
     }
-    ucs_free(timerq->timers);
+
+    kh_foreach_value(&timerq->hash, timer, {
+        ucs_free(timer);
+    });
+    kh_destroy_inplace(ucs_timerq_hash, &timerq->hash);
+    ucs_free(timerq->slots);
 }
 
 ucs_status_t ucs_timerq_add(ucs_timer_queue_t *timerq, int timer_id,
                             ucs_time_t interval)
 {
     ucs_status_t status;
-    ucs_timer_t *ptr;
+    ucs_timer_t *timer;
+    khiter_t hash_it;
+    int ret;
 
     ucs_trace_func("timerq=%p interval=%.2fus timer_id=%d", timerq,
                    ucs_time_to_usec(interval), timer_id);
 
+    timer = ucs_malloc(sizeof(*timer), "timer");
+    if (timer == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
     pthread_spin_lock(&timerq->lock);
 
     /* Make sure ID is unique */
-    for (ptr = timerq->timers; ptr < timerq->timers + timerq->num_timers; ++ptr) {
-        if (ptr->id == timer_id) {
-            status = UCS_ERR_ALREADY_EXISTS;
-            goto out_unlock;
-        }
-    }
-
-    /* Resize timer array */
-    ptr = ucs_realloc(timerq->timers, (timerq->num_timers + 1) * sizeof(ucs_timer_t),
-                      "timerq");
-    if (ptr == NULL) {
+    hash_it = kh_put(ucs_timerq_hash, &timerq->hash, timer_id, &ret);
+    if (ret == -1) {
         status = UCS_ERR_NO_MEMORY;
-        goto out_unlock;
+        goto err_free;
+    } else if (ret == 0) {
+        status = UCS_ERR_ALREADY_EXISTS;
+        goto err_free;
     }
-    timerq->timers = ptr;
-    ++timerq->num_timers;
-    timerq->min_interval = ucs_min(interval, timerq->min_interval);
 
     /* Initialize the new timer */
-    ptr = &timerq->timers[timerq->num_timers - 1];
-    ptr->expiration = 0; /* will fire the next time sweep is called */
-    ptr->interval   = interval;
-    ptr->id         = timer_id;
+    timer->expiration = 0; /* will fire the next time sweep is called */
+    timer->interval   = interval;
+    timer->id         = timer_id;
+    kh_value(&timerq->hash, hash_it) = timer;
+    ucs_timerq_insert(timerq, timer);
 
-    status = UCS_OK;
+    ++timerq->num_timers;
+    timerq->min_interval = ucs_min(interval, timerq->min_interval);
+    pthread_spin_unlock(&timerq->lock);
+    return UCS_OK;
 
-out_unlock:
+err_free:
     pthread_spin_unlock(&timerq->lock);
+    ucs_free(timer);
     return status;
 }
 
 ucs_status_t ucs_timerq_remove(ucs_timer_queue_t *timerq, int timer_id)
 {
-    ucs_status_t status;
-    ucs_timer_t *ptr;
+    ucs_timer_t *timer, *ptr;
+    khiter_t hash_it;
 
     ucs_trace_func("timerq=%p timer_id=%d", timerq, timer_id);
 
-    status = UCS_ERR_NO_ELEM;
-
     pthread_spin_lock(&timerq->lock);
-    timerq->min_interval = UCS_TIME_INFINITY;
-    for (ptr = timerq->timers; ptr < timerq->timers + timerq->num_timers; ++ptr) {
-        if (ptr->id == timer_id) {
-            *ptr = timerq->timers[--timerq->num_timers];
-            status = UCS_OK;
-            break;
-        } else {
+
+    hash_it = kh_get(ucs_timerq_hash, &timerq->hash, timer_id);
+    if (hash_it == kh_end(&timerq->hash)) {
+        pthread_spin_unlock(&timerq->lock);
+        return UCS_ERR_NO_ELEM;
+    }
+
+    timer = kh_value(&timerq->hash, hash_it);
+    kh_del(ucs_timerq_hash, &timerq->hash, hash_it);
+    ucs_timerq_unlink(timerq, timer);
+    --timerq->num_timers;
+
+    /* Only removing a timer with the minimal interval requires a rescan */
+    if (timer->interval == timerq->min_interval) {
+        timerq->min_interval = UCS_TIME_INFINITY;
+        kh_foreach_value(&timerq->hash, ptr, {
             timerq->min_interval = ucs_min(timerq->min_interval, ptr->interval);
-        }
+        });
+    }
+
+    pthread_spin_unlock(&timerq->lock);
+    ucs_free(timer);
+    return UCS_OK;
+}
+
+ucs_time_t ucs_timerq_next_expiration(ucs_timer_queue_t *timerq)
+{
+    ucs_time_t expiration;
+    unsigned level, shift;
+
+    pthread_spin_lock(&timerq->lock);
+
+    if (!ucs_list_is_empty(&timerq->pending)) {
+        expiration = timerq->now;
+        goto out;
     }
 
-    /* TODO realloc - shrink */
-    if (timerq->num_timers == 0) {
-        ucs_assert(timerq->min_interval == UCS_TIME_INFINITY);
-        free(timerq->timers);
-        timerq->timers = NULL;
+    /* Lower levels expire first, and the start of a slot is a lower bound */
+    expiration = UCS_TIME_INFINITY;
+    for (level = 0; level < UCS_TIMERQ_NUM_LEVELS; ++level) {
+        if (timerq->slot_map[level] != 0) {
+            shift      = level * UCS_TIMERQ_SLOT_BITS;
+            expiration = (timerq->now & ~UCS_MASK_SAFE(shift + UCS_TIMERQ_SLOT_BITS)) |
+                         ((ucs_time_t)ucs_ffs64(timerq->slot_map[level]) << shift);
+            break;
+        }
     }
 
+out:
     pthread_spin_unlock(&timerq->lock);
-    return status;
+    return expiration;
+}
+
+ucs_timer_t *ucs_timerq_expire_first(ucs_timer_queue_t *timerq,
+                                     ucs_time_t current_time)
+{
+    pthread_spin_lock(&timerq->lock);
+    ucs_timerq_advance(timerq, current_time);
+    return ucs_timerq_pop_expired(timerq);
+}
+
+ucs_timer_t *ucs_timerq_expire_next(ucs_timer_queue_t *timerq,
+                                    ucs_timer_t *timer,
+                                    ucs_time_t current_time)
+{
+    timer->expiration = current_time + timer->interval;
+    ucs_timerq_insert(timerq, timer);
+    return ucs_timerq_pop_expired(timerq);
 }
@@ -7,24 +7,48 @@
 #ifndef UCS_TIMERQ_H
 #define UCS_TIMERQ_H
 
-#include <ucs/datastruct/queue.h>
+#include <ucs/datastruct/khash.h>
+#include <ucs/datastruct/list.h>
 #include <ucs/time/time.h>
 #include <ucs/sys/preprocessor.h>
+#include <ucs/type/status.h>
 #include <pthread.h>
 
 
+/*
+ * The timers are kept in a hierarchical timing wheel: every level has
+ * UCS_TIMERQ_NUM_SLOTS slots, and a timer is placed on the level of the most
+ * significant digit in which its expiration time differs from the current
+ * time of the wheel. Adding and removing a timer is O(1), and advancing the
+ * wheel touches only non-empty slots.
+ */
+#define UCS_TIMERQ_SLOT_BITS       6
+#define UCS_TIMERQ_NUM_SLOTS       UCS_BIT(UCS_TIMERQ_SLOT_BITS)
+#define UCS_TIMERQ_NUM_LEVELS      ucs_div_round_up(64, UCS_TIMERQ_SLOT_BITS)
+
+
 typedef struct ucs_timer {
     ucs_time_t                 expiration;/* Absolute timer expiration time */
     ucs_time_t                 interval;  /* Re-scheduling interval */
     int                        id;
+    ucs_list_link_t            list;      /* Entry in a wheel slot, or in the
+                                             pending/expired list */
 } ucs_timer_t;
 
 
+KHASH_MAP_INIT_INT(ucs_timerq_hash, ucs_timer_t*);
+
+
 typedef struct ucs_timer_queue {
     pthread_spinlock_t         lock;
-    ucs_time_t                 min_interval; /* Expiration of next timer */
-    ucs_timer_t                *timers;      /* Array of timers */
+    ucs_time_t                 min_interval; /* Minimal timer interval */
+    ucs_time_t                 now;          /* Time the wheel was advanced to */
     unsigned                   num_timers;   /* Number of timers */
+    khash_t(ucs_timerq_hash)   hash;         /* Timers by ID */
+    ucs_list_link_t            pending;      /* Timers due not later than 'now' */
+    ucs_list_link_t            expired;      /* Timers being dispatched */
+    uint64_t                   slot_map[UCS_TIMERQ_NUM_LEVELS]; /* Non-empty slots */
+    ucs_list_link_t            *slots;       /* Wheel slots, level by level */
 } ucs_timer_queue_t;
 
 
@@ -45,7 +69,7 @@ void ucs_timerq_cleanup(ucs_timer_queue_t *timerq);
 
 
 /**
- * Add a periodic timer.
+ * Add a periodic timer. The timer fires the next time the queue is swept.
  *
  * @param timerq     Timer queue to schedule on.
  * @param timer_id   Timer ID to add.
@@ -64,6 +88,30 @@ ucs_status_t ucs_timerq_add(ucs_timer_queue_t *timerq, int timer_id,
 ucs_status_t ucs_timerq_remove(ucs_timer_queue_t *timerq, int timer_id);
 
 
+/**
+ * @return Time not later than the expiration of the next timer, or
+ *         UCS_TIME_INFINITY if there are no timers.
+ */
+ucs_time_t ucs_timerq_next_expiration(ucs_timer_queue_t *timerq);
+
+
+/**
+ * Lock the queue, advance it to the given time and return the first expired
+ * timer. Used by @ref ucs_timerq_for_each_expired.
+ */
+ucs_timer_t *ucs_timerq_expire_first(ucs_timer_queue_t *timerq,
+                                     ucs_time_t current_time);
+
+
+/**
+ * Re-schedule a dispatched timer and return the next expired one. Releases
+ * the lock when there are no more expired timers.
+ */
+ucs_timer_t *ucs_timerq_expire_next(ucs_timer_queue_t *timerq,
+                                    ucs_timer_t *timer,
+                                    ucs_time_t current_time);
+
+
 /**
  * @return Minimal timer interval.
  */
@@ -89,22 +137,11 @@ static inline int ucs_timerq_is_empty(ucs_timer_queue_t *timerq) {
  *
  * @note Timers which expired between calls to this function will also be dispatched.
  * @note There is no guarantee on the order of dispatching.
+ * @note The queue is locked during the loop, which must not be left by 'break'.
  */
 #define ucs_timerq_for_each_expired(_timer, _timerq, _current_time) \
-    for ( \
-         /* Initialization */ \
-         pthread_spin_lock(&(_timerq)->lock), /* Grab lock */ \
-         _timer = (_timerq)->timers; /* Set iterator */ \
-         \
-         /* Condition */ \
-         (_timer != (_timerq)->timers + (_timerq)->num_timers) || /* Reached the end */ \
-         pthread_spin_unlock(&(_timerq)->lock); /* Release lock - should return 0 */ \
-         \
-         /* Step: advance iterator */ \
-         ++_timer) \
-        \
-        if ((_current_time >= (_timer)->expiration) /* Check if this timer has expirted */ && \
-            ((_timer)->expiration = _current_time + (_timer)->interval) /* Update expiration time */ \
-           )
+    for (_timer = ucs_timerq_expire_first(_timerq, _current_time); \
+         _timer != NULL; \
+         _timer = ucs_timerq_expire_next(_timerq, _timer, _current_time))
 
 #endif
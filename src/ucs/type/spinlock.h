@@ -35,6 +35,11 @@ static inline ucs_status_t ucs_spinlock_init(ucs_spinlock_t *lock)
     return UCS_OK;
 }
 
+static inline void ucs_spinlock_destroy(ucs_spinlock_t *lock)
+{
+    pthread_spin_destroy(&lock->lock);
+}
+
 static inline int ucs_spin_is_owner(ucs_spinlock_t *lock, pthread_t self)
 {
     return lock->owner == self;
@@ -149,7 +149,7 @@ ucs_status_t uct_wakeup_open(uct_iface_h iface, unsigned events,
         return UCS_ERR_INVALID_PARAM;
     }
 
-    *wakeup_p = ucs_malloc(sizeof(**wakeup_p), "iface_wakeup_context");
+    *wakeup_p = ucs_malloc(sizeof(**wakeup_p), "iface_wakeup");
     if (*wakeup_p == NULL) {
         return UCS_ERR_NO_MEMORY;
     }
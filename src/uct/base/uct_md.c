@@ -411,7 +411,7 @@ void uct_config_release(void *config)
     uct_config_bundle_t *bundle = (uct_config_bundle_t *)config - 1;
 
     ucs_config_parser_release_opts(config, bundle->table);
-    ucs_free((void*)(bundle->table_prefix));
+    free((void*)(bundle->table_prefix));
     ucs_free(bundle);
 }
 
@@ -52,7 +52,7 @@ static ucs_status_t uct_cuda_mem_reg(uct_md_h md, void *address, size_t length,
 {
     ucs_status_t rc;
     uct_mem_h * mem_hndl = NULL;
-    mem_hndl = ucs_malloc(sizeof(void *), "cuda handle for test passing");
+    mem_hndl = ucs_malloc(sizeof(void *), "cuda_mem_handle");
     if (NULL == mem_hndl) {
       ucs_error("Failed to allocate memory for gni_mem_handle_t");
       rc = UCS_ERR_NO_MEMORY;
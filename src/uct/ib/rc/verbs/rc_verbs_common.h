@@ -8,6 +8,7 @@
 #define UCT_RC_VERBS_COMMON_H
 
 #include <ucs/arch/bitops.h>
+#include <ucs/debug/profile.h>
 
 #include <uct/ib/rc/base/rc_iface.h>
 #include <uct/ib/rc/base/rc_ep.h>
@@ -143,8 +144,9 @@ uct_rc_verbs_iface_poll_rx_common(uct_rc_iface_t *iface)
                 uct_recv_desc_iface(udesc) = &iface->super.super.super;
             }
         } else {
-            uct_ib_iface_invoke_am(&iface->super, hdr->am_id, hdr + 1,
-                                   wc[i].byte_len - sizeof(*hdr), desc);
+            UCS_PROFILE_CALL_VOID(uct_ib_iface_invoke_am, &iface->super,
+                                  hdr->am_id, hdr + 1,
+                                  wc[i].byte_len - sizeof(*hdr), desc);
         }
     }
     iface->rx.available += num_wcs;
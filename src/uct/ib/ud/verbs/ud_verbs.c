@@ -12,6 +12,7 @@
 #include <ucs/debug/memtrack.h>
 #include <ucs/type/class.h>
 #include <ucs/debug/instrument.h>
+#include <ucs/debug/profile.h>
 #include <string.h>
 #include <arpa/inet.h> /* For htonl */
 
@@ -324,11 +325,11 @@ uct_ud_verbs_iface_poll_rx(uct_ud_verbs_iface_t *iface, int is_async)
     UCT_IB_IFACE_VERBS_FOREACH_RXWQE(&iface->super.super, i, packet, wc, num_wcs) {
         uct_ib_log_recv_completion(&iface->super.super, IBV_QPT_UD, &wc[i],
                                    packet, uct_ud_dump_packet);
-        uct_ud_ep_process_rx(&iface->super,
-                             (uct_ud_neth_t *)(packet + UCT_IB_GRH_LEN),
-                             wc[i].byte_len - UCT_IB_GRH_LEN,
-                             (uct_ud_recv_skb_t *)wc[i].wr_id,
-                             is_async);
+        UCS_PROFILE_CALL_VOID(uct_ud_ep_process_rx, &iface->super,
+                              (uct_ud_neth_t *)(packet + UCT_IB_GRH_LEN),
+                              wc[i].byte_len - UCT_IB_GRH_LEN,
+                              (uct_ud_recv_skb_t *)wc[i].wr_id,
+                              is_async);
 
     }
     iface->super.rx.available += num_wcs;
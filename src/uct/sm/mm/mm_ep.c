@@ -8,6 +8,7 @@
 #include "mm_ep.h"
 
 #include <ucs/arch/atomic.h>
+#include <ucs/debug/profile.h>
 
 SGLIB_DEFINE_LIST_FUNCTIONS(uct_mm_remote_seg_t, uct_mm_remote_seg_compare, next)
 SGLIB_DEFINE_HASHED_CONTAINER_FUNCTIONS(uct_mm_remote_seg_t,
@@ -371,8 +372,10 @@ uct_mm_ep_am_common_send(const unsigned is_short, uct_mm_ep_t *ep, uct_mm_iface_
     }
 }
 
-ucs_status_t uct_mm_ep_am_short(uct_ep_h tl_ep, uint8_t id, uint64_t header,
-                                const void *payload, unsigned length)
+UCS_PROFILE_FUNC(ucs_status_t, uct_mm_ep_am_short,
+                 (tl_ep, id, header, payload, length),
+                 uct_ep_h tl_ep, uint8_t id, uint64_t header,
+                 const void *payload, unsigned length)
 {
     uct_mm_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_mm_iface_t);
     uct_mm_ep_t *ep = ucs_derived_of(tl_ep, uct_mm_ep_t);
@@ -385,8 +388,9 @@ ucs_status_t uct_mm_ep_am_short(uct_ep_h tl_ep, uint8_t id, uint64_t header,
                                     header, payload, NULL, NULL);
 }
 
-ssize_t uct_mm_ep_am_bcopy(uct_ep_h tl_ep, uint8_t id, uct_pack_callback_t pack_cb,
-                           void *arg)
+UCS_PROFILE_FUNC(ssize_t, uct_mm_ep_am_bcopy, (tl_ep, id, pack_cb, arg),
+                 uct_ep_h tl_ep, uint8_t id, uct_pack_callback_t pack_cb,
+                 void *arg)
 {
     uct_mm_iface_t *iface = ucs_derived_of(tl_ep->iface, uct_mm_iface_t);
     uct_mm_ep_t *ep = ucs_derived_of(tl_ep, uct_mm_ep_t);
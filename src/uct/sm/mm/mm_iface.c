@@ -12,6 +12,7 @@
 #include <ucs/arch/atomic.h>
 #include <ucs/arch/bitops.h>
 #include <ucs/async/async.h>
+#include <ucs/debug/profile.h>
 #include <sys/poll.h>
 
 
@@ -246,7 +247,8 @@ static inline void uct_mm_iface_poll_fifo(uct_mm_iface_t *iface)
         ucs_memory_cpu_load_fence();
         ucs_assert(iface->read_index <= iface->recv_fifo_ctl->head);
 
-        status = uct_mm_iface_process_recv(iface, read_index_elem);
+        status = UCS_PROFILE_CALL(uct_mm_iface_process_recv, iface,
+                                  read_index_elem);
         if (status != UCS_OK) {
             /* the last_recv_desc is in use. get a new descriptor for it */
             UCT_TL_IFACE_GET_RX_DESC(&iface->super, &iface->recv_desc_mp,
@@ -501,7 +501,7 @@ static ucs_status_t uct_posix_free(void *address, uct_mm_id_t mm_id, size_t leng
         orig_fd = (int)(mm_id & UCS_MASK_SAFE(UCT_MM_POSIX_FD_BITS));
         close(orig_fd);
     } else {
-        char *file_name = ucs_calloc(1, NAME_MAX, "shared mr posix mmap");
+        char *file_name = ucs_calloc(1, NAME_MAX, "posix_mmap_file");
         if (file_name == NULL) {
             ucs_error("Failed to allocate memory for the shm_unlink file name. %m");
             status = UCS_ERR_NO_MEMORY;
@@ -13,6 +13,7 @@ extern "C" {
 #include <ucs/sys/sys.h>
 }
 #include <pthread.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -41,8 +42,16 @@ void test_perf::rte_comm::pop(void *data, size_t size) {
 }
 
 
-test_perf::rte::rte(unsigned index, rte_comm& send, rte_comm& recv) :
-    m_index(index), m_send(send), m_recv(recv) {
+test_perf::rte::rte(unsigned index, unsigned size, rte_comm *comms) :
+    m_index(index), m_size(size), m_comms(comms) {
+}
+
+test_perf::rte_comm& test_perf::rte::send_comm(unsigned dst) const {
+    return m_comms[(m_index * m_size) + dst];
+}
+
+test_perf::rte_comm& test_perf::rte::recv_comm(unsigned src) const {
+    return m_comms[(src * m_size) + m_index];
 }
 
 unsigned test_perf::rte::index() const {
@@ -50,7 +59,8 @@ unsigned test_perf::rte::index() const {
 }
 
 unsigned test_perf::rte::group_size(void *rte_group) {
-    return 2;
+    rte *self = reinterpret_cast<rte*>(rte_group);
+    return self->m_size;
 }
 
 unsigned test_perf::rte::group_index(void *rte_group) {
@@ -61,11 +71,22 @@ unsigned test_perf::rte::group_index(void *rte_group) {
 void test_perf::rte::barrier(void *rte_group) {
     static const uint32_t magic = 0xdeadbeed;
     rte *self = reinterpret_cast<rte*>(rte_group);
-    uint32_t dummy = magic;
-    self->m_send.push(&dummy, sizeof(dummy));
-    dummy = 0;
-    self->m_recv.pop(&dummy, sizeof(dummy));
-    ucs_assert_always(dummy == magic);
+    uint32_t dummy;
+
+    for (unsigned i = 0; i < self->m_size; ++i) {
+        if (i != self->m_index) {
+            dummy = magic;
+            self->send_comm(i).push(&dummy, sizeof(dummy));
+        }
+    }
+
+    for (unsigned i = 0; i < self->m_size; ++i) {
+        if (i != self->m_index) {
+            dummy = 0;
+            self->recv_comm(i).pop(&dummy, sizeof(dummy));
+            ucs_assert_always(dummy == magic);
+        }
+    }
 }
 
 void test_perf::rte::post_vec(void *rte_group, const struct iovec *iovec,
@@ -80,9 +101,15 @@ void test_perf::rte::post_vec(void *rte_group, const struct iovec *iovec,
         size += iovec[i].iov_len;
     }
 
-    self->m_send.push(&size, sizeof(size));
-    for (i = 0; i < iovcnt; ++i) {
-        self->m_send.push(iovec[i].iov_base, iovec[i].iov_len);
+    for (unsigned dst = 0; dst < self->m_size; ++dst) {
+        if (dst == self->m_index) {
+            continue;
+        }
+
+        self->send_comm(dst).push(&size, sizeof(size));
+        for (i = 0; i < iovcnt; ++i) {
+            self->send_comm(dst).push(iovec[i].iov_base, iovec[i].iov_len);
+        }
     }
 }
 
@@ -92,13 +119,14 @@ void test_perf::rte::recv(void *rte_group, unsigned src, void *buffer,
     rte *self = reinterpret_cast<rte*>(rte_group);
     size_t size;
 
-    if (src != 1 - self->m_index) {
+    if (src == self->m_index) {
         return;
     }
 
-    self->m_recv.pop(&size, sizeof(size));
+    ucs_assert_always(src < self->m_size);
+    self->recv_comm(src).pop(&size, sizeof(size));
     ucs_assert_always(size <= max);
-    self->m_recv.pop(buffer, size);
+    self->recv_comm(src).pop(buffer, size);
 }
 
 void test_perf::rte::exchange_vec(void *rte_group, void * req)
@@ -108,6 +136,11 @@ void test_perf::rte::exchange_vec(void *rte_group, void * req)
 void test_perf::rte::report(void *rte_group, const ucx_perf_result_t *result,
                             void *arg, int is_final)
 {
+    rte *self = reinterpret_cast<rte*>(rte_group);
+
+    if (is_final) {
+        self->m_results.push_back(*result);
+    }
 }
 
 ucx_perf_rte_t test_perf::rte::test_rte = {
@@ -165,26 +198,38 @@ void* test_perf::thread_func(void *arg)
     return result;
 }
 
-test_perf::test_result test_perf::run_multi_threaded(const test_spec &test, unsigned flags,
-                                                     const std::string &tl_name,
-                                                     const std::string &dev_name,
-                                                     const std::vector<int> &cpus)
+std::vector<test_perf::test_result>
+test_perf::run_multi_threaded(const test_spec &test, unsigned flags,
+                              const std::string &tl_name,
+                              const std::string &dev_name,
+                              const std::vector<int> &cpus)
 {
-    rte_comm c0to1, c1to0;
+    unsigned group_size   = (test.group_size == 0) ? 2 : test.group_size;
+    unsigned thread_count = std::max(test.thread_count, 1u);
+    std::vector<rte_comm> comms(group_size * group_size);
+    std::vector<thread_arg> args(group_size);
+    std::vector<pthread_t> threads(group_size);
+    std::vector<rte*> rtes(group_size);
+    std::vector<test_result> results(group_size);
+    unsigned i;
+    int ret;
 
     ucx_perf_params_t params;
     params.api             = test.api;
     params.command         = test.command;
     params.test_type       = test.test_type;
-    params.thread_mode     = UCS_THREAD_MODE_SINGLE;
+    params.thread_mode     = (thread_count > 1) ? UCS_THREAD_MODE_MULTI :
+                                                  UCS_THREAD_MODE_SINGLE;
     params.async_mode      = UCS_ASYNC_MODE_THREAD;
-    params.thread_count    = 1;
+    params.thread_count    = thread_count;
     params.wait_mode       = UCX_PERF_WAIT_MODE_LAST;
     params.flags           = flags;
     params.message_size    = test.msglen;
     params.am_hdr_size     = 8;
     params.alignment       = ucs_get_page_size();
     params.max_outstanding = test.max_outstanding;
+    params.ep_count        = std::max(test.ep_count, 1u);
+    params.ep_order        = UCX_PERF_EP_ORDER_ROUND_ROBIN;
     params.warmup_iter     = test.iters / 10;
     params.max_iter        = test.iters;
     params.max_time        = 0.0;
@@ -196,44 +241,103 @@ test_perf::test_result test_perf::run_multi_threaded(const test_spec &test, unsi
     strncpy(params.uct.tl_name , tl_name.c_str(),  sizeof(params.uct.tl_name));
     params.uct.data_layout = test.data_layout;
     params.uct.fc_window   = UCT_PERF_TEST_MAX_FC_WINDOW;
+    params.ucp.datatype    = test.ucp_datatype;
+    params.ucp.iov_count   = std::max(test.ucp_iov_count, 1u);
+    params.ucp.call_mode   = test.ucp_call_mode;
+
+    for (i = 0; i < group_size; ++i) {
+        rtes[i]                  = new rte(i, group_size, &comms[0]);
+        args[i].params           = params;
+        args[i].params.rte_group = rtes[i];
+        args[i].cpu              = cpus[i % cpus.size()];
+    }
 
-    thread_arg arg0;
-    arg0.params   = params;
-    arg0.cpu      = cpus[0];
+    for (i = 0; i < group_size; ++i) {
+        ret = pthread_create(&threads[i], NULL, thread_func, &args[i]);
+        if (ret) {
+            UCS_TEST_MESSAGE << strerror(errno);
+            throw ucs::test_abort_exception();
+        }
+    }
 
-    rte rte0(0, c0to1, c1to0);
-    arg0.params.rte_group = &rte0;
+    for (i = 0; i < group_size; ++i) {
+        void *ptr;
+        pthread_join(threads[i], &ptr);
 
-    pthread_t thread0, thread1;
-    int ret = pthread_create(&thread0, NULL, thread_func, &arg0);
-    if (ret) {
-        UCS_TEST_MESSAGE << strerror(errno);
-        throw ucs::test_abort_exception();
+        test_result *result = reinterpret_cast<test_result*>(ptr);
+        results[i] = *result;
+        if (!rtes[i]->m_results.empty()) {
+            /* The last final report is the aggregate of the per-thread ones */
+            results[i].thread_results.assign(rtes[i]->m_results.begin(),
+                                             rtes[i]->m_results.end() - 1);
+        }
+        delete result;
+        delete rtes[i];
+    }
+
+    return results;
+}
+
+void test_perf::check_thread_results(const test_result &result,
+                                     unsigned thread_count)
+{
+    ucx_perf_counter_t iters = 0;
+    double msgrate           = 0;
+
+    ASSERT_EQ(thread_count, result.thread_results.size());
+    EXPECT_EQ(-1, result.result.thread_index);
+
+    for (unsigned i = 0; i < thread_count; ++i) {
+        const ucx_perf_result_t &tresult = result.thread_results[i];
+        EXPECT_EQ(int(i), tresult.thread_index);
+        EXPECT_GT(tresult.iters, 0ul);
+        iters   += tresult.iters;
+        msgrate += tresult.msgrate.total_average;
     }
 
-    thread_arg arg1;
-    arg1.params   = params;
-    arg1.cpu      = cpus[1];
+    EXPECT_EQ(iters, result.result.iters);
+    EXPECT_NEAR(msgrate, result.result.msgrate.total_average, msgrate * 1e-9);
+}
 
-    rte rte1(1, c1to0, c0to1);
-    arg1.params.rte_group = &rte1;
+/*
+ * In incast and all-to-all tests, every message announced by a FIN must have
+ * been received before the receiver reported its results.
+ */
+void test_perf::check_fin_counts(const test_spec &test,
+                                 const std::vector<test_result> &results)
+{
+    ucx_perf_counter_t sent = 0, received = 0;
 
-    ret = pthread_create(&thread1, NULL, thread_func, &arg1);
-    if (ret) {
-        UCS_TEST_MESSAGE << strerror(errno);
-        throw ucs::test_abort_exception();
+    for (unsigned i = 0; i < results.size(); ++i) {
+        if ((test.test_type == UCX_PERF_TEST_TYPE_ALLTOALL) || (i != 0)) {
+            sent     += results[i].result.iters;
+        }
+        if ((test.test_type == UCX_PERF_TEST_TYPE_ALLTOALL) || (i == 0)) {
+            received += results[i].result.recv.msgs;
+        }
     }
 
-    void *ptr0, *ptr1;
-    pthread_join(thread0, &ptr0);
-    pthread_join(thread1, &ptr1);
+    EXPECT_GT(sent, 0ul);
+    EXPECT_EQ(sent, received);
+}
 
-    test_result *result0 = reinterpret_cast<test_result*>(ptr0),
-                *result1 = reinterpret_cast<test_result*>(ptr1);
-    test_result result = *result1;
-    delete result0;
-    delete result1;
-    return result;
+unsigned test_perf::result_index(const test_spec &test)
+{
+    /* The receiver of incast and all-to-all tests is first, otherwise the
+     * client is second */
+    return ((test.test_type == UCX_PERF_TEST_TYPE_INCAST) ||
+            (test.test_type == UCX_PERF_TEST_TYPE_ALLTOALL) ||
+            (test.group_size == 1)) ? 0 : 1;
+}
+
+ucs_status_t test_perf::run_once(const test_spec& test, unsigned flags,
+                                 const std::string &tl_name,
+                                 const std::string &dev_name)
+{
+    std::vector<test_result> results = run_multi_threaded(test, flags, tl_name,
+                                                          dev_name,
+                                                          get_affinity());
+    return results[result_index(test)].status;
 }
 
 void test_perf::run_test(const test_spec& test, unsigned flags, double min, double max,
@@ -248,11 +352,15 @@ void test_perf::run_test(const test_spec& test, unsigned flags, double min, doub
         UCS_TEST_MESSAGE << "Need at least 2 CPUs (got: " << cpus.size() << " )";
         throw ucs::test_abort_exception();
     }
-    cpus.resize(2);
+    /* Every member of the group runs on its own CPU, if there are enough */
+    cpus.resize(std::min(cpus.size(),
+                         size_t(std::max(test.group_size, 2u))));
 
     for (int i = 0; i < 5; ++i) {
-        test_result result = run_multi_threaded(test, flags, tl_name, dev_name,
-                                                cpus);
+        std::vector<test_result> results = run_multi_threaded(test, flags,
+                                                              tl_name, dev_name,
+                                                              cpus);
+        const test_result &result = results[result_index(test)];
         if ((result.status == UCS_ERR_UNSUPPORTED) ||
             (result.status == UCS_ERR_UNREACHABLE))
         {
@@ -260,6 +368,16 @@ void test_perf::run_test(const test_spec& test, unsigned flags, double min, doub
         }
 
         ASSERT_UCS_OK(result.status);
+        if (test.thread_count > 1) {
+            check_thread_results(result, test.thread_count);
+        }
+        if ((test.test_type == UCX_PERF_TEST_TYPE_INCAST) ||
+            (test.test_type == UCX_PERF_TEST_TYPE_ALLTOALL)) {
+            check_fin_counts(test, results);
+        }
+        EXPECT_GT(result.result.latency_dist.samples, 0ul);
+        EXPECT_LE(result.result.latency_dist.p50, result.result.latency_dist.p99);
+        EXPECT_LE(result.result.latency_dist.p99, result.result.latency_dist.p999);
 
         double value = *(double*)( ((char*)&result.result) + test.field_offset) *
                         test.norm;
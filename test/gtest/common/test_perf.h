@@ -29,6 +29,15 @@ protected:
 
         double                 min; /* TODO remove this field */
         double                 max; /* TODO remove this field */
+
+        unsigned               thread_count; /* 0 means a single thread */
+        unsigned               ep_count;     /* 0 means a single endpoint */
+
+        ucp_perf_datatype_t    ucp_datatype;
+        unsigned               ucp_iov_count; /* 0 means a single entry */
+        ucp_perf_call_mode_t   ucp_call_mode;
+
+        unsigned               group_size;   /* 0 means 2 processes */
     };
 
     static std::vector<int> get_affinity();
@@ -36,6 +45,11 @@ protected:
     void run_test(const test_spec& test, unsigned flags, double min, double max,
                   const std::string &tl_name, const std::string &dev_name);
 
+    /* Run the test once without checking its results, return its status */
+    ucs_status_t run_once(const test_spec& test, unsigned flags,
+                          const std::string &tl_name,
+                          const std::string &dev_name);
+
 private:
     class rte_comm {
     public:
@@ -50,10 +64,14 @@ private:
         std::string      m_queue;
     };
 
+    /*
+     * Every member of the group runs in its own thread. comms[i * size + j]
+     * carries the data which member i sends to member j.
+     */
     class rte {
     public:
         /* RTE functions */
-        rte(unsigned index, rte_comm& send, rte_comm& recv);
+        rte(unsigned index, unsigned size, rte_comm *comms);
 
         unsigned index() const;
 
@@ -76,10 +94,17 @@ private:
 
         static ucx_perf_rte_t test_rte;
 
+        /* Final results, per-thread ones first in multi-threaded tests */
+        std::vector<ucx_perf_result_t> m_results;
+
     private:
+        rte_comm& send_comm(unsigned dst) const;
+
+        rte_comm& recv_comm(unsigned src) const;
+
         const unsigned m_index;
-        rte_comm       &m_send;
-        rte_comm       &m_recv;
+        const unsigned m_size;
+        rte_comm       *m_comms;
     };
 
     struct thread_arg {
@@ -88,18 +113,28 @@ private:
     };
 
     struct test_result {
-        ucs_status_t        status;
-        ucx_perf_result_t   result;
+        ucs_status_t                   status;
+        ucx_perf_result_t              result;
+        std::vector<ucx_perf_result_t> thread_results;
     };
 
     static void set_affinity(int cpu);
 
     static void* thread_func(void *arg);
 
-    test_result run_multi_threaded(const test_spec &test, unsigned flags,
-                                   const std::string &tl_name,
-                                   const std::string &dev_name,
-                                   const std::vector<int> &cpus);
+    static void check_thread_results(const test_result &result,
+                                     unsigned thread_count);
+
+    static void check_fin_counts(const test_spec &test,
+                                 const std::vector<test_result> &results);
+
+    static unsigned result_index(const test_spec &test);
+
+    std::vector<test_result> run_multi_threaded(const test_spec &test,
+                                                unsigned flags,
+                                                const std::string &tl_name,
+                                                const std::string &dev_name,
+                                                const std::vector<int> &cpus);
 };
 
 #endif
@@ -0,0 +1,80 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2001-2016.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "ucp_test.h"
+
+extern "C" {
+#include <ucp/core/ucp_worker.h>
+}
+
+class test_ucp_ep_config : public ucp_test {
+public:
+    static ucp_params_t get_ctx_params() {
+        ucp_params_t params = ucp_test::get_ctx_params();
+        params.features     = UCP_FEATURE_TAG;
+        return params;
+    }
+
+protected:
+    /* Generate a distinct configuration key for every index, which uses only
+     * stub lanes so it would be valid with any set of transports.
+     */
+    static ucp_ep_config_key_t make_key(unsigned index) {
+        ucp_ep_config_key_t key;
+
+        memset(&key, 0, sizeof(key));
+        key.rma_lane_map     = 0;
+        key.amo_lane_map     = 0;
+        key.reachable_md_map = index & UCS_MASK(UCP_MD_INDEX_BITS);
+        key.num_lanes        = 1 + ((index >> UCP_MD_INDEX_BITS) % UCP_MAX_LANES);
+        key.am_lane          = 0;
+        key.rndv_lane        = key.num_lanes - 1;
+        key.wireup_msg_lane  = UCP_NULL_LANE;
+        memset(key.lanes, UCP_NULL_RESOURCE, sizeof(key.lanes));
+        memset(key.amo_lanes, UCP_NULL_LANE, sizeof(key.amo_lanes));
+        return key;
+    }
+};
+
+UCS_TEST_P(test_ucp_ep_config, many_configs) {
+    const unsigned count = 1000;
+    ucp_worker_h worker  = sender().worker();
+    std::vector<unsigned> indices;
+
+    unsigned initial_count = worker->ep_config_count;
+    for (unsigned i = 0; i < count; ++i) {
+        ucp_ep_config_key_t key = make_key(i);
+        indices.push_back(ucp_worker_get_ep_config(worker, &key));
+    }
+
+    EXPECT_EQ(initial_count + count, worker->ep_config_count);
+    EXPECT_GE(worker->ep_config_max, worker->ep_config_count);
+
+    /* Existing configurations are found, and were kept when the table grew */
+    for (unsigned i = 0; i < count; ++i) {
+        ucp_ep_config_key_t key = make_key(i);
+        EXPECT_EQ(indices[i], ucp_worker_get_ep_config(worker, &key));
+        EXPECT_TRUE(ucp_ep_config_is_equal(&key,
+                                           &worker->ep_config[indices[i]].key));
+        EXPECT_EQ((size_t)UCP_MIN_BCOPY,
+                  worker->ep_config[indices[i]].max_am_bcopy);
+    }
+    EXPECT_EQ(initial_count + count, worker->ep_config_count);
+}
+
+UCS_TEST_P(test_ucp_ep_config, connect_after_many_configs) {
+    ucp_worker_h worker = sender().worker();
+
+    for (unsigned i = 0; i < 300; ++i) {
+        ucp_ep_config_key_t key = make_key(i);
+        ucp_worker_get_ep_config(worker, &key);
+    }
+
+    sender().connect(&receiver());
+    sender().flush_worker();
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_ep_config)
@@ -6,6 +6,13 @@
 
 #include "test_ucp_memheap.h"
 
+#include <algorithm>
+
+extern "C" {
+#include <ucp/core/ucp_worker.h>
+#include <ucp/core/ucp_mm.h>
+}
+
 
 class test_ucp_mmap : public test_ucp_memheap {
 public:
@@ -25,9 +32,37 @@ public:
 
 protected:
     void test_rkey_management(entity *e, ucp_mem_h memh, bool is_dummy);
+
+    struct arena_thread_args {
+        ucp_context_h          context;
+        unsigned               index;
+        std::vector<ucp_mem_h> memhs;
+    };
+
+    static void *arena_thread(void *arg);
 };
 
 
+void *test_ucp_mmap::arena_thread(void *arg)
+{
+    arena_thread_args *args = reinterpret_cast<arena_thread_args*>(arg);
+    ucs_status_t status;
+
+    for (unsigned i = 0; i < 50; ++i) {
+        ucp_mem_h memh;
+        void *ptr = NULL;
+
+        status = ucp_mem_map(args->context, &ptr, 1024, 0, &memh);
+        if (status != UCS_OK) {
+            break;
+        }
+        memset(ptr, args->index, 1024);
+        args->memhs.push_back(memh);
+    }
+    return NULL;
+}
+
+
 void test_ucp_mmap::test_rkey_management(entity *e, ucp_mem_h memh, bool is_dummy)
 {
     size_t rkey_size;
@@ -36,10 +71,12 @@ void test_ucp_mmap::test_rkey_management(entity *e, ucp_mem_h memh, bool is_dumm
 
     /* Some transports don't support memory registration, so the memory
      * can be inaccessible remotely. But it should always be possible
-     * to pack/unpack a key for dummy memh. */
+     * to pack/unpack a key for dummy memh. During background registration,
+     * there may be no registered memory yet. */
 
     status = ucp_rkey_pack(e->ucph(), memh, &rkey_buffer, &rkey_size);
-    if (status == UCS_ERR_UNSUPPORTED && !is_dummy) {
+    if (((status == UCS_ERR_UNSUPPORTED) || (status == UCS_ERR_NO_RESOURCE)) &&
+        !is_dummy) {
         return;
     }
     ASSERT_UCS_OK(status);
@@ -105,6 +142,101 @@ UCS_TEST_P(test_ucp_mmap, reg) {
     }
 }
 
+UCS_TEST_P(test_ucp_mmap, reg_async) {
+    static const size_t size = 8 * 1024 * 1024;
+    std::vector<char> buffer(size);
+    ucp_mem_h memh, sync_memh;
+    ucs_status_t status;
+    void *ptr;
+
+    sender().connect(&sender());
+
+    ptr    = &buffer[0];
+    status = ucp_mem_map(sender().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC, &memh);
+    ASSERT_EQ(UCS_INPROGRESS, status);
+    EXPECT_EQ(&buffer[0], ptr);
+    EXPECT_EQ(&buffer[0], memh->address);
+
+    do {
+        status = ucp_mem_map_test(sender().ucph(), memh);
+    } while (status == UCS_INPROGRESS);
+    ASSERT_UCS_OK(status);
+
+    /* The same MDs are registered as in a blocking mapping */
+    status = ucp_mem_map(sender().ucph(), &ptr, size, 0, &sync_memh);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(sync_memh->md_map, memh->md_map);
+    EXPECT_EQ(UCS_OK, ucp_mem_map_test(sender().ucph(), sync_memh));
+
+    test_rkey_management(&sender(), memh, false);
+
+    status = ucp_mem_unmap(sender().ucph(), sync_memh);
+    ASSERT_UCS_OK(status);
+    status = ucp_mem_unmap(sender().ucph(), memh);
+    ASSERT_UCS_OK(status);
+}
+
+UCS_TEST_P(test_ucp_mmap, reg_async_chunks, "MEM_REG_CHUNK=1m") {
+    static const size_t size = 8 * 1024 * 1024 + 4096;
+    std::vector<char> buffer(size);
+    ucp_mem_h memh, sync_memh;
+    ucs_status_t status;
+    void *ptr;
+
+    sender().connect(&sender());
+
+    ptr    = &buffer[0];
+    status = ucp_mem_map(sender().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC, &memh);
+    ASSERT_EQ(UCS_INPROGRESS, status);
+    EXPECT_EQ(9u, memh->reg_num_chunks);
+
+    /* The registered length only grows, by whole chunks */
+    size_t reg_length = 0;
+    do {
+        status = ucp_mem_map_test(sender().ucph(), memh);
+        EXPECT_GE(memh->reg_length, reg_length);
+        reg_length = memh->reg_length;
+        EXPECT_TRUE(((reg_length % memh->reg_chunk) == 0) || (reg_length == size));
+    } while (status == UCS_INPROGRESS);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(size, memh->reg_length);
+
+    status = ucp_mem_map(sender().ucph(), &ptr, size, 0, &sync_memh);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(sync_memh->md_map, memh->md_map);
+
+    test_rkey_management(&sender(), memh, false);
+
+    status = ucp_mem_unmap(sender().ucph(), sync_memh);
+    ASSERT_UCS_OK(status);
+    status = ucp_mem_unmap(sender().ucph(), memh);
+    ASSERT_UCS_OK(status);
+}
+
+UCS_TEST_P(test_ucp_mmap, reg_async_unmap, "MEM_REG_CHUNK=64k") {
+    static const size_t size = 1024 * 1024;
+    static const unsigned num_buffers = 20;
+    std::vector<char> buffer(size * num_buffers);
+    std::vector<ucp_mem_h> memhs(num_buffers);
+    ucs_status_t status;
+
+    sender().connect(&sender());
+
+    for (unsigned i = 0; i < num_buffers; ++i) {
+        void *ptr = &buffer[i * size];
+        status = ucp_mem_map(sender().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC,
+                             &memhs[i]);
+        ASSERT_EQ(UCS_INPROGRESS, status);
+    }
+
+    /* Unmapping stops the registration at any stage */
+    for (unsigned i = 0; i < num_buffers; ++i) {
+        test_rkey_management(&sender(), memhs[i], false);
+        status = ucp_mem_unmap(sender().ucph(), memhs[i]);
+        ASSERT_UCS_OK(status);
+    }
+}
+
 UCS_TEST_P(test_ucp_mmap, dummy_mem) {
 
     ucs_status_t status;
@@ -131,4 +263,171 @@ UCS_TEST_P(test_ucp_mmap, dummy_mem) {
     }
 }
 
+UCS_TEST_P(test_ucp_mmap, alloc_arena_mt, "MEM_ARENA_THRESH=1k",
+           "MEM_ARENA_SIZE=16k") {
+    static const unsigned num_threads = 4;
+    arena_thread_args args[num_threads];
+    pthread_t threads[num_threads];
+    ucs_status_t status;
+
+    /* Threads grow the arenas concurrently, and get disjoint regions */
+    for (unsigned i = 0; i < num_threads; ++i) {
+        args[i].context = sender().ucph();
+        args[i].index   = i + 1;
+        pthread_create(&threads[i], NULL, arena_thread, &args[i]);
+    }
+    for (unsigned i = 0; i < num_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (unsigned i = 0; i < num_threads; ++i) {
+        EXPECT_EQ(50u, args[i].memhs.size());
+        for (unsigned j = 0; j < args[i].memhs.size(); ++j) {
+            ucp_mem_h memh = args[i].memhs[j];
+            EXPECT_TRUE(memh->arena_memh != NULL);
+            EXPECT_EQ(1024, std::count((char*)memh->address,
+                                       (char*)memh->address + 1024,
+                                       (char)args[i].index));
+            status = ucp_mem_unmap(sender().ucph(), memh);
+            ASSERT_UCS_OK(status);
+        }
+    }
+}
+
+UCS_TEST_P(test_ucp_mmap, alloc_arena, "MEM_ARENA_THRESH=1k",
+           "MEM_ARENA_SIZE=16k") {
+    static const unsigned num_regions = 100;
+    std::vector<ucp_mem_h> memhs;
+    std::vector<void*> ptrs;
+    ucs_status_t status;
+
+    sender().connect(&sender());
+
+    /* Small allocations are carved out of the arenas, and do not overlap */
+    for (unsigned i = 0; i < num_regions; ++i) {
+        size_t size = 1 + (rand() % 1024);
+        ucp_mem_h memh;
+        void *ptr = NULL;
+
+        status = ucp_mem_map(sender().ucph(), &ptr, size, rand_flags(), &memh);
+        ASSERT_UCS_OK(status);
+        ASSERT_TRUE(memh->arena_memh != NULL);
+        EXPECT_EQ(ptr, memh->address);
+        EXPECT_EQ(size, memh->length);
+        EXPECT_EQ(memh->arena_memh->md_map, memh->md_map);
+        EXPECT_GE(ptr, memh->arena_memh->address);
+        EXPECT_LE((char*)ptr + size,
+                  (char*)memh->arena_memh->address + memh->arena_memh->length);
+
+        memset(ptr, i, size);
+        test_rkey_management(&sender(), memh, false);
+        memhs.push_back(memh);
+        ptrs.push_back(ptr);
+    }
+
+    for (unsigned i = 0; i < num_regions; ++i) {
+        EXPECT_EQ((char)i, *(char*)ptrs[i]);
+        EXPECT_EQ((char)i, ((char*)ptrs[i])[memhs[i]->length - 1]);
+    }
+
+    /* Released regions are reused */
+    void *ptr = ptrs.back();
+    size_t size = memhs.back()->length;
+    status = ucp_mem_unmap(sender().ucph(), memhs.back());
+    ASSERT_UCS_OK(status);
+    memhs.pop_back();
+
+    ucp_mem_h memh;
+    void *new_ptr = NULL;
+    status = ucp_mem_map(sender().ucph(), &new_ptr, size, 0, &memh);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(ptr, new_ptr);
+    memhs.push_back(memh);
+
+    /* Large allocations are not carved */
+    void *large_ptr = NULL;
+    status = ucp_mem_map(sender().ucph(), &large_ptr, 4096, 0, &memh);
+    ASSERT_UCS_OK(status);
+    EXPECT_TRUE(memh->arena_memh == NULL);
+    memhs.push_back(memh);
+
+    for (unsigned i = 0; i < memhs.size(); ++i) {
+        status = ucp_mem_unmap(sender().ucph(), memhs[i]);
+        ASSERT_UCS_OK(status);
+    }
+}
+
+UCS_TEST_P(test_ucp_mmap, rkey_cache, "RKEY_CACHE_SIZE=4") {
+    static const unsigned num_buffers = 6;
+    ucp_worker_h worker = sender().worker();
+    std::vector<ucp_mem_h> memhs(num_buffers);
+    std::vector<void*> rkey_buffers(num_buffers);
+    std::vector<ucp_rkey_h> rkeys(num_buffers);
+    ucs_status_t status;
+    size_t rkey_size;
+    ucp_rkey_h rkey;
+
+    sender().connect(&sender());
+
+    for (unsigned i = 0; i < num_buffers; ++i) {
+        void *ptr = NULL;
+        status = ucp_mem_map(sender().ucph(), &ptr, 4096, 0, &memhs[i]);
+        ASSERT_UCS_OK(status);
+        status = ucp_rkey_pack(sender().ucph(), memhs[i], &rkey_buffers[i],
+                               &rkey_size);
+        ASSERT_UCS_OK(status);
+    }
+
+    for (unsigned i = 0; i < 4; ++i) {
+        status = ucp_ep_rkey_unpack(sender().ep(), rkey_buffers[i], &rkeys[i]);
+        if (status == UCS_ERR_UNREACHABLE) {
+            UCS_TEST_SKIP_R("unreachable");
+        }
+        ASSERT_UCS_OK(status);
+    }
+    EXPECT_EQ(4u, worker->rkey_cache_count);
+
+    /* Same packed key returns the same handle, and makes it recently used */
+    status = ucp_ep_rkey_unpack(sender().ep(), rkey_buffers[0], &rkey);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(rkeys[0], rkey);
+    ucp_rkey_destroy(rkey);
+
+    /* A copy of the packed key is found as well */
+    std::vector<char> rkey_copy((char*)rkey_buffers[2],
+                                (char*)rkey_buffers[2] + rkey_size);
+    status = ucp_ep_rkey_unpack(sender().ep(), &rkey_copy[0], &rkey);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(rkeys[2], rkey);
+    ucp_rkey_destroy(rkey);
+
+    /* Adding more keys evicts the least recently used ones */
+    for (unsigned i = 4; i < num_buffers; ++i) {
+        status = ucp_ep_rkey_unpack(sender().ep(), rkey_buffers[i], &rkeys[i]);
+        ASSERT_UCS_OK(status);
+    }
+    EXPECT_EQ(4u, worker->rkey_cache_count);
+
+    status = ucp_ep_rkey_unpack(sender().ep(), rkey_buffers[0], &rkey);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(rkeys[0], rkey);
+    ucp_rkey_destroy(rkey);
+
+    /* Evicted keys are still valid for their users, and a new handle is
+     * created for them */
+    status = ucp_ep_rkey_unpack(sender().ep(), rkey_buffers[1], &rkey);
+    ASSERT_UCS_OK(status);
+    EXPECT_NE(rkeys[1], rkey);
+    EXPECT_EQ(rkeys[1]->md_map, rkey->md_map);
+    ucp_rkey_destroy(rkey);
+    EXPECT_EQ(4u, worker->rkey_cache_count);
+
+    for (unsigned i = 0; i < num_buffers; ++i) {
+        ucp_rkey_destroy(rkeys[i]);
+        ucp_rkey_buffer_release(rkey_buffers[i]);
+        status = ucp_mem_unmap(sender().ucph(), memhs[i]);
+        ASSERT_UCS_OK(status);
+    }
+}
+
 UCP_INSTANTIATE_TEST_CASE(test_ucp_mmap)
@@ -20,6 +20,7 @@ protected:
         test_base::init(); /* Skip entities creation in ucp_test */
     }
     static test_spec tests[];
+    static test_spec group_tests[];
 };
 
 
@@ -30,6 +31,36 @@ test_perf::test_spec test_ucp_perf::tests[] =
     UCT_PERF_DATA_LAYOUT_LAST, 8, 1, 100000l,
     ucs_offsetof(ucx_perf_result_t, latency.total_average), 1e6, 0.001, 30.0 },
 
+  { "tag latency iov", "usec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_PINGPONG,
+    UCT_PERF_DATA_LAYOUT_LAST, 64, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, latency.total_average), 1e6, 0.001, 30.0,
+    0, 0, UCP_PERF_DATATYPE_IOV, 4, UCP_PERF_CALL_MODE_BLOCKING },
+
+  { "tag latency generic", "usec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_PINGPONG,
+    UCT_PERF_DATA_LAYOUT_LAST, 64, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, latency.total_average), 1e6, 0.001, 30.0,
+    0, 0, UCP_PERF_DATATYPE_GENERIC, 1, UCP_PERF_CALL_MODE_BLOCKING },
+
+  { "tag bw iov", "MB/sec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_LAST, 16384, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 100.0, 100000.0,
+    0, 0, UCP_PERF_DATATYPE_IOV, 16, UCP_PERF_CALL_MODE_BLOCKING },
+
+  { "tag bw generic", "MB/sec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_LAST, 16384, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 100.0, 100000.0,
+    0, 0, UCP_PERF_DATATYPE_GENERIC, 1, UCP_PERF_CALL_MODE_BLOCKING },
+
+  { "tag rate nb", "Mpps",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_LAST, 8, 16, 2000000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.5, 100.0,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_NB },
+
   { "put latency", "usec",
     UCX_PERF_API_UCP, UCX_PERF_CMD_PUT, UCX_PERF_TEST_TYPE_PINGPONG,
     UCT_PERF_DATA_LAYOUT_LAST, 8, 1, 100000l,
@@ -45,6 +76,12 @@ test_perf::test_spec test_ucp_perf::tests[] =
     UCT_PERF_DATA_LAYOUT_LAST, 2048, 1, 100000l,
     ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 200.0, 100000.0 },
 
+  { "put bw nbi", "MB/sec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_PUT, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_LAST, 2048, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 200.0, 100000.0,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_NBI },
+
   { "get latency", "usec",
     UCX_PERF_API_UCP, UCX_PERF_CMD_GET, UCX_PERF_TEST_TYPE_STREAM_UNI,
     UCT_PERF_DATA_LAYOUT_LAST, 8, 1, 100000l,
@@ -55,6 +92,12 @@ test_perf::test_spec test_ucp_perf::tests[] =
     UCT_PERF_DATA_LAYOUT_LAST, 16384, 1, 10000l,
     ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 200.0, 100000.0 },
 
+  { "get bw nbi", "MB/sec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_GET, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_LAST, 16384, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 200.0, 100000.0,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_NBI },
+
   { "atomic add rate", "Mpps",
     UCX_PERF_API_UCP, UCX_PERF_CMD_ADD, UCX_PERF_TEST_TYPE_STREAM_UNI,
     UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 1000000l,
@@ -79,6 +122,37 @@ test_perf::test_spec test_ucp_perf::tests[] =
 };
 
 
+/* More than 2 processes, the receivers check the FIN message counts */
+test_perf::test_spec test_ucp_perf::group_tests[] =
+{
+  { "tag incast 3", "Mpps",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_INCAST,
+    UCT_PERF_DATA_LAYOUT_LAST, 8, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, recv.msgrate), 1e-6, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 3 },
+
+  { "tag incast 4", "MB/sec",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_INCAST,
+    UCT_PERF_DATA_LAYOUT_LAST, 4096, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 4 },
+
+  { "tag alltoall 3", "Mpps",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_ALLTOALL,
+    UCT_PERF_DATA_LAYOUT_LAST, 8, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 3 },
+
+  { "tag alltoall 4", "Mpps",
+    UCX_PERF_API_UCP, UCX_PERF_CMD_TAG, UCX_PERF_TEST_TYPE_ALLTOALL,
+    UCT_PERF_DATA_LAYOUT_LAST, 4096, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 4 },
+
+  { NULL }
+};
+
+
 UCS_TEST_P(test_ucp_perf, envelope) {
     /* Run all tests */
     std::stringstream ss;
@@ -91,4 +165,33 @@ UCS_TEST_P(test_ucp_perf, envelope) {
     }
 }
 
+UCS_TEST_P(test_ucp_perf, incast_alltoall) {
+    std::stringstream ss;
+    ss << GetParam();
+    ucs::scoped_setenv tls("UCX_TLS", ss.str().c_str());
+    for (test_spec *test = group_tests; test->title != NULL; ++test) {
+        run_test(*test, 0, test->min, test->max, "", "");
+    }
+}
+
+UCS_TEST_P(test_ucp_perf, group_size_check) {
+    std::stringstream ss;
+    ss << GetParam();
+    ucs::scoped_setenv tls("UCX_TLS", ss.str().c_str());
+    test_spec test = tests[0]; /* tag latency */
+
+    /* Point-to-point tests require exactly 2 processes */
+    test.group_size = 3;
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM, run_once(test, 0, "", ""));
+
+    /* Incast requires at least 2 processes */
+    test            = group_tests[0];
+    test.iters      = 100;
+    test.group_size = 1;
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM, run_once(test, 0, "", ""));
+
+    test.group_size = 2;
+    EXPECT_EQ(UCS_OK, run_once(test, 0, "", ""));
+}
+
 UCP_INSTANTIATE_TEST_CASE(test_ucp_perf)
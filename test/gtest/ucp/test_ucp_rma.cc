@@ -7,6 +7,11 @@
 
 #include "test_ucp_memheap.h"
 
+extern "C" {
+#include <ucp/core/ucp_mm.h>
+#include <ucp/core/ucp_ep.h>
+}
+
 
 class test_ucp_rma : public test_ucp_memheap {
 public:
@@ -38,6 +43,21 @@ public:
         ASSERT_UCS_OK(status);
     }
 
+    void blocking_put_resolved(entity *e, size_t max_size,
+                               void *memheap_addr,
+                               ucp_rkey_h rkey,
+                               std::string& expected_data)
+    {
+        blocking_put(e, max_size, memheap_addr, rkey, expected_data);
+
+        /* The lane and rkey index are saved for the endpoint configuration */
+        uint32_t resolved = rkey->rma_resolved;
+        EXPECT_EQ(e->ep()->cfg_index, UCP_RKEY_RESOLVED_CFG(resolved));
+        EXPECT_LT(UCP_RKEY_RESOLVED_INDEX(resolved),
+                  (uint32_t)ucs_count_one_bits(rkey->md_map));
+        EXPECT_NE(UCP_RKEY_RESOLVED_INVALID, resolved);
+    }
+
     void nonblocking_get_nbi(entity *e, size_t max_size,
                              void *memheap_addr,
                              ucp_rkey_h rkey,
@@ -63,6 +83,38 @@ public:
                          (uintptr_t)memheap_addr, rkey);
         ASSERT_UCS_OK(status);
     }
+
+protected:
+    struct mt_rma_arg {
+        ucp_ep_h   ep;
+        ucp_rkey_h rkey;
+        uint64_t   addr;
+        size_t     size;
+        unsigned   errors;
+    };
+
+    static void *mt_rma_thread(void *ptr) {
+        mt_rma_arg *arg = reinterpret_cast<mt_rma_arg*>(ptr);
+        std::string send_data(arg->size, 0), recv_data(arg->size, 0);
+        ucs_status_t status;
+
+        for (int i = 0; i < 100 / ucs::test_time_multiplier(); ++i) {
+            ucs::fill_random(send_data);
+            status = ucp_put(arg->ep, &send_data[0], arg->size, arg->addr,
+                             arg->rkey);
+            if (status == UCS_OK) {
+                status = ucp_ep_flush(arg->ep);
+            }
+            if (status == UCS_OK) {
+                status = ucp_get(arg->ep, &recv_data[0], arg->size, arg->addr,
+                                 arg->rkey);
+            }
+            if ((status != UCS_OK) || (send_data != recv_data)) {
+                ++arg->errors;
+            }
+        }
+        return NULL;
+    }
 };
 
 
@@ -76,6 +128,23 @@ UCS_TEST_P(test_ucp_rma, blocking_put_registered) {
                        1, true, false);
 }
 
+UCS_TEST_P(test_ucp_rma, blocking_put_arena, "MEM_ARENA_THRESH=4k",
+           "MEM_ARENA_SIZE=64k") {
+    test_blocking_xfer(static_cast<blocking_send_func_t>(&test_ucp_rma::blocking_put),
+                       1, false, false);
+}
+
+UCS_TEST_P(test_ucp_rma, blocking_get_arena, "MEM_ARENA_THRESH=4k",
+           "MEM_ARENA_SIZE=64k") {
+    test_blocking_xfer(static_cast<blocking_send_func_t>(&test_ucp_rma::blocking_get),
+                       1, false, false);
+}
+
+UCS_TEST_P(test_ucp_rma, blocking_put_resolved) {
+    test_blocking_xfer(static_cast<blocking_send_func_t>(&test_ucp_rma::blocking_put_resolved),
+                       1, false, false);
+}
+
 UCS_TEST_P(test_ucp_rma, nonblocking_put_nbi_flush_worker) {
     test_blocking_xfer(static_cast<nonblocking_send_func_t>(&test_ucp_rma::nonblocking_put_nbi),
                        1, false, false);
@@ -139,5 +208,60 @@ UCS_TEST_P(test_ucp_rma, nonblocking_stream_get_nbi_flush_ep) {
                        1, true, true);
 }
 
+UCS_TEST_P(test_ucp_rma, blocking_put_get_mt) {
+    static const int    num_threads = 4;
+    static const size_t size        = 1024;
+    ucs_status_t status;
+
+    sender().connect(&receiver());
+    if (&sender() != &receiver()) {
+        receiver().connect(&sender());
+    }
+
+    ucp_mem_h memh;
+    void *memheap = NULL;
+    status = ucp_mem_map(receiver().ucph(), &memheap, num_threads * size,
+                         GetParam().variant, &memh);
+    ASSERT_UCS_OK(status);
+
+    void *rkey_buffer;
+    size_t rkey_buffer_size;
+    status = ucp_rkey_pack(receiver().ucph(), memh, &rkey_buffer,
+                           &rkey_buffer_size);
+    ASSERT_UCS_OK(status);
+
+    ucp_rkey_h rkey;
+    status = ucp_ep_rkey_unpack(sender().ep(), rkey_buffer, &rkey);
+    ASSERT_UCS_OK(status);
+    ucp_rkey_buffer_release(rkey_buffer);
+
+    /* Each thread puts and gets back its own part of the heap, while all of
+     * them share the sender endpoint and worker */
+    mt_rma_arg args[num_threads];
+    pthread_t threads[num_threads];
+    for (int i = 0; i < num_threads; ++i) {
+        args[i].ep     = sender().ep();
+        args[i].rkey   = rkey;
+        args[i].addr   = (uintptr_t)memheap + i * size;
+        args[i].size   = size;
+        args[i].errors = 0;
+        pthread_create(&threads[i], NULL, mt_rma_thread, &args[i]);
+    }
+
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(threads[i], NULL);
+        EXPECT_EQ(0u, args[i].errors) << "thread " << i;
+    }
+
+    ucp_rkey_destroy(rkey);
+    receiver().flush_worker();
+
+    disconnect(sender());
+    disconnect(receiver());
+
+    status = ucp_mem_unmap(receiver().ucph(), memh);
+    ASSERT_UCS_OK(status);
+}
+
 UCP_INSTANTIATE_TEST_CASE(test_ucp_rma)
 
@@ -449,6 +449,114 @@ UCS_TEST_P(test_ucp_tag_match, rndv_req_exp, "RNDV_THRESH=1048576") {
     request_release(my_recv_req);
 }
 
+UCS_TEST_P(test_ucp_tag_match, rndv_req_exp_async_memh, "RNDV_THRESH=1048576",
+           "MEM_REG_CHUNK=256k") {
+    static const size_t size = 4 * 1024 * 1024;
+    request *my_send_req, *my_recv_req;
+    ucp_mem_h send_memh, recv_memh;
+    ucs_status_t status;
+    void *ptr;
+
+    std::vector<char> sendbuf(size, 0);
+    std::vector<char> recvbuf(size, 0);
+
+    if (&sender() == &receiver()) {
+        UCS_TEST_SKIP_R("loop-back unsupported");
+    }
+
+    ucs::fill_random(sendbuf);
+
+    /* Both buffers are registered in the background, and the receiver gets
+     * the data to the chunks of its buffer as soon as they are registered */
+    ptr    = &sendbuf[0];
+    status = ucp_mem_map(sender().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC,
+                         &send_memh);
+    ASSERT_EQ(UCS_INPROGRESS, status);
+
+    ptr    = &recvbuf[0];
+    status = ucp_mem_map(receiver().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC,
+                         &recv_memh);
+    ASSERT_EQ(UCS_INPROGRESS, status);
+
+    my_recv_req = recv_nb(&recvbuf[0], recvbuf.size(), DATATYPE, 0x1337, 0xffff);
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(my_recv_req));
+
+    my_send_req = send_nb(&sendbuf[0], sendbuf.size(), DATATYPE, 0x111337);
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(my_send_req));
+
+    wait(my_recv_req);
+    while (!my_send_req->completed) {
+        progress();
+    }
+
+    EXPECT_EQ(sendbuf.size(),      my_recv_req->info.length);
+    EXPECT_EQ((ucp_tag_t)0x111337, my_recv_req->info.sender_tag);
+    EXPECT_EQ(sendbuf, recvbuf);
+    EXPECT_EQ(UCS_OK, my_send_req->status);
+
+    request_release(my_send_req);
+    request_release(my_recv_req);
+
+    status = ucp_mem_unmap(receiver().ucph(), recv_memh);
+    ASSERT_UCS_OK(status);
+    status = ucp_mem_unmap(sender().ucph(), send_memh);
+    ASSERT_UCS_OK(status);
+}
+
+UCS_TEST_P(test_ucp_tag_match, rndv_req_exp_async_memh_unmap,
+           "RNDV_THRESH=1048576", "MEM_REG_CHUNK=256k") {
+    static const size_t size = 4 * 1024 * 1024;
+    request *my_send_req, *my_recv_req;
+    ucp_mem_h send_memh, recv_memh;
+    ucs_status_t status;
+    void *ptr;
+
+    std::vector<char> sendbuf(size, 0);
+    std::vector<char> recvbuf(size, 0);
+
+    if (&sender() == &receiver()) {
+        UCS_TEST_SKIP_R("loop-back unsupported");
+    }
+
+    ucs::fill_random(sendbuf);
+
+    ptr    = &sendbuf[0];
+    status = ucp_mem_map(sender().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC,
+                         &send_memh);
+    ASSERT_EQ(UCS_INPROGRESS, status);
+
+    ptr    = &recvbuf[0];
+    status = ucp_mem_map(receiver().ucph(), &ptr, size, UCP_MEM_MAP_ASYNC,
+                         &recv_memh);
+    ASSERT_EQ(UCS_INPROGRESS, status);
+
+    my_recv_req = recv_nb(&recvbuf[0], recvbuf.size(), DATATYPE, 0x1337, 0xffff);
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(my_recv_req));
+
+    my_send_req = send_nb(&sendbuf[0], sendbuf.size(), DATATYPE, 0x111337);
+    ASSERT_TRUE(!UCS_PTR_IS_ERR(my_send_req));
+
+    /* The handles are unmapped while the transfer may still use them, and the
+     * requests keep them registered until they complete */
+    short_progress_loop();
+    status = ucp_mem_unmap(sender().ucph(), send_memh);
+    ASSERT_UCS_OK(status);
+    status = ucp_mem_unmap(receiver().ucph(), recv_memh);
+    ASSERT_UCS_OK(status);
+
+    wait(my_recv_req);
+    while (!my_send_req->completed) {
+        progress();
+    }
+
+    EXPECT_EQ(sendbuf.size(), my_recv_req->info.length);
+    EXPECT_EQ(sendbuf, recvbuf);
+    EXPECT_EQ(UCS_OK, my_send_req->status);
+
+    request_release(my_send_req);
+    request_release(my_recv_req);
+}
+
 UCS_TEST_P(test_ucp_tag_match, rndv_rts_unexp, "RNDV_THRESH=1048576") {
     static const size_t size = 1148576;
     request *my_send_req;
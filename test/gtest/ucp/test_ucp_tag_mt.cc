@@ -0,0 +1,143 @@
+/**
+* Copyright (C) Mellanox Technologies Ltd. 2001-2016.  ALL RIGHTS RESERVED.
+*
+* See file LICENSE for terms.
+*/
+
+#include "test_ucp_tag.h"
+
+#include <common/test_helpers.h>
+extern "C" {
+#include <ucs/arch/atomic.h>
+}
+
+
+class test_ucp_tag_mt : public test_ucp_tag {
+public:
+    using test_ucp_tag::get_ctx_params;
+
+protected:
+    static const int      NUM_THREADS = 4;
+    static const unsigned MAX_LENGTH  = 2000;
+
+    class thread {
+    public:
+        thread(test_ucp_tag_mt *test, int index, bool is_sender) :
+            m_test(test), m_index(index), m_is_sender(is_sender) {
+            pthread_create(&m_thread, NULL, run, reinterpret_cast<void*>(this));
+        }
+
+        void join() {
+            void *retval;
+            pthread_join(m_thread, &retval);
+        }
+
+    private:
+        static void *run(void *arg) {
+            thread *self = reinterpret_cast<thread*>(arg);
+            if (self->m_is_sender) {
+                self->m_test->send_messages(self->m_index);
+            } else {
+                self->m_test->recv_messages(self->m_index);
+            }
+            return NULL;
+        }
+
+        test_ucp_tag_mt *m_test;
+        int             m_index;
+        bool            m_is_sender;
+        pthread_t       m_thread;
+    };
+
+    static size_t msg_length(unsigned iter) {
+        return sizeof(uint64_t) * (1 + (iter % (MAX_LENGTH / sizeof(uint64_t))));
+    }
+
+    static uint64_t msg_value(int index, unsigned iter) {
+        return ((uint64_t)index << 32) | iter;
+    }
+
+    unsigned num_iters() const {
+        return 1000 / ucs::test_time_multiplier();
+    }
+
+    void wait_mt(request *req) {
+        while (!req->completed) {
+            progress();
+        }
+    }
+
+    void send_messages(int index) {
+        std::vector<uint64_t> sendbuf(MAX_LENGTH / sizeof(uint64_t));
+        request *req;
+
+        for (unsigned iter = 0; iter < num_iters(); ++iter) {
+            std::fill(sendbuf.begin(), sendbuf.end(), msg_value(index, iter));
+            req = (request*)ucp_tag_send_nb(sender().ep(), &sendbuf[0],
+                                            msg_length(iter), DATATYPE, index,
+                                            send_callback);
+            if (UCS_PTR_IS_ERR(req)) {
+                ucs_atomic_add32(&m_errors, 1);
+                return;
+            } else if (req != NULL) {
+                wait_mt(req);
+                request_release(req);
+            }
+        }
+    }
+
+    void recv_messages(int index) {
+        std::vector<uint64_t> recvbuf(MAX_LENGTH / sizeof(uint64_t));
+        request *req;
+
+        for (unsigned iter = 0; iter < num_iters(); ++iter) {
+            req = (request*)ucp_tag_recv_nb(receiver().worker(), &recvbuf[0],
+                                            MAX_LENGTH, DATATYPE, index,
+                                            (ucp_tag_t)-1, recv_callback);
+            if (UCS_PTR_IS_ERR(req) || (req == NULL)) {
+                ucs_atomic_add32(&m_errors, 1);
+                return;
+            }
+
+            wait_mt(req);
+            if ((req->status != UCS_OK) ||
+                (req->info.length != msg_length(iter)) ||
+                (req->info.sender_tag != (ucp_tag_t)index))
+            {
+                ucs_atomic_add32(&m_errors, 1);
+            } else {
+                for (size_t i = 0; i < msg_length(iter) / sizeof(uint64_t); ++i) {
+                    if (recvbuf[i] != msg_value(index, iter)) {
+                        ucs_atomic_add32(&m_errors, 1);
+                        break;
+                    }
+                }
+            }
+            request_release(req);
+        }
+    }
+
+    void run_threads() {
+        ucs::ptr_vector<thread> threads;
+
+        m_errors = 0;
+        for (int i = 0; i < NUM_THREADS; ++i) {
+            threads.push_back(new thread(this, i, false));
+            threads.push_back(new thread(this, i, true));
+        }
+
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads.at(i).join();
+        }
+
+        EXPECT_EQ(0u, m_errors);
+    }
+
+    volatile uint32_t m_errors;
+};
+
+UCS_TEST_P(test_ucp_tag_mt, send_recv_concurrent) {
+    run_threads();
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_tag_mt)
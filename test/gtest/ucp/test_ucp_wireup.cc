@@ -10,9 +10,16 @@
 
 #include <algorithm>
 
+#include <sys/socket.h>
+#include <sys/un.h>
+
 extern "C" {
+#include <ucp/core/ucp_ep.inl>
+#include <ucp/core/ucp_listener.h>
 #include <ucp/wireup/address.h>
 #include <ucp/proto/proto.h>
+#include <ucs/datastruct/mpool.inl>
+#include <ucs/time/time.h>
 }
 
 class test_ucp_wireup : public ucp_test {
@@ -50,8 +57,20 @@ protected:
 
     void disconnect(ucp_ep_h ep);
 
+    size_t set_num_lanes(ucp_ep_h ep, ucp_lane_index_t num_lanes);
+
     void waitall(std::vector<void*> reqs);
 
+    void listener_wireup(const std::string& sockaddr,
+                         bool stalled_client = false);
+
+    void sync_send_recv_nb(ucp_ep_h ep, ucp_worker_h worker,
+                           elem_type *recv_buffer, std::vector<void*>& reqs);
+
+    void connect_storm(size_t count, std::vector<ucp_ep_h>& reply_eps);
+
+    static void send_completion(void *request, ucs_status_t status);
+
 private:
     vec_type   m_send_data;
     vec_type   m_recv_data;
@@ -63,10 +82,10 @@ private:
 
     ucp_rkey_h get_rkey(ucp_mem_h memh);
 
-    static void send_completion(void *request, ucs_status_t status);
-
     static void recv_completion(void *request, ucs_status_t status,
                                 ucp_tag_recv_info_t *info);
+
+    static void accept_callback(ucp_ep_h ep, void *arg);
 };
 
 std::vector<ucp_test_param>
@@ -211,6 +230,11 @@ void test_ucp_wireup::recv_completion(void *request, ucs_status_t status,
 {
 }
 
+void test_ucp_wireup::accept_callback(ucp_ep_h ep, void *arg)
+{
+    *reinterpret_cast<ucp_ep_h*>(arg) = ep;
+}
+
 void test_ucp_wireup::send_recv(ucp_ep_h ep, ucp_worker_h worker,
                                 size_t length, int repeat)
 {
@@ -220,6 +244,63 @@ void test_ucp_wireup::send_recv(ucp_ep_h ep, ucp_worker_h worker,
     waitall(send_reqs);
 }
 
+void test_ucp_wireup::sync_send_recv_nb(ucp_ep_h ep, ucp_worker_h worker,
+                                        elem_type *recv_buffer,
+                                        std::vector<void*>& reqs)
+{
+    void *req;
+
+    req = ucp_tag_send_sync_nb(ep, &m_send_data[0], 1, DT_U64, TAG,
+                               send_completion);
+    ASSERT_FALSE(UCS_PTR_IS_ERR(req));
+    reqs.push_back(req);
+
+    req = ucp_tag_recv_nb(worker, recv_buffer, 1, DT_U64, TAG, (ucp_tag_t)-1,
+                          recv_completion);
+    ASSERT_FALSE(UCS_PTR_IS_ERR(req));
+    reqs.push_back(req);
+}
+
+void test_ucp_wireup::connect_storm(size_t count,
+                                    std::vector<ucp_ep_h>& reply_eps)
+{
+    entity& server = sender();
+    std::vector<void*> reqs;
+    vec_type recv_data(count);
+
+    while (entities().size() < count + 1) {
+        create_entity();
+    }
+
+    ucs_time_t start_time = ucs_get_time();
+
+    /* All peers connect at once, and their synchronous sends make the server
+     * create endpoints back to them */
+    for (size_t i = 0; i < count; ++i) {
+        entity& peer = entities().at(i + 1);
+        peer.connect(&server);
+        sync_send_recv_nb(peer.ep(), server.worker(), &recv_data[i], reqs);
+    }
+    waitall(reqs);
+    reqs.clear();
+
+    /* Reply on the endpoints created by the peers' requests */
+    for (size_t i = 0; i < count; ++i) {
+        entity& peer = entities().at(i + 1);
+        ucp_ep_h ep  = ucp_worker_get_reply_ep(server.worker(),
+                                               peer.worker()->uuid);
+        reply_eps.push_back(ep);
+        sync_send_recv_nb(ep, peer.worker(), &recv_data[i], reqs);
+    }
+    waitall(reqs);
+
+    UCS_TEST_MESSAGE << count << " peers connected in "
+                     << ucs_time_to_msec(ucs_get_time() - start_time) << " ms";
+
+    EXPECT_EQ(count, (size_t)std::count(recv_data.begin(), recv_data.end(),
+                                        elem_type(SEND_DATA)));
+}
+
 void test_ucp_wireup::disconnect(ucp_ep_h ep) {
     void *req = ucp_disconnect_nb(ep);
     if (!UCS_PTR_IS_PTR(req)) {
@@ -228,6 +309,36 @@ void test_ucp_wireup::disconnect(ucp_ep_h ep) {
     wait(req);
 }
 
+/* Move an unconnected endpoint to a configuration with the given number of
+ * lanes, and return its memory usage */
+size_t test_ucp_wireup::set_num_lanes(ucp_ep_h ep, ucp_lane_index_t num_lanes)
+{
+    ucp_worker_h worker = ep->worker;
+    ucp_ep_config_key_t key;
+    ucs_status_t status;
+
+    memset(&key, 0, sizeof(key));
+    key.am_lane          = UCP_NULL_LANE;
+    key.rndv_lane        = UCP_NULL_LANE;
+    key.wireup_msg_lane  = UCP_NULL_LANE;
+    key.num_lanes        = num_lanes;
+    memset(key.lanes, UCP_NULL_RESOURCE, sizeof(key.lanes));
+    memset(key.amo_lanes, UCP_NULL_LANE, sizeof(key.amo_lanes));
+
+    status = ucp_ep_set_cfg_index(ep, ucp_worker_get_ep_config(worker, &key));
+    EXPECT_UCS_OK(status);
+    EXPECT_EQ(num_lanes, ucp_ep_num_lanes(ep));
+
+    /* The lanes array is taken from the pool of its size */
+    EXPECT_EQ(&worker->ep_lanes_mp[num_lanes - 1],
+              ucs_mpool_obj_owner(ep->uct_eps));
+    for (ucp_lane_index_t lane = 0; lane < num_lanes; ++lane) {
+        EXPECT_TRUE(ep->uct_eps[lane] == NULL);
+    }
+
+    return ucp_ep_memory_usage(ep);
+}
+
 void test_ucp_wireup::waitall(std::vector<void*> reqs)
 {
     while (!reqs.empty()) {
@@ -236,17 +347,82 @@ void test_ucp_wireup::waitall(std::vector<void*> reqs)
     }
 }
 
+void test_ucp_wireup::listener_wireup(const std::string& sockaddr,
+                                      bool stalled_client)
+{
+    ucp_ep_h client_ep, server_ep = NULL;
+    ucp_listener_h listener;
+    char listener_addr[256];
+    ucs_status_t status;
+    int stalled_fd = -1;
+
+    if (GetParam().variant != TEST_TAG) {
+        UCS_TEST_SKIP_R("tag only");
+    }
+
+    status = ucp_listener_create(receiver().worker(), sockaddr.c_str(),
+                                 accept_callback, &server_ep, &listener);
+    ASSERT_UCS_OK(status);
+
+    status = ucp_listener_get_sockaddr(listener, listener_addr,
+                                       sizeof(listener_addr));
+    ASSERT_UCS_OK(status);
+
+    if (stalled_client) {
+        /* A client which connects and never sends its address */
+        std::string path = sockaddr.substr(UCP_SOCKADDR_UNIX_PREFIX_LEN);
+        struct sockaddr_un addr;
+
+        ASSERT_LT(path.size(), sizeof(addr.sun_path));
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        stalled_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        ASSERT_GE(stalled_fd, 0);
+        ASSERT_EQ(0, connect(stalled_fd, (struct sockaddr*)&addr,
+                             sizeof(addr)));
+    }
+
+    /* The listener replies without being progressed, and without waiting
+     * for other clients */
+    ucs_time_t start_time = ucs_get_time();
+    status = ucp_ep_create_sockaddr(sender().worker(), listener_addr,
+                                    &client_ep);
+    ASSERT_UCS_OK(status);
+    EXPECT_LT(ucs_time_to_sec(ucs_get_time() - start_time),
+              UCP_SOCKADDR_IO_TIMEOUT_SEC / 2.0);
+
+    if (stalled_fd >= 0) {
+        close(stalled_fd);
+    }
+
+    ucs_time_t deadline = ucs_get_time() + ucs_time_from_sec(10.0);
+    while ((server_ep == NULL) && (ucs_get_time() < deadline)) {
+        progress();
+    }
+    ASSERT_TRUE(server_ep != NULL);
+
+    send_recv(client_ep, receiver().worker(), 1, 1);
+    sender().flush_worker();
+    send_recv(server_ep, sender().worker(), 1, 1);
+    receiver().flush_worker();
+
+    ucp_listener_destroy(listener);
+}
+
 UCS_TEST_P(test_ucp_wireup, address) {
     ucs_status_t status;
     size_t size;
     void *buffer;
     unsigned order[UCP_MAX_RESOURCES];
 
-    status = ucp_address_pack(sender().worker(), NULL, -1, order, &size, &buffer);
+    status = ucp_address_pack(sender().worker(), NULL, -1, 0, order, &size,
+                              &buffer);
     ASSERT_UCS_OK(status);
     ASSERT_TRUE(buffer != NULL);
     ASSERT_GT(size, 0ul);
     EXPECT_LE(size, 512ul); /* Expect a reasonable address size */
+    EXPECT_EQ(size, ucp_address_length(buffer));
 
     char name[UCP_WORKER_NAME_MAX];
     uint64_t uuid;
@@ -259,9 +435,95 @@ UCS_TEST_P(test_ucp_wireup, address) {
     EXPECT_EQ(std::string(ucp_worker_get_name(sender().worker())), std::string(name));
     EXPECT_LE(address_count, static_cast<unsigned>(sender().ucph()->num_tls));
 
-    /* TODO test addresses */
+    /* Every transport should be unpacked with its own attributes and device
+     * address, also when those were deduplicated in the packed address */
+    ucp_context_h context = sender().ucph();
+    ucp_worker_h worker   = sender().worker();
+    for (ucp_rsc_index_t i = 0; i < context->num_tls; ++i) {
+        const uct_iface_attr_t *iface_attr = &worker->iface_attrs[i];
+        if (!(iface_attr->cap.flags & (UCT_IFACE_FLAG_CONNECT_TO_IFACE |
+                                       UCT_IFACE_FLAG_CONNECT_TO_EP))) {
+            continue;
+        }
+
+        ASSERT_LT(order[i], address_count);
+        const ucp_address_entry_t *ae = &address_list[order[i]];
+        EXPECT_EQ(context->tl_rscs[i].tl_name_csum, ae->tl_name_csum);
+        EXPECT_EQ(context->tl_rscs[i].md_index, ae->md_index);
+        EXPECT_EQ(iface_attr->priority, ae->iface_attr.priority);
+        EXPECT_FLOAT_EQ(iface_attr->bandwidth, ae->iface_attr.bandwidth);
+        EXPECT_EQ(iface_attr->cap.flags & UCP_ADDRESS_IFACE_FLAGS &
+                  ~(UCP_UCT_IFACE_ATOMIC32_FLAGS | UCP_UCT_IFACE_ATOMIC64_FLAGS),
+                  ae->iface_attr.cap_flags &
+                  ~(UCP_UCT_IFACE_ATOMIC32_FLAGS | UCP_UCT_IFACE_ATOMIC64_FLAGS));
+
+        ASSERT_EQ(iface_attr->device_addr_len, ae->dev_addr_len);
+        if (ae->dev_addr_len > 0) {
+            std::vector<char> dev_addr(ae->dev_addr_len);
+            ASSERT_UCS_OK(uct_iface_get_device_address(worker->ifaces[i],
+                                         (uct_device_addr_t*)&dev_addr[0]));
+            EXPECT_EQ(0, memcmp(&dev_addr[0], ae->dev_addr, ae->dev_addr_len));
+        }
+    }
+
+    ucs_free(address_list);
+    ucs_free(buffer);
+}
+
+UCS_TEST_P(test_ucp_wireup, short_address) {
+    ucs_status_t status;
+    void *buffer, *short_buffer;
+    size_t size, short_size;
+
+    status = ucp_address_pack(sender().worker(), NULL, -1, 0, NULL, &size,
+                              &buffer);
+    ASSERT_UCS_OK(status);
+    status = ucp_address_pack(sender().worker(), NULL, -1,
+                              UCP_ADDRESS_PACK_FLAG_SHORT, NULL,
+                              &short_size, &short_buffer);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(short_size, ucp_address_length(short_buffer));
+    EXPECT_LE(short_size, size);
+
+    char name[UCP_WORKER_NAME_MAX];
+    uint64_t uuid, short_uuid;
+    unsigned address_count, short_address_count;
+    ucp_address_entry_t *address_list, *short_address_list;
+
+    ucp_address_unpack(buffer, &uuid, name, sizeof(name), &address_count,
+                       &address_list);
+    ucp_address_unpack(short_buffer, &short_uuid, name, sizeof(name),
+                       &short_address_count, &short_address_list);
+    EXPECT_EQ(uuid, short_uuid);
+    ASSERT_EQ(address_count, short_address_count);
+    if (address_count > 0) {
+        EXPECT_LT(short_size, size);
+    }
+
+    /* The short address keeps everything but the performance estimations */
+    for (unsigned i = 0; i < address_count; ++i) {
+        const ucp_address_entry_t *ae  = &address_list[i];
+        const ucp_address_entry_t *sae = &short_address_list[i];
+        EXPECT_EQ(ae->tl_name_csum, sae->tl_name_csum);
+        EXPECT_EQ(ae->md_index,     sae->md_index);
+        EXPECT_EQ(ae->md_flags,     sae->md_flags);
+        EXPECT_EQ(ae->dev_addr_len, sae->dev_addr_len);
+        EXPECT_EQ(ae->tl_addr_len,  sae->tl_addr_len);
+        EXPECT_EQ(ae->iface_attr.cap_flags, sae->iface_attr.cap_flags);
+        EXPECT_EQ(ae->iface_attr.priority,  sae->iface_attr.priority);
+        EXPECT_EQ(0.0, sae->iface_attr.overhead);
+        EXPECT_GE(sae->iface_attr.bandwidth, ae->iface_attr.bandwidth);
+        if (ae->dev_addr_len > 0) {
+            EXPECT_EQ(0, memcmp(ae->dev_addr, sae->dev_addr, ae->dev_addr_len));
+        }
+        if (ae->tl_addr_len > 0) {
+            EXPECT_EQ(0, memcmp(ae->tl_addr, sae->tl_addr, ae->tl_addr_len));
+        }
+    }
 
+    ucs_free(short_address_list);
     ucs_free(address_list);
+    ucs_free(short_buffer);
     ucs_free(buffer);
 }
 
@@ -271,10 +533,12 @@ UCS_TEST_P(test_ucp_wireup, empty_address) {
     void *buffer;
     unsigned order[UCP_MAX_RESOURCES];
 
-    status = ucp_address_pack(sender().worker(), NULL, 0, order, &size, &buffer);
+    status = ucp_address_pack(sender().worker(), NULL, 0, 0, order, &size,
+                              &buffer);
     ASSERT_UCS_OK(status);
     ASSERT_TRUE(buffer != NULL);
     ASSERT_GT(size, 0ul);
+    EXPECT_EQ(size, ucp_address_length(buffer));
 
     char name[UCP_WORKER_NAME_MAX];
     uint64_t uuid;
@@ -298,6 +562,16 @@ UCS_TEST_P(test_ucp_wireup, one_sided_wireup) {
     sender().flush_worker();
 }
 
+UCS_TEST_P(test_ucp_wireup, short_address_wireup, "ADDRESS_SHORT=y") {
+    sender().connect(&receiver());
+    if (&sender() != &receiver()) {
+        receiver().connect(&sender());
+    }
+
+    send_recv(sender().ep(), receiver().worker(), 1, 1);
+    sender().flush_worker();
+}
+
 UCS_TEST_P(test_ucp_wireup, two_sided_wireup) {
     sender().connect(&receiver());
     if (&sender() != &receiver()) {
@@ -324,6 +598,21 @@ UCS_TEST_P(test_ucp_wireup, multi_wireup) {
     }
 }
 
+UCS_TEST_P(test_ucp_wireup, connect_storm) {
+    skip_loopback();
+
+    if (GetParam().variant != TEST_TAG) {
+        UCS_TEST_SKIP_R("tag only");
+    }
+
+    std::vector<ucp_ep_h> reply_eps;
+    connect_storm(ucs_max(64 / ucs::test_time_multiplier(), 2), reply_eps);
+
+    for (size_t i = 0; i < reply_eps.size(); ++i) {
+        ucp_ep_destroy(reply_eps[i]);
+    }
+}
+
 UCS_TEST_P(test_ucp_wireup, reply_ep_send_before) {
     skip_loopback();
 
@@ -341,6 +630,37 @@ UCS_TEST_P(test_ucp_wireup, reply_ep_send_before) {
     }
 }
 
+UCS_TEST_P(test_ucp_wireup, reply_ep_after_remote_destroy) {
+    skip_loopback();
+
+    if (GetParam().variant != TEST_TAG) {
+        UCS_TEST_SKIP_R("tag only");
+    }
+
+    std::vector<void*> reqs;
+    elem_type recv_data = 0;
+
+    /* The receiver gets an endpoint back to the sender by its request */
+    sender().connect(&receiver());
+    sync_send_recv_nb(sender().ep(), receiver().worker(), &recv_data, reqs);
+    waitall(reqs);
+    reqs.clear();
+
+    ucp_ep_h ep = ucp_worker_get_reply_ep(receiver().worker(),
+                                          sender().worker()->uuid);
+
+    /* After the sender has destroyed its endpoint, it can reply only if the
+     * receiver sends a wireup request again */
+    disconnect(sender().revoke_ep());
+
+    recv_data = 0;
+    sync_send_recv_nb(ep, sender().worker(), &recv_data, reqs);
+    waitall(reqs);
+    EXPECT_EQ(elem_type(SEND_DATA), recv_data);
+
+    ucp_ep_destroy(ep);
+}
+
 UCS_TEST_P(test_ucp_wireup, reply_ep_send_after) {
     skip_loopback();
 
@@ -499,4 +819,285 @@ UCS_TEST_P(test_ucp_wireup, disconnect_nb_onesided) {
 
 }
 
+UCS_TEST_P(test_ucp_wireup, lazy_one_sided_wireup, "EP_LAZY_CONNECT=y") {
+    sender().connect(&receiver());
+    EXPECT_TRUE(sender().ep()->flags & UCP_EP_FLAG_LAZY_CONNECT);
+
+    send_recv(sender().ep(), receiver().worker(), 1, 1);
+    if (GetParam().variant == TEST_TAG) {
+        EXPECT_FALSE(sender().ep()->flags & UCP_EP_FLAG_LAZY_CONNECT);
+    }
+    sender().flush_worker();
+}
+
+UCS_TEST_P(test_ucp_wireup, lazy_two_sided_wireup, "EP_LAZY_CONNECT=y") {
+    sender().connect(&receiver());
+    if (!is_loopback()) {
+        receiver().connect(&sender());
+    }
+
+    /* Receiver endpoint is connected by the wireup request of the sender */
+    send_recv(sender().ep(), receiver().worker(), 1, 1);
+    sender().flush_worker();
+    send_recv(receiver().ep(), sender().worker(), 1, 1);
+    receiver().flush_worker();
+    if (GetParam().variant == TEST_TAG) {
+        EXPECT_FALSE(receiver().ep()->flags & UCP_EP_FLAG_LAZY_CONNECT);
+    }
+}
+
+UCS_TEST_P(test_ucp_wireup, lazy_connect_failure, "EP_LAZY_CONNECT=y") {
+    if (GetParam().variant != TEST_TAG) {
+        UCS_TEST_SKIP_R("tag only");
+    }
+
+    unsigned order[UCP_MAX_RESOURCES];
+    ucs_status_t status;
+    size_t size;
+    void *buffer;
+    ucp_ep_h ep;
+
+    /* Address of a fake peer without any transports, so connect would fail */
+    status = ucp_address_pack(receiver().worker(), NULL, 0, 0, order, &size,
+                              &buffer);
+    ASSERT_UCS_OK(status);
+    *(uint64_t*)buffer = receiver().worker()->uuid ^ 0x5a5a5a5a5a5a5a5aull;
+
+    status = ucp_ep_create(sender().worker(), (ucp_address_t*)buffer, &ep);
+    ucs_free(buffer);
+    ASSERT_UCS_OK(status);
+    EXPECT_TRUE(ep->flags & UCP_EP_FLAG_LAZY_CONNECT);
+
+    /* The first send fails to connect, and every later one reports the same
+     * error instead of using an endpoint without lanes */
+    elem_type send_data = SEND_DATA;
+    std::vector<ucs_status_t> statuses;
+    disable_errors();
+    for (int i = 0; i < 3; ++i) {
+        void *req = ucp_tag_send_nb(ep, &send_data, 1, DT_U64, TAG,
+                                    send_completion);
+        ASSERT_TRUE(UCS_PTR_IS_ERR(req));
+        statuses.push_back(UCS_PTR_STATUS(req));
+    }
+    restore_errors();
+
+    EXPECT_NE(UCS_OK, statuses[0]);
+    EXPECT_EQ(statuses[0], statuses[1]);
+    EXPECT_EQ(statuses[0], statuses[2]);
+    EXPECT_FALSE(ep->flags & UCP_EP_FLAG_LAZY_CONNECT);
+    EXPECT_TRUE(ep->flags & UCP_EP_FLAG_FAILED);
+    EXPECT_EQ(statuses[0], ep->status);
+
+    disconnect(ep);
+}
+
+UCS_TEST_P(test_ucp_wireup, lazy_many_endpoints, "EP_LAZY_CONNECT=y") {
+    const size_t count = 4096 / ucs::test_time_multiplier();
+    std::vector<ucp_ep_h> eps;
+    ucp_address_t *address;
+    size_t address_length;
+    ucs_status_t status;
+
+    status = ucp_worker_get_address(receiver().worker(), &address,
+                                    &address_length);
+    ASSERT_UCS_OK(status);
+
+    /* Endpoints to fake peers, which are never used for communication */
+    std::vector<char> fake_address((char*)address, (char*)address + address_length);
+    uint64_t fake_uuid = receiver().worker()->uuid ^ 0x5a5a5a5a5a5a5a5aull;
+    ucp_worker_release_address(receiver().worker(), address);
+
+    ucs_time_t start_time = ucs_get_time();
+    for (size_t i = 0; i < count; ++i) {
+        ucp_ep_h ep;
+        *(uint64_t*)&fake_address[0] = fake_uuid + i;
+        status = ucp_ep_create(sender().worker(), (ucp_address_t*)&fake_address[0],
+                               &ep);
+        ASSERT_UCS_OK(status);
+        EXPECT_TRUE(ep->flags & UCP_EP_FLAG_LAZY_CONNECT);
+        eps.push_back(ep);
+    }
+    double elapsed = ucs_time_to_usec(ucs_get_time() - start_time);
+
+    UCS_TEST_MESSAGE << "created " << count << " endpoints in " << elapsed
+                     << " usec (" << (elapsed / count) << " usec per endpoint, "
+                     << ucp_ep_memory_usage(eps.front()) << " bytes each)";
+
+    /* The lanes array is resized with the configuration, so an endpoint with
+     * fewer lanes takes less memory */
+    ucp_ep_h ep        = eps.front();
+    uint16_t cfg_index = ep->cfg_index;
+    size_t max_size    = set_num_lanes(ep, UCP_MAX_LANES);
+    size_t min_size    = set_num_lanes(ep, 1);
+    EXPECT_LT(min_size, max_size);
+    EXPECT_EQ((UCP_MAX_LANES - 1) * sizeof(*ep->uct_eps), max_size - min_size);
+    status = ucp_ep_set_cfg_index(ep, cfg_index);
+    ASSERT_UCS_OK(status);
+    EXPECT_EQ(cfg_index, ep->cfg_index);
+
+    /* The real peer is connected on demand as well */
+    sender().connect(&receiver());
+    send_recv(sender().ep(), receiver().worker(), 1, 1);
+    sender().flush_worker();
+
+    for (size_t i = 0; i < count; ++i) {
+        disconnect(eps[i]);
+    }
+}
+
+UCS_TEST_P(test_ucp_wireup, listener_unix) {
+    std::stringstream ss;
+    ss << "unix:/tmp/ucp_test_listener." << getpid() << "." << rand();
+    listener_wireup(ss.str());
+}
+
+UCS_TEST_P(test_ucp_wireup, listener_stalled_client) {
+    std::stringstream ss;
+    ss << "unix:/tmp/ucp_test_listener." << getpid() << "." << rand();
+    listener_wireup(ss.str(), true);
+}
+
+UCS_TEST_P(test_ucp_wireup, listener_tcp) {
+    listener_wireup("127.0.0.1:0");
+}
+
+UCS_TEST_P(test_ucp_wireup, listener_unreachable) {
+    std::stringstream ss;
+    ucs_status_t status;
+    ucp_ep_h ep;
+
+    ss << "unix:/tmp/ucp_test_listener." << getpid() << "." << rand();
+    disable_errors();
+    status = ucp_ep_create_sockaddr(sender().worker(), ss.str().c_str(), &ep);
+    restore_errors();
+    EXPECT_EQ(UCS_ERR_UNREACHABLE, status);
+}
+
 UCP_INSTANTIATE_TEST_CASE(test_ucp_wireup)
+
+#if ENABLE_STATS
+class test_ucp_wireup_stats : public test_ucp_wireup {
+protected:
+    virtual void init() {
+        stats_activate();
+        test_ucp_wireup::init();
+    }
+
+    virtual void cleanup() {
+        test_ucp_wireup::cleanup();
+        stats_restore();
+    }
+
+    void stats_activate() {
+        ucs_stats_cleanup();
+        push_config();
+        modify_config("STATS_DEST",    "file:/dev/null");
+        modify_config("STATS_TRIGGER", "exit");
+        ucs_stats_init();
+        ASSERT_TRUE(ucs_stats_is_active());
+    }
+
+    void stats_restore() {
+        ucs_stats_cleanup();
+        pop_config();
+        ucs_stats_init();
+    }
+
+    static uint64_t counter(entity& e, unsigned index) {
+        return UCS_STATS_GET_COUNTER(e.worker()->stats, index);
+    }
+};
+
+UCS_TEST_P(test_ucp_wireup_stats, connect_storm) {
+    skip_loopback();
+
+    if (GetParam().variant != TEST_TAG) {
+        UCS_TEST_SKIP_R("tag only");
+    }
+
+    const size_t count = ucs_max(64 / ucs::test_time_multiplier(), 2);
+    std::vector<ucp_ep_h> reply_eps;
+
+    connect_storm(count, reply_eps);
+
+    entity& server = sender();
+    uint64_t peer_requests = 0, peer_acks = 0, peer_acks_skipped = 0;
+    for (size_t i = 0; i < count; ++i) {
+        entity& peer = entities().at(i + 1);
+        peer_requests     += counter(peer, UCP_WORKER_STAT_TX_WIREUP_REQUEST);
+        peer_acks         += counter(peer, UCP_WORKER_STAT_TX_WIREUP_ACK);
+        peer_acks_skipped += counter(peer,
+                                     UCP_WORKER_STAT_TX_WIREUP_ACK_SKIPPED);
+    }
+
+    uint64_t server_requests = counter(server,
+                                       UCP_WORKER_STAT_TX_WIREUP_REQUEST);
+    uint64_t server_replies  = counter(server, UCP_WORKER_STAT_TX_WIREUP_REPLY);
+    uint64_t server_implicit_ack =
+                    counter(server, UCP_WORKER_STAT_RX_WIREUP_IMPLICIT_ACK);
+
+    UCS_TEST_MESSAGE << count << " peers: " << peer_requests << " requests, "
+                     << server_replies << " replies, " << peer_acks
+                     << " acks, " << peer_acks_skipped << " acks carried by "
+                     << "a queued request";
+
+    /* Every peer sends one request. The server may send one request back to
+     * each peer after the connection is established, because the peer could
+     * have destroyed its endpoint by then. */
+    EXPECT_EQ(count, peer_requests);
+    EXPECT_LE(server_requests, count);
+
+    /* Every reply is acknowledged exactly once, either by an ack or by the
+     * synchronous send which was queued on the peer */
+    EXPECT_EQ(server_replies, peer_acks + server_implicit_ack);
+    EXPECT_EQ(peer_acks_skipped, server_implicit_ack);
+
+    for (size_t i = 0; i < count; ++i) {
+        ucp_ep_destroy(reply_eps[i]);
+    }
+}
+
+UCS_TEST_P(test_ucp_wireup_stats, connect_storm_p2p) {
+    skip_loopback();
+
+    if (GetParam().variant != TEST_TAG) {
+        UCS_TEST_SKIP_R("tag only");
+    }
+
+    const size_t count = ucs_max(64 / ucs::test_time_multiplier(), 2);
+    std::vector<ucp_ep_h> reply_eps;
+
+    connect_storm(count, reply_eps);
+
+    if (!ucp_ep_is_lane_p2p(reply_eps[0], ucp_ep_get_am_lane(reply_eps[0]))) {
+        for (size_t i = 0; i < count; ++i) {
+            ucp_ep_destroy(reply_eps[i]);
+        }
+        UCS_TEST_SKIP_R("AM lane is not p2p, so the server does not wait for "
+                        "acks and none can be skipped");
+    }
+
+    /* The sync send queued on each peer acknowledges the server's reply, so
+     * no separate ack is sent by anyone */
+    uint64_t peer_acks = 0, peer_acks_skipped = 0;
+    for (size_t i = 0; i < count; ++i) {
+        entity& peer = entities().at(i + 1);
+        peer_acks         += counter(peer, UCP_WORKER_STAT_TX_WIREUP_ACK);
+        peer_acks_skipped += counter(peer,
+                                     UCP_WORKER_STAT_TX_WIREUP_ACK_SKIPPED);
+    }
+
+    /* Replies are sent instead of requests */
+    EXPECT_EQ(0ul, counter(sender(), UCP_WORKER_STAT_TX_WIREUP_REQUEST));
+    EXPECT_EQ(count, counter(sender(), UCP_WORKER_STAT_TX_WIREUP_REPLY));
+    EXPECT_EQ(count, counter(sender(), UCP_WORKER_STAT_RX_WIREUP_IMPLICIT_ACK));
+    EXPECT_EQ(count, peer_acks_skipped);
+    EXPECT_EQ(0ul, peer_acks);
+
+    for (size_t i = 0; i < count; ++i) {
+        ucp_ep_destroy(reply_eps[i]);
+    }
+}
+
+UCP_INSTANTIATE_TEST_CASE(test_ucp_wireup_stats)
+#endif
@@ -210,8 +210,10 @@ class local_timer : public local,
                     public base_timer
 {
 public:
-    local_timer(ucs_async_mode_t mode) : local(mode), base_timer(mode) {
-        set_timer(&m_async, ucs_time_from_usec(1000));
+    local_timer(ucs_async_mode_t mode,
+                ucs_time_t interval = ucs_time_from_usec(1000)) :
+        local(mode), base_timer(mode) {
+        set_timer(&m_async, interval);
     }
 
     ~local_timer() {
@@ -219,6 +221,22 @@ public:
     }
 };
 
+class local_slow_event : public local_event {
+public:
+    local_slow_event(ucs_async_mode_t mode, unsigned delay_usec) :
+        local_event(mode), m_delay_usec(delay_usec) {
+    }
+
+protected:
+    virtual void ack_event() {
+        local_event::ack_event();
+        ucs::safe_usleep(m_delay_usec);
+    }
+
+private:
+    unsigned m_delay_usec;
+};
+
 class test_async : public testing::TestWithParam<ucs_async_mode_t>,
 public ucs::test_base {
 public:
@@ -479,6 +497,47 @@ UCS_TEST_P(test_async, ctx_timer_block) {
     EXPECT_GE(lt.count(), 1); /* Timer could expire again after unblock */
 }
 
+UCS_TEST_P(test_async, ctx_timer_precision) {
+    static const double INTERVAL_USEC = 100.0;
+
+    if (GetParam() == UCS_ASYNC_MODE_POLL) {
+        UCS_TEST_SKIP_R("poll mode");
+    }
+
+    local_timer lt(GetParam(), ucs_time_from_usec(INTERVAL_USEC));
+
+    int        start_count = lt.count();
+    ucs_time_t start_time  = ucs_get_time();
+    suspend(COUNT * 5);
+    double elapsed_usec    = ucs_time_to_usec(ucs_get_time() - start_time);
+    int count              = lt.count() - start_count;
+
+    UCS_TEST_MESSAGE << "requested interval " << INTERVAL_USEC << " usec, "
+                     << "average " << (elapsed_usec / ucs_max(count, 1))
+                     << " usec (" << count << " expirations)";
+    EXPECT_GE(count, elapsed_usec / INTERVAL_USEC / 10);
+}
+
+UCS_TEST_P(test_async, ctx_timer_slow_neighbor, "ASYNC_NUM_THREADS=2") {
+    if (GetParam() != UCS_ASYNC_MODE_THREAD) {
+        UCS_TEST_SKIP_R("not thread mode");
+    }
+
+    /* Contexts are created one after another, so they are assigned to
+     * different async threads */
+    local_slow_event le(GetParam(), COUNT * 4 * SLEEP_USEC *
+                                    ucs::test_time_multiplier());
+    local_timer lt(GetParam());
+
+    le.push_event();
+    suspend(COUNT); /* Let the slow handler start */
+
+    int count = lt.count();
+    suspend(COUNT * 2);
+    EXPECT_EQ(1, le.count());
+    EXPECT_GE(lt.count() - count, COUNT / 4);
+}
+
 typedef test_async_mt<local_event> test_async_event_mt;
 typedef test_async_mt<local_timer> test_async_timer_mt;
 
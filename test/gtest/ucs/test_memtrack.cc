@@ -99,6 +99,56 @@ UCS_TEST_F(test_memtrack, parse_dump) {
     free(buf);
 }
 
+UCS_TEST_F(test_memtrack, hot_path) {
+    void *a, *b;
+
+    EXPECT_EQ(0u, ucs_memtrack_num_allocs());
+
+    a = ucs_malloc(ALLOC_SIZE, ALLOC_NAME);
+    UCS_MEMTRACK_HOT_PATH_ENTER();
+    b = ucs_malloc(ALLOC_SIZE, ALLOC_NAME);
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    ucs_free(b);
+    ucs_free(a);
+
+    /* Counters are cumulative, so released allocations are counted as well */
+    EXPECT_EQ(2u, ucs_memtrack_num_allocs());
+    EXPECT_EQ(1u, ucs_memtrack_num_hot_path_allocs());
+}
+
+UCS_TEST_F(test_memtrack, sites) {
+    static const int NUM_ALLOCS = 3;
+    std::string report;
+    void *ptr;
+    char *buf;
+    size_t size;
+
+    modify_config("MEMTRACK_SITES", "y");
+    for (int i = 0; i < NUM_ALLOCS; ++i) {
+        ptr = ucs_malloc(100, ALLOC_NAME);
+        ucs_free(ptr);
+    }
+    UCS_MEMTRACK_HOT_PATH_ENTER();
+    ptr = ucs_malloc(ALLOC_SIZE, ALLOC_NAME);
+    UCS_MEMTRACK_HOT_PATH_EXIT();
+    ucs_free(ptr);
+
+    FILE* tempf = open_memstream(&buf, &size);
+    ucs_memtrack_dump(tempf);
+    fclose(tempf);
+    report = buf;
+    free(buf);
+
+    /* Sites are sorted by hot-path allocations. 100 bytes fall into the bin of
+     * sizes from 64 to 127, and ALLOC_SIZE into the bin from 8192. */
+    size_t hot_site = report.find("8192:1");
+    size_t site     = report.find("64:" + ucs::to_string(NUM_ALLOCS));
+    ASSERT_NE(std::string::npos, report.find("call site")) << report;
+    ASSERT_NE(std::string::npos, hot_site) << report;
+    ASSERT_NE(std::string::npos, site) << report;
+    EXPECT_LT(hot_site, site) << report;
+}
+
 UCS_TEST_F(test_memtrack, malloc_realloc) {
     void* ptr;
 
@@ -55,6 +55,28 @@ public:
     void test_header(ucs_profile_header_t *hdr, unsigned exp_mode);
     void test_locations(ucs_profile_location_t *locations, unsigned num_locations,
                         uint64_t exp_count);
+    void test_thread(ucs_profile_thread_header_t *thread_hdr,
+                     ucs_profile_location_t *locations, unsigned num_locations,
+                     uint64_t exp_count, uint64_t exp_num_records);
+
+    /* Return the header of the section which follows @a thread_hdr */
+    static ucs_profile_thread_header_t*
+    next_thread(ucs_profile_thread_header_t *thread_hdr, unsigned num_locations) {
+        return reinterpret_cast<ucs_profile_thread_header_t*>(
+                        thread_records(thread_hdr, num_locations) +
+                        thread_hdr->num_records);
+    }
+
+    static ucs_profile_thread_location_t*
+    thread_locations(ucs_profile_thread_header_t *thread_hdr) {
+        return reinterpret_cast<ucs_profile_thread_location_t*>(thread_hdr + 1);
+    }
+
+    static ucs_profile_record_t*
+    thread_records(ucs_profile_thread_header_t *thread_hdr, unsigned num_locations) {
+        return reinterpret_cast<ucs_profile_record_t*>(
+                        thread_locations(thread_hdr) + num_locations);
+    }
 };
 
 const char* test_profile::UCS_PROFILE_FILENAME = "test.prof";
@@ -82,6 +104,7 @@ const int test_profile::MAX_LINE = __LINE__;
 
 void test_profile::test_header(ucs_profile_header_t *hdr, unsigned exp_mode)
 {
+    EXPECT_EQ(UCS_PROFILE_FILE_VERSION,         hdr->version);
     EXPECT_EQ(std::string(ucs_get_host_name()), std::string(hdr->hostname));
     EXPECT_EQ(getpid(),                         (pid_t)hdr->pid);
     EXPECT_EQ(exp_mode,                         hdr->mode);
@@ -109,6 +132,39 @@ void test_profile::test_locations(ucs_profile_location_t *locations,
     EXPECT_NE(loc_names.end(), loc_names.find("sum"));
 }
 
+void test_profile::test_thread(ucs_profile_thread_header_t *thread_hdr,
+                               ucs_profile_location_t *locations,
+                               unsigned num_locations, uint64_t exp_count,
+                               uint64_t exp_num_records)
+{
+    ucs_profile_thread_location_t *counters = thread_locations(thread_hdr);
+    for (unsigned i = 0; i < num_locations; ++i) {
+        EXPECT_EQ(exp_count, counters[i].count);
+    }
+
+    EXPECT_EQ(exp_num_records, thread_hdr->num_records);
+    ucs_profile_record_t *records = thread_records(thread_hdr, num_locations);
+    int nesting = 0;
+    for (uint64_t i = 0; i < thread_hdr->num_records; ++i) {
+        ucs_profile_record_t *rec = &records[i];
+        EXPECT_LT(rec->location, num_locations);
+        if (i > 0) {
+            EXPECT_GE(rec->timestamp, records[i - 1].timestamp);
+        }
+
+        /* Scopes of each thread are properly nested */
+        if (rec->location >= num_locations) {
+            continue;
+        } else if (locations[rec->location].type == UCS_PROFILE_TYPE_SCOPE_BEGIN) {
+            ++nesting;
+        } else if (locations[rec->location].type == UCS_PROFILE_TYPE_SCOPE_END) {
+            --nesting;
+        }
+        EXPECT_GE(nesting, 0);
+    }
+    EXPECT_EQ(0, nesting);
+}
+
 UCS_TEST_F(test_profile, accum) {
     scoped_profile p(*this, UCS_PROFILE_FILENAME, "accum");
     profile_test_func1();
@@ -119,11 +175,16 @@ UCS_TEST_F(test_profile, accum) {
     test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_ACCUM));
 
     EXPECT_EQ(9u, hdr->num_locations);
-    test_locations(reinterpret_cast<ucs_profile_location_t*>(hdr + 1),
-                   hdr->num_locations,
-                   1);
+    ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
+    test_locations(locations, hdr->num_locations, 1);
 
     EXPECT_EQ(0u, hdr->num_records);
+    ASSERT_EQ(1u, hdr->num_threads);
+    ucs_profile_thread_header_t *thread_hdr =
+                    reinterpret_cast<ucs_profile_thread_header_t*>(locations +
+                                                                   hdr->num_locations);
+    EXPECT_EQ(ucs_get_tid(), (pid_t)thread_hdr->tid);
+    test_thread(thread_hdr, locations, hdr->num_locations, 1, 0);
 }
 
 UCS_TEST_F(test_profile, log) {
@@ -143,16 +204,201 @@ UCS_TEST_F(test_profile, log) {
     test_locations(locations, hdr->num_locations, 0);
 
     EXPECT_EQ(9 * ITER, (int)hdr->num_records);
-    ucs_profile_record_t *records = reinterpret_cast<ucs_profile_record_t*>(locations +
-                                                                            hdr->num_locations);
-    uint64_t prev_ts = records[0].timestamp;
-    for (uint64_t i = 0; i < hdr->num_records; ++i) {
-        ucs_profile_record_t *rec = &records[i];
-        EXPECT_GE(rec->location, 0u);
-        EXPECT_LT(rec->location, 9u);
-        EXPECT_GE(rec->timestamp, prev_ts);
-        prev_ts = rec->timestamp;
+    ASSERT_EQ(1u, hdr->num_threads);
+    ucs_profile_thread_header_t *thread_hdr =
+                    reinterpret_cast<ucs_profile_thread_header_t*>(locations +
+                                                                   hdr->num_locations);
+    EXPECT_EQ(ucs_get_tid(), (pid_t)thread_hdr->tid);
+    test_thread(thread_hdr, locations, hdr->num_locations, 0, 9 * ITER);
+}
+
+UCS_TEST_F(test_profile, dump_reset) {
+    scoped_profile p(*this, UCS_PROFILE_FILENAME, "accum,log");
+
+    for (int iter = 0; iter < 3; ++iter) {
+        /* The second dump finds no new data */
+        if (iter != 1) {
+            profile_test_func1();
+            profile_test_func2(1, 2);
+        }
+
+        std::string data = p.read();
+        ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+        unsigned exp_count = (iter != 1) ? 1 : 0;
+
+        EXPECT_EQ(9u, hdr->num_locations);
+        ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
+        test_locations(locations, hdr->num_locations, exp_count);
+
+        EXPECT_EQ(9u * exp_count, hdr->num_records);
+        ASSERT_EQ(1u, hdr->num_threads);
+        ucs_profile_thread_header_t *thread_hdr =
+                        reinterpret_cast<ucs_profile_thread_header_t*>(locations +
+                                                                       hdr->num_locations);
+        test_thread(thread_hdr, locations, hdr->num_locations, exp_count,
+                    9 * exp_count);
+    }
+}
+
+UCS_TEST_F(test_profile, sample) {
+    static const int ITER = 12;
+    modify_config("PROFILE_SAMPLE_RATE", "4");
+    scoped_profile p(*this, UCS_PROFILE_FILENAME, "accum,log");
+    for (int i = 0; i < ITER; ++i) {
+        profile_test_func1();
+    }
+
+    std::string data = p.read();
+    ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+
+    /* Nested events follow the decision of their top-level scope */
+    ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
+    for (unsigned i = 0; i < hdr->num_locations; ++i) {
+        std::string function = locations[i].function;
+        if (function.find("profile_test_func1") == 0) {
+            EXPECT_EQ(size_t(ITER / 4), locations[i].count) << function;
+        } else {
+            EXPECT_EQ(0u, locations[i].count) << function;
+        }
+    }
+
+    EXPECT_EQ(5u * ITER / 4, hdr->num_records);
+}
+
+class test_profile_stream : public test_profile {
+protected:
+    static const int ITER = 20;
+
+    static std::string stream_file_name(unsigned index) {
+        return std::string(UCS_PROFILE_FILENAME) + "." +
+               ucs::to_string(index);
+    }
+
+    /* Record events for a few stream intervals, and stop profiling */
+    void record_events(const char *num_files) {
+        modify_config("PROFILE_STREAM_INTERVAL", "5ms");
+        modify_config("PROFILE_STREAM_FILES", num_files);
+        scoped_profile p(*this, UCS_PROFILE_FILENAME, "log");
+        for (int i = 0; i < ITER; ++i) {
+            profile_test_func1();
+            profile_test_func2(1, 2);
+            usleep(2000);
+        }
+        ucs_profile_global_cleanup();
+    }
+};
+
+UCS_TEST_F(test_profile_stream, flush) {
+    uint64_t num_records = 0;
+    uint64_t prev_timestamp = 0;
+    unsigned index;
+
+    record_events("0");
+
+    /* Every record appears exactly once, in time order across the files */
+    for (index = 0; ; ++index) {
+        std::ifstream f(stream_file_name(index).c_str());
+        if (!f) {
+            break;
+        }
+
+        std::string data((std::istreambuf_iterator<char>(f)),
+                         std::istreambuf_iterator<char>());
+        unlink(stream_file_name(index).c_str());
+
+        ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+        test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_LOG));
+        ASSERT_EQ(1u, hdr->num_threads);
+        ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
+        ucs_profile_thread_header_t *thread_hdr =
+                        reinterpret_cast<ucs_profile_thread_header_t*>(locations +
+                                                                       hdr->num_locations);
+        EXPECT_EQ(hdr->num_records, thread_hdr->num_records);
+
+        ucs_profile_record_t *records = thread_records(thread_hdr,
+                                                       hdr->num_locations);
+        for (uint64_t i = 0; i < thread_hdr->num_records; ++i) {
+            EXPECT_GE(records[i].timestamp, prev_timestamp);
+            prev_timestamp = records[i].timestamp;
+        }
+        num_records += thread_hdr->num_records;
+    }
+
+    EXPECT_GT(index, 1u);
+    EXPECT_EQ(9u * ITER, num_records);
+}
+
+UCS_TEST_F(test_profile_stream, rotate) {
+    std::set<unsigned> indices;
+
+    record_events("2");
+
+    /* Only the most recent files are kept */
+    for (unsigned index = 0; index < 10 * ITER; ++index) {
+        if (unlink(stream_file_name(index).c_str()) == 0) {
+            indices.insert(index);
+        }
+    }
+
+    ASSERT_EQ(2u, indices.size());
+    EXPECT_EQ(*indices.begin() + 1, *indices.rbegin());
+    EXPECT_GT(*indices.begin(), 0u);
+}
+
+class test_profile_mt : public test_profile {
+protected:
+    static const int NUM_THREADS = 4;
+    static const int ITER        = 10;
+
+    static void *profile_thread_func(void *arg) {
+        pid_t *tid = reinterpret_cast<pid_t*>(arg);
+
+        *tid = ucs_get_tid();
+        for (int i = 0; i < ITER; ++i) {
+            profile_test_func1();
+            profile_test_func2(1, 2);
+        }
+        return NULL;
+    }
+};
+
+UCS_TEST_F(test_profile_mt, accum_log) {
+    scoped_profile p(*this, UCS_PROFILE_FILENAME, "accum,log");
+    pthread_t threads[NUM_THREADS];
+    std::set<pid_t> tids;
+    pid_t thread_tids[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, profile_thread_func, &thread_tids[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        tids.insert(thread_tids[i]);
+    }
+
+    std::string data = p.read();
+    ucs_profile_header_t *hdr = reinterpret_cast<ucs_profile_header_t*>(&data[0]);
+    test_header(hdr, UCS_BIT(UCS_PROFILE_MODE_ACCUM) | UCS_BIT(UCS_PROFILE_MODE_LOG));
+
+    /* Location counters are summed over all threads */
+    EXPECT_EQ(9u, hdr->num_locations);
+    ucs_profile_location_t *locations = reinterpret_cast<ucs_profile_location_t*>(hdr + 1);
+    for (unsigned i = 0; i < hdr->num_locations; ++i) {
+        EXPECT_EQ(size_t(NUM_THREADS * ITER), locations[i].count);
+    }
+
+    /* Every thread has its own section */
+    EXPECT_EQ(9u * NUM_THREADS * ITER, hdr->num_records);
+    ASSERT_EQ(unsigned(NUM_THREADS), hdr->num_threads);
+    ucs_profile_thread_header_t *thread_hdr =
+                    reinterpret_cast<ucs_profile_thread_header_t*>(locations +
+                                                                   hdr->num_locations);
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        EXPECT_EQ(1u, tids.erase(thread_hdr->tid));
+        test_thread(thread_hdr, locations, hdr->num_locations, ITER, 9 * ITER);
+        thread_hdr = next_thread(thread_hdr, hdr->num_locations);
     }
+    EXPECT_EQ((char*)thread_hdr, &data[0] + data.size());
 }
 
 #endif
@@ -7,6 +7,7 @@
 #include <common/test.h>
 extern "C" {
 #include <ucs/stats/stats.h>
+#include <ucs/arch/cpu.h>
 }
 
 #include <sys/socket.h>
@@ -17,11 +18,22 @@ extern "C" {
 class stats_test : public ucs::test {
 public:
 
-    template <unsigned N>
-    struct stats_class {
-        ucs_stats_class_t cls;
-        const char        *counter_names[N];
-    };
+    /* Classes are never released, since stats dumped on exit refer to them */
+    static ucs_stats_class_t *new_class(const char *name,
+                                        unsigned num_counters,
+                                        const char **counter_names,
+                                        unsigned num_histograms = 0,
+                                        const char **histogram_names = NULL) {
+        ucs_stats_class_t *cls = (ucs_stats_class_t*)
+                        malloc(sizeof(*cls) + num_counters * sizeof(const char*));
+        cls->name            = name;
+        cls->num_counters    = num_counters;
+        cls->num_histograms  = num_histograms;
+        cls->histogram_names = histogram_names;
+        std::copy(counter_names, counter_names + num_counters,
+                  cls->counter_names);
+        return cls;
+    }
 
     virtual void init() {
         ucs::test::init();
@@ -44,19 +56,22 @@ public:
     virtual std::string stats_trigger_config() = 0;
 
     void prepare_nodes() {
-        static stats_class<0> category_stats_class = {
-            {"category", 0, {}}
+        static const char *counter_names[] = {
+            "counter0", "counter1", "counter2", "counter3"
         };
-
-        static stats_class<4> data_stats_class = {
-            { "data", NUM_COUNTERS, {} },
-            { "counter0","counter1","counter2","counter3" }
+        static const char *histogram_names[] = {
+            "latency"
         };
+        static ucs_stats_class_t *category_stats_class =
+                        new_class("category", 0, NULL);
+        static ucs_stats_class_t *data_stats_class =
+                        new_class("data", NUM_COUNTERS, counter_names,
+                                  NUM_HISTOGRAMS, histogram_names);
 
-        ucs_status_t status = UCS_STATS_NODE_ALLOC(&cat_node, &category_stats_class.cls, NULL);
+        ucs_status_t status = UCS_STATS_NODE_ALLOC(&cat_node, category_stats_class, NULL);
         ASSERT_UCS_OK(status);
         for (unsigned i = 0; i < NUM_DATA_NODES; ++i) {
-            status = UCS_STATS_NODE_ALLOC(&data_nodes[i], &data_stats_class.cls,
+            status = UCS_STATS_NODE_ALLOC(&data_nodes[i], data_stats_class,
                                          cat_node, "-%d", i);
             ASSERT_UCS_OK(status);
 
@@ -64,6 +79,11 @@ public:
             UCS_STATS_UPDATE_COUNTER(data_nodes[i], 1, 20);
             UCS_STATS_UPDATE_COUNTER(data_nodes[i], 2, 30);
             UCS_STATS_UPDATE_COUNTER(data_nodes[i], 3, 40);
+
+            /* 1..100, so percentiles are known */
+            for (unsigned value = 1; value <= 100; ++value) {
+                UCS_STATS_UPDATE_HISTOGRAM(data_nodes[i], 0, value);
+            }
         }
 
         /* make sure our original node is ok */
@@ -93,16 +113,32 @@ public:
             EXPECT_EQ(unsigned(NUM_COUNTERS),  data_node->cls->num_counters);
             EXPECT_EQ(std::string("counter0"), std::string(data_node->cls->counter_names[0]));
 
-            EXPECT_EQ((unsigned)10, data_node->counters[0]);
-            EXPECT_EQ((unsigned)20, data_node->counters[1]);
-            EXPECT_EQ((unsigned)30, data_node->counters[2]);
-            EXPECT_EQ((unsigned)40, data_node->counters[3]);
+            EXPECT_EQ((unsigned)10, ucs_stats_node_counter(data_node, 0));
+            EXPECT_EQ((unsigned)20, ucs_stats_node_counter(data_node, 1));
+            EXPECT_EQ((unsigned)30, ucs_stats_node_counter(data_node, 2));
+            EXPECT_EQ((unsigned)40, ucs_stats_node_counter(data_node, 3));
+
+            ASSERT_EQ(unsigned(NUM_HISTOGRAMS), data_node->cls->num_histograms);
+            EXPECT_EQ(std::string("latency"),
+                      std::string(data_node->cls->histogram_names[0]));
+            ucs_stats_counter_t *buckets = ucs_stats_node_histogram(data_node, 0);
+            EXPECT_EQ(100u, ucs_stats_histogram_count(buckets));
+            check_near(50,  ucs_stats_histogram_percentile(buckets, 50.0));
+            check_near(99,  ucs_stats_histogram_percentile(buckets, 99.0));
+            check_near(100, ucs_stats_histogram_percentile(buckets, 100.0));
         }
     }
 
+    /* Reported value is the bucket lower bound */
+    static void check_near(uint64_t expected, uint64_t value) {
+        EXPECT_LE(value, expected);
+        EXPECT_GE(value, expected - (expected >> UCS_STATS_HISTOGRAM_SUB_BITS));
+    }
+
 protected:    
     static const unsigned NUM_DATA_NODES = 20;
     static const unsigned NUM_COUNTERS   = 4;
+    static const unsigned NUM_HISTOGRAMS = 1;
 
     ucs_stats_node_t       *cat_node;
     ucs_stats_node_t       *data_nodes[NUM_DATA_NODES];
@@ -122,9 +158,11 @@ public:
     }
 
     void wait_for_stats() {
-        do {
+        /* Statistics may be split to several packets */
+        while (ucs_list_is_empty(ucs_stats_server_get_stats(m_server))) {
             usleep(1000 * ucs::test_time_multiplier());
-        } while (ucs_stats_server_rcvd_packets(m_server) == 0);
+        }
+        ucs_stats_server_purge_stats(m_server);
     }
 
     virtual std::string stats_dest_config() {
@@ -235,6 +273,8 @@ public:
                 pos = data.find(value, pos);
                 EXPECT_NE(pos, std::string::npos) << value << " not found";
             }
+            pos = data.find("latency: count 100 p50 ", pos);
+            EXPECT_NE(pos, std::string::npos) << "latency histogram not found";
         }
         close_pipes();
     }
@@ -289,4 +329,152 @@ UCS_TEST_F(stats_on_exit_test, dump) {
     free_nodes();
 }
 
+class stats_sharded_test : public stats_file_test {
+public:
+    virtual void init() {
+        stats_file_test::init();
+        modify_config("STATS_SHARDS", ucs::to_string(unsigned(NUM_SHARDS)).c_str());
+    }
+
+protected:
+    static const unsigned NUM_SHARDS  = 3;
+    static const unsigned NUM_THREADS = 6;
+
+    static void *update_counters(void *arg) {
+        ucs_stats_node_t *node = reinterpret_cast<ucs_stats_node_t*>(arg);
+
+        for (unsigned i = 0; i < num_iters(); ++i) {
+            UCS_STATS_UPDATE_COUNTER(node, 0, 1);
+            UCS_STATS_UPDATE_COUNTER(node, 1, 2);
+        }
+        return NULL;
+    }
+
+    static unsigned num_iters() {
+        return 100000 / ucs::test_time_multiplier();
+    }
+};
+
+UCS_TEST_F(stats_sharded_test, concurrent_update) {
+    static const char *counter_names[] = { "counter0", "counter1" };
+    static ucs_stats_class_t *sharded_stats_class =
+                    new_class("sharded", 2, counter_names);
+    pthread_t threads[NUM_THREADS];
+    ucs_stats_node_t *node;
+
+    ucs_status_t status = UCS_STATS_NODE_ALLOC(&node, sharded_stats_class, NULL);
+    ASSERT_UCS_OK(status);
+    ASSERT_EQ(unsigned(NUM_SHARDS), node->num_shards);
+    EXPECT_EQ(0ul, (uintptr_t)node->shards % UCS_SYS_CACHE_LINE_SIZE);
+    EXPECT_EQ(0ul, node->shard_stride * sizeof(ucs_stats_counter_t) %
+                   UCS_SYS_CACHE_LINE_SIZE);
+
+    /* More threads than shards, so the last shard is shared */
+    for (unsigned i = 0; i < NUM_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, update_counters, node);
+    }
+    for (unsigned i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    EXPECT_EQ(NUM_THREADS * num_iters(), UCS_STATS_GET_COUNTER(node, 0));
+    EXPECT_EQ(NUM_THREADS * num_iters() * 2, UCS_STATS_GET_COUNTER(node, 1));
+    EXPECT_EQ(0u, node->counters[0]);
+
+    ucs_stats_dump();
+    UCS_STATS_NODE_FREE(node);
+
+    std::string data = get_data();
+    FILE *f = fmemopen(&data[0], data.size(), "rb");
+    ucs_stats_node_t *root;
+    status = ucs_stats_deserialize(f, &root);
+    ASSERT_UCS_OK(status);
+    fclose(f);
+
+    ASSERT_EQ(1ul, ucs_list_length(&root->children[UCS_STATS_ACTIVE_CHILDREN]));
+    ucs_stats_node_t *result = ucs_list_head(&root->children[UCS_STATS_ACTIVE_CHILDREN],
+                                             ucs_stats_node_t, list);
+    EXPECT_EQ(NUM_THREADS * num_iters(),     result->counters[0]);
+    EXPECT_EQ(NUM_THREADS * num_iters() * 2, result->counters[1]);
+    ucs_stats_free(root);
+}
+
+UCS_TEST_F(stats_sharded_test, set_and_max) {
+    static const char *counter_names[] = { "counter0", "counter1" };
+    static ucs_stats_class_t *sharded_stats_class =
+                    new_class("sharded_set", 2, counter_names);
+    pthread_t thread;
+    ucs_stats_node_t *node;
+
+    ucs_status_t status = UCS_STATS_NODE_ALLOC(&node, sharded_stats_class, NULL);
+    ASSERT_UCS_OK(status);
+    ASSERT_EQ(unsigned(NUM_SHARDS), node->num_shards);
+
+    /* Spread values over the shards of another thread and of this one */
+    pthread_create(&thread, NULL, update_counters, node);
+    pthread_join(thread, NULL);
+    UCS_STATS_UPDATE_COUNTER(node, 0, 1);
+    UCS_STATS_UPDATE_COUNTER(node, 1, 2);
+
+    /* A set value reads back as is, and only the shard of this thread is
+     * changed, so concurrent updates of other threads are not lost */
+    ASSERT_NE(0u, ucs_stats_thread_index);
+    unsigned own_shard = ucs_min(ucs_stats_thread_index, NUM_SHARDS) - 1;
+    std::vector<ucs_stats_counter_t> shards(node->shards,
+                                            node->shards + NUM_SHARDS *
+                                                           node->shard_stride);
+    UCS_STATS_SET_COUNTER(node, 0, 5);
+    EXPECT_EQ(5u, UCS_STATS_GET_COUNTER(node, 0));
+    for (unsigned i = 0; i < NUM_SHARDS; ++i) {
+        if (i != own_shard) {
+            EXPECT_EQ(shards[i * node->shard_stride],
+                      node->shards[i * node->shard_stride]) << "shard " << i;
+        }
+    }
+
+    /* Maximum is compared with the total value of the counter */
+    ucs_stats_counter_t total = UCS_STATS_GET_COUNTER(node, 1);
+    UCS_STATS_UPDATE_MAX(node, 1, total - 1);
+    EXPECT_EQ(total, UCS_STATS_GET_COUNTER(node, 1));
+    UCS_STATS_UPDATE_MAX(node, 1, total + 10);
+    EXPECT_EQ(total + 10, UCS_STATS_GET_COUNTER(node, 1));
+
+    UCS_STATS_NODE_FREE(node);
+}
+
+class stats_histogram_test : public ucs::test {
+};
+
+UCS_TEST_F(stats_histogram_test, buckets) {
+    unsigned prev_bucket = 0;
+
+    for (uint64_t value = 0; value < 100000; ++value) {
+        unsigned bucket = ucs_stats_histogram_bucket(value);
+        ASSERT_LT(bucket, (unsigned)UCS_STATS_HISTOGRAM_BUCKETS);
+        ASSERT_GE(bucket, prev_bucket);
+        ASSERT_LE(ucs_stats_histogram_bucket_value(bucket), value);
+        ASSERT_GT(ucs_stats_histogram_bucket_value(bucket + 1), value);
+        prev_bucket = bucket;
+    }
+
+    EXPECT_EQ(UCS_STATS_HISTOGRAM_BUCKETS - 1,
+              ucs_stats_histogram_bucket(UINT64_MAX));
+}
+
+UCS_TEST_F(stats_histogram_test, percentile) {
+    std::vector<ucs_stats_counter_t> buckets(UCS_STATS_HISTOGRAM_BUCKETS, 0);
+
+    EXPECT_EQ(0u, ucs_stats_histogram_percentile(&buckets[0], 99.0));
+
+    /* 990 fast samples and 10 slow ones */
+    buckets[ucs_stats_histogram_bucket(1000)]    += 990;
+    buckets[ucs_stats_histogram_bucket(1000000)] += 10;
+
+    EXPECT_EQ(1000u, ucs_stats_histogram_count(&buckets[0]));
+    EXPECT_EQ(ucs_stats_histogram_bucket_value(ucs_stats_histogram_bucket(1000)),
+              ucs_stats_histogram_percentile(&buckets[0], 99.0));
+    EXPECT_EQ(ucs_stats_histogram_bucket_value(ucs_stats_histogram_bucket(1000000)),
+              ucs_stats_histogram_percentile(&buckets[0], 99.9));
+}
+
 #endif
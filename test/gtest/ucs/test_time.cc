@@ -11,6 +11,7 @@ extern "C" {
 }
 
 #include <time.h>
+#include <map>
 
 class test_time : public ucs::test {
 };
@@ -144,3 +145,83 @@ UCS_TEST_F(test_time, timerq) {
 }
 
 
+
+UCS_TEST_F(test_time, timerq_wheel) {
+    static const unsigned NUM_TIMERS = 200;
+    static const unsigned NUM_SWEEPS = 2000;
+
+    std::map<int, ucs_time_t> intervals;   /* Expected timers */
+    std::map<int, ucs_time_t> expirations; /* Expected expiration times */
+    ucs_timer_queue_t timerq;
+    ucs_status_t status;
+    ucs_timer_t *timer;
+
+    status = ucs_timerq_init(&timerq);
+    ASSERT_UCS_OK(status);
+
+    ucs_time_t current_time = ((ucs_time_t)::rand() << 32) | ::rand();
+    int next_id             = 0;
+
+    for (unsigned sweep = 0; sweep < NUM_SWEEPS; ++sweep) {
+        /* Add and remove timers, with intervals from one tick to days */
+        while (intervals.size() < NUM_TIMERS) {
+            ucs_time_t interval = (::rand() % UCS_BIT(::rand() % 40)) + 1;
+            status = ucs_timerq_add(&timerq, next_id, interval);
+            ASSERT_UCS_OK(status);
+            intervals[next_id]   = interval;
+            expirations[next_id] = current_time; /* fires on next sweep */
+            ++next_id;
+        }
+
+        if (::rand() % 4 == 0) {
+            std::map<int, ucs_time_t>::iterator iter = intervals.begin();
+            std::advance(iter, ::rand() % intervals.size());
+            status = ucs_timerq_remove(&timerq, iter->first);
+            ASSERT_UCS_OK(status);
+            expirations.erase(iter->first);
+            intervals.erase(iter);
+        }
+
+        ucs_time_t min_interval = UCS_TIME_INFINITY;
+        ucs_time_t next_expiration = UCS_TIME_INFINITY;
+        for (std::map<int, ucs_time_t>::iterator iter = intervals.begin();
+             iter != intervals.end(); ++iter) {
+            min_interval    = std::min(min_interval, iter->second);
+            next_expiration = std::min(next_expiration,
+                                       expirations[iter->first]);
+        }
+        EXPECT_EQ(min_interval, ucs_timerq_min_interval(&timerq));
+        EXPECT_LE(ucs_timerq_next_expiration(&timerq), next_expiration);
+
+        /* Advance by a single tick, or jump far ahead */
+        current_time += (::rand() % UCS_BIT(::rand() % 32)) + 1;
+
+        std::map<int, ucs_time_t> fired;
+        ucs_timerq_for_each_expired(timer, &timerq, current_time) {
+            EXPECT_TRUE(fired.find(timer->id) == fired.end());
+            fired[timer->id] = current_time + timer->interval;
+        }
+
+        for (std::map<int, ucs_time_t>::iterator iter = expirations.begin();
+             iter != expirations.end(); ++iter) {
+            if (iter->second <= current_time) {
+                ASSERT_TRUE(fired.find(iter->first) != fired.end())
+                        << "timer " << iter->first << " did not fire";
+                iter->second = fired[iter->first];
+                fired.erase(iter->first);
+            }
+        }
+        EXPECT_TRUE(fired.empty()) << fired.size() << " timers fired early";
+    }
+
+    for (std::map<int, ucs_time_t>::iterator iter = intervals.begin();
+         iter != intervals.end(); ++iter) {
+        status = ucs_timerq_remove(&timerq, iter->first);
+        ASSERT_UCS_OK(status);
+    }
+
+    EXPECT_EQ(UCS_ERR_NO_ELEM, ucs_timerq_remove(&timerq, next_id));
+    EXPECT_TRUE(ucs_timerq_is_empty(&timerq));
+    EXPECT_EQ(UCS_TIME_INFINITY, ucs_timerq_next_expiration(&timerq));
+    ucs_timerq_cleanup(&timerq);
+}
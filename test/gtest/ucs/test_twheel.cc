@@ -227,6 +227,20 @@ UCS_TEST_F(twheel, add_overflow) {
 #endif
 }
 
+UCS_TEST_F(twheel, long_delay) {
+    struct hr_timer t;
+
+    /* Longer than the wheel range - must not fire before its time */
+    init_timer(&t, 0);
+    t.d = m_wheel.res * m_wheel.num_slots * 3;
+    add_timer(&t);
+    do {
+        ucs_twheel_sweep(&m_wheel, ucs_get_time());
+    } while (t.end_time == 0);
+
+    EXPECT_GE(t.end_time - t.start_time, t.d - 2 * m_wheel.res);
+}
+
 UCS_TEST_F(twheel, delayed_sweep) {
     std::vector<struct hr_timer> t(N_TIMERS);
 
@@ -10,6 +10,7 @@
 #include <gtest/common/test_perf.h>
 extern "C" {
 #include <ucs/arch/cpu.h>
+#include <tools/perf/libperf_int.h>
 }
 
 
@@ -18,6 +19,8 @@ extern "C" {
 class test_uct_perf : public uct_test, public test_perf {
 protected:
     static test_spec tests[];
+    static test_spec mt_tests[];
+    static test_spec group_tests[];
 };
 
 
@@ -102,6 +105,74 @@ test_perf::test_spec test_uct_perf::tests[] =
 };
 
 
+/* Multiple endpoints and worker-per-thread runs, performance is not checked */
+test_perf::test_spec test_uct_perf::mt_tests[] =
+{
+  { "am latency 4 eps", "usec",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_PINGPONG,
+    UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, latency.total_average), 1e6, 0.0, 1e6,
+    1, 4 },
+
+  { "am rate 4 eps", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    1, 4 },
+
+  { "put bcopy bw 3 eps", "MB/sec",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_PUT, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_BCOPY, 2048, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, bandwidth.total_average), MB, 0.0, 1e6,
+    1, 3 },
+
+  { "am rate 2 threads", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    2, 1 },
+
+  { "am rate 2 threads 2 eps", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_STREAM_UNI,
+    UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 100000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    2, 2 },
+
+  { NULL }
+};
+
+
+/* More than 2 processes, the receivers check the FIN message counts */
+test_perf::test_spec test_uct_perf::group_tests[] =
+{
+  { "am incast 3", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_INCAST,
+    UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, recv.msgrate), 1e-6, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 3 },
+
+  { "am incast 2 eps", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_INCAST,
+    UCT_PERF_DATA_LAYOUT_BCOPY, 64, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, recv.msgrate), 1e-6, 0.0, 1e6,
+    0, 2, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 4 },
+
+  { "am alltoall 3", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_ALLTOALL,
+    UCT_PERF_DATA_LAYOUT_SHORT, 8, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 3 },
+
+  { "am alltoall 4", "Mpps",
+    UCX_PERF_API_UCT, UCX_PERF_CMD_AM, UCX_PERF_TEST_TYPE_ALLTOALL,
+    UCT_PERF_DATA_LAYOUT_BCOPY, 64, 1, 10000l,
+    ucs_offsetof(ucx_perf_result_t, msgrate.total_average), 1e-6, 0.0, 1e6,
+    0, 0, UCP_PERF_DATATYPE_CONTIG, 1, UCP_PERF_CALL_MODE_BLOCKING, 4 },
+
+  { NULL }
+};
+
+
 UCS_TEST_P(test_uct_perf, envelope) {
     bool check_perf;
 
@@ -137,4 +208,114 @@ UCS_TEST_P(test_uct_perf, envelope) {
     }
 }
 
+UCS_TEST_P(test_uct_perf, multi_ep_mt_workers) {
+    if (GetParam()->tl_name == "cm" || GetParam()->tl_name == "ugni_udt") {
+        UCS_TEST_SKIP;
+    }
+
+    for (test_spec *test = mt_tests; test->title != NULL; ++test) {
+        run_test(*test, (test->thread_count > 1) ? UCX_PERF_TEST_FLAG_MT_WORKERS : 0,
+                 0, INT_MAX, GetParam()->tl_name, GetParam()->dev_name);
+    }
+}
+
+UCS_TEST_P(test_uct_perf, incast_alltoall) {
+    if (GetParam()->tl_name == "cm" || GetParam()->tl_name == "ugni_udt") {
+        UCS_TEST_SKIP;
+    }
+
+    for (test_spec *test = group_tests; test->title != NULL; ++test) {
+        run_test(*test, 0, test->min, test->max, GetParam()->tl_name,
+                 GetParam()->dev_name);
+    }
+}
+
+UCS_TEST_P(test_uct_perf, group_size_check) {
+    test_spec test = tests[0]; /* am latency */
+    ucs_status_t status;
+
+    /* Point-to-point tests require exactly 2 processes */
+    test.group_size = 3;
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM,
+              run_once(test, 0, GetParam()->tl_name, GetParam()->dev_name));
+
+    test.group_size = 1;
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM,
+              run_once(test, 0, GetParam()->tl_name, GetParam()->dev_name));
+
+    /* Incast requires at least 2 processes, and a single thread */
+    test            = group_tests[0];
+    test.iters      = 100;
+    test.group_size = 1;
+    EXPECT_EQ(UCS_ERR_INVALID_PARAM,
+              run_once(test, 0, GetParam()->tl_name, GetParam()->dev_name));
+
+    test.group_size   = 2;
+    test.thread_count = 2;
+    EXPECT_EQ(UCS_ERR_UNSUPPORTED,
+              run_once(test, 0, GetParam()->tl_name, GetParam()->dev_name));
+
+    /* Incast and all-to-all can run with 2 processes as well, unless the
+     * transport lacks the capabilities they need */
+    test.thread_count = 1;
+    status = run_once(test, 0, GetParam()->tl_name, GetParam()->dev_name);
+    if (status != UCS_ERR_UNSUPPORTED) {
+        EXPECT_UCS_OK(status);
+    }
+}
+
 UCT_INSTANTIATE_NO_SELF_TEST_CASE(test_uct_perf);
+
+
+class test_uct_perf_ep_order : public ucs::test {
+protected:
+    void init_perf(ucx_perf_context_t *perf, unsigned ep_count,
+                   ucx_perf_ep_order_t ep_order) {
+        perf->params.ep_count = ep_count;
+        perf->params.ep_order = ep_order;
+        perf->ep_index        = 0;
+        perf->ep_seed         = 1;
+    }
+};
+
+UCS_TEST_F(test_uct_perf_ep_order, round_robin) {
+    ucx_perf_context_t *perf = new ucx_perf_context_t();
+    static const unsigned ep_count = 3;
+
+    init_perf(perf, ep_count, UCX_PERF_EP_ORDER_ROUND_ROBIN);
+    for (unsigned i = 0; i < 2 * ep_count; ++i) {
+        EXPECT_EQ(i % ep_count, ucx_perf_next_ep_index(perf)) << "i=" << i;
+    }
+
+    delete perf;
+}
+
+UCS_TEST_F(test_uct_perf_ep_order, random) {
+    ucx_perf_context_t *perf = new ucx_perf_context_t();
+    static const unsigned ep_count = 4;
+    std::vector<unsigned> counts(ep_count, 0);
+
+    init_perf(perf, ep_count, UCX_PERF_EP_ORDER_RANDOM);
+    for (unsigned i = 0; i < 1000; ++i) {
+        unsigned index = ucx_perf_next_ep_index(perf);
+        ASSERT_LT(index, ep_count);
+        ++counts[index];
+    }
+
+    for (unsigned i = 0; i < ep_count; ++i) {
+        EXPECT_GT(counts[i], 0u) << "ep " << i << " was never selected";
+    }
+
+    delete perf;
+}
+
+UCS_TEST_F(test_uct_perf_ep_order, single_ep) {
+    ucx_perf_context_t *perf = new ucx_perf_context_t();
+
+    init_perf(perf, 1, UCX_PERF_EP_ORDER_RANDOM);
+    for (unsigned i = 0; i < 10; ++i) {
+        EXPECT_EQ(0u, ucx_perf_next_ep_index(perf));
+    }
+
+    delete perf;
+}